@@ -122,6 +122,12 @@ extern DL_IMPORT(void) PyEval_ReInitThreads(void);
 
 #endif /* !WITH_THREAD */
 
+/* How long, in microseconds, a thread may keep the interpreter while
+   another waits for it; and how long the current thread has had it. */
+extern unsigned long _PyEval_GetSwitchInterval(void);
+extern void _PyEval_SetSwitchInterval(unsigned long);
+extern unsigned long _PyEval_GetGILHeld(void);
+
 extern DL_IMPORT(int) _PyEval_SliceIndex(PyObject *, int *);
 
 
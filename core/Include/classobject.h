@@ -19,6 +19,7 @@ typedef struct {
     PyObject	*cl_getattr;
     PyObject	*cl_setattr;
     PyObject	*cl_delattr;
+    PyDictKeysObject *cl_keys;	/* Shared by the instance dicts */
 } PyClassObject;
 
 typedef struct {
@@ -26,8 +26,46 @@ typedef struct {
     PyObject *co_name;		/* string (name, for reference) */
     int co_firstlineno;		/* first source line number */
     PyObject *co_lnotab;	/* string (encoding addr<->lineno mapping) */
+    struct _globalcache *co_globalcache; /* LOAD_GLOBAL cache or NULL */
+    struct _attrcache *co_attrcache; /* LOAD_ATTR cache or NULL */
+    unsigned char *co_quickcode; /* co_code with specialized opcodes, or NULL */
+    int co_quickdeopts;		/* times a specialization was undone */
+    void *co_zombieframe;	/* for optimization only (see frameobject.c) */
+    PyObject *co_lazysource;	/* marshal data to load the body from, or NULL */
+    int co_lazyoffset;		/* where in co_lazysource the code starts */
 } PyCodeObject;
 
+/* Code objects nested in a .pyc are read without their body, and
+   co_code, co_consts, co_names, co_varnames and co_lnotab are only
+   loaded from the marshal data (see marshal.c) when they are first
+   needed.  Until then co_consts holds just the docstring, if any, and
+   the others are empty; call PyCode_LOAD() before using them.
+   PyFrame_New() does so for code that is about to run. */
+#define PyCode_LOAD(co) \
+	((co)->co_lazysource == NULL ? 0 : _PyCode_Load(co))
+
+/* LOAD_GLOBAL cache, one entry per co_names slot, allocated on first use.
+   An entry is valid while the globals and builtins dicts still have the
+   ma_version they had when it was filled (see ceval.c). */
+typedef struct _globalcache {
+    Py_dictversion_t gc_globals_version;
+    Py_dictversion_t gc_builtins_version;
+    PyObject *gc_value;		/* borrowed from one of the two dicts */
+} PyGlobalCacheEntry;
+
+/* LOAD_ATTR cache, likewise one entry per co_names slot.  It remembers
+   where the attribute was found for one type; an entry is valid while
+   _PyType_Epoch and the version of the type's tp_dict are unchanged. */
+typedef struct _attrcache {
+    PyTypeObject *ac_type;
+    Py_typeepoch_t ac_epoch;
+    Py_dictversion_t ac_version;	/* of ac_type->tp_dict */
+    PyObject *ac_descr;		/* borrowed from a dict in ac_type's MRO */
+    descrgetfunc ac_get;	/* ac_descr's tp_descr_get, or NULL */
+    int ac_hint;		/* entry in the instance dict for AC_DICT */
+    int ac_kind;		/* AC_xxx in ceval.c; 0 if unused */
+} PyAttrCacheEntry;
+
 /* Masks for co_flags above */
 #define CO_OPTIMIZED	0x0001
 #define CO_NEWLOCALS	0x0002
@@ -61,6 +99,7 @@ DL_IMPORT(PyCodeObject *) PyCode_New(
 	PyObject *, PyObject *, PyObject *, PyObject *, int, PyObject *); 
         /* same as struct above */
 DL_IMPORT(int) PyCode_Addr2Line(PyCodeObject *, int);
+extern int _PyCode_Load(PyCodeObject *);
 
 /* Future feature support */
 
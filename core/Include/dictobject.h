@@ -9,77 +9,117 @@ extern "C" {
 /* Dictionary object type -- mapping from hashable object to object */
 
 /*
-There are three kinds of slots in the table:
-
-1. Unused.  me_key == me_value == NULL
-   Does not hold an active (key, value) pair now and never did.  Unused can
-   transition to Active upon key insertion.  This is the only case in which
-   me_key is NULL, and is each slot's initial state.
-
-2. Active.  me_key != NULL and me_key != dummy and me_value != NULL
-   Holds an active (key, value) pair.  Active can transition to Dummy upon
-   key deletion.  This is the only case in which me_value != NULL.
-
-3. Dummy.  me_key == dummy and me_value == NULL
-   Previously held an active (key, value) pair, but that was deleted and an
-   active pair has not yet overwritten the slot.  Dummy can transition to
-   Active upon key insertion.  Dummy slots cannot be made Unused again
-   (cannot have me_key set to NULL), else the probe sequence in case of
-   collision would have no way to know they were once active.
-
-Note: .popitem() abuses the me_hash field of an Unused or Dummy slot to
-hold a search finger.  The me_hash field of Unused or Dummy slots has no
-meaning otherwise.
+A dict is made of a keys object and, for split tables only, a separate
+array of values.  The keys object holds an index table of dk_size slots
+(a power of 2), followed by a dense array of entries kept in insertion
+order.  Each index slot holds one of
+
+1. DKIX_EMPTY.  The slot was never used.  Probing stops here.
+
+2. DKIX_DUMMY.  The entry the slot pointed to was deleted.  Probing
+   continues past it, and it isn't reused until the table is rebuilt.
+
+3. The position of an entry in the entry array.
+
+The index table is what open addressing probes, so it is the only part
+that must stay sparse; its slots are 1, 2 or 4 bytes wide depending on
+dk_size, and the 3-word entries are only allocated up to the usable
+two-thirds of it.
+
+There are two kinds of tables:
+
+Combined: ma_values is NULL and the entries hold the values.  The keys
+   object belongs to the dict alone.  Deleting a key clears its entry and
+   marks its index slot DKIX_DUMMY.
+
+Split: the keys object is shared, through dk_refcnt, by the instance
+   dicts of one class, and each dict keeps its values in ma_values[],
+   parallel to the entries.  Only exact string keys go in a split table,
+   and its entries are only ever appended; a key this dict doesn't have is
+   a NULL in ma_values[].  Anything else converts the dict to a combined
+   table.
 */
 
-/* PyDict_MINSIZE is the minimum size of a dictionary.  This many slots are
- * allocated directly in the dict object (in the ma_smalltable member).
- * It must be a power of 2, and at least 4.  8 allows dicts with no more
- * than 5 active entries to live in ma_smalltable (and so avoid an
- * additional malloc); instrumentation suggested this suffices for the
- * majority of dicts (consisting mostly of usually-small instance dicts and
- * usually-small dicts created to pass keyword arguments).
+/* PyDict_MINSIZE is the smallest size of an index table.  It must be a
+ * power of 2, and at least 4.  8 allows dicts with no more than 5
+ * active entries; instrumentation suggested this suffices for the
+ * majority of dicts (consisting mostly of usually-small instance dicts
+ * and usually-small dicts created to pass keyword arguments).
  */
 #define PyDict_MINSIZE 8
 
 typedef struct {
 	long me_hash;      /* cached hash code of me_key */
 	PyObject *me_key;
-	PyObject *me_value;
+	PyObject *me_value; /* NULL in split tables and deleted entries */
 #ifdef USE_CACHE_ALIGNED
 	long	aligner;
 #endif
 } PyDictEntry;
 
-/*
-To ensure the lookup algorithm terminates, there must be at least one Unused
-slot (NULL key) in the table.
-The value ma_fill is the number of non-NULL keys (sum of Active and Dummy);
-ma_used is the number of non-NULL, non-dummy keys (== the number of non-NULL
-values == the number of Active items).
-To avoid slowing down lookups on a near-full table, we resize the table when
-it's two-thirds full.
-*/
 typedef struct _dictobject PyDictObject;
+typedef struct _dictkeysobject PyDictKeysObject;
+
+/* Find key in mp.  If it's there, return the position of its entry and
+ * set *value_addr to where its value is stored (which may hold NULL for
+ * a key in a split table that isn't in this dict); else return
+ * DKIX_EMPTY and set *value_addr to NULL.  Never raises, and outstanding
+ * exceptions are preserved.
+ */
+typedef int (*PyDictLookupFunc)(PyDictObject *mp, PyObject *key, long hash,
+				PyObject ***value_addr);
+
+#define DKIX_EMPTY (-1)
+#define DKIX_DUMMY (-2)
+
+struct _dictkeysobject {
+	int dk_refcnt;
+	int dk_size;		/* # index slots, a power of 2 */
+	PyDictLookupFunc dk_lookup;
+	int dk_usable;		/* # entries that can still be appended */
+	int dk_nentries;	/* # entries appended, including deleted ones */
+	/* dk_size indices, each as wide as needed to hold an entry
+	 * position, followed by the entries. */
+	union {
+		signed char as_1[PyDict_MINSIZE];
+		short as_2[1];
+		int as_4[1];
+		PyDictEntry *aligner;
+	} dk_indices;
+};
+
+#define _PyDict_IXSIZE(dk) \
+	((dk)->dk_size <= 0x80 ? 1 : (dk)->dk_size <= 0x8000 ? 2 : 4)
+#define _PyDict_ENTRIES(dk) \
+	((PyDictEntry *)((char *)&(dk)->dk_indices + \
+			 (dk)->dk_size * _PyDict_IXSIZE(dk)))
+/* The value of entry ix of mp, or NULL. */
+#define _PyDict_VALUE(mp, ix) \
+	((mp)->ma_values != NULL ? (mp)->ma_values[ix] : \
+	 _PyDict_ENTRIES((mp)->ma_keys)[ix].me_value)
+
+/* The type of ma_version.  A 32-bit counter could wrap in the life of a
+   long-running program and make a stale cached lookup look current, so
+   the counter is 64 bits wide wherever the compiler has such a type. */
+#ifdef HAVE_LONG_LONG
+typedef unsigned LONG_LONG Py_dictversion_t;
+#else
+typedef unsigned long Py_dictversion_t;
+#endif
+
 struct _dictobject {
 	PyObject_HEAD
-	int ma_fill;  /* # Active + # Dummy */
 	int ma_used;  /* # Active */
-
-	/* The table contains ma_mask + 1 slots, and that's a power of 2.
-	 * We store the mask instead of the size because the mask is more
-	 * frequently needed.
+	/* Changed on every mutation to a value no other dict has had, so
+	 * that lookup results can be cached against it.
 	 */
-	int ma_mask;
-
-	/* ma_table points to ma_smalltable for small tables, else to
-	 * additional malloc'ed memory.  ma_table is never NULL!  This rule
-	 * saves repeated runtime null-tests in the workhorse getitem and
-	 * setitem calls.
+	Py_dictversion_t ma_version;
+	/* ma_keys is never NULL!  An empty dict points to a static, empty
+	 * keys object.  This rule saves repeated runtime null-tests in the
+	 * workhorse getitem and setitem calls.
 	 */
-	PyDictEntry *ma_table;
-	PyDictEntry *(*ma_lookup)(PyDictObject *mp, PyObject *key, long hash);
-	PyDictEntry ma_smalltable[PyDict_MINSIZE];
+	PyDictKeysObject *ma_keys;
+	PyObject **ma_values;	/* NULL unless the table is split */
 };
 
   /* extern DL_IMPORT(const PyTypeObject) PyDict_Type; */
@@ -88,6 +128,7 @@ struct _dictobject {
 #define PyDictIter_Type ((PYTHON_GLOBALS->tobj).t_PyDictIter)
 
 #define PyDict_Check(op) PyObject_TypeCheck(op, &PyDict_Type)
+#define PyDict_CheckExact(op) ((op)->ob_type == &PyDict_Type)
 
 extern DL_IMPORT(PyObject *) PyDict_New(void);
 extern DL_IMPORT(PyObject *) PyDict_GetItem(PyObject *mp, PyObject *key);
@@ -128,6 +169,21 @@ extern DL_IMPORT(PyObject *) PyDict_GetItemString(PyObject *dp, const char *key)
 extern DL_IMPORT(int) PyDict_SetItemString(PyObject *dp, const char *key, PyObject *item);
 extern DL_IMPORT(int) PyDict_DelItemString(PyObject *dp, char *key);
 
+/* Instance dicts that share their keys with the other instances of a
+   class.  *pkeys is the class's slot for the keys; it starts out NULL and
+   is released with _PyDict_ReleaseSharedKeys().  Set attributes on such
+   a dict with _PyDict_SetItemShared() (value NULL deletes), so the class
+   can pick up a larger key table when the shared one fills up. */
+extern PyObject *_PyDict_NewShared(PyDictKeysObject **pkeys);
+extern int _PyDict_SetItemShared(PyDictKeysObject **pkeys,
+					    PyObject *dp, PyObject *key,
+					    PyObject *value);
+extern void _PyDict_ReleaseSharedKeys(PyDictKeysObject **pkeys);
+
+/* Free list of dict objects, see PyFreeListStats */
+extern PyFreeListStats *_PyDict_FreeListStats(long *bytes);
+extern long PyDict_ClearFreeList(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -50,6 +50,10 @@ extern DL_IMPORT(void) PyFloat_AsReprString(char*, PyFloatObject *v);
    preserve precision across conversions. */
 extern DL_IMPORT(void) PyFloat_AsString(char*, PyFloatObject *v);
 
+/* Free list of floats, see PyFreeListStats */
+extern PyFreeListStats *_PyFloat_FreeListStats(long *bytes);
+extern long PyFloat_ClearFreeList(void);
+
 #ifdef __cplusplus
 }
 #endif
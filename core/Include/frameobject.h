@@ -29,7 +29,8 @@ typedef struct _frame {
     PyObject *f_trace;		/* Trace function */
     PyObject *f_exc_type, *f_exc_value, *f_exc_traceback;
     PyThreadState *f_tstate;
-    int f_lasti;		/* Last instruction if called */
+    int f_lasti;		/* Current instruction (resume point if
+				   suspended by yield) */
     int f_lineno;		/* Current line number */
     int f_restricted;		/* Flag set if restricted operations
 				   in this scope */
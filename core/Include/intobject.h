@@ -41,6 +41,10 @@ extern DL_IMPORT(PyObject *) PyInt_FromLong(long);
 extern DL_IMPORT(long) PyInt_AsLong(PyObject *);
 extern DL_IMPORT(long) PyInt_GetMax(void);
 
+/* Free list of ints, see PyFreeListStats */
+extern PyFreeListStats *_PyInt_FreeListStats(long *bytes);
+extern long PyInt_ClearFreeList(void);
+
 
 /*
 False and True are special intobjects used by Boolean expressions.
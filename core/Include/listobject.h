@@ -45,6 +45,10 @@ extern DL_IMPORT(int) PyList_Sort(PyObject *);
 extern DL_IMPORT(int) PyList_Reverse(PyObject *);
 extern DL_IMPORT(PyObject *) PyList_AsTuple(PyObject *);
 
+/* Free list of list objects, see PyFreeListStats */
+extern PyFreeListStats *_PyList_FreeListStats(long *bytes);
+extern long PyList_ClearFreeList(void);
+
 /* Macro, trading safety for speed */
 #define PyList_GET_ITEM(op, i) (((PyListObject *)(op))->ob_item[i])
 #define PyList_SET_ITEM(op, i, v) (((PyListObject *)(op))->ob_item[i] = (v))
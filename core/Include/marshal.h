@@ -16,6 +16,7 @@ DL_IMPORT(long) PyMarshal_ReadLongFromFile(FILE *);
 DL_IMPORT(int) PyMarshal_ReadShortFromFile(FILE *);
 DL_IMPORT(PyObject *) PyMarshal_ReadObjectFromFile(FILE *);
 DL_IMPORT(PyObject *) PyMarshal_ReadLastObjectFromFile(FILE *);
+extern PyObject *PyMarshal_ReadLazyObjectFromFile(FILE *);
 DL_IMPORT(PyObject *) PyMarshal_ReadObjectFromString(char *, int);
 
 #ifdef __cplusplus
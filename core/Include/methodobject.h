@@ -18,6 +18,7 @@ typedef PyObject *(*PyCFunction)(PyObject *, PyObject *);
 typedef PyObject *(*PyCFunctionWithKeywords)(PyObject *, PyObject *,
 					     PyObject *);
 typedef PyObject *(*PyNoArgsFunction)(PyObject *);
+typedef PyObject *(*PyCFunctionFast)(PyObject *, PyObject **, int);
 
 extern DL_IMPORT(PyCFunction) PyCFunction_GetFunction(PyObject *);
 extern DL_IMPORT(PyObject *) PyCFunction_GetSelf(PyObject *);
@@ -55,6 +56,11 @@ extern DL_IMPORT(PyObject *) PyCFunction_New(const PyMethodDef *, PyObject *);
 /* METH_NOARGS and METH_O must not be combined with any other flag. */
 #define METH_NOARGS   0x0004
 #define METH_O        0x0008
+/* METH_FASTCALL functions are PyCFunctionFast: they get a pointer to
+   their (borrowed) positional arguments and their number, which saves
+   building an argument tuple when called from the eval loop.  It must
+   not be combined with any other flag either. */
+#define METH_FASTCALL 0x0080
 
 typedef struct PyMethodChain {
     PyMethodDef *methods;		/* Methods of this type */
@@ -19,6 +19,8 @@ extern DL_IMPORT(int) PyArg_UnpackTuple(PyObject *, char *, int, int, ...);
 extern DL_IMPORT(PyObject *) Py_BuildValue(char *, ...);
 
 extern DL_IMPORT(int) PyArg_VaParse(PyObject *, char *, va_list);
+/* For the core's METH_FASTCALL functions; not exported */
+extern int _PyArg_ParseStack(PyObject **, int, char *, ...);
 extern DL_IMPORT(PyObject *) Py_VaBuildValue(char *, va_list);
 
 extern DL_IMPORT(int) PyModule_AddObject(PyObject *, char *, PyObject *);
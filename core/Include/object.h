@@ -333,6 +333,27 @@ extern DL_IMPORT(PyObject *) PyType_GenericAlloc(PyTypeObject *, int);
 extern DL_IMPORT(PyObject *) PyType_GenericNew(PyTypeObject *,
 					       PyObject *, PyObject *);
 extern DL_IMPORT(PyObject *) _PyType_Lookup(PyTypeObject *, PyObject *);
+/* Where a heap type keeps the key table its instance dicts share, or NULL
+   for other types (see _PyDict_NewShared()) */
+extern struct _dictkeysobject **_PyType_SharedKeys(PyTypeObject *);
+
+/* Moves on whenever some type's attributes may have changed, invalidating
+   lookup results cached against it (see _PyType_Lookup() and LOAD_ATTR).
+   Caches key their entries on the type's address as well, and a type
+   allocated at the address of a dead one must not find its entries
+   current after the epoch wraps, so it is 64 bits wide where possible,
+   like the dict version (see dictobject.h). */
+#ifdef HAVE_LONG_LONG
+typedef unsigned LONG_LONG Py_typeepoch_t;
+#define _PyType_NewEpoch() ((void)++_PyType_Epoch)
+#else
+typedef unsigned long Py_typeepoch_t;
+#define _PyType_NewEpoch() \
+	((void)(++_PyType_Epoch != 0 || \
+		(Py_FatalError("type epoch overflow"), 0)))
+#endif
+  /* extern DL_IMPORT(Py_typeepoch_t) _PyType_Epoch; */
+#define _PyType_Epoch (PYTHON_GLOBALS->type_epoch)
 
 /* Generic operations on objects */
 extern DL_IMPORT(int) PyObject_Print(PyObject *, FILE *, int);
@@ -78,10 +78,17 @@ recommended to use PyObject_{New, NewVar, Del}. */
    modules should use the PyObject_* API. */
 
 #ifdef WITH_PYMALLOC
+#if defined(SYMBIAN) && !defined(Py_BUILD_CORE)
+/* Only the exported wrappers can be reached from outside the DLL */
+#define PyCore_OBJECT_MALLOC_FUNC    PyObject_Malloc
+#define PyCore_OBJECT_REALLOC_FUNC   PyObject_Realloc
+#define PyCore_OBJECT_FREE_FUNC      PyObject_Free
+#else
 #define PyCore_OBJECT_MALLOC_FUNC    _PyCore_ObjectMalloc
 #define PyCore_OBJECT_REALLOC_FUNC   _PyCore_ObjectRealloc
 #define PyCore_OBJECT_FREE_FUNC      _PyCore_ObjectFree
 #define NEED_TO_DECLARE_OBJECT_MALLOC_AND_FRIEND
+#endif
 #endif /* !WITH_PYMALLOC */
 
 #ifndef PyCore_OBJECT_MALLOC_FUNC
@@ -282,12 +289,16 @@ extern PyGC_Head _PyGC_generation0;
 #define _PyGC_generation0 (*((PyGC_Head*)PYTHON_GLOBALS->gc_globals))
 #endif
 
+/* gc_refs of a tracked object outside of a collection */
+#define _PyGC_REFS_REACHABLE (-123)
+
 /* Tell the GC to track this object.  NB: While the object is tracked the
  * collector it must be safe to call the ob_traverse method. */
 #define _PyObject_GC_TRACK(o) do { \
 	PyGC_Head *g = (PyGC_Head *)(o)-1; \
 	if (g->gc.gc_next != NULL) \
 		Py_FatalError("GC object already in linked list"); \
+	g->gc.gc_refs = _PyGC_REFS_REACHABLE; \
 	g->gc.gc_next = &_PyGC_generation0; \
 	g->gc.gc_prev = _PyGC_generation0.gc.gc_prev; \
 	g->gc.gc_prev->gc.gc_next = g; \
@@ -334,6 +345,34 @@ extern PyGC_Head _PyGC_generation0;
 #define PyObject_FROM_GC(op) (op)
 
 
+/*
+ * Free lists
+ * ==========
+ *
+ * tuple, list, dict, int and float keep deallocated objects of their
+ * exact type on a free list and hand them out again on the next
+ * allocation.  Each free list counts its use in a PyFreeListStats,
+ * which sys.getfreeliststats() reports.  A free list keeps at most
+ * limit objects (tuples: limit of each size), or any number if limit
+ * is negative; sys.setfreelistlimit() changes it.
+ *
+ * Int and float objects are carved out of blocks of about 1K, and a
+ * block can only be released when all of its objects are free.  Their
+ * limit is -1 by default; when it is set, a free list that grows past
+ * it gives its empty blocks back, at most once for every doubling of
+ * the free list after the last time.
+ *
+ * Py*_ClearFreeList() empties a free list (int, float: releases its
+ * empty blocks) and returns the number of bytes it released;
+ * sys.trim_caches() calls all of them.
+ */
+typedef struct {
+	unsigned long hits;	/* allocations served by the free list */
+	unsigned long misses;	/* allocations that went to the allocator */
+	int count;		/* objects on the free list */
+	int limit;		/* most objects kept, -1 for no limit */
+} PyFreeListStats;
+
 /* Test if a type supports weak references */
 #define PyType_SUPPORTS_WEAKREFS(t) \
         (PyType_HasFeature((t), Py_TPFLAGS_HAVE_WEAKREFS) \
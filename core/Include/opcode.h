@@ -14,6 +14,9 @@ extern "C" {
 #define DUP_TOP		4
 #define ROT_FOUR	5
 
+#define NOP		9	/* Peephole filler, squeezed out before the
+				   code object is built */
+
 #define UNARY_POSITIVE	10
 #define UNARY_NEGATIVE	11
 #define UNARY_NOT	12
@@ -37,9 +40,21 @@ extern "C" {
 #define SLICE		30
 /* Also uses 31-33 */
 
+/* Specialized forms of the arithmetic opcodes, written by the eval loop
+   into co_quickcode only; they never appear in co_code */
+#define BINARY_ADD_INT		34
+#define BINARY_ADD_FLOAT	35
+#define BINARY_SUBTRACT_INT	36
+#define BINARY_SUBTRACT_FLOAT	37
+#define BINARY_MULTIPLY_INT	38
+#define BINARY_MULTIPLY_FLOAT	39
+
 #define STORE_SLICE	40
 /* Also uses 41-43 */
 
+#define BINARY_MODULO_INT	44
+#define BINARY_DIVIDE_FLOAT	45
+
 #define DELETE_SLICE	50
 /* Also uses 51-53 */
 
@@ -142,6 +157,10 @@ extern "C" {
 /* Support for opargs more than 16 bits long */
 #define EXTENDED_ARG  143
 
+/* Specialized forms of COMPARE_OP, see above */
+#define COMPARE_OP_INT		144
+#define COMPARE_OP_FLOAT	145
+
 /* Comparison operator codes (argument to COMPARE_OP) */
 enum cmp_op {LT=Py_LT, LE=Py_LE, EQ=Py_EQ, NE=Py_NE, GT=Py_GT, GE=Py_GE,
 	     IN, NOT_IN, IS, IS_NOT, EXC_MATCH, BAD};
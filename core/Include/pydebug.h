@@ -18,6 +18,12 @@ extern "C" {
   /* extern DL_IMPORT(int) Py_OptimizeFlag; */
 #define Py_OptimizeFlag (PYTHON_GLOBALS->_OptimizeFlag)
 
+  /* extern DL_IMPORT(int) Py_LinenoFlag; */
+#define Py_LinenoFlag (PYTHON_GLOBALS->_LinenoFlag)
+
+  /* extern DL_IMPORT(int) Py_NoPeepholeFlag; */
+#define Py_NoPeepholeFlag (PYTHON_GLOBALS->_NoPeepholeFlag)
+
   /* extern DL_IMPORT(int) Py_NoSiteFlag; */
 #define Py_NoSiteFlag (PYTHON_GLOBALS->_NoSiteFlag)
 
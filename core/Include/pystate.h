@@ -72,6 +72,21 @@ typedef struct _ts {
 
     int tick_counter;
 
+    /* The interpreter lock, see ceval.c.  gil_wakeup is the lock this
+       thread blocks on while it waits its turn; gil_priority orders the
+       waiters (higher first).  The rest is the thread's identity and
+       its time, in seconds, spent waiting for and holding the lock, the
+       number of acquisitions, of those that had to wait, and of forced
+       hand-offs to another thread. */
+    void *gil_wakeup;
+    int gil_priority;
+    long thread_id;
+    double gil_wait;
+    double gil_hold;
+    long gil_acquisitions;
+    long gil_contended;
+    long gil_handoffs;
+
     /* XXX signal handlers should also be here */
 
 } PyThreadState;
@@ -92,6 +107,20 @@ DL_IMPORT(PyThreadState *) PyThreadState_Get(void);
 DL_IMPORT(PyThreadState *) PyThreadState_Swap(PyThreadState *);
 DL_IMPORT(PyObject *) PyThreadState_GetDict(void);
 
+/* A copy of one thread's interpreter lock statistics, for
+   sys.getgilstats() */
+typedef struct {
+    long thread_id;
+    double gil_wait;
+    double gil_hold;
+    long gil_acquisitions;
+    long gil_contended;
+    long gil_handoffs;
+    int gil_priority;
+} PyGILStats;
+
+extern PyGILStats *_PyThreadState_GetGILStats(PyInterpreterState *, int *);
+
 
 /* Variable and macro for in-line access to current thread state */
 
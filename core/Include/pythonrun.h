@@ -101,6 +101,8 @@ DL_IMPORT(void) PyMethod_Fini(void);
 DL_IMPORT(void) PyFrame_Fini(void);
 DL_IMPORT(void) PyCFunction_Fini(void);
 DL_IMPORT(void) PyTuple_Fini(void);
+extern void PyList_Fini(void);
+extern void PyDict_Fini(void);
 DL_IMPORT(void) PyString_Fini(void);
 DL_IMPORT(void) PyInt_Fini(void);
 DL_IMPORT(void) PyFloat_Fini(void);
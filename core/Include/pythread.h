@@ -19,6 +19,11 @@ DL_IMPORT(void) PyThread_exit_thread(void);
 DL_IMPORT(void) PyThread__PyThread_exit_thread(void);
 DL_IMPORT(long) PyThread_get_thread_ident(void);
 
+/* A monotonic clock for timing lock hand-offs, in microseconds.  It
+   wraps around, so only differences of its values are meaningful, and
+   its resolution is that of the platform's tick. */
+extern unsigned long PyThread_get_microseconds(void);
+
 #ifdef SYMBIAN
 DL_IMPORT(int) PyThread_AtExit(void (*)(void));
 #endif
@@ -77,10 +77,17 @@ extern DL_IMPORT(PyObject *) _PyString_FormatLong(PyObject*, int, int,
 extern DL_IMPORT(void) PyString_InternInPlace(PyObject **);
 extern DL_IMPORT(PyObject *) PyString_InternFromString(const char *);
 extern DL_IMPORT(void) _Py_ReleaseInternedStrings(void);
+extern PyObject *_PyString_LookupInterned(PyObject *);
+/* An interned string is its own ob_sinterned.  Two distinct interned
+   strings never compare equal, so a pointer test settles equality. */
+#define PyString_CHECK_INTERNED(op) \
+	(((PyStringObject *)(op))->ob_sinterned == (PyObject *)(op))
 #else
 #define PyString_InternInPlace(p)
 #define PyString_InternFromString(cp) PyString_FromString(cp)
 #define _Py_ReleaseInternedStrings()
+#define _PyString_LookupInterned(s) ((PyObject *)NULL)
+#define PyString_CHECK_INTERNED(op) 0
 #endif
 
 /* Macro, trading safety for speed */
@@ -39,6 +39,10 @@ extern DL_IMPORT(int) PyTuple_SetItem(PyObject *, int, PyObject *);
 extern DL_IMPORT(PyObject *) PyTuple_GetSlice(PyObject *, int, int);
 extern DL_IMPORT(int) _PyTuple_Resize(PyObject **, int);
 
+/* Free list of tuples of each size, see PyFreeListStats */
+extern PyFreeListStats *_PyTuple_FreeListStats(long *bytes);
+extern long PyTuple_ClearFreeList(void);
+
 /* Macro, trading safety for speed */
 #define PyTuple_GET_ITEM(op, i) (((PyTupleObject *)(op))->ob_item[i])
 #define PyTuple_GET_SIZE(op)    (((PyTupleObject *)(op))->ob_size)
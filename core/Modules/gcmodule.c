@@ -21,6 +21,8 @@
 
 #include "Python.h"
 
+#include <time.h>
+
 #ifdef WITH_CYCLE_GC
 
 /* Get an object's GC head */
@@ -29,6 +31,27 @@
 /* Get the object given the GC head */
 #define FROM_GC(g) ((PyObject *)(((PyGC_Head *)g)+1))
 
+/* Kinds of collection pause, and the upper bounds in microseconds of the
+ * buckets their durations are counted in; the last bucket has no bound. */
+#define PAUSE_GEN0		0
+#define PAUSE_GEN1		1
+#define PAUSE_GEN2		2
+#define PAUSE_INCREMENTAL	3
+#define NUM_PAUSE_KINDS		4
+#define NUM_PAUSE_BUCKETS	11
+
+static const long pause_bounds[NUM_PAUSE_BUCKETS - 1] = {
+	100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000
+};
+
+/* Totals for the collections of one generation, for gc.get_stats() */
+typedef struct {
+	long collections;
+	long collected;		/* unreachable objects freed */
+	long uncollectable;	/* unreachable objects put in gc.garbage */
+	double pause;		/* seconds spent collecting */
+} gcstats;
+
 #ifdef SYMBIAN
 typedef struct {
   PyGC_Head generation0;
@@ -47,10 +70,29 @@ typedef struct {
   PyObject *has_finalizer_delstr;
   long collect_generations_collections0;
   long collect_generations_collections1;
+  PyGC_Head f_incr_todo;
+  PyGC_Head f_incr_counting;
+  PyGC_Head f_incr_counted;
+  PyGC_Head f_incr_grey;
+  PyGC_Head f_incr_unreachable;
+  int f_incr_phase;
+  long f_incr_budget;
+  long f_incr_budget_us;
+  long f_pauses[NUM_PAUSE_KINDS][NUM_PAUSE_BUCKETS];
+  long f_incr_survivors;
+  int f_threshold0_now;
+  int f_survival;
+  int f_full_growth;
+  int f_max_scale;
+  long f_long_lived_total;
+  long f_long_lived_pending;
+  gcstats f_stats[3];
 } GcGlobals;
 
 #define GC_GLOBALS ((GcGlobals*)(PYTHON_GLOBALS->gc_globals))
 
+static void gc_list_init(PyGC_Head *list);
+
 static void init_gc_globals()
 {
   /* Memory gets freed when the memory pool is destroyed */
@@ -65,7 +107,7 @@ static void init_gc_globals()
   gb->f_generation2.gc.gc_prev = &(gb->f_generation2);
   gb->f_generation2.gc.gc_refs = 0;
   gb->f_generation = 0;
-  gb->f_enabled = 0;
+  gb->f_enabled = 1;
   gb->f_threshold0 = 700;
   gb->f_threshold1 = 10;
   gb->f_threshold2 = 10;
@@ -77,6 +119,23 @@ static void init_gc_globals()
   gb->has_finalizer_delstr = NULL;
   gb->collect_generations_collections0 = 0;
   gb->collect_generations_collections1 = 0;
+  gc_list_init(&gb->f_incr_todo);
+  gc_list_init(&gb->f_incr_counting);
+  gc_list_init(&gb->f_incr_counted);
+  gc_list_init(&gb->f_incr_grey);
+  gc_list_init(&gb->f_incr_unreachable);
+  gb->f_incr_phase = 0;
+  gb->f_incr_budget = 0;
+  gb->f_incr_budget_us = 0;
+  memset(gb->f_pauses, 0, sizeof(gb->f_pauses));
+  gb->f_incr_survivors = 0;
+  gb->f_threshold0_now = 700;
+  gb->f_survival = 0;
+  gb->f_full_growth = 25;
+  gb->f_max_scale = 10;
+  gb->f_long_lived_total = 0;
+  gb->f_long_lived_pending = 0;
+  memset(gb->f_stats, 0, sizeof(gb->f_stats));
   PYTHON_GLOBALS->gc_globals = gb;
 }
 #endif
@@ -107,6 +166,40 @@ static int threshold2 = 10;  /* generation1 collections before collecting 2 */
 #define threshold2 (GC_GLOBALS->f_threshold2)
 #endif
 
+/* The thresholds adapt to how the program uses memory:
+ *
+ * - A full collection takes time proportional to the number of objects
+ *   that survived the last one, and finds garbage only among the objects
+ *   that have been added since.  Once generation 1 has been collected
+ *   threshold2 times, the full collection still waits until the objects
+ *   promoted to generation 2 since the last one (long_lived_pending) are
+ *   at least full_growth percent of those that survived it
+ *   (long_lived_total).
+ *
+ * - When most of generation 0 survives its collections, they are
+ *   wasted work.  threshold0_now, the threshold actually used, is
+ *   threshold0 scaled up so that each collection expects to find about
+ *   threshold0 dead objects, going by a running average of the percentage
+ *   of objects that survived (survival), but by no more than max_scale.
+ *
+ * full_growth 0 and max_scale 1 give fixed thresholds.
+ */
+#ifndef SYMBIAN
+static int threshold0_now = 700;
+static int survival = 0;
+static int full_growth = 25;
+static int max_scale = 10;
+static long long_lived_total = 0;
+static long long_lived_pending = 0;
+#else
+#define threshold0_now (GC_GLOBALS->f_threshold0_now)
+#define survival (GC_GLOBALS->f_survival)
+#define full_growth (GC_GLOBALS->f_full_growth)
+#define max_scale (GC_GLOBALS->f_max_scale)
+#define long_lived_total (GC_GLOBALS->f_long_lived_total)
+#define long_lived_pending (GC_GLOBALS->f_long_lived_pending)
+#endif
+
 /* net new objects allocated since last collection */
 #ifndef SYMBIAN
 static int allocated;
@@ -121,6 +214,65 @@ static int collecting;
 #define collecting (GC_GLOBALS->f_collecting)
 #endif
 
+/* Incremental collection of the oldest generation.  When a budget is set,
+ * a generation 2 collection is spread over the following collections:
+ *
+ * INCR_INIT: the objects of all generations were moved to incr_todo; mark
+ *     them as uncounted and move them to incr_counting.
+ * INCR_COUNT: count the references to each object from the others by
+ *     traversing them, moving them on to incr_counted.
+ * INCR_SCAN: objects with more references than were counted are
+ *     reachable from outside; they and everything they reach go through
+ *     incr_grey back to generation2.  The rest go to incr_unreachable.
+ *
+ * The program runs between slices, so the counts and the scan are only
+ * a guess: references can be made and dropped behind the collector's
+ * back.  Once the scan is done, incr_unreachable is therefore collected
+ * normally, in one go, which frees only what is really unreachable.
+ * Being found reachable by mistake merely puts off an object's
+ * collection to the next cycle.  Objects allocated or promoted meanwhile
+ * go to the young generations and generation2 as usual.
+ *
+ * A slice looks at budget objects for every threshold0 allocations since
+ * the last one, so that a program allocating faster gets collected
+ * faster.  Should the program still outrun the collection, promoting more
+ * than INCR_MAX_LAG times what triggers a full collection before it is
+ * done, the rest of it is done at once by a full collection.
+ */
+#define INCR_IDLE	0
+#define INCR_INIT	1
+#define INCR_COUNT	2
+#define INCR_SCAN	3
+
+#define INCR_MAX_LAG	2
+
+#ifndef SYMBIAN
+static PyGC_Head incr_todo = {{&incr_todo, &incr_todo, 0}};
+static PyGC_Head incr_counting = {{&incr_counting, &incr_counting, 0}};
+static PyGC_Head incr_counted = {{&incr_counted, &incr_counted, 0}};
+static PyGC_Head incr_grey = {{&incr_grey, &incr_grey, 0}};
+static PyGC_Head incr_unreachable = {{&incr_unreachable,
+				     &incr_unreachable, 0}};
+static int incr_phase = INCR_IDLE;
+static long incr_budget = 0;	/* objects per slice, 0 to not use slices */
+static long incr_budget_us = 0;	/* microseconds per slice, 0 for no limit */
+static long incr_survivors = 0;	/* objects found reachable by the scan */
+static long pauses[NUM_PAUSE_KINDS][NUM_PAUSE_BUCKETS];
+static gcstats stats[3];
+#else
+#define incr_todo (GC_GLOBALS->f_incr_todo)
+#define incr_counting (GC_GLOBALS->f_incr_counting)
+#define incr_counted (GC_GLOBALS->f_incr_counted)
+#define incr_grey (GC_GLOBALS->f_incr_grey)
+#define incr_unreachable (GC_GLOBALS->f_incr_unreachable)
+#define incr_phase (GC_GLOBALS->f_incr_phase)
+#define incr_budget (GC_GLOBALS->f_incr_budget)
+#define incr_budget_us (GC_GLOBALS->f_incr_budget_us)
+#define incr_survivors (GC_GLOBALS->f_incr_survivors)
+#define pauses (GC_GLOBALS->f_pauses)
+#define stats (GC_GLOBALS->f_stats)
+#endif
+
 /* set for debugging information */
 #define DEBUG_STATS		(1<<0) /* print collection statistics */
 #define DEBUG_COLLECTABLE	(1<<1) /* print collectable objects */
@@ -148,11 +300,20 @@ static int debug;
  * collection candidates from non-candidates just by looking at the object.
  */
 /* Special gc_refs value, although any negative value means "moved". */
-#define GC_MOVED  -123
+#define GC_MOVED  _PyGC_REFS_REACHABLE
 
 /* True iff an object is still a candidate for collection. */
 #define STILL_A_CANDIDATE(o) ((AS_GC(o))->gc.gc_refs >= 0)
 
+/* During an incremental collection, gc_refs of the objects in incr_todo is
+ * left alone, and that of the objects in the other incr_ lists is
+ * GC_UNCOUNTED minus the number of references to them counted so far,
+ * except for incr_grey, whose objects are GC_MOVED.  These values are
+ * far below any other, and young collections leave them alone.
+ */
+#define GC_UNCOUNTED (INT_MIN / 2)
+#define INCR_MEMBER(gc) ((gc)->gc.gc_refs <= GC_UNCOUNTED)
+
 /* list of uncollectable objects */
 #ifndef SYMBIAN
 static PyObject *garbage;
@@ -224,6 +385,12 @@ gc_list_merge(PyGC_Head *from, PyGC_Head *to)
 	gc_list_init(from);
 }
 
+static int
+gc_list_is_empty(PyGC_Head *list)
+{
+	return list->gc.gc_next == list;
+}
+
 static long
 gc_list_size(PyGC_Head *list)
 {
@@ -241,15 +408,19 @@ gc_list_size(PyGC_Head *list)
 
 /* Set all gc_refs = ob_refcnt.  After this, STILL_A_CANDIDATE(o) is true
  * for all objects in containers, and false for all tracked gc objects not
- * in containers (although see the comment in visit_decref).
+ * in containers (although see the comment in visit_decref).  Returns the
+ * number of objects in containers.
  */
-static void
+static long
 update_refs(PyGC_Head *containers)
 {
+	long n = 0;
 	PyGC_Head *gc = containers->gc.gc_next;
 	for (; gc != containers; gc=gc->gc.gc_next) {
 		gc->gc.gc_refs = FROM_GC(gc)->ob_refcnt;
+		n++;
 	}
+	return n;
 }
 
 static int
@@ -264,11 +435,12 @@ visit_decref(PyObject *op, void *data)
          * could underflow gc_refs in a long-lived old object.  In that case,
          * visit_move() may move the old object back to the generation
          * getting collected.  That would be a waste of time, but wouldn't
-         * cause an error.
+         * cause an error.  The counts of an incremental collection in
+         * progress must be left alone, though.
          */
 	if (op && PyObject_IS_GC(op)) {
 		PyGC_Head *gc = AS_GC(op);
-		if (gc->gc.gc_next != NULL)
+		if (gc->gc.gc_next != NULL && !INCR_MEMBER(gc))
 			AS_GC(op)->gc.gc_refs--;
 	}
 	return 0;
@@ -471,11 +643,43 @@ delete_garbage(PyGC_Head *unreachable, PyGC_Head *old)
 	}
 }
 
+/* Scale threshold0 by the survival rate */
+static void
+update_threshold0(void)
+{
+	int room = 100 - survival;
+
+	if (room < 100 / max_scale)
+		room = 100 / max_scale;
+	threshold0_now = (int)((long)threshold0 * 100 / room);
+}
+
+/* Adapt the thresholds to a collection of the current generation, which
+ * looked at size objects and found survivors of them reachable. */
+static void
+adapt_thresholds(long size, long survivors)
+{
+	switch (generation) {
+	case 0:
+		survival = (3 * survival + (int)(survivors * 100 / size)) / 4;
+		update_threshold0();
+		break;
+	case 1:
+		long_lived_pending += survivors;
+		break;
+	case 2:
+		/* an incremental collection has already seen some */
+		long_lived_total = incr_survivors + survivors;
+		break;
+	}
+}
+
 /* This is the main function.  Read this to understand how the
  * collection process works. */
 static long
 collect(PyGC_Head *young, PyGC_Head *old)
 {
+	long size;
 	long n = 0;
 	long m = 0;
 	PyGC_Head reachable;
@@ -497,7 +701,7 @@ collect(PyGC_Head *young, PyGC_Head *old)
 	 * container set are reachable from outside the set (ie. have a
 	 * refcount greater than 0 when all the references within the
 	 * set are taken into account */
-	update_refs(young);
+	size = update_refs(young);
 	subtract_refs(young);
 
 	/* Move everything reachable from outside the set into the
@@ -569,10 +773,205 @@ collect(PyGC_Head *young, PyGC_Head *old)
 		PyErr_WriteUnraisable(gc_str);
 		Py_FatalError("unexpected exception during garbage collection");
 	}
+	stats[generation].collected += m;
+	stats[generation].uncollectable += n;
+	if (size > 0)
+		adapt_thresholds(size, size - m);
 	allocated = 0;
 	return n+m;
 }
 
+/*** pause statistics ***/
+
+/* Current time in seconds, for measuring pauses */
+static double
+gc_clock(void)
+{
+#ifdef HAVE_GETTIMEOFDAY
+	struct timeval t;
+#ifdef GETTIMEOFDAY_NO_TZ
+	if (gettimeofday(&t) == 0)
+		return (double)t.tv_sec + t.tv_usec*0.000001;
+#else /* !GETTIMEOFDAY_NO_TZ */
+	if (gettimeofday(&t, (struct timezone *)NULL) == 0)
+		return (double)t.tv_sec + t.tv_usec*0.000001;
+#endif /* !GETTIMEOFDAY_NO_TZ */
+#endif /* !HAVE_GETTIMEOFDAY */
+	return (double)clock() / CLOCKS_PER_SEC;
+}
+
+/* Count a pause of the given kind that began at start */
+static void
+record_pause(int kind, double start)
+{
+	double us = (gc_clock() - start) * 1e6;
+	int i;
+
+	for (i = 0; i < NUM_PAUSE_BUCKETS - 1; i++) {
+		if (us < pause_bounds[i])
+			break;
+	}
+	pauses[kind][i]++;
+	stats[kind == PAUSE_INCREMENTAL ? 2 : kind].pause += us * 1e-6;
+}
+
+/*** incremental collection ***/
+
+/* Count a reference to op from another object being collected */
+static int
+visit_count(PyObject *op, void *data)
+{
+	if (op && PyObject_IS_GC(op)) {
+		PyGC_Head *gc = AS_GC(op);
+		if (gc->gc.gc_next != NULL && INCR_MEMBER(gc))
+			gc->gc.gc_refs--;
+	}
+	return 0;
+}
+
+/* op is reachable from an object found reachable; move it to incr_grey */
+static int
+visit_grey(PyObject *op, void *data)
+{
+	if (op && PyObject_IS_GC(op)) {
+		PyGC_Head *gc = AS_GC(op);
+		if (gc->gc.gc_next != NULL && INCR_MEMBER(gc)) {
+			gc_list_remove(gc);
+			gc_list_append(gc, &incr_grey);
+			gc->gc.gc_refs = GC_MOVED;
+		}
+	}
+	return 0;
+}
+
+/* Start an incremental collection of all generations */
+static void
+incremental_start(void)
+{
+	gc_list_merge(&_PyGC_generation0, &generation2);
+	gc_list_merge(&generation1, &generation2);
+	gc_list_move(&generation2, &incr_todo);
+	incr_phase = INCR_INIT;
+	incr_survivors = 0;
+	long_lived_pending = 0;
+}
+
+/* Give up an incremental collection, putting its objects back in
+ * generation2.  The counts left in gc_refs do no harm: young collections
+ * ignore them, and every other collection starts by resetting them. */
+static void
+incremental_abort(void)
+{
+	gc_list_merge(&incr_todo, &generation2);
+	gc_list_merge(&incr_counting, &generation2);
+	gc_list_merge(&incr_counted, &generation2);
+	gc_list_merge(&incr_grey, &generation2);
+	gc_list_merge(&incr_unreachable, &generation2);
+	incr_phase = INCR_IDLE;
+	incr_survivors = 0;
+}
+
+/* Do one slice of an incremental collection, stopping when budget objects
+ * have been looked at or the collection is done.  start is when the pause
+ * began.  Returns the number of unreachable objects found, if the
+ * collection finished. */
+static long
+incremental_step(long budget, double start)
+{
+	PyGC_Head *gc;
+	PyObject *op;
+	long work;
+
+	for (work = 0; work < budget; work++) {
+		if (incr_budget_us > 0 && (work & 31) == 31 &&
+		    (gc_clock() - start) * 1e6 >= incr_budget_us)
+			break;
+		switch (incr_phase) {
+		case INCR_INIT:
+			if (gc_list_is_empty(&incr_todo)) {
+				incr_phase = INCR_COUNT;
+				continue;
+			}
+			gc = incr_todo.gc.gc_next;
+			gc->gc.gc_refs = GC_UNCOUNTED;
+			gc_list_remove(gc);
+			gc_list_append(gc, &incr_counting);
+			break;
+		case INCR_COUNT:
+			if (gc_list_is_empty(&incr_counting)) {
+				incr_phase = INCR_SCAN;
+				continue;
+			}
+			gc = incr_counting.gc.gc_next;
+			op = FROM_GC(gc);
+			gc_list_remove(gc);
+			gc_list_append(gc, &incr_counted);
+			(void) op->ob_type->tp_traverse(op,
+					(visitproc)visit_count, NULL);
+			break;
+		case INCR_SCAN:
+			if (!gc_list_is_empty(&incr_grey)) {
+				/* everything a reachable object refers to is
+				 * reachable too */
+				gc = incr_grey.gc.gc_next;
+				op = FROM_GC(gc);
+				gc_list_remove(gc);
+				gc_list_append(gc, &generation2);
+				incr_survivors++;
+				(void) op->ob_type->tp_traverse(op,
+						(visitproc)visit_grey, NULL);
+			}
+			else if (!gc_list_is_empty(&incr_counted)) {
+				/* an object with references from outside is
+				 * reachable */
+				gc = incr_counted.gc.gc_next;
+				op = FROM_GC(gc);
+				gc_list_remove(gc);
+				if (op->ob_refcnt > GC_UNCOUNTED - gc->gc.gc_refs) {
+					gc_list_append(gc, &incr_grey);
+					gc->gc.gc_refs = GC_MOVED;
+				}
+				else
+					gc_list_append(gc, &incr_unreachable);
+			}
+			else {
+				/* check what was left with a real collection */
+				long n = 0;
+				incr_phase = INCR_IDLE;
+				generation = 2;
+				stats[2].collections++;
+				if (gc_list_is_empty(&incr_unreachable)) {
+					long_lived_total = incr_survivors;
+					allocated = 0;
+				}
+				else
+					n = collect(&incr_unreachable, &generation2);
+				incr_survivors = 0;
+				return n;
+			}
+			break;
+		}
+	}
+	return 0;
+}
+
+/* Collect all generations at once */
+static long
+collect_oldest(void)
+{
+	long n = 0;
+
+	incremental_abort();
+	generation = 2;
+	stats[2].collections++;
+	long_lived_pending = 0;
+	gc_list_merge(&_PyGC_generation0, &generation2);
+	gc_list_merge(&generation1, &generation2);
+	if (!gc_list_is_empty(&generation2))
+		n = collect(&generation2, &generation2);
+	return n;
+}
+
 static long
 collect_generations(void)
 {
@@ -584,41 +983,76 @@ collect_generations(void)
 #define collections1 (GC_GLOBALS->collect_generations_collections1)
 #endif
 	long n = 0;
-
-
-	if (collections1 > threshold2) {
-		generation = 2;
-		gc_list_merge(&_PyGC_generation0, &generation2);
-		gc_list_merge(&generation1, &generation2);
-		if (generation2.gc.gc_next != &generation2) {
-			n = collect(&generation2, &generation2);
-		}
+	long budget, full = long_lived_total / 100 * full_growth;
+	double start = gc_clock();
+
+	/* allocated is reset by the collection */
+	budget = incr_budget * (allocated / (threshold0 > 0 ? threshold0 : 1));
+	if (budget < incr_budget)
+		budget = incr_budget;
+	if (incr_phase != INCR_IDLE &&
+	    long_lived_pending > INCR_MAX_LAG * (full > threshold0 ?
+						 full : threshold0)) {
+		/* the incremental collection is falling behind */
+		collections1 = 0;
+		n = collect_oldest();
+		record_pause(PAUSE_GEN2, start);
+		return n;
+	}
+	if (collections1 > threshold2 && incr_phase == INCR_IDLE &&
+	    long_lived_pending >= full) {
 		collections1 = 0;
+		if (incr_budget > 0) {
+			/* the slices run after the collections that follow */
+			incremental_start();
+			n = incremental_step(budget, start);
+			record_pause(PAUSE_INCREMENTAL, start);
+			return n;
+		}
+		n = collect_oldest();
+		record_pause(PAUSE_GEN2, start);
 	}
 	else if (collections0 > threshold1) {
 		generation = 1;
-		collections1++;
+		stats[1].collections++;
+		if (incr_phase == INCR_IDLE)
+			collections1++;
 		gc_list_merge(&_PyGC_generation0, &generation1);
 		if (generation1.gc.gc_next != &generation1) {
 			n = collect(&generation1, &generation2);
 		}
 		collections0 = 0;
+		record_pause(PAUSE_GEN1, start);
 	}
 	else {
 		generation = 0;
+		stats[0].collections++;
 		collections0++;
 		if (_PyGC_generation0.gc.gc_next != &_PyGC_generation0) {
 			n = collect(&_PyGC_generation0, &generation1);
 		}
+		record_pause(PAUSE_GEN0, start);
+	}
+	if (incr_phase != INCR_IDLE && incr_budget == 0) {
+		/* set_budget(0) was called while collecting */
+		incremental_abort();
+	}
+	else if (incr_phase != INCR_IDLE) {
+		start = gc_clock();
+		n += incremental_step(budget, start);
+		record_pause(PAUSE_INCREMENTAL, start);
 	}
 	return n;
 }
 
-static char gc_enable__doc__[] =
+const static char gc_enable__doc__[] =
+#ifdef SYMBIAN
+"";
+#else
 "enable() -> None\n"
 "\n"
-"Enable automatic garbage collection.\n"
-;
+"Enable automatic garbage collection.\n";
+#endif
 
 static PyObject *
 gc_enable(PyObject *self, PyObject *args)
@@ -633,11 +1067,14 @@ gc_enable(PyObject *self, PyObject *args)
 	return Py_None;
 }
 
-static char gc_disable__doc__[] =
+const static char gc_disable__doc__[] =
+#ifdef SYMBIAN
+"";
+#else
 "disable() -> None\n"
 "\n"
-"Disable automatic garbage collection.\n"
-;
+"Disable automatic garbage collection.\n";
+#endif
 
 static PyObject *
 gc_disable(PyObject *self, PyObject *args)
@@ -652,11 +1089,14 @@ gc_disable(PyObject *self, PyObject *args)
 	return Py_None;
 }
 
-static char gc_isenabled__doc__[] =
+const static char gc_isenabled__doc__[] =
+#ifdef SYMBIAN
+"";
+#else
 "isenabled() -> status\n"
 "\n"
-"Returns true if automatic garbage collection is enabled.\n"
-;
+"Returns true if automatic garbage collection is enabled.\n";
+#endif
 
 static PyObject *
 gc_isenabled(PyObject *self, PyObject *args)
@@ -668,16 +1108,20 @@ gc_isenabled(PyObject *self, PyObject *args)
 	return Py_BuildValue("i", enabled);
 }
 
-static char gc_collect__doc__[] =
+const static char gc_collect__doc__[] =
+#ifdef SYMBIAN
+"";
+#else
 "collect() -> n\n"
 "\n"
-"Run a full collection.  The number of unreachable objects is returned.\n"
-;
+"Run a full collection.  The number of unreachable objects is returned.\n";
+#endif
 
 static PyObject *
 gc_collect(PyObject *self, PyObject *args)
 {
 	long n;
+	double start;
 
 	if (!PyArg_ParseTuple(args, ":collect"))	/* check no args */
 		return NULL;
@@ -687,17 +1131,19 @@ gc_collect(PyObject *self, PyObject *args)
 	}
 	else {
 		collecting = 1;
-		generation = 2;
-		gc_list_merge(&_PyGC_generation0, &generation2);
-		gc_list_merge(&generation1, &generation2);
-		n = collect(&generation2, &generation2);
+		start = gc_clock();
+		n = collect_oldest();
+		record_pause(PAUSE_GEN2, start);
 		collecting = 0;
 	}
 
 	return Py_BuildValue("l", n);
 }
 
-static char gc_set_debug__doc__[] =
+const static char gc_set_debug__doc__[] =
+#ifdef SYMBIAN
+"";
+#else
 "set_debug(flags) -> None\n"
 "\n"
 "Set the garbage collection debugging flags. Debugging information is\n"
@@ -711,8 +1157,8 @@ static char gc_set_debug__doc__[] =
 "  DEBUG_INSTANCES - Print instance objects.\n"
 "  DEBUG_OBJECTS - Print objects other than instances.\n"
 "  DEBUG_SAVEALL - Save objects to gc.garbage rather than freeing them.\n"
-"  DEBUG_LEAK - Debug leaking programs (everything but STATS).\n"
-;
+"  DEBUG_LEAK - Debug leaking programs (everything but STATS).\n";
+#endif
 
 static PyObject *
 gc_set_debug(PyObject *self, PyObject *args)
@@ -724,11 +1170,14 @@ gc_set_debug(PyObject *self, PyObject *args)
 	return Py_None;
 }
 
-static char gc_get_debug__doc__[] =
+const static char gc_get_debug__doc__[] =
+#ifdef SYMBIAN
+"";
+#else
 "get_debug() -> flags\n"
 "\n"
-"Get the garbage collection debugging flags.\n"
-;
+"Get the garbage collection debugging flags.\n";
+#endif
 
 static PyObject *
 gc_get_debug(PyObject *self, PyObject *args)
@@ -739,12 +1188,15 @@ gc_get_debug(PyObject *self, PyObject *args)
 	return Py_BuildValue("i", debug);
 }
 
-static char gc_set_thresh__doc__[] =
+const static char gc_set_thresh__doc__[] =
+#ifdef SYMBIAN
+"";
+#else
 "set_threshold(threshold0, [threshold1, threshold2]) -> None\n"
 "\n"
 "Sets the collection thresholds.  Setting threshold0 to zero disables\n"
-"collection.\n"
-;
+"collection.  See set_adaptive() for how they are adjusted.\n";
+#endif
 
 static PyObject *
 gc_set_thresh(PyObject *self, PyObject *args)
@@ -752,16 +1204,20 @@ gc_set_thresh(PyObject *self, PyObject *args)
 	if (!PyArg_ParseTuple(args, "i|ii:set_threshold", &threshold0,
 				&threshold1, &threshold2))
 		return NULL;
+	update_threshold0();
 
 	Py_INCREF(Py_None);
 	return Py_None;
 }
 
-static char gc_get_thresh__doc__[] =
+const static char gc_get_thresh__doc__[] =
+#ifdef SYMBIAN
+"";
+#else
 "get_threshold() -> (threshold0, threshold1, threshold2)\n"
 "\n"
-"Return the current collection thresholds\n"
-;
+"Return the current collection thresholds\n";
+#endif
 
 static PyObject *
 gc_get_thresh(PyObject *self, PyObject *args)
@@ -772,6 +1228,242 @@ gc_get_thresh(PyObject *self, PyObject *args)
 	return Py_BuildValue("(iii)", threshold0, threshold1, threshold2);
 }
 
+const static char gc_set_adaptive__doc__[] =
+#ifdef SYMBIAN
+"";
+#else
+"set_adaptive(full_growth[, max_scale]) -> None\n"
+"\n"
+"Set how the collection thresholds adapt to the program.  A full\n"
+"collection is only done once the objects that have survived into the\n"
+"oldest generation since the last one number at least full_growth\n"
+"percent of those that survived it.  threshold0 is raised when most\n"
+"young objects survive their collection, up to max_scale times.\n"
+"set_adaptive(0, 1) gives fixed thresholds.\n";
+#endif
+
+static PyObject *
+gc_set_adaptive(PyObject *self, PyObject *args)
+{
+	int growth, scale = max_scale;
+
+	if (!PyArg_ParseTuple(args, "i|i:set_adaptive", &growth, &scale))
+		return NULL;
+	if (growth < 0 || scale < 1 || scale > 100) {
+		PyErr_SetString(PyExc_ValueError,
+			"full_growth must be >= 0 and max_scale in 1..100");
+		return NULL;
+	}
+	full_growth = growth;
+	max_scale = scale;
+	update_threshold0();
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+const static char gc_get_adaptive__doc__[] =
+#ifdef SYMBIAN
+"";
+#else
+"get_adaptive() -> (full_growth, max_scale)\n"
+"\n"
+"Return the settings of set_adaptive().\n";
+#endif
+
+static PyObject *
+gc_get_adaptive(PyObject *self, PyObject *args)
+{
+	if (!PyArg_ParseTuple(args, ":get_adaptive"))	/* no args */
+		return NULL;
+
+	return Py_BuildValue("(ii)", full_growth, max_scale);
+}
+
+const static char gc_get_stats__doc__[] =
+#ifdef SYMBIAN
+"";
+#else
+"get_stats() -> [dict, dict, dict]\n"
+"\n"
+"Return a dict for each generation with its number of objects, and the\n"
+"number of collections of it, of unreachable objects they collected and\n"
+"found uncollectable, and the seconds they took.  The first also has\n"
+"the threshold in use and the survival percentage it follows; the last\n"
+"has the number of objects that survived the last full collection and\n"
+"that survived into it since.\n";
+#endif
+
+static int
+set_long_item(PyObject *d, char *key, long value)
+{
+	int status;
+	PyObject *v = PyInt_FromLong(value);
+
+	if (v == NULL)
+		return -1;
+	status = PyDict_SetItemString(d, key, v);
+	Py_DECREF(v);
+	return status;
+}
+
+static PyObject *
+gc_get_stats(PyObject *self, PyObject *args)
+{
+	PyObject *result, *d;
+	long objects[3];
+	int i;
+
+	if (!PyArg_ParseTuple(args, ":get_stats"))	/* no args */
+		return NULL;
+	objects[0] = gc_list_size(&_PyGC_generation0);
+	objects[1] = gc_list_size(&generation1);
+	objects[2] = gc_list_size(&generation2) +
+		gc_list_size(&incr_todo) +
+		gc_list_size(&incr_counting) +
+		gc_list_size(&incr_counted) +
+		gc_list_size(&incr_grey) +
+		gc_list_size(&incr_unreachable);
+	result = PyList_New(3);
+	if (result == NULL)
+		return NULL;
+	for (i = 0; i < 3; i++) {
+		d = Py_BuildValue("{s:l,s:l,s:l,s:l,s:d}",
+				  "objects", objects[i],
+				  "collections", stats[i].collections,
+				  "collected", stats[i].collected,
+				  "uncollectable", stats[i].uncollectable,
+				  "pause", stats[i].pause);
+		if (d == NULL) {
+			Py_DECREF(result);
+			return NULL;
+		}
+		PyList_SET_ITEM(result, i, d);
+	}
+	d = PyList_GET_ITEM(result, 0);
+	if (set_long_item(d, "threshold", threshold0_now) < 0 ||
+	    set_long_item(d, "survival", survival) < 0)
+		goto error;
+	d = PyList_GET_ITEM(result, 2);
+	if (set_long_item(d, "long_lived", long_lived_total) < 0 ||
+	    set_long_item(d, "long_lived_pending", long_lived_pending) < 0)
+		goto error;
+	return result;
+
+ error:
+	Py_DECREF(result);
+	return NULL;
+}
+
+const static char gc_set_budget__doc__[] =
+#ifdef SYMBIAN
+"";
+#else
+"set_budget(objects[, usecs]) -> None\n"
+"\n"
+"Collect the oldest generation incrementally, a slice at a time, instead\n"
+"of all at once.  Each slice looks at no more than objects objects for\n"
+"every threshold0 objects allocated since the last slice and, if usecs\n"
+"is given and not zero, stops after about usecs microseconds.  One slice\n"
+"runs after each young collection until the collection is done, or has\n"
+"fallen so far behind that a full collection finishes it.  objects 0\n"
+"turns incremental collection off.\n";
+#endif
+
+static PyObject *
+gc_set_budget(PyObject *self, PyObject *args)
+{
+	long budget, budget_us = 0;
+
+	if (!PyArg_ParseTuple(args, "l|l:set_budget", &budget, &budget_us))
+		return NULL;
+	if (budget < 0 || budget_us < 0) {
+		PyErr_SetString(PyExc_ValueError,
+				"budget must not be negative");
+		return NULL;
+	}
+	if (budget == 0 && !collecting)
+		incremental_abort();
+	incr_budget = budget;
+	incr_budget_us = budget_us;
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+const static char gc_get_budget__doc__[] =
+#ifdef SYMBIAN
+"";
+#else
+"get_budget() -> (objects, usecs)\n"
+"\n"
+"Return the budget of a slice of incremental collection.\n";
+#endif
+
+static PyObject *
+gc_get_budget(PyObject *self, PyObject *args)
+{
+	if (!PyArg_ParseTuple(args, ":get_budget"))	/* no args */
+		return NULL;
+
+	return Py_BuildValue("(ll)", incr_budget, incr_budget_us);
+}
+
+const static char gc_get_pauses__doc__[] =
+#ifdef SYMBIAN
+"";
+#else
+"get_pause_histograms([clear]) -> dict\n"
+"\n"
+"Return how long the program was stopped by each kind of collection:\n"
+"'gen0', 'gen1', 'gen2' (full collections) and 'incremental' (slices).\n"
+"Each maps to a list of counts of pauses, bucketed by the limits in\n"
+"PAUSE_BUCKETS (in microseconds); the last count is of longer pauses.\n"
+"If clear is true, the counts are reset to zero afterwards.\n";
+#endif
+
+static PyObject *
+gc_get_pauses(PyObject *self, PyObject *args)
+{
+	static const char *const kinds[NUM_PAUSE_KINDS] = {
+		"gen0", "gen1", "gen2", "incremental"
+	};
+	PyObject *result, *counts;
+	int clear = 0;
+	int i, j;
+
+	if (!PyArg_ParseTuple(args, "|i:get_pause_histograms", &clear))
+		return NULL;
+	result = PyDict_New();
+	if (result == NULL)
+		return NULL;
+	for (i = 0; i < NUM_PAUSE_KINDS; i++) {
+		counts = PyList_New(NUM_PAUSE_BUCKETS);
+		if (counts == NULL)
+			goto error;
+		for (j = 0; j < NUM_PAUSE_BUCKETS; j++) {
+			PyObject *v = PyInt_FromLong(pauses[i][j]);
+			if (v == NULL) {
+				Py_DECREF(counts);
+				goto error;
+			}
+			PyList_SET_ITEM(counts, j, v);
+		}
+		if (PyDict_SetItemString(result, (char *)kinds[i], counts) < 0) {
+			Py_DECREF(counts);
+			goto error;
+		}
+		Py_DECREF(counts);
+	}
+	if (clear)
+		memset(pauses, 0, sizeof(pauses));
+	return result;
+
+ error:
+	Py_DECREF(result);
+	return NULL;
+}
+
 static int
 referrersvisit(PyObject* obj, PyObject *objs)
 {
@@ -801,9 +1493,13 @@ gc_referrers_for(PyObject *objs, PyGC_Head *list, PyObject *resultlist)
 	return 1; /* no error */
 }
 
-static char gc_get_referrers__doc__[]=
+const static char gc_get_referrers__doc__[] =
+#ifdef SYMBIAN
+"";
+#else
 "get_referrers(*objs) -> list\n\
 Return the list of objects that directly refer to any of objs.";
+#endif
 
 static PyObject *
 gc_get_referrers(PyObject *self, PyObject *args)
@@ -811,19 +1507,27 @@ gc_get_referrers(PyObject *self, PyObject *args)
 	PyObject *result = PyList_New(0);
 	if (!(gc_referrers_for(args, &_PyGC_generation0, result) &&
 	      gc_referrers_for(args, &generation1, result) &&
-	      gc_referrers_for(args, &generation2, result))) {
+	      gc_referrers_for(args, &generation2, result) &&
+	      gc_referrers_for(args, &incr_todo, result) &&
+	      gc_referrers_for(args, &incr_counting, result) &&
+	      gc_referrers_for(args, &incr_counted, result) &&
+	      gc_referrers_for(args, &incr_grey, result) &&
+	      gc_referrers_for(args, &incr_unreachable, result))) {
 		Py_DECREF(result);
 		return NULL;
 	}
 	return result;
 }
 
-static char gc_get_objects__doc__[] =
+const static char gc_get_objects__doc__[] =
+#ifdef SYMBIAN
+"";
+#else
 "get_objects() -> [...]\n"
 "\n"
 "Return a list of objects tracked by the collector (excluding the list\n"
-"returned).\n"
-;
+"returned).\n";
+#endif
 
 /* appending objects in a GC list to a Python list */
 static int
@@ -854,7 +1558,12 @@ gc_get_objects(PyObject *self, PyObject *args)
 	}
 	if (append_objects(result, &_PyGC_generation0) ||
 	    append_objects(result, &generation1) ||
-	    append_objects(result, &generation2)) {
+	    append_objects(result, &generation2) ||
+	    append_objects(result, &incr_todo) ||
+	    append_objects(result, &incr_counting) ||
+	    append_objects(result, &incr_counted) ||
+	    append_objects(result, &incr_grey) ||
+	    append_objects(result, &incr_unreachable)) {
 		Py_DECREF(result);
 		return NULL;
 	}
@@ -862,7 +1571,7 @@ gc_get_objects(PyObject *self, PyObject *args)
 }
 
 
-static char gc__doc__ [] =
+const static char gc__doc__[] =
 #ifndef SYMBIAN
 "This module provides access to the garbage collector for reference cycles.\n"
 "\n"
@@ -874,6 +1583,12 @@ static char gc__doc__ [] =
 "get_debug() -- Get debugging flags.\n"
 "set_threshold() -- Set the collection thresholds.\n"
 "get_threshold() -- Return the current the collection thresholds.\n"
+"set_budget() -- Collect the oldest generation in slices.\n"
+"get_budget() -- Return the budget of a slice.\n"
+"set_adaptive() -- Set how the thresholds adapt.\n"
+"get_adaptive() -- Return how the thresholds adapt.\n"
+"get_stats() -- Return statistics for each generation.\n"
+"get_pause_histograms() -- Return how long collections took.\n"
 "get_objects() -- Return a list of all objects tracked by the collector.\n"
 "get_referrers() -- Return the list of objects that refer to an object.\n"
 ;
@@ -890,6 +1605,15 @@ static PyMethodDef GcMethods[] = {
 	{"get_debug",	   gc_get_debug,  METH_VARARGS, gc_get_debug__doc__},
 	{"set_threshold",  gc_set_thresh, METH_VARARGS, gc_set_thresh__doc__},
 	{"get_threshold",  gc_get_thresh, METH_VARARGS, gc_get_thresh__doc__},
+	{"set_budget",	   gc_set_budget, METH_VARARGS, gc_set_budget__doc__},
+	{"get_budget",	   gc_get_budget, METH_VARARGS, gc_get_budget__doc__},
+	{"set_adaptive",   gc_set_adaptive, METH_VARARGS,
+		gc_set_adaptive__doc__},
+	{"get_adaptive",   gc_get_adaptive, METH_VARARGS,
+		gc_get_adaptive__doc__},
+	{"get_stats",	   gc_get_stats,  METH_VARARGS, gc_get_stats__doc__},
+	{"get_pause_histograms", gc_get_pauses, METH_VARARGS,
+		gc_get_pauses__doc__},
 	{"collect",	   gc_collect,	  METH_VARARGS, gc_collect__doc__},
 	{"get_objects",    gc_get_objects,METH_VARARGS, gc_get_objects__doc__},
 	{"get_referrers",  gc_get_referrers, METH_VARARGS,
@@ -905,6 +1629,12 @@ static const PyMethodDef GcMethods[] = {
 	{"get_debug",	   gc_get_debug,  METH_VARARGS, NULL}, 
 	{"set_threshold",  gc_set_thresh, METH_VARARGS, NULL}, 
 	{"get_threshold",  gc_get_thresh, METH_VARARGS, NULL}, 
+	{"set_budget",	   gc_set_budget, METH_VARARGS, NULL},
+	{"get_budget",	   gc_get_budget, METH_VARARGS, NULL},
+	{"set_adaptive",   gc_set_adaptive, METH_VARARGS, NULL},
+	{"get_adaptive",   gc_get_adaptive, METH_VARARGS, NULL},
+	{"get_stats",	   gc_get_stats,  METH_VARARGS, NULL},
+	{"get_pause_histograms", gc_get_pauses, METH_VARARGS, NULL},
 	{"collect",	   gc_collect,	  METH_VARARGS, NULL}, 
 	{"get_objects",    gc_get_objects,METH_VARARGS, NULL}, 
 	{"get_referrers",  gc_get_referrers, METH_VARARGS, NULL},
@@ -917,6 +1647,8 @@ initgc(void)
 {
 	PyObject *m;
 	PyObject *d;
+	PyObject *bounds;
+	int i;
 
 	m = Py_InitModule4("gc",
 			      GcMethods,
@@ -942,6 +1674,13 @@ initgc(void)
 			PyInt_FromLong(DEBUG_SAVEALL));
 	PyDict_SetItemString(d, "DEBUG_LEAK",
 			PyInt_FromLong(DEBUG_LEAK));
+	bounds = PyTuple_New(NUM_PAUSE_BUCKETS - 1);
+	if (bounds == NULL)
+		return;
+	for (i = 0; i < NUM_PAUSE_BUCKETS - 1; i++)
+		PyTuple_SET_ITEM(bounds, i, PyInt_FromLong(pause_bounds[i]));
+	PyDict_SetItemString(d, "PAUSE_BUCKETS", bounds);
+	Py_DECREF(bounds);
 }
 
 /* for debugging */
@@ -987,7 +1726,7 @@ _PyObject_GC_Malloc(PyTypeObject *tp, int nitems)
 	  init_gc_globals();
 #endif
 	allocated++;
- 	if (allocated > threshold0 &&
+ 	if (allocated > threshold0_now &&
  	    enabled &&
  	    threshold0 &&
  	    !collecting &&
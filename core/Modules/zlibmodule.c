@@ -10,35 +10,42 @@
 #ifdef WITH_THREAD
 #include "pythread.h"
 
-/* #defs ripped off from _tkinter.c, even though the situation here is much
-   simpler, because we don't have to worry about waiting for Tcl
-   events!  And, since zlib itself is threadsafe, we don't need to worry
-   about re-entering zlib functions.
-
-   N.B.
-
-   Since ENTER_ZLIB and LEAVE_ZLIB only need to be called on functions
-   that modify the components of preexisting de/compress objects, it
-   could prove to be a performance gain on multiprocessor machines if
-   there was an de/compress object-specific lock.  However, for the
-   moment the ENTER_ZLIB and LEAVE_ZLIB calls are global for ALL
-   de/compress objects.
- */
-
-static PyThread_type_lock zlib_lock = NULL; /* initialized on module load */
-
-#define ENTER_ZLIB \
-	Py_BEGIN_ALLOW_THREADS \
-	PyThread_acquire_lock(zlib_lock, 1); \
-	Py_END_ALLOW_THREADS
+/* zlib itself is threadsafe, so the interpreter lock is released while
+   it works.  Each de/compress object has a lock of its own that keeps
+   two threads from using its z_stream at once; independent objects run
+   in parallel.  The lock is taken without releasing the interpreter
+   lock when nobody else holds it, which is nearly always. */
+
+#define ENTER_ZLIB(obj) \
+	if (!PyThread_acquire_lock((obj)->lock, 0)) { \
+		Py_BEGIN_ALLOW_THREADS \
+		PyThread_acquire_lock((obj)->lock, 1); \
+		Py_END_ALLOW_THREADS \
+	}
 
-#define LEAVE_ZLIB \
-	PyThread_release_lock(zlib_lock);
+#define LEAVE_ZLIB(obj) \
+	PyThread_release_lock((obj)->lock);
+
+/* Handing the interpreter lock to another thread and waiting to get it
+   back costs more than (de)compressing a small buffer, so it is only
+   released for at least ZLIB_UNLOCK_MIN bytes of input. */
+#define ZLIB_UNLOCK_MIN 4096
+
+#define ZLIB_BEGIN_ALLOW_THREADS(n) { \
+	PyThreadState *_save = NULL; \
+	if ((n) >= ZLIB_UNLOCK_MIN) \
+		_save = PyEval_SaveThread();
+#define ZLIB_END_ALLOW_THREADS \
+	if (_save != NULL) \
+		PyEval_RestoreThread(_save); \
+	}
 
 #else
 
-#define ENTER_ZLIB
-#define LEAVE_ZLIB
+#define ENTER_ZLIB(obj)
+#define LEAVE_ZLIB(obj)
+#define ZLIB_BEGIN_ALLOW_THREADS(n) {
+#define ZLIB_END_ALLOW_THREADS }
 
 #endif
 
@@ -67,8 +74,31 @@ typedef struct
     PyObject *unused_data;
     PyObject *unconsumed_tail;
     int is_initialised;
+#ifdef WITH_THREAD
+    PyThread_type_lock lock;
+#endif
 } compobject;
 
+/* The input of a call, owned by the caller for as long as the
+   interpreter lock may be released.  The data "s#" finds in argument 0
+   is only certain to stay put if that is a string: another thread could
+   resize or free any other buffer object meanwhile, so that is copied
+   into a string first.  Returns a new reference, or NULL. */
+static PyObject *
+zlib_input(PyObject *args, Byte **input, int *length)
+{
+    PyObject *arg = PyTuple_GET_ITEM(args, 0);
+
+    if (PyString_Check(arg)) {
+	Py_INCREF(arg);
+	return arg;
+    }
+    arg = PyString_FromStringAndSize((char *)*input, *length);
+    if (arg != NULL)
+	*input = (Byte *)PyString_AS_STRING(arg);
+    return arg;
+}
+
 static void
 zlib_error(z_stream zst, int err, char *msg)
 {
@@ -96,6 +126,16 @@ newcompobject(PyTypeObject *type)
     if (self == NULL)
 	return NULL;
     self->is_initialised = 0;
+    self->unconsumed_tail = NULL;
+#ifdef WITH_THREAD
+    self->lock = PyThread_allocate_lock();
+    if (self->lock == NULL) {
+	self->unused_data = NULL;
+	Py_DECREF(self);
+	PyErr_SetString(PyExc_MemoryError, "Can't allocate lock");
+	return NULL;
+    }
+#endif
     self->unused_data = PyString_FromString("");
     if (self->unused_data == NULL) {
 	Py_DECREF(self);
@@ -117,7 +157,7 @@ static char compress__doc__[] =
 static PyObject *
 PyZlib_compress(PyObject *self, PyObject *args)
 {
-    PyObject *ReturnVal = NULL;
+    PyObject *ReturnVal = NULL, *inputobj;
     Byte *input, *output;
     int length, level=Z_DEFAULT_COMPRESSION, err;
     z_stream zst;
@@ -125,6 +165,8 @@ PyZlib_compress(PyObject *self, PyObject *args)
     /* require Python string object, optional 'level' arg */
     if (!PyArg_ParseTuple(args, "s#|i:compress", &input, &length, &level))
 	return NULL;
+    if ((inputobj = zlib_input(args, &input, &length)) == NULL)
+	return NULL;
 
     zst.avail_out = length + length/1000 + 12 + 1;
 
@@ -132,6 +174,7 @@ PyZlib_compress(PyObject *self, PyObject *args)
     if (output == NULL) {
 	PyErr_SetString(PyExc_MemoryError,
 			"Can't allocate memory to compress data");
+	Py_DECREF(inputobj);
 	return NULL;
     }
 
@@ -162,9 +205,9 @@ PyZlib_compress(PyObject *self, PyObject *args)
 	goto error;
     }
 
-    Py_BEGIN_ALLOW_THREADS;
+    ZLIB_BEGIN_ALLOW_THREADS(length)
     err = deflate(&zst, Z_FINISH);
-    Py_END_ALLOW_THREADS;
+    ZLIB_END_ALLOW_THREADS
 
     if (err != Z_STREAM_END) {
 	zlib_error(zst, err, "while compressing data");
@@ -181,6 +224,7 @@ PyZlib_compress(PyObject *self, PyObject *args)
 
  error:
     free(output);
+    Py_DECREF(inputobj);
 
     return ReturnVal;
 }
@@ -194,7 +238,7 @@ static char decompress__doc__[] =
 static PyObject *
 PyZlib_decompress(PyObject *self, PyObject *args)
 {
-    PyObject *result_str;
+    PyObject *result_str, *inputobj;
     Byte *input;
     int length, err;
     int wsize=DEF_WBITS, r_strlen=DEFAULTALLOC;
@@ -203,6 +247,8 @@ PyZlib_decompress(PyObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "s#|ii:decompress",
 			  &input, &length, &wsize, &r_strlen))
 	return NULL;
+    if ((inputobj = zlib_input(args, &input, &length)) == NULL)
+	return NULL;
 
     if (r_strlen <= 0)
 	r_strlen = 1;
@@ -210,8 +256,10 @@ PyZlib_decompress(PyObject *self, PyObject *args)
     zst.avail_in = length;
     zst.avail_out = r_strlen;
 
-    if (!(result_str = PyString_FromStringAndSize(NULL, r_strlen)))
+    if (!(result_str = PyString_FromStringAndSize(NULL, r_strlen))) {
+	Py_DECREF(inputobj);
 	return NULL;
+    }
 
     zst.zalloc = (alloc_func)NULL;
     zst.zfree = (free_func)Z_NULL;
@@ -233,9 +281,9 @@ PyZlib_decompress(PyObject *self, PyObject *args)
     }
 
     do {
-	Py_BEGIN_ALLOW_THREADS
+	ZLIB_BEGIN_ALLOW_THREADS(length)
 	err=inflate(&zst, Z_FINISH);
-	Py_END_ALLOW_THREADS
+	ZLIB_END_ALLOW_THREADS
 
 	switch(err) {
 	case(Z_STREAM_END):
@@ -279,10 +327,12 @@ PyZlib_decompress(PyObject *self, PyObject *args)
     }
 
     _PyString_Resize(&result_str, zst.total_out);
+    Py_DECREF(inputobj);
     return result_str;
 
  error:
     Py_XDECREF(result_str);
+    Py_DECREF(inputobj);
     return NULL;
 }
 
@@ -364,6 +414,10 @@ Comp_dealloc(compobject *self)
 	deflateEnd(&self->zst);
     Py_XDECREF(self->unused_data);
     Py_XDECREF(self->unconsumed_tail);
+#ifdef WITH_THREAD
+    if (self->lock != NULL)
+	PyThread_free_lock(self->lock);
+#endif
     PyObject_Del(self);
 }
 
@@ -374,6 +428,10 @@ Decomp_dealloc(compobject *self)
 	inflateEnd(&self->zst);
     Py_XDECREF(self->unused_data);
     Py_XDECREF(self->unconsumed_tail);
+#ifdef WITH_THREAD
+    if (self->lock != NULL)
+	PyThread_free_lock(self->lock);
+#endif
     PyObject_Del(self);
 }
 
@@ -389,17 +447,21 @@ static PyObject *
 PyZlib_objcompress(compobject *self, PyObject *args)
 {
     int err, inplen, length = DEFAULTALLOC;
-    PyObject *RetVal;
+    PyObject *RetVal, *inputobj;
     Byte *input;
     unsigned long start_total_out;
 
     if (!PyArg_ParseTuple(args, "s#:compress", &input, &inplen))
 	return NULL;
+    if ((inputobj = zlib_input(args, &input, &inplen)) == NULL)
+	return NULL;
 
-    if (!(RetVal = PyString_FromStringAndSize(NULL, length)))
+    if (!(RetVal = PyString_FromStringAndSize(NULL, length))) {
+	Py_DECREF(inputobj);
 	return NULL;
+    }
 
-    ENTER_ZLIB
+    ENTER_ZLIB(self)
 
     start_total_out = self->zst.total_out;
     self->zst.avail_in = inplen;
@@ -407,9 +469,9 @@ PyZlib_objcompress(compobject *self, PyObject *args)
     self->zst.avail_out = length;
     self->zst.next_out = (unsigned char *)PyString_AS_STRING(RetVal);
 
-    Py_BEGIN_ALLOW_THREADS
+    ZLIB_BEGIN_ALLOW_THREADS(inplen)
     err = deflate(&(self->zst), Z_NO_FLUSH);
-    Py_END_ALLOW_THREADS
+    ZLIB_END_ALLOW_THREADS
 
     /* while Z_OK and the output buffer is full, there might be more output,
        so extend the output buffer and try again */
@@ -423,9 +485,9 @@ PyZlib_objcompress(compobject *self, PyObject *args)
 	self->zst.avail_out = length;
 	length = length << 1;
 
-	Py_BEGIN_ALLOW_THREADS
+	ZLIB_BEGIN_ALLOW_THREADS(inplen)
 	err = deflate(&(self->zst), Z_NO_FLUSH);
-	Py_END_ALLOW_THREADS
+	ZLIB_END_ALLOW_THREADS
     }
     /* We will only get Z_BUF_ERROR if the output buffer was full but
        there wasn't more output when we tried again, so it is not an error
@@ -443,7 +505,8 @@ PyZlib_objcompress(compobject *self, PyObject *args)
 	RetVal = NULL;
 
  error:
-    LEAVE_ZLIB
+    LEAVE_ZLIB(self)
+    Py_DECREF(inputobj);
     return RetVal;
 }
 
@@ -463,7 +526,7 @@ PyZlib_objdecompress(compobject *self, PyObject *args)
 {
     int err, inplen, old_length, length = DEFAULTALLOC;
     int max_length = 0;
-    PyObject *RetVal;
+    PyObject *RetVal, *inputobj;
     Byte *input;
     unsigned long start_total_out;
 
@@ -475,14 +538,18 @@ PyZlib_objdecompress(compobject *self, PyObject *args)
 			"max_length must be greater than zero");
 	return NULL;
     }
+    if ((inputobj = zlib_input(args, &input, &inplen)) == NULL)
+	return NULL;
 
     /* limit amount of data allocated to max_length */
     if (max_length && length > max_length)
 	length = max_length;
-    if (!(RetVal = PyString_FromStringAndSize(NULL, length)))
+    if (!(RetVal = PyString_FromStringAndSize(NULL, length))) {
+	Py_DECREF(inputobj);
 	return NULL;
+    }
 
-    ENTER_ZLIB
+    ENTER_ZLIB(self)
 
     start_total_out = self->zst.total_out;
     self->zst.avail_in = inplen;
@@ -490,9 +557,9 @@ PyZlib_objdecompress(compobject *self, PyObject *args)
     self->zst.avail_out = length;
     self->zst.next_out = (unsigned char *)PyString_AS_STRING(RetVal);
 
-    Py_BEGIN_ALLOW_THREADS
+    ZLIB_BEGIN_ALLOW_THREADS(inplen)
     err = inflate(&(self->zst), Z_SYNC_FLUSH);
-    Py_END_ALLOW_THREADS
+    ZLIB_END_ALLOW_THREADS
 
     /* While Z_OK and the output buffer is full, there might be more output.
        So extend the output buffer and try again.
@@ -518,9 +585,9 @@ PyZlib_objdecompress(compobject *self, PyObject *args)
 	    + old_length;
 	self->zst.avail_out = length - old_length;
 
-	Py_BEGIN_ALLOW_THREADS
+	ZLIB_BEGIN_ALLOW_THREADS(inplen)
 	err = inflate(&(self->zst), Z_SYNC_FLUSH);
-	Py_END_ALLOW_THREADS
+	ZLIB_END_ALLOW_THREADS
     }
 
     /* Not all of the compressed data could be accomodated in the output buffer
@@ -565,7 +632,8 @@ PyZlib_objdecompress(compobject *self, PyObject *args)
 	RetVal = NULL;
 
  error:
-    LEAVE_ZLIB
+    LEAVE_ZLIB(self)
+    Py_DECREF(inputobj);
 
     return RetVal;
 }
@@ -598,7 +666,7 @@ PyZlib_flush(compobject *self, PyObject *args)
     if (!(RetVal = PyString_FromStringAndSize(NULL, length)))
 	return NULL;
 
-    ENTER_ZLIB
+    ENTER_ZLIB(self)
 
     start_total_out = self->zst.total_out;
     self->zst.avail_in = 0;
@@ -655,7 +723,7 @@ PyZlib_flush(compobject *self, PyObject *args)
 	RetVal = NULL;
 
  error:
-    LEAVE_ZLIB
+    LEAVE_ZLIB(self)
 
     return RetVal;
 }
@@ -678,7 +746,7 @@ PyZlib_unflush(compobject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, ""))
 	return NULL;
 
-    ENTER_ZLIB
+    ENTER_ZLIB(self)
 
     err = inflateEnd(&(self->zst));
     if (err != Z_OK)
@@ -688,7 +756,7 @@ PyZlib_unflush(compobject *self, PyObject *args)
 	retval = PyString_FromStringAndSize(NULL, 0);
     }
 
-    LEAVE_ZLIB
+    LEAVE_ZLIB(self)
 
     return retval;
 }
@@ -725,7 +793,7 @@ Decomp_getattr(compobject *self, char *name)
 {
     PyObject * retval;
 
-    ENTER_ZLIB
+    ENTER_ZLIB(self)
 
     if (strcmp(name, "unused_data") == 0) {
 	Py_INCREF(self->unused_data);
@@ -736,7 +804,7 @@ Decomp_getattr(compobject *self, char *name)
     } else
 	retval = Py_FindMethod(Decomp_methods, (PyObject *)self, name);
 
-    LEAVE_ZLIB
+    LEAVE_ZLIB(self)
 
     return retval;
 }
@@ -754,9 +822,16 @@ PyZlib_adler32(PyObject *self, PyObject *args)
     Byte *buf;
     int len;
 
+    PyObject *bufobj;
+
     if (!PyArg_ParseTuple(args, "s#|l:adler32", &buf, &len, &adler32val))
 	return NULL;
+    if ((bufobj = zlib_input(args, &buf, &len)) == NULL)
+	return NULL;
+    ZLIB_BEGIN_ALLOW_THREADS(len)
     adler32val = adler32(adler32val, buf, len);
+    ZLIB_END_ALLOW_THREADS
+    Py_DECREF(bufobj);
     return PyInt_FromLong(adler32val);
 }
 
@@ -772,9 +847,16 @@ PyZlib_crc32(PyObject *self, PyObject *args)
     uLong crc32val = crc32(0L, Z_NULL, 0);
     Byte *buf;
     int len;
+    PyObject *bufobj;
+
     if (!PyArg_ParseTuple(args, "s#|l:crc32", &buf, &len, &crc32val))
 	return NULL;
+    if ((bufobj = zlib_input(args, &buf, &len)) == NULL)
+	return NULL;
+    ZLIB_BEGIN_ALLOW_THREADS(len)
     crc32val = crc32(crc32val, buf, len);
+    ZLIB_END_ALLOW_THREADS
+    Py_DECREF(bufobj);
     return PyInt_FromLong(crc32val);
 }
 
@@ -880,7 +962,4 @@ PyInit_zlib(void)
 	Py_DECREF(ver);
     }
 
-#ifdef WITH_THREAD
-    zlib_lock = PyThread_allocate_lock();
-#endif // WITH_THREAD
 }
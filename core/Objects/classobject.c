@@ -129,6 +129,7 @@ PyClass_New(PyObject *bases, PyObject *dict, PyObject *name)
 	Py_XINCREF(op->cl_getattr);
 	Py_XINCREF(op->cl_setattr);
 	Py_XINCREF(op->cl_delattr);
+	op->cl_keys = NULL;
 	_PyObject_GC_TRACK(op);
 	return (PyObject *) op;
 }
@@ -187,6 +188,7 @@ class_dealloc(PyClassObject *op)
 	Py_XDECREF(op->cl_getattr);
 	Py_XDECREF(op->cl_setattr);
 	Py_XDECREF(op->cl_delattr);
+	_PyDict_ReleaseSharedKeys(&op->cl_keys);
 	PyObject_GC_Del(op);
 }
 
@@ -526,7 +528,7 @@ PyInstance_NewRaw(PyObject *klass, PyObject *dict)
 		return NULL;
 	}
 	if (dict == NULL) {
-		dict = PyDict_New();
+		dict = _PyDict_NewShared(&((PyClassObject *)klass)->cl_keys);
 		if (dict == NULL)
 			return NULL;
 	}
@@ -759,7 +761,8 @@ static int
 instance_setattr1(PyInstanceObject *inst, PyObject *name, PyObject *v)
 {
 	if (v == NULL) {
-		int rv = PyDict_DelItem(inst->in_dict, name);
+		int rv = _PyDict_SetItemShared(&inst->in_class->cl_keys,
+					       inst->in_dict, name, NULL);
 		if (rv < 0)
 			PyErr_Format(PyExc_AttributeError,
 				     "%.50s instance has no attribute '%.400s'",
@@ -768,7 +771,8 @@ instance_setattr1(PyInstanceObject *inst, PyObject *name, PyObject *v)
 		return rv;
 	}
 	else
-		return PyDict_SetItem(inst->in_dict, name, v);
+		return _PyDict_SetItemShared(&inst->in_class->cl_keys,
+					     inst->in_dict, name, v);
 }
 
 static int
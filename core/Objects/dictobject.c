@@ -3,6 +3,7 @@
 /* Dictionary object implementation using a hash table */
 
 #include "Python.h"
+#include <stddef.h>
 
 typedef PyDictEntry dictentry;
 typedef PyDictObject dictobject;
@@ -107,16 +108,86 @@ polynomial.  In Tim's experiments the current scheme ran faster, produced
 equally good collision statistics, needed less code & used less memory.
 */
 
-/* Object used as dummy key to fill deleted entries */
+/* Last ma_version handed out.  Every mutation of any dict takes the next
+   one, so a (dict, ma_version) pair never repeats and a cached lookup
+   result can be trusted while the version it was taken at is current. */
 #ifndef SYMBIAN
-static PyObject *dummy; /* Initialized by first call to newdictobject() */
+static Py_dictversion_t dict_version = 0;
 #else
-#define dummy (pyglobals->dummy)
+#define dict_version (PYTHON_GLOBALS->dict_version)
 #endif
 
-/* forward declarations */
-static dictentry *
-lookdict_string(dictobject *mp, PyObject *key, long hash);
+#ifdef HAVE_LONG_LONG
+#define NEW_VERSION(mp) ((mp)->ma_version = ++dict_version)
+#else
+/* Without a 64-bit counter, a wrap could bring back a version that is
+   still cached somewhere.  There is no finding every cache, so stop. */
+#define NEW_VERSION(mp) \
+	((mp)->ma_version = ++dict_version != 0 ? dict_version : \
+	 (Py_FatalError("dict version counter overflow"), 0))
+#endif
+
+/* Keys objects of the smallest size are recycled, since nearly every
+   dict has one.  The free ones are chained through their index table. */
+#ifndef SYMBIAN
+static PyDictKeysObject *keys_free_list = NULL;
+static int keys_numfree = 0;
+#else
+#define keys_free_list (*(PyDictKeysObject **)&(PYTHON_GLOBALS->dict_keys_free_list))
+#define keys_numfree (PYTHON_GLOBALS->dict_keys_numfree)
+#endif
+#define MAXFREEKEYS 80
+#define DK_NEXT_FREE(dk) (*(PyDictKeysObject **)&(dk)->dk_indices)
+
+/* So are dict objects; the free ones are chained through ma_keys. */
+#ifndef PyDict_MAXFREELIST
+#define PyDict_MAXFREELIST 80	/* Default number of dicts to save */
+#endif
+#ifndef SYMBIAN
+static dictobject *free_dicts = NULL;
+static PyFreeListStats dict_freelist = {0, 0, 0, PyDict_MAXFREELIST};
+#else
+#define free_dicts (*(dictobject **)&(PYTHON_GLOBALS->dict_free_list))
+#define dict_freelist (PYTHON_GLOBALS->dict_freelist)
+#endif
+
+#define DK_SIZE(dk) ((dk)->dk_size)
+#define DK_MASK(dk) ((dk)->dk_size - 1)
+#define DK_IXSIZE(dk) _PyDict_IXSIZE(dk)
+#define DK_ENTRIES(dk) _PyDict_ENTRIES(dk)
+#define DICT_VALUE(mp, ix) _PyDict_VALUE(mp, ix)
+
+/* A table of size n has room for this many entries; this keeps the index
+   table at most two-thirds full, so failing searches end quickly. */
+#define USABLE_FRACTION(n) (((n) << 1) / 3)
+
+/* The keys object of every empty combined dict.  It has no room for
+   entries, so the first insertion replaces it; it is never written to,
+   and is exempt from reference counting. */
+static int lookdict_string(dictobject *mp, PyObject *key, long hash,
+			   PyObject ***value_addr);
+
+static const PyDictKeysObject empty_keys_struct = {
+	1,				/* dk_refcnt */
+	PyDict_MINSIZE,			/* dk_size */
+	lookdict_string,		/* dk_lookup */
+	0,				/* dk_usable */
+	0,				/* dk_nentries */
+	{{DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY,
+	  DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY}},
+};
+
+#define Py_EMPTY_KEYS ((PyDictKeysObject *)&empty_keys_struct)
+
+#define DK_INCREF(dk) do {						\
+	if ((dk) != Py_EMPTY_KEYS)					\
+		(dk)->dk_refcnt++;					\
+    } while(0)
+
+#define DK_DECREF(dk) do {						\
+	if ((dk) != Py_EMPTY_KEYS && --(dk)->dk_refcnt == 0)		\
+		free_keys_object(dk);					\
+    } while(0)
 
 #ifdef SHOW_CONVERSION_COUNTS
 const static long created = 0L;
@@ -131,46 +202,140 @@ show_counts(void)
 }
 #endif
 
-/* Initialization macros.
-   There are two ways to create a dict:  PyDict_New() is the main C API
-   function, and the tp_new slot maps to dict_new().  In the latter case we
-   can save a little time over what PyDict_New does because it's guaranteed
-   that the PyDictObject struct is already zeroed out.
-   Everyone except dict_new() should use EMPTY_TO_MINSIZE (unless they have
-   an excellent reason not to).
-*/
+/* Index table access.  The width of a slot depends on the table size,
+   which is fixed for the life of a keys object. */
 
-#define INIT_NONZERO_DICT_SLOTS(mp) do {				\
-	(mp)->ma_table = (mp)->ma_smalltable;				\
-	(mp)->ma_mask = PyDict_MINSIZE - 1;				\
-    } while(0)
+static int
+dk_get_index(PyDictKeysObject *dk, unsigned int i)
+{
+	if (dk->dk_size <= 0x80)
+		return dk->dk_indices.as_1[i];
+	else if (dk->dk_size <= 0x8000)
+		return dk->dk_indices.as_2[i];
+	else
+		return dk->dk_indices.as_4[i];
+}
 
-#define EMPTY_TO_MINSIZE(mp) do {					\
-	memset((mp)->ma_smalltable, 0, sizeof((mp)->ma_smalltable));	\
-	(mp)->ma_used = (mp)->ma_fill = 0;				\
-	INIT_NONZERO_DICT_SLOTS(mp);					\
-    } while(0)
+static void
+dk_set_index(PyDictKeysObject *dk, unsigned int i, int ix)
+{
+	if (dk->dk_size <= 0x80)
+		dk->dk_indices.as_1[i] = (signed char)ix;
+	else if (dk->dk_size <= 0x8000)
+		dk->dk_indices.as_2[i] = (short)ix;
+	else
+		dk->dk_indices.as_4[i] = ix;
+}
 
-DL_EXPORT(PyObject *)
-PyDict_New(void)
+/* Return a new keys object with room for USABLE_FRACTION(size) entries,
+   or NULL without an exception set. */
+static PyDictKeysObject *
+new_keys_object(int size)
+{
+	PyDictKeysObject *dk;
+	int ixsize, usable;
+
+	assert(size >= PyDict_MINSIZE);
+	assert((size & (size - 1)) == 0);
+	ixsize = size <= 0x80 ? 1 : size <= 0x8000 ? 2 : 4;
+	usable = USABLE_FRACTION(size);
+	if (size == PyDict_MINSIZE && keys_free_list != NULL) {
+		dk = keys_free_list;
+		keys_free_list = DK_NEXT_FREE(dk);
+		keys_numfree--;
+	}
+	else {
+		dk = (PyDictKeysObject *)PyObject_MALLOC(
+			offsetof(PyDictKeysObject, dk_indices) +
+			size * ixsize + usable * sizeof(dictentry));
+		if (dk == NULL)
+			return NULL;
+	}
+	dk->dk_refcnt = 1;
+	dk->dk_size = size;
+	dk->dk_lookup = lookdict_string;
+	dk->dk_usable = usable;
+	dk->dk_nentries = 0;
+	/* DKIX_EMPTY is all one bits at every width.  Entries past
+	   dk_nentries are never looked at, so they are left alone. */
+	memset(&dk->dk_indices, 0xff, size * ixsize);
+	return dk;
+}
+
+/* Give back the memory of dk, whose entries hold no references. */
+static void
+release_keys_memory(PyDictKeysObject *dk)
+{
+	if (dk->dk_size == PyDict_MINSIZE && keys_numfree < MAXFREEKEYS) {
+		DK_NEXT_FREE(dk) = keys_free_list;
+		keys_free_list = dk;
+		keys_numfree++;
+	}
+	else
+		PyObject_FREE(dk);
+}
+
+static void
+free_keys_object(PyDictKeysObject *dk)
+{
+	dictentry *ep = DK_ENTRIES(dk);
+	int i, n = dk->dk_nentries;
+
+	assert(dk != Py_EMPTY_KEYS);
+	for (i = 0; i < n; i++, ep++) {
+		Py_XDECREF(ep->me_key);
+		Py_XDECREF(ep->me_value);
+	}
+	release_keys_memory(dk);
+}
+
+/* Return a split table's values array for keys dk, all NULL. */
+static PyObject **
+new_values(PyDictKeysObject *dk)
+{
+	int n = USABLE_FRACTION(dk->dk_size);
+	PyObject **values;
+
+	values = (PyObject **)PyObject_MALLOC(n * sizeof(PyObject *));
+	if (values != NULL)
+		memset(values, 0, n * sizeof(PyObject *));
+	return values;
+}
+
+/* Initialization.
+   There are two ways to create a dict:  PyDict_New() is the main C API
+   function, and the tp_new slot maps to dict_new().  Both start out with
+   the empty keys object, so a dict that stays empty costs no table at
+   all.
+*/
+
+/* Make a dict from keys and values, stealing a reference to keys. */
+static PyObject *
+new_dict(PyDictKeysObject *keys, PyObject **values)
 {
 	register dictobject *mp;
-#ifdef SYMBIAN
-	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
-#endif
-	if (dummy == NULL) { /* Auto-initialize dummy */
-		dummy = PyString_FromString("<dummy key>");
-		if (dummy == NULL)
+
+	if (free_dicts != NULL) {
+		mp = free_dicts;
+		free_dicts = (dictobject *)mp->ma_keys;
+		dict_freelist.count--;
+		dict_freelist.hits++;
+		_Py_NewReference((PyObject *)mp);
+	}
+	else {
+		dict_freelist.misses++;
+		mp = PyObject_GC_New(dictobject, &PyDict_Type);
+		if (mp == NULL) {
+			DK_DECREF(keys);
+			if (values != NULL)
+				PyObject_FREE(values);
 			return NULL;
-#ifdef SHOW_CONVERSION_COUNTS
-		Py_AtExit(show_counts);
-#endif
+		}
 	}
-	mp = PyObject_GC_New(dictobject, &PyDict_Type);
-	if (mp == NULL)
-		return NULL;
-	EMPTY_TO_MINSIZE(mp);
-	mp->ma_lookup = lookdict_string;
+	mp->ma_keys = keys;
+	mp->ma_values = values;
+	mp->ma_used = 0;
+	NEW_VERSION(mp);
 #ifdef SHOW_CONVERSION_COUNTS
 	++created;
 #endif
@@ -178,6 +343,16 @@ PyDict_New(void)
 	return (PyObject *)mp;
 }
 
+DL_EXPORT(PyObject *)
+PyDict_New(void)
+{
+#ifdef SHOW_CONVERSION_COUNTS
+	if (created == 0)
+		Py_AtExit(show_counts);
+#endif
+	return new_dict(Py_EMPTY_KEYS, NULL);
+}
+
 /*
 The basic lookup function used by all operations.
 This is based on Algorithm D from Knuth Vol. 3, Sec. 6.4.
@@ -193,112 +368,85 @@ All arithmetic on hash should ignore overflow.
 contributions by Reimer Behrends, Jyrki Alakuijala, Vladimir Marangozov and
 Christian Tismer).
 
-This function must never return NULL; failures are indicated by returning
-a dictentry* for which the me_value field is NULL.  Exceptions are never
-reported by this function, and outstanding exceptions are maintained.
+See PyDictLookupFunc for the interface.  Comparisons that raise are
+treated as unequal, and their exceptions are cleared.
 */
 
-static dictentry *
-lookdict(dictobject *mp, PyObject *key, register long hash)
+static int
+lookdict(dictobject *mp, PyObject *key, register long hash,
+	 PyObject ***value_addr)
 {
-	register int i;
+	register unsigned int i;
 	register unsigned int perturb;
-	register dictentry *freeslot;
-	register unsigned int mask = mp->ma_mask;
-	dictentry *ep0 = mp->ma_table;
+	register unsigned int mask;
+	PyDictKeysObject *dk;
+	dictentry *ep0;
 	register dictentry *ep;
-	register int restore_error;
-	register int checked_error;
-	register int cmp;
+	register int ix;
+	int restore_error;
+	int checked_error;
+	int cmp;
 	PyObject *err_type, *err_value, *err_tb;
 	PyObject *startkey;
 
-	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; //  avoid TLS reads
-
-	i = hash & mask;
-	ep = &ep0[i];
-	if (ep->me_key == NULL || ep->me_key == key)
-		return ep;
-
 	restore_error = checked_error = 0;
-	if (ep->me_key == dummy)
-		freeslot = ep;
-	else {
-		if (ep->me_hash == hash) {
-			/* error can't have been checked yet */
-			checked_error = 1;
-			if (PyErr_Occurred()) {
-				restore_error = 1;
-				PyErr_Fetch(&err_type, &err_value, &err_tb);
-			}
-			startkey = ep->me_key;
-			cmp = PyObject_RichCompareBool(startkey, key, Py_EQ);
-			if (cmp < 0)
-				PyErr_Clear();
-			if (ep0 == mp->ma_table && ep->me_key == startkey) {
-				if (cmp > 0)
-					goto Done;
-			}
-			else {
-				/* The compare did major nasty stuff to the
-				 * dict:  start over.
-				 * XXX A clever adversary could prevent this
-				 * XXX from terminating.
- 				 */
- 				ep = lookdict(mp, key, hash);
- 				goto Done;
- 			}
-		}
-		freeslot = NULL;
-	}
-
-	/* In the loop, me_key == dummy is by far (factor of 100s) the
-	   least likely outcome, so test for that last. */
+  top:
+	dk = mp->ma_keys;
+	mask = DK_MASK(dk);
+	ep0 = DK_ENTRIES(dk);
+	i = (unsigned int)hash & mask;
 	for (perturb = hash; ; perturb >>= PERTURB_SHIFT) {
-		i = (i << 2) + i + perturb + 1;
-		ep = &ep0[i & mask];
-		if (ep->me_key == NULL) {
-			if (freeslot != NULL)
-				ep = freeslot;
+		ix = dk_get_index(dk, i & mask);
+		if (ix == DKIX_EMPTY) {
+			*value_addr = NULL;
 			break;
 		}
-		if (ep->me_key == key)
-			break;
-		if (ep->me_hash == hash && ep->me_key != dummy) {
-			if (!checked_error) {
-				checked_error = 1;
-				if (PyErr_Occurred()) {
-					restore_error = 1;
-					PyErr_Fetch(&err_type, &err_value,
-						    &err_tb);
+		if (ix >= 0) {
+			ep = &ep0[ix];
+			if (ep->me_key == key)
+				goto found;
+			if (ep->me_hash == hash) {
+				if (!checked_error) {
+					checked_error = 1;
+					if (PyErr_Occurred()) {
+						restore_error = 1;
+						PyErr_Fetch(&err_type, &err_value,
+							    &err_tb);
+					}
+				}
+				startkey = ep->me_key;
+				Py_INCREF(startkey);
+				cmp = PyObject_RichCompareBool(startkey, key,
+							       Py_EQ);
+				Py_DECREF(startkey);
+				if (cmp < 0)
+					PyErr_Clear();
+				if (dk != mp->ma_keys || ep->me_key != startkey) {
+					/* The compare did major nasty stuff to
+					 * the dict:  start over.
+					 * XXX A clever adversary could prevent
+					 * XXX this from terminating.
+					 */
+					goto top;
 				}
-			}
-			startkey = ep->me_key;
-			cmp = PyObject_RichCompareBool(startkey, key, Py_EQ);
-			if (cmp < 0)
-				PyErr_Clear();
-			if (ep0 == mp->ma_table && ep->me_key == startkey) {
 				if (cmp > 0)
-					break;
+					goto found;
 			}
-			else {
-				/* The compare did major nasty stuff to the
-				 * dict:  start over.
-				 * XXX A clever adversary could prevent this
-				 * XXX from terminating.
- 				 */
- 				ep = lookdict(mp, key, hash);
- 				break;
- 			}
 		}
-		else if (ep->me_key == dummy && freeslot == NULL)
-			freeslot = ep;
+		i = (i << 2) + i + perturb + 1;
 	}
+	if (restore_error)
+		PyErr_Restore(err_type, err_value, err_tb);
+	return DKIX_EMPTY;
 
-Done:
+  found:
+	if (mp->ma_values != NULL)
+		*value_addr = &mp->ma_values[ix];
+	else
+		*value_addr = &ep->me_value;
 	if (restore_error)
 		PyErr_Restore(err_type, err_value, err_tb);
-	return ep;
+	return ix;
 }
 
 /*
@@ -306,112 +454,107 @@ Done:
  * this assumption allows testing for errors during PyObject_Compare() to
  * be dropped; string-string comparisons never raise exceptions.  This also
  * means we don't need to go through PyObject_Compare(); we can always use
- * _PyString_Eq directly.
+ * _PyString_Eq directly.  When both the key and an entry's key are
+ * interned, they are equal only if they are the same object, so the
+ * comparison is skipped altogether.
  *
  * This is valuable because the general-case error handling in lookdict() is
- * expensive, and dicts with pure-string keys are very common.
+ * expensive, and dicts with pure-string keys are very common.  A table
+ * keeps this lookup until insertdict() puts a non-string key in it.
  */
-static dictentry *
-lookdict_string(dictobject *mp, PyObject *key, register long hash)
+static int
+lookdict_string(dictobject *mp, PyObject *key, register long hash,
+		PyObject ***value_addr)
 {
-	register int i;
+	register unsigned int i;
 	register unsigned int perturb;
-	register dictentry *freeslot;
-	register unsigned int mask = mp->ma_mask;
-	dictentry *ep0 = mp->ma_table;
+	PyDictKeysObject *dk = mp->ma_keys;
+	register unsigned int mask = DK_MASK(dk);
+	dictentry *ep0 = DK_ENTRIES(dk);
 	register dictentry *ep;
-
-	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; //  avoid TLS reads
+	register int ix;
+	int key_interned;
 
 	/* Make sure this function doesn't have to handle non-string keys,
 	   including subclasses of str; e.g., one reason to subclass
 	   strings is to override __eq__, and for speed we don't cater to
 	   that here. */
-	if (!PyString_CheckExact(key)) {
-#ifdef SHOW_CONVERSION_COUNTS
-		++converted;
-#endif
-		mp->ma_lookup = lookdict;
-		return lookdict(mp, key, hash);
-	}
-	i = hash & mask;
-	ep = &ep0[i];
-	if (ep->me_key == NULL || ep->me_key == key)
-		return ep;
-	if (ep->me_key == dummy)
-		freeslot = ep;
-	else {
-		if (ep->me_hash == hash
-		    && _PyString_Eq(ep->me_key, key)) {
-			return ep;
+	if (!PyString_CheckExact(key))
+		return lookdict(mp, key, hash, value_addr);
+	/* An interned entry key equal to an interned key is that key. */
+	key_interned = PyString_CHECK_INTERNED(key);
+	i = (unsigned int)hash & mask;
+	for (perturb = hash; ; perturb >>= PERTURB_SHIFT) {
+		ix = dk_get_index(dk, i & mask);
+		if (ix == DKIX_EMPTY) {
+			*value_addr = NULL;
+			return DKIX_EMPTY;
+		}
+		if (ix >= 0) {
+			ep = &ep0[ix];
+			if (ep->me_key == key
+			    || (ep->me_hash == hash
+				&& !(key_interned
+				     && PyString_CHECK_INTERNED(ep->me_key))
+				&& _PyString_Eq(ep->me_key, key))) {
+				if (mp->ma_values != NULL)
+					*value_addr = &mp->ma_values[ix];
+				else
+					*value_addr = &ep->me_value;
+				return ix;
+			}
 		}
-		freeslot = NULL;
+		i = (i << 2) + i + perturb + 1;
 	}
+}
 
-	/* In the loop, me_key == dummy is by far (factor of 100s) the
-	   least likely outcome, so test for that last. */
-	for (perturb = hash; ; perturb >>= PERTURB_SHIFT) {
+/* Return the index slot of a hash that isn't in dk yet. */
+static unsigned int
+find_empty_slot(PyDictKeysObject *dk, long hash)
+{
+	register unsigned int i;
+	register unsigned int perturb;
+	register unsigned int mask = DK_MASK(dk);
+
+	i = (unsigned int)hash & mask;
+	for (perturb = hash; dk_get_index(dk, i & mask) != DKIX_EMPTY;
+	     perturb >>= PERTURB_SHIFT)
 		i = (i << 2) + i + perturb + 1;
-		ep = &ep0[i & mask];
-		if (ep->me_key == NULL)
-			return freeslot == NULL ? ep : freeslot;
-		if (ep->me_key == key
-		    || (ep->me_hash == hash
-		        && ep->me_key != dummy
-			&& _PyString_Eq(ep->me_key, key)))
-			return ep;
-		if (ep->me_key == dummy && freeslot == NULL)
-			freeslot = ep;
-	}
+	return i & mask;
 }
 
-/*
-Internal routine to insert a new item into the table.
-Used both by the internal resize routine and by the public insert routine.
-Eats a reference to key and one to value.
-*/
-static void
-insertdict(register dictobject *mp, PyObject *key, long hash, PyObject *value)
+/* Return the index slot that points to entry ix, whose hash is hash. */
+static unsigned int
+lookdict_index(PyDictKeysObject *dk, long hash, int ix)
 {
-	PyObject *old_value;
-	register dictentry *ep;
-	typedef PyDictEntry *(*lookupfunc)(PyDictObject *, PyObject *, long);
+	register unsigned int i;
+	register unsigned int perturb;
+	register unsigned int mask = DK_MASK(dk);
 
-	assert(mp->ma_lookup != NULL);
-	ep = mp->ma_lookup(mp, key, hash);
-	if (ep->me_value != NULL) {
-		old_value = ep->me_value;
-		ep->me_value = value;
-		Py_DECREF(old_value); /* which **CAN** re-enter */
-		Py_DECREF(key);
-	}
-	else {
-		if (ep->me_key == NULL)
-			mp->ma_fill++;
-		else
-			Py_DECREF(ep->me_key);
-		ep->me_key = key;
-		ep->me_hash = hash;
-		ep->me_value = value;
-		mp->ma_used++;
+	i = (unsigned int)hash & mask;
+	for (perturb = hash; dk_get_index(dk, i & mask) != ix;
+	     perturb >>= PERTURB_SHIFT) {
+		assert(dk_get_index(dk, i & mask) != DKIX_EMPTY);
+		i = (i << 2) + i + perturb + 1;
 	}
+	return i & mask;
 }
 
 /*
-Restructure the table by allocating a new table and reinserting all
-items again.  When entries have been deleted, the new table may
-actually be smaller than the old one.
+Restructure the table by allocating a new keys object and moving all
+live items into it; the result is always a combined table.  When entries
+have been deleted, the new table may actually be smaller than the old
+one.  Returns -1 with MemoryError set on failure, leaving the dict as it
+was.
 */
 static int
 dictresize(dictobject *mp, int minused)
 {
 	int newsize;
-	dictentry *oldtable, *newtable, *ep;
-	int i;
-	int is_oldtable_malloced;
-	dictentry small_copy[PyDict_MINSIZE];
-
-	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; //  avoid TLS reads
+	PyDictKeysObject *oldkeys, *newkeys;
+	PyObject **oldvalues;
+	dictentry *oldentries, *newentries;
+	int i, j, n;
 
 	assert(minused >= 0);
 
@@ -425,65 +568,130 @@ dictresize(dictobject *mp, int minused)
 		return -1;
 	}
 
-	/* Get space for a new table. */
-	oldtable = mp->ma_table;
-	assert(oldtable != NULL);
-	is_oldtable_malloced = oldtable != mp->ma_smalltable;
-
-	if (newsize == PyDict_MINSIZE) {
-		/* A large table is shrinking, or we can't get any smaller. */
-		newtable = mp->ma_smalltable;
-		if (newtable == oldtable) {
-			if (mp->ma_fill == mp->ma_used) {
-				/* No dummies, so no point doing anything. */
-				return 0;
-			}
-			/* We're not going to resize it, but rebuild the
-			   table anyway to purge old dummy entries.
-			   Subtle:  This is *necessary* if fill==size,
-			   as lookdict needs at least one virgin slot to
-			   terminate failing searches.  If fill < size, it's
-			   merely desirable, as dummies slow searches. */
-			assert(mp->ma_fill > mp->ma_used);
-			memcpy(small_copy, oldtable, sizeof(small_copy));
-			oldtable = small_copy;
-		}
+	oldkeys = mp->ma_keys;
+	oldvalues = mp->ma_values;
+	newkeys = new_keys_object(newsize);
+	if (newkeys == NULL) {
+		PyErr_NoMemory();
+		return -1;
 	}
-	else {
-		newtable = PyMem_NEW(dictentry, newsize);
-		if (newtable == NULL) {
-			PyErr_NoMemory();
-			return -1;
+	assert(newkeys->dk_usable >= mp->ma_used);
+	if (oldkeys->dk_lookup == lookdict)
+		newkeys->dk_lookup = lookdict;
+
+	/* Copy the live entries over, in order.  This is refcount-neutral
+	   for a combined table; a split table's keys stay with the shared
+	   keys object, so they are increfed here. */
+	oldentries = DK_ENTRIES(oldkeys);
+	newentries = DK_ENTRIES(newkeys);
+	n = oldkeys->dk_nentries;
+	for (i = j = 0; i < n; i++) {
+		PyObject *value = oldvalues != NULL ? oldvalues[i] :
+			oldentries[i].me_value;
+		if (value != NULL) {
+			newentries[j].me_hash = oldentries[i].me_hash;
+			newentries[j].me_key = oldentries[i].me_key;
+			newentries[j].me_value = value;
+			if (oldvalues != NULL)
+				Py_INCREF(oldentries[i].me_key);
+			dk_set_index(newkeys,
+				     find_empty_slot(newkeys,
+						     oldentries[i].me_hash),
+				     j);
+			j++;
 		}
 	}
+	assert(j == mp->ma_used);
+	newkeys->dk_usable -= j;
+	newkeys->dk_nentries = j;
 
-	/* Make the dict empty, using the new table. */
-	assert(newtable != oldtable);
-	mp->ma_table = newtable;
-	mp->ma_mask = newsize - 1;
-	memset(newtable, 0, sizeof(dictentry) * newsize);
-	mp->ma_used = 0;
-	i = mp->ma_fill;
-	mp->ma_fill = 0;
-
-	/* Copy the data over; this is refcount-neutral for active entries;
-	   dummy entries aren't copied over, of course */
-	for (ep = oldtable; i > 0; ep++) {
-		if (ep->me_value != NULL) {	/* active entry */
-			--i;
-			insertdict(mp, ep->me_key, ep->me_hash, ep->me_value);
-		}
-		else if (ep->me_key != NULL) {	/* dummy entry */
-			--i;
-			assert(ep->me_key == dummy);
-			Py_DECREF(ep->me_key);
+	mp->ma_keys = newkeys;
+	mp->ma_values = NULL;
+	NEW_VERSION(mp);
+	if (oldvalues != NULL) {
+		PyObject_FREE(oldvalues);
+		DK_DECREF(oldkeys);
+	}
+	else if (oldkeys != Py_EMPTY_KEYS) {
+		/* The references went to newkeys. */
+		assert(oldkeys->dk_refcnt == 1);
+		release_keys_memory(oldkeys);
+	}
+	return 0;
+}
+
+/* Make room for one more entry.  Normally this doubles the size, but it
+   can also shrink the table if many keys have been deleted, or turn a
+   split table into a combined one. */
+#define insertion_resize(mp) dictresize((mp), (mp)->ma_used*2)
+
+/*
+Internal routine to insert a new item into the table.
+Used by the public insert routines.
+Eats a reference to key and one to value, even on failure.
+*/
+static int
+insertdict(register dictobject *mp, PyObject *key, long hash, PyObject *value)
+{
+	PyObject *old_value;
+	PyObject **value_addr;
+	PyDictKeysObject *dk;
+	register dictentry *ep;
+	int ix;
+
+	if (mp->ma_values != NULL && !PyString_CheckExact(key)) {
+		if (insertion_resize(mp) != 0)
+			goto Fail;
+	}
+	ix = mp->ma_keys->dk_lookup(mp, key, hash, &value_addr);
+	NEW_VERSION(mp);
+	if (ix >= 0) {
+		old_value = *value_addr;
+		*value_addr = value;
+		Py_DECREF(key);
+		if (old_value == NULL) {
+			/* A shared key this dict had no value for. */
+			assert(mp->ma_values != NULL);
+			mp->ma_used++;
 		}
-		/* else key == value == NULL:  nothing to do */
+		else
+			Py_DECREF(old_value); /* which **CAN** re-enter */
+		return 0;
 	}
 
-	if (is_oldtable_malloced)
-		PyMem_DEL(oldtable);
+	/* A new key:  append an entry. */
+	if (mp->ma_keys->dk_usable <= 0) {
+		if (insertion_resize(mp) != 0)
+			goto Fail;
+	}
+	dk = mp->ma_keys;
+	if (dk->dk_lookup == lookdict_string && !PyString_CheckExact(key)) {
+#ifdef SHOW_CONVERSION_COUNTS
+		++converted;
+#endif
+		dk->dk_lookup = lookdict;
+	}
+	ix = dk->dk_nentries;
+	dk_set_index(dk, find_empty_slot(dk, hash), ix);
+	ep = &DK_ENTRIES(dk)[ix];
+	ep->me_key = key;
+	ep->me_hash = hash;
+	if (mp->ma_values != NULL) {
+		assert(mp->ma_values[ix] == NULL);
+		mp->ma_values[ix] = value;
+		ep->me_value = NULL;
+	}
+	else
+		ep->me_value = value;
+	dk->dk_usable--;
+	dk->dk_nentries++;
+	mp->ma_used++;
 	return 0;
+
+  Fail:
+	Py_DECREF(key);
+	Py_DECREF(value);
+	return -1;
 }
 
 DL_EXPORT(PyObject *)
@@ -491,6 +699,7 @@ PyDict_GetItem(PyObject *op, PyObject *key)
 {
 	long hash;
 	dictobject *mp = (dictobject *)op;
+	PyObject **value_addr;
 	if (!PyDict_Check(op)) {
 		return NULL;
 	}
@@ -505,7 +714,9 @@ PyDict_GetItem(PyObject *op, PyObject *key)
 			return NULL;
 		}
 	}
-	return (mp->ma_lookup)(mp, key, hash)->me_value;
+	if (mp->ma_keys->dk_lookup(mp, key, hash, &value_addr) < 0)
+		return NULL;
+	return *value_addr;
 }
 
 /* CAUTION: PyDict_SetItem() must guarantee that it won't resize the
@@ -519,7 +730,6 @@ PyDict_SetItem(register PyObject *op, PyObject *key, PyObject *value)
 {
 	register dictobject *mp;
 	register long hash;
-	register int n_used;
 
 	if (!PyDict_Check(op)) {
 		PyErr_BadInternalCall();
@@ -548,22 +758,9 @@ PyDict_SetItem(register PyObject *op, PyObject *key, PyObject *value)
 		if (hash == -1)
 			return -1;
 	}
-	assert(mp->ma_fill <= mp->ma_mask);  /* at least one empty slot */
-	n_used = mp->ma_used;
 	Py_INCREF(value);
 	Py_INCREF(key);
-	insertdict(mp, key, hash, value);
-	/* If we added a key, we can safely resize.  Otherwise skip this!
-	 * If fill >= 2/3 size, adjust size.  Normally, this doubles the
-	 * size, but it's also possible for the dict to shrink (if ma_fill is
-	 * much larger than ma_used, meaning a lot of dict keys have been
-	 * deleted).
-	 */
-	if (mp->ma_used > n_used && mp->ma_fill*3 >= (mp->ma_mask+1)*2) {
-		if (dictresize(mp, mp->ma_used*2) != 0)
-			return -1;
-	}
-	return 0;
+	return insertdict(mp, key, hash, value);
 }
 
 DL_EXPORT(int)
@@ -571,11 +768,12 @@ PyDict_DelItem(PyObject *op, PyObject *key)
 {
 	register dictobject *mp;
 	register long hash;
+	PyDictKeysObject *dk;
 	register dictentry *ep;
+	PyObject **value_addr;
 	PyObject *old_value, *old_key;
-#ifdef SYMBIAN
-	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
-#endif
+	int ix;
+
 	if (!PyDict_Check(op)) {
 		PyErr_BadInternalCall();
 		return -1;
@@ -590,19 +788,27 @@ PyDict_DelItem(PyObject *op, PyObject *key)
 			return -1;
 	}
 	mp = (dictobject *)op;
-	ep = (mp->ma_lookup)(mp, key, hash);
-	if (ep->me_value == NULL) {
+	ix = mp->ma_keys->dk_lookup(mp, key, hash, &value_addr);
+	if (ix < 0 || *value_addr == NULL) {
 		PyErr_SetObject(PyExc_KeyError, key);
 		return -1;
 	}
-	old_key = ep->me_key;
-	Py_INCREF(dummy);
-	ep->me_key = dummy;
-	old_value = ep->me_value;
-	ep->me_value = NULL;
+	old_value = *value_addr;
+	*value_addr = NULL;
+	old_key = NULL;
+	if (mp->ma_values == NULL) {
+		/* The shared keys of a split table stay put. */
+		dk = mp->ma_keys;
+		ep = &DK_ENTRIES(dk)[ix];
+		dk_set_index(dk, lookdict_index(dk, ep->me_hash, ix),
+			     DKIX_DUMMY);
+		old_key = ep->me_key;
+		ep->me_key = NULL;
+	}
 	mp->ma_used--;
+	NEW_VERSION(mp);
 	Py_DECREF(old_value);
-	Py_DECREF(old_key);
+	Py_XDECREF(old_key);
 	return 0;
 }
 
@@ -610,69 +816,39 @@ DL_EXPORT(void)
 PyDict_Clear(PyObject *op)
 {
 	dictobject *mp;
-	dictentry *ep, *table;
-	int table_is_malloced;
-	int fill;
-	dictentry small_copy[PyDict_MINSIZE];
-#ifdef Py_DEBUG
+	PyDictKeysObject *oldkeys;
+	PyObject **oldvalues;
 	int i, n;
-#endif
 
 	if (!PyDict_Check(op))
 		return;
 	mp = (dictobject *)op;
-#ifdef Py_DEBUG
-	n = mp->ma_mask + 1;
-	i = 0;
-#endif
-
-	table = mp->ma_table;
-	assert(table != NULL);
-	table_is_malloced = table != mp->ma_smalltable;
+	oldkeys = mp->ma_keys;
+	oldvalues = mp->ma_values;
+	if (oldkeys == Py_EMPTY_KEYS)
+		return;
 
 	/* This is delicate.  During the process of clearing the dict,
 	 * decrefs can cause the dict to mutate.  To avoid fatal confusion
 	 * (voice of experience), we have to make the dict empty before
-	 * clearing the slots, and never refer to anything via mp->xxx while
-	 * clearing.
+	 * clearing the old table, and never refer to anything via mp->xxx
+	 * while clearing.
 	 */
-	fill = mp->ma_fill;
-	if (table_is_malloced)
-		EMPTY_TO_MINSIZE(mp);
-
-	else if (fill > 0) {
-		/* It's a small table with something that needs to be cleared.
-		 * Afraid the only safe way is to copy the dict entries into
-		 * another small table first.
-		 */
-		memcpy(small_copy, table, sizeof(small_copy));
-		table = small_copy;
-		EMPTY_TO_MINSIZE(mp);
-	}
-	/* else it's a small table that's already empty */
+	mp->ma_keys = Py_EMPTY_KEYS;
+	mp->ma_values = NULL;
+	mp->ma_used = 0;
+	NEW_VERSION(mp);
 
-	/* Now we can finally clear things.  If C had refcounts, we could
-	 * assert that the refcount on table is 1 now, i.e. that this function
-	 * has unique access to it, so decref side-effects can't alter it.
+	/* Now we can finally clear things.  Nobody else can reach
+	 * oldvalues, and a combined table's oldkeys, any more.
 	 */
-	for (ep = table; fill > 0; ++ep) {
-#ifdef Py_DEBUG
-		assert(i < n);
-		++i;
-#endif
-		if (ep->me_key) {
-			--fill;
-			Py_DECREF(ep->me_key);
-			Py_XDECREF(ep->me_value);
-		}
-#ifdef Py_DEBUG
-		else
-			assert(ep->me_value == NULL);
-#endif
+	if (oldvalues != NULL) {
+		n = oldkeys->dk_nentries;
+		for (i = 0; i < n; i++)
+			Py_XDECREF(oldvalues[i]);
+		PyObject_FREE(oldvalues);
 	}
-
-	if (table_is_malloced)
-		PyMem_DEL(table);
+	DK_DECREF(oldkeys);
 }
 
 /* CAUTION:  In general, it isn't safe to use PyDict_Next in a loop that
@@ -683,45 +859,139 @@ PyDict_Clear(PyObject *op)
 DL_EXPORT(int)
 PyDict_Next(PyObject *op, int *ppos, PyObject **pkey, PyObject **pvalue)
 {
-	int i;
+	int i, n;
 	register dictobject *mp;
+	dictentry *ep0;
 	if (!PyDict_Check(op))
 		return 0;
 	mp = (dictobject *)op;
 	i = *ppos;
 	if (i < 0)
 		return 0;
-	while (i <= mp->ma_mask && mp->ma_table[i].me_value == NULL)
-		i++;
+	n = mp->ma_keys->dk_nentries;
+	ep0 = DK_ENTRIES(mp->ma_keys);
+	if (mp->ma_values != NULL) {
+		while (i < n && mp->ma_values[i] == NULL)
+			i++;
+	}
+	else {
+		while (i < n && ep0[i].me_value == NULL)
+			i++;
+	}
 	*ppos = i+1;
-	if (i > mp->ma_mask)
+	if (i >= n)
 		return 0;
 	if (pkey)
-		*pkey = mp->ma_table[i].me_key;
+		*pkey = ep0[i].me_key;
 	if (pvalue)
-		*pvalue = mp->ma_table[i].me_value;
+		*pvalue = DICT_VALUE(mp, i);
 	return 1;
 }
 
+/* Instance dicts with shared keys */
+
+PyObject *
+_PyDict_NewShared(PyDictKeysObject **pkeys)
+{
+	PyObject **values;
+
+	if (*pkeys == NULL) {
+		*pkeys = new_keys_object(PyDict_MINSIZE);
+		if (*pkeys == NULL)
+			return PyDict_New();
+	}
+	values = new_values(*pkeys);
+	if (values == NULL)
+		return PyErr_NoMemory();
+	DK_INCREF(*pkeys);
+	return new_dict(*pkeys, values);
+}
+
+/* Turn mp, a combined table with only string keys, into a split one and
+   return a new reference to its keys, or return NULL if it won't do. */
+static PyDictKeysObject *
+make_keys_shared(dictobject *mp)
+{
+	PyDictKeysObject *dk = mp->ma_keys;
+	PyObject **values;
+	dictentry *ep;
+	int i, n;
+
+	if (mp->ma_values != NULL || dk == Py_EMPTY_KEYS ||
+	    dk->dk_lookup != lookdict_string ||
+	    dk->dk_nentries != mp->ma_used)
+		return NULL;
+	values = new_values(dk);
+	if (values == NULL)
+		return NULL;
+	ep = DK_ENTRIES(dk);
+	n = dk->dk_nentries;
+	for (i = 0; i < n; i++) {
+		values[i] = ep[i].me_value;
+		ep[i].me_value = NULL;
+	}
+	mp->ma_values = values;
+	DK_INCREF(dk);
+	return dk;
+}
+
+int
+_PyDict_SetItemShared(PyDictKeysObject **pkeys, PyObject *op,
+		      PyObject *key, PyObject *value)
+{
+	PyDictKeysObject *cached = *pkeys;
+	int shared, res;
+
+	shared = cached != NULL && ((dictobject *)op)->ma_keys == cached;
+	if (value == NULL)
+		res = PyDict_DelItem(op, key);
+	else
+		res = PyDict_SetItem(op, key, value);
+	if (shared && ((dictobject *)op)->ma_keys != cached &&
+	    cached->dk_refcnt == 1) {
+		/* This dict outgrew the shared keys, and no other instance
+		   uses them any more:  share its bigger table instead. */
+		*pkeys = make_keys_shared((dictobject *)op);
+		DK_DECREF(cached);
+	}
+	return res;
+}
+
+void
+_PyDict_ReleaseSharedKeys(PyDictKeysObject **pkeys)
+{
+	PyDictKeysObject *dk = *pkeys;
+
+	if (dk != NULL) {
+		*pkeys = NULL;
+		DK_DECREF(dk);
+	}
+}
+
 /* Methods */
 
 static void
 dict_dealloc(register dictobject *mp)
 {
-	register dictentry *ep;
-	int fill = mp->ma_fill;
+	PyObject **values = mp->ma_values;
+	int i, n;
  	PyObject_GC_UnTrack(mp);
 	Py_TRASHCAN_SAFE_BEGIN(mp)
-	for (ep = mp->ma_table; fill > 0; ep++) {
-		if (ep->me_key) {
-			--fill;
-			Py_DECREF(ep->me_key);
-			Py_XDECREF(ep->me_value);
-		}
+	if (values != NULL) {
+		n = mp->ma_keys->dk_nentries;
+		for (i = 0; i < n; i++)
+			Py_XDECREF(values[i]);
+		PyObject_FREE(values);
+	}
+	DK_DECREF(mp->ma_keys);
+	if ((dict_freelist.count < dict_freelist.limit ||
+	     dict_freelist.limit < 0) && PyDict_CheckExact(mp)) {
+		mp->ma_keys = (PyDictKeysObject *)free_dicts;
+		free_dicts = mp;
+		dict_freelist.count++;
 	}
-	if (mp->ma_table != mp->ma_smalltable)
-		PyMem_DEL(mp->ma_table);
-	mp->ob_type->tp_free((PyObject *)mp);
+	else
+		mp->ob_type->tp_free((PyObject *)mp);
 	Py_TRASHCAN_SAFE_END(mp)
 }
 
@@ -741,9 +1011,9 @@ dict_print(register dictobject *mp, register FILE *fp, register int flags)
 
 	fprintf(fp, "{");
 	any = 0;
-	for (i = 0; i <= mp->ma_mask; i++) {
-		dictentry *ep = mp->ma_table + i;
-		PyObject *pvalue = ep->me_value;
+	for (i = 0; i < mp->ma_keys->dk_nentries; i++) {
+		dictentry *ep = DK_ENTRIES(mp->ma_keys) + i;
+		PyObject *pvalue = DICT_VALUE(mp, i);
 		if (pvalue != NULL) {
 			/* Prevent PyObject_Repr from deleting value during
 			   key format */
@@ -858,8 +1128,8 @@ static PyObject *
 dict_subscript(dictobject *mp, register PyObject *key)
 {
 	PyObject *v;
+	PyObject **value_addr;
 	long hash;
-	assert(mp->ma_table != NULL);
 #ifdef CACHE_HASH
 	if (!PyString_CheckExact(key) ||
 	    (hash = ((PyStringObject *) key)->ob_shash) == -1)
@@ -869,7 +1139,10 @@ dict_subscript(dictobject *mp, register PyObject *key)
 		if (hash == -1)
 			return NULL;
 	}
-	v = (mp->ma_lookup)(mp, key, hash) -> me_value;
+	if (mp->ma_keys->dk_lookup(mp, key, hash, &value_addr) < 0)
+		v = NULL;
+	else
+		v = *value_addr;
 	if (v == NULL)
 		PyErr_SetObject(PyExc_KeyError, key);
 	else
@@ -910,9 +1183,9 @@ dict_keys(register dictobject *mp)
 		Py_DECREF(v);
 		goto again;
 	}
-	for (i = 0, j = 0; i <= mp->ma_mask; i++) {
-		if (mp->ma_table[i].me_value != NULL) {
-			PyObject *key = mp->ma_table[i].me_key;
+	for (i = 0, j = 0; i < mp->ma_keys->dk_nentries; i++) {
+		if (DICT_VALUE(mp, i) != NULL) {
+			PyObject *key = DK_ENTRIES(mp->ma_keys)[i].me_key;
 			Py_INCREF(key);
 			PyList_SET_ITEM(v, j, key);
 			j++;
@@ -939,9 +1212,9 @@ dict_values(register dictobject *mp)
 		Py_DECREF(v);
 		goto again;
 	}
-	for (i = 0, j = 0; i <= mp->ma_mask; i++) {
-		if (mp->ma_table[i].me_value != NULL) {
-			PyObject *value = mp->ma_table[i].me_value;
+	for (i = 0, j = 0; i < mp->ma_keys->dk_nentries; i++) {
+		PyObject *value = DICT_VALUE(mp, i);
+		if (value != NULL) {
 			Py_INCREF(value);
 			PyList_SET_ITEM(v, j, value);
 			j++;
@@ -982,10 +1255,10 @@ dict_items(register dictobject *mp)
 		goto again;
 	}
 	/* Nothing we do below makes any function calls. */
-	for (i = 0, j = 0; i <= mp->ma_mask; i++) {
-		if (mp->ma_table[i].me_value != NULL) {
-			key = mp->ma_table[i].me_key;
-			value = mp->ma_table[i].me_value;
+	for (i = 0, j = 0; i < mp->ma_keys->dk_nentries; i++) {
+		value = DICT_VALUE(mp, i);
+		if (value != NULL) {
+			key = DK_ENTRIES(mp->ma_keys)[i].me_key;
 			item = PyList_GET_ITEM(v, j);
 			Py_INCREF(key);
 			PyTuple_SET_ITEM(item, 0, key);
@@ -1099,6 +1372,7 @@ PyDict_Merge(PyObject *a, PyObject *b, int override)
 	register PyDictObject *mp, *other;
 	register int i;
 	dictentry *entry;
+	PyObject *value;
 
 	/* We accept for the argument either a concrete dictionary object,
 	 * or an abstract "mapping" object.  For the former, we can do
@@ -1119,19 +1393,21 @@ PyDict_Merge(PyObject *a, PyObject *b, int override)
 		 * incrementally resizing as we insert new items.  Expect
 		 * that there will be no (or few) overlapping keys.
 		 */
-		if ((mp->ma_fill + other->ma_used)*3 >= (mp->ma_mask+1)*2) {
+		if (other->ma_used > mp->ma_keys->dk_usable) {
 		   if (dictresize(mp, (mp->ma_used + other->ma_used)*3/2) != 0)
 			   return -1;
 		}
-		for (i = 0; i <= other->ma_mask; i++) {
-			entry = &other->ma_table[i];
-			if (entry->me_value != NULL &&
+		for (i = 0; i < other->ma_keys->dk_nentries; i++) {
+			entry = &DK_ENTRIES(other->ma_keys)[i];
+			value = DICT_VALUE(other, i);
+			if (value != NULL &&
 			    (override ||
 			     PyDict_GetItem(a, entry->me_key) == NULL)) {
 				Py_INCREF(entry->me_key);
-				Py_INCREF(entry->me_value);
-				insertdict(mp, entry->me_key, entry->me_hash,
-					   entry->me_value);
+				Py_INCREF(value);
+				if (insertdict(mp, entry->me_key,
+					       entry->me_hash, value) != 0)
+					return -1;
 			}
 		}
 	}
@@ -1195,25 +1471,47 @@ PyDict_Copy(PyObject *o)
 	register int i;
 	dictobject *copy;
 	dictentry *entry;
+	PyObject **values, *value;
 
 	if (o == NULL || !PyDict_Check(o)) {
 		PyErr_BadInternalCall();
 		return NULL;
 	}
 	mp = (dictobject *)o;
+	if (mp->ma_values != NULL) {
+		/* A split table's copy shares its keys too. */
+		values = new_values(mp->ma_keys);
+		if (values == NULL)
+			return PyErr_NoMemory();
+		for (i = 0; i < mp->ma_keys->dk_nentries; i++) {
+			values[i] = mp->ma_values[i];
+			Py_XINCREF(values[i]);
+		}
+		DK_INCREF(mp->ma_keys);
+		copy = (dictobject *)new_dict(mp->ma_keys, values);
+		if (copy != NULL)
+			copy->ma_used = mp->ma_used;
+		return (PyObject *)copy;
+	}
 	copy = (dictobject *)PyDict_New();
 	if (copy == NULL)
 		return NULL;
 	if (mp->ma_used > 0) {
-		if (dictresize(copy, mp->ma_used*3/2) != 0)
+		if (dictresize(copy, mp->ma_used*3/2) != 0) {
+			Py_DECREF(copy);
 			return NULL;
-		for (i = 0; i <= mp->ma_mask; i++) {
-			entry = &mp->ma_table[i];
-			if (entry->me_value != NULL) {
+		}
+		for (i = 0; i < mp->ma_keys->dk_nentries; i++) {
+			entry = &DK_ENTRIES(mp->ma_keys)[i];
+			value = entry->me_value;
+			if (value != NULL) {
 				Py_INCREF(entry->me_key);
-				Py_INCREF(entry->me_value);
-				insertdict(copy, entry->me_key, entry->me_hash,
-					   entry->me_value);
+				Py_INCREF(value);
+				if (insertdict(copy, entry->me_key,
+					       entry->me_hash, value) != 0) {
+					Py_DECREF(copy);
+					return NULL;
+				}
 			}
 		}
 	}
@@ -1275,11 +1573,11 @@ characterize(dictobject *a, dictobject *b, PyObject **pval)
 	PyObject *aval = NULL; /* a[akey] */
 	int i, cmp;
 
-	for (i = 0; i <= a->ma_mask; i++) {
+	for (i = 0; i < a->ma_keys->dk_nentries; i++) {
 		PyObject *thiskey, *thisaval, *thisbval;
-		if (a->ma_table[i].me_value == NULL)
+		if (DICT_VALUE(a, i) == NULL)
 			continue;
-		thiskey = a->ma_table[i].me_key;
+		thiskey = DK_ENTRIES(a->ma_keys)[i].me_key;
 		Py_INCREF(thiskey);  /* keep alive across compares */
 		if (akey != NULL) {
 			cmp = PyObject_RichCompareBool(akey, thiskey, Py_LT);
@@ -1288,8 +1586,8 @@ characterize(dictobject *a, dictobject *b, PyObject **pval)
 				goto Fail;
 			}
 			if (cmp > 0 ||
-			    i > a->ma_mask ||
-			    a->ma_table[i].me_value == NULL)
+			    i >= a->ma_keys->dk_nentries ||
+			    DICT_VALUE(a, i) == NULL)
 			{
 				/* Not the *smallest* a key; or maybe it is
 				 * but the compare shrunk the dict so we can't
@@ -1303,7 +1601,7 @@ characterize(dictobject *a, dictobject *b, PyObject **pval)
 		}
 
 		/* Compare a[thiskey] to b[thiskey]; cmp <- true iff equal. */
-		thisaval = a->ma_table[i].me_value;
+		thisaval = DICT_VALUE(a, i);
 		assert(thisaval);
 		Py_INCREF(thisaval);   /* keep alive */
 		thisbval = PyDict_GetItem((PyObject *)b, thiskey);
@@ -1403,12 +1701,12 @@ dict_equal(dictobject *a, dictobject *b)
 		return 0;
 
 	/* Same # of entries -- check all of 'em.  Exit early on any diff. */
-	for (i = 0; i <= a->ma_mask; i++) {
-		PyObject *aval = a->ma_table[i].me_value;
+	for (i = 0; i < a->ma_keys->dk_nentries; i++) {
+		PyObject *aval = DICT_VALUE(a, i);
 		if (aval != NULL) {
 			int cmp;
 			PyObject *bval;
-			PyObject *key = a->ma_table[i].me_key;
+			PyObject *key = DK_ENTRIES(a->ma_keys)[i].me_key;
 			/* temporarily bump aval's refcount to ensure it stays
 			   alive until we're done with it */
 			Py_INCREF(aval);
@@ -1452,6 +1750,7 @@ dict_has_key(register dictobject *mp, PyObject *key)
 {
 	long hash;
 	register long ok;
+	PyObject **value_addr;
 #ifdef CACHE_HASH
 	if (!PyString_CheckExact(key) ||
 	    (hash = ((PyStringObject *) key)->ob_shash) == -1)
@@ -1461,19 +1760,21 @@ dict_has_key(register dictobject *mp, PyObject *key)
 		if (hash == -1)
 			return NULL;
 	}
-	ok = (mp->ma_lookup)(mp, key, hash)->me_value != NULL;
+	ok = mp->ma_keys->dk_lookup(mp, key, hash, &value_addr) >= 0 &&
+		*value_addr != NULL;
 	return PyInt_FromLong(ok);
 }
 
 static PyObject *
-dict_get(register dictobject *mp, PyObject *args)
+dict_get(register dictobject *mp, PyObject **args, int nargs)
 {
 	PyObject *key;
 	PyObject *failobj = Py_None;
 	PyObject *val = NULL;
+	PyObject **value_addr;
 	long hash;
 
-	if (!PyArg_ParseTuple(args, "O|O:get", &key, &failobj))
+	if (!_PyArg_ParseStack(args, nargs, "O|O:get", &key, &failobj))
 		return NULL;
 
 #ifdef CACHE_HASH
@@ -1485,7 +1786,8 @@ dict_get(register dictobject *mp, PyObject *args)
 		if (hash == -1)
 			return NULL;
 	}
-	val = (mp->ma_lookup)(mp, key, hash)->me_value;
+	if (mp->ma_keys->dk_lookup(mp, key, hash, &value_addr) >= 0)
+		val = *value_addr;
 
 	if (val == NULL)
 		val = failobj;
@@ -1495,14 +1797,15 @@ dict_get(register dictobject *mp, PyObject *args)
 
 
 static PyObject *
-dict_setdefault(register dictobject *mp, PyObject *args)
+dict_setdefault(register dictobject *mp, PyObject **args, int nargs)
 {
 	PyObject *key;
 	PyObject *failobj = Py_None;
 	PyObject *val = NULL;
+	PyObject **value_addr;
 	long hash;
 
-	if (!PyArg_ParseTuple(args, "O|O:setdefault", &key, &failobj))
+	if (!_PyArg_ParseStack(args, nargs, "O|O:setdefault", &key, &failobj))
 		return NULL;
 
 #ifdef CACHE_HASH
@@ -1514,7 +1817,8 @@ dict_setdefault(register dictobject *mp, PyObject *args)
 		if (hash == -1)
 			return NULL;
 	}
-	val = (mp->ma_lookup)(mp, key, hash)->me_value;
+	if (mp->ma_keys->dk_lookup(mp, key, hash, &value_addr) >= 0)
+		val = *value_addr;
 	if (val == NULL) {
 		val = failobj;
 		if (PyDict_SetItem((PyObject*)mp, key, failobj))
@@ -1536,13 +1840,11 @@ dict_clear(register dictobject *mp)
 static PyObject *
 dict_popitem(dictobject *mp)
 {
-	int i = 0;
+	int i;
+	PyDictKeysObject *dk;
 	dictentry *ep;
 	PyObject *res;
 
-#ifdef SYMBIAN
-	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
-#endif
 	/* Allocate the result tuple before checking the size.  Believe it
 	 * or not, this allocation could trigger a garbage collection which
 	 * could empty the dict, so if we checked the size first and that
@@ -1561,36 +1863,28 @@ dict_popitem(dictobject *mp)
 				"popitem(): dictionary is empty");
 		return NULL;
 	}
-	/* Set ep to "the first" dict entry with a value.  We abuse the hash
-	 * field of slot 0 to hold a search finger:
-	 * If slot 0 has a value, use slot 0.
-	 * Else slot 0 is being used to hold a search finger,
-	 * and we use its hash value as the first index to look.
-	 */
-	ep = &mp->ma_table[0];
-	if (ep->me_value == NULL) {
-		i = (int)ep->me_hash;
-		/* The hash field may be a real hash value, or it may be a
-		 * legit search finger, or it may be a once-legit search
-		 * finger that's out of bounds now because it wrapped around
-		 * or the table shrunk -- simply make sure it's in bounds now.
-		 */
-		if (i > mp->ma_mask || i < 1)
-			i = 1;	/* skip slot 0 */
-		while ((ep = &mp->ma_table[i])->me_value == NULL) {
-			i++;
-			if (i > mp->ma_mask)
-				i = 1;
+	/* Entries can only be given back at the end of a combined table. */
+	if (mp->ma_values != NULL) {
+		if (dictresize(mp, mp->ma_used*2) != 0) {
+			Py_DECREF(res);
+			return NULL;
 		}
 	}
+	/* Pop the last entry; the deleted ones behind it are trimmed off,
+	 * so "while d: d.popitem()" takes linear time. */
+	dk = mp->ma_keys;
+	i = dk->dk_nentries - 1;
+	while (DK_ENTRIES(dk)[i].me_value == NULL)
+		i--;
+	ep = &DK_ENTRIES(dk)[i];
+	dk_set_index(dk, lookdict_index(dk, ep->me_hash, i), DKIX_DUMMY);
 	PyTuple_SET_ITEM(res, 0, ep->me_key);
 	PyTuple_SET_ITEM(res, 1, ep->me_value);
-	Py_INCREF(dummy);
-	ep->me_key = dummy;
+	ep->me_key = NULL;
 	ep->me_value = NULL;
+	dk->dk_nentries = i;
 	mp->ma_used--;
-	assert(mp->ma_table[0].me_value == NULL);
-	mp->ma_table[0].me_hash = i + 1;  /* next place to start */
+	NEW_VERSION(mp);
 	return res;
 }
 
@@ -1712,9 +2006,9 @@ static const char iteritems__doc__[] =
 static const PyMethodDef mapp_methods[] = {
 	{"has_key",	(PyCFunction)dict_has_key,      METH_O,
 	 has_key__doc__},
-	{"get",         (PyCFunction)dict_get,          METH_VARARGS,
+	{"get",         (PyCFunction)dict_get,          METH_FASTCALL,
 	 get__doc__},
-	{"setdefault",  (PyCFunction)dict_setdefault,   METH_VARARGS,
+	{"setdefault",  (PyCFunction)dict_setdefault,   METH_FASTCALL,
 	 setdefault_doc__},
 	{"popitem",	(PyCFunction)dict_popitem,	METH_NOARGS,
 	 popitem__doc__},
@@ -1743,6 +2037,7 @@ static int
 dict_contains(dictobject *mp, PyObject *key)
 {
 	long hash;
+	PyObject **value_addr;
 
 #ifdef CACHE_HASH
 	if (!PyString_CheckExact(key) ||
@@ -1753,7 +2048,8 @@ dict_contains(dictobject *mp, PyObject *key)
 		if (hash == -1)
 			return -1;
 	}
-	return (mp->ma_lookup)(mp, key, hash)->me_value != NULL;
+	return mp->ma_keys->dk_lookup(mp, key, hash, &value_addr) >= 0 &&
+		*value_addr != NULL;
 }
 
 /* Hack to implement "key in dict" */
@@ -1780,9 +2076,9 @@ dict_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 	if (self != NULL) {
 		PyDictObject *d = (PyDictObject *)self;
 		/* It's guaranteed that tp->alloc zeroed out the struct. */
-		assert(d->ma_table == NULL && d->ma_fill == 0 && d->ma_used == 0);
-		INIT_NONZERO_DICT_SLOTS(d);
-		d->ma_lookup = lookdict_string;
+		assert(d->ma_keys == NULL && d->ma_used == 0);
+		d->ma_keys = Py_EMPTY_KEYS;
+		NEW_VERSION(d);
 #ifdef SHOW_CONVERSION_COUNTS
 		++created;
 #endif
@@ -1928,6 +2224,50 @@ PyDict_DelItemString(PyObject *v, char *key)
 	return err;
 }
 
+/* Bytes taken by a saved dict and by a saved keys object. */
+#define DICT_BYTES sizeof(dictobject)
+#define KEYS_BYTES (offsetof(PyDictKeysObject, dk_indices) + \
+		    PyDict_MINSIZE + \
+		    USABLE_FRACTION(PyDict_MINSIZE) * sizeof(dictentry))
+
+PyFreeListStats *
+_PyDict_FreeListStats(long *bytes)
+{
+	*bytes = dict_freelist.count * (long)DICT_BYTES +
+		 keys_numfree * (long)KEYS_BYTES;
+	return &dict_freelist;
+}
+
+/* Release the saved dicts and keys objects. */
+long
+PyDict_ClearFreeList(void)
+{
+	PyDictKeysObject *dk;
+	dictobject *mp;
+	long freed;
+
+	(void)_PyDict_FreeListStats(&freed);
+	while (free_dicts != NULL) {
+		mp = free_dicts;
+		free_dicts = (dictobject *)mp->ma_keys;
+		PyObject_GC_Del(mp);
+	}
+	dict_freelist.count = 0;
+	while (keys_free_list != NULL) {
+		dk = keys_free_list;
+		keys_free_list = DK_NEXT_FREE(dk);
+		PyObject_FREE(dk);
+	}
+	keys_numfree = 0;
+	return freed;
+}
+
+void
+PyDict_Fini(void)
+{
+	(void)PyDict_ClearFreeList();
+}
+
 /* Dictionary iterator type */
 
 #ifndef SYMBIAN
@@ -0,0 +1,142 @@
+#ifndef Py_FASTSEARCH_H
+#define Py_FASTSEARCH_H
+
+/* Substring search shared by stringobject.c and unicodeobject.c.
+
+   The includer defines STRINGLIB_CHAR (char or Py_UNICODE) before
+   including this file and gets a private fastsearch() for that
+   character type.
+
+   The forward search is a simplified Boyer-Moore-Horspool: compare the
+   last pattern character first, and on a mismatch look at the character
+   just past the window.  If it does not occur in the pattern at all
+   (tested with a one-word bloom filter built from the pattern) the
+   window jumps by the whole pattern length; otherwise it moves by the
+   distance from the last character to its previous occurrence in the
+   pattern.  The reverse search is the mirror image.  Single-character
+   patterns use memchr() where the character type allows it.
+
+   Worst case is still O(n*m), but typical searches look at far fewer
+   than n characters and need no setup beyond one pass over the
+   pattern. */
+
+#define FAST_COUNT 0
+#define FAST_SEARCH 1
+#define FAST_RSEARCH 2
+
+#define FASTSEARCH_BLOOM_ADD(mask, ch) \
+	((mask) |= (1UL << ((ch) & (LONG_BIT - 1))))
+#define FASTSEARCH_BLOOM(mask, ch) \
+	((mask) & (1UL << ((ch) & (LONG_BIT - 1))))
+
+/* Search for p[0:m] in s[0:n].  FAST_SEARCH and FAST_RSEARCH return the
+   index of the first (last) match or -1.  FAST_COUNT returns the
+   number of non-overlapping matches, stopping at maxcount. */
+static int
+fastsearch(const STRINGLIB_CHAR *s, int n,
+	   const STRINGLIB_CHAR *p, int m,
+	   int maxcount, int mode)
+{
+	unsigned long mask;
+	int skip, count = 0;
+	int i, j, mlast, w;
+
+	w = n - m;
+
+	if (w < 0 || (mode == FAST_COUNT && maxcount <= 0))
+		return mode == FAST_COUNT ? 0 : -1;
+
+	if (m <= 1) {
+		if (m <= 0)
+			return mode == FAST_COUNT ? 0 : -1;
+		if (mode == FAST_SEARCH) {
+			if (sizeof(STRINGLIB_CHAR) == 1) {
+				const char *r = (const char *)memchr(s, p[0], n);
+				return r == NULL ? -1 : (int)(r - (const char *)s);
+			}
+			for (i = 0; i < n; i++)
+				if (s[i] == p[0])
+					return i;
+			return -1;
+		}
+		if (mode == FAST_RSEARCH) {
+			for (i = n - 1; i >= 0; i--)
+				if (s[i] == p[0])
+					return i;
+			return -1;
+		}
+		for (i = 0; i < n; i++)
+			if (s[i] == p[0]) {
+				count++;
+				if (count == maxcount)
+					return maxcount;
+			}
+		return count;
+	}
+
+	mlast = m - 1;
+	skip = mlast - 1;
+	mask = 0;
+
+	if (mode != FAST_RSEARCH) {
+		for (i = 0; i < mlast; i++) {
+			FASTSEARCH_BLOOM_ADD(mask, p[i]);
+			if (p[i] == p[mlast])
+				skip = mlast - i - 1;
+		}
+		FASTSEARCH_BLOOM_ADD(mask, p[mlast]);
+
+		for (i = 0; i <= w; i++) {
+			if (s[i + mlast] == p[mlast]) {
+				for (j = 0; j < mlast; j++)
+					if (s[i + j] != p[j])
+						break;
+				if (j == mlast) {
+					if (mode != FAST_COUNT)
+						return i;
+					count++;
+					if (count == maxcount)
+						return maxcount;
+					i = i + mlast;
+					continue;
+				}
+				if (i < w && !FASTSEARCH_BLOOM(mask, s[i + m]))
+					i = i + m;
+				else
+					i = i + skip;
+			}
+			else if (i < w && !FASTSEARCH_BLOOM(mask, s[i + m]))
+				i = i + m;
+		}
+	}
+	else {
+		FASTSEARCH_BLOOM_ADD(mask, p[0]);
+		for (i = mlast; i > 0; i--) {
+			FASTSEARCH_BLOOM_ADD(mask, p[i]);
+			if (p[i] == p[0])
+				skip = i - 1;
+		}
+
+		for (i = w; i >= 0; i--) {
+			if (s[i] == p[0]) {
+				for (j = mlast; j > 0; j--)
+					if (s[i + j] != p[j])
+						break;
+				if (j == 0)
+					return i;
+				if (i > 0 && !FASTSEARCH_BLOOM(mask, s[i - 1]))
+					i = i - m;
+				else
+					i = i - skip;
+			}
+			else if (i > 0 && !FASTSEARCH_BLOOM(mask, s[i - 1]))
+				i = i - m;
+		}
+	}
+
+	if (mode != FAST_COUNT)
+		return -1;
+	return count;
+}
+
+#endif /* !Py_FASTSEARCH_H */
@@ -42,8 +42,23 @@ typedef struct {
 	int f_softspace; /* Flag used by 'print' command */
 	int f_binary; /* Flag which indicates whether the file is open
 			 open in binary (1) or test (0) mode */
+	int f_unlocked; /* # of operations using f_fp with the interpreter
+			   lock released; close() fails while it is non-0 */
 } PyFileObject;
 
+/* Release the interpreter lock around an operation on f->f_fp.  f_fp
+   stays valid until the matching FILE_END_ALLOW_THREADS or
+   FILE_BLOCK_THREADS, because file_close() won't close it in between. */
+#define FILE_BEGIN_ALLOW_THREADS(f) \
+	(f)->f_unlocked++; \
+	Py_BEGIN_ALLOW_THREADS
+#define FILE_BLOCK_THREADS(f) \
+	Py_BLOCK_THREADS \
+	(f)->f_unlocked--;
+#define FILE_END_ALLOW_THREADS(f) \
+	Py_END_ALLOW_THREADS \
+	(f)->f_unlocked--;
+
 DL_EXPORT(FILE *)
 PyFile_AsFile(PyObject *f)
 {
@@ -112,6 +127,7 @@ open_the_file(PyFileObject *f, char *name, char *mode)
 	else
 #endif
 	{
+		FILE *fp;
 #ifdef SYMBIAN
 		/* Remove the eventual 'b' from mode to compensate for a bug
 		   in Symbian OS STDLIB implementation. */
@@ -126,11 +142,12 @@ open_the_file(PyFileObject *f, char *name, char *mode)
 #endif
 		Py_BEGIN_ALLOW_THREADS
 #ifdef SYMBIAN
-		f->f_fp = fopen(name, tmp_mode);
+		fp = fopen(name, tmp_mode);
 #else
-		f->f_fp = fopen(name, mode);
+		fp = fopen(name, mode);
 #endif
 		Py_END_ALLOW_THREADS
+		f->f_fp = fp;
 	}
 	if (f->f_fp == NULL) {
 #ifdef NO_FOPEN_ERRNO
@@ -260,14 +277,21 @@ static PyObject *
 file_close(PyFileObject *f)
 {
 	int sts = 0;
-	if (f->f_fp != NULL) {
+	FILE *fp = f->f_fp;
+	if (fp != NULL) {
+		if (f->f_unlocked > 0) {
+			PyErr_SetString(PyExc_IOError,
+				"close() called during concurrent operation on the same file object");
+			return NULL;
+		}
+		/* Nobody else may use fp once the lock is released */
+		f->f_fp = NULL;
 		if (f->f_close != NULL) {
 			Py_BEGIN_ALLOW_THREADS
 			errno = 0;
-			sts = (*f->f_close)(f->f_fp);
+			sts = (*f->f_close)(fp);
 			Py_END_ALLOW_THREADS
 		}
-		f->f_fp = NULL;
 	}
 	if (sts == EOF)
 		return PyErr_SetFromErrno(PyExc_IOError);
@@ -377,10 +401,10 @@ file_seek(PyFileObject *f, PyObject *args)
 	if (PyErr_Occurred())
 		return NULL;
 
-	Py_BEGIN_ALLOW_THREADS
+	FILE_BEGIN_ALLOW_THREADS(f)
 	errno = 0;
 	ret = _portable_fseek(f->f_fp, offset, whence);
-	Py_END_ALLOW_THREADS
+	FILE_END_ALLOW_THREADS(f)
 
 	if (ret != 0) {
 		PyErr_SetFromErrno(PyExc_IOError);
@@ -417,20 +441,20 @@ file_truncate(PyFileObject *f, PyObject *args)
 			return NULL;
 	} else {
 		/* Default to current position*/
-		Py_BEGIN_ALLOW_THREADS
+		FILE_BEGIN_ALLOW_THREADS(f)
 		errno = 0;
 		newsize = _portable_ftell(f->f_fp);
-		Py_END_ALLOW_THREADS
+		FILE_END_ALLOW_THREADS(f)
 		if (newsize == -1) {
 		        PyErr_SetFromErrno(PyExc_IOError);
 			clearerr(f->f_fp);
 			return NULL;
 		}
 	}
-	Py_BEGIN_ALLOW_THREADS
+	FILE_BEGIN_ALLOW_THREADS(f)
 	errno = 0;
 	ret = fflush(f->f_fp);
-	Py_END_ALLOW_THREADS
+	FILE_END_ALLOW_THREADS(f)
 	if (ret != 0) goto onioerror;
 
 #ifdef MS_WIN32
@@ -441,17 +465,17 @@ file_truncate(PyFileObject *f, PyObject *args)
 			"the new size is too long for _chsize (it is limited to 32-bit values)");
 		return NULL;
 	} else {
-		Py_BEGIN_ALLOW_THREADS
+		FILE_BEGIN_ALLOW_THREADS(f)
 		errno = 0;
 		ret = _chsize(fileno(f->f_fp), (long)newsize);
-		Py_END_ALLOW_THREADS
+		FILE_END_ALLOW_THREADS(f)
 		if (ret != 0) goto onioerror;
 	}
 #else
-	Py_BEGIN_ALLOW_THREADS
+	FILE_BEGIN_ALLOW_THREADS(f)
 	errno = 0;
 	ret = ftruncate(fileno(f->f_fp), newsize);
-	Py_END_ALLOW_THREADS
+	FILE_END_ALLOW_THREADS(f)
 	if (ret != 0) goto onioerror;
 #endif /* !MS_WIN32 */
 
@@ -472,10 +496,10 @@ file_tell(PyFileObject *f)
 
 	if (f->f_fp == NULL)
 		return err_closed();
-	Py_BEGIN_ALLOW_THREADS
+	FILE_BEGIN_ALLOW_THREADS(f)
 	errno = 0;
 	pos = _portable_ftell(f->f_fp);
-	Py_END_ALLOW_THREADS
+	FILE_END_ALLOW_THREADS(f)
 	if (pos == -1) {
 		PyErr_SetFromErrno(PyExc_IOError);
 		clearerr(f->f_fp);
@@ -503,10 +527,10 @@ file_flush(PyFileObject *f)
 
 	if (f->f_fp == NULL)
 		return err_closed();
-	Py_BEGIN_ALLOW_THREADS
+	FILE_BEGIN_ALLOW_THREADS(f)
 	errno = 0;
 	res = fflush(f->f_fp);
-	Py_END_ALLOW_THREADS
+	FILE_END_ALLOW_THREADS(f)
 	if (res != 0) {
 		PyErr_SetFromErrno(PyExc_IOError);
 		clearerr(f->f_fp);
@@ -522,9 +546,9 @@ file_isatty(PyFileObject *f)
 	long res;
 	if (f->f_fp == NULL)
 		return err_closed();
-	Py_BEGIN_ALLOW_THREADS
+	FILE_BEGIN_ALLOW_THREADS(f)
 	res = isatty((int)fileno(f->f_fp));
-	Py_END_ALLOW_THREADS
+	FILE_END_ALLOW_THREADS(f)
 	return PyInt_FromLong(res);
 }
 
@@ -610,11 +634,11 @@ file_read(PyFileObject *f, PyObject *args)
 		return NULL;
 	bytesread = 0;
 	for (;;) {
-		Py_BEGIN_ALLOW_THREADS
+		FILE_BEGIN_ALLOW_THREADS(f)
 		errno = 0;
 		chunksize = fread(BUF(v) + bytesread, 1,
 				  buffersize - bytesread, f->f_fp);
-		Py_END_ALLOW_THREADS
+		FILE_END_ALLOW_THREADS(f)
 		if (chunksize == 0) {
 			if (!ferror(f->f_fp))
 				break;
@@ -640,30 +664,51 @@ file_read(PyFileObject *f, PyObject *args)
 static PyObject *
 file_readinto(PyFileObject *f, PyObject *args)
 {
-	char *ptr;
-	int ntodo;
-	size_t ndone, nnow;
+	char *ptr, *chunk;
+	int ntodo, len;
+	size_t ndone, nnow, nchunk;
 
 	if (f->f_fp == NULL)
 		return err_closed();
 	if (!PyArg_Parse(args, "w#", &ptr, &ntodo))
 		return NULL;
+	/* Another thread could resize or free the buffer while the lock
+	   is released, so read into one of our own and copy from that
+	   with the lock held. */
+	nchunk = ntodo < BIGCHUNK ? ntodo : BIGCHUNK;
+	chunk = PyMem_Malloc(nchunk ? nchunk : 1);
+	if (chunk == NULL)
+		return PyErr_NoMemory();
 	ndone = 0;
 	while (ntodo > 0) {
-		Py_BEGIN_ALLOW_THREADS
+		FILE_BEGIN_ALLOW_THREADS(f)
 		errno = 0;
-		nnow = fread(ptr+ndone, 1, ntodo, f->f_fp);
-		Py_END_ALLOW_THREADS
+		nnow = fread(chunk, 1, (size_t)ntodo < nchunk ? ntodo : nchunk,
+			     f->f_fp);
+		FILE_END_ALLOW_THREADS(f)
 		if (nnow == 0) {
 			if (!ferror(f->f_fp))
 				break;
 			PyErr_SetFromErrno(PyExc_IOError);
 			clearerr(f->f_fp);
+			PyMem_Free(chunk);
+			return NULL;
+		}
+		if (PyObject_AsWriteBuffer(args, (void **)&ptr, &len) < 0) {
+			PyMem_Free(chunk);
+			return NULL;
+		}
+		if ((size_t)len < ndone + nnow) {
+			PyMem_Free(chunk);
+			PyErr_SetString(PyExc_IOError,
+				"readinto() buffer shrank during the read");
 			return NULL;
 		}
+		memcpy(ptr + ndone, chunk, nnow);
 		ndone += nnow;
 		ntodo -= nnow;
 	}
+	PyMem_Free(chunk);
 	return PyInt_FromLong((long)ndone);
 }
 
@@ -718,7 +763,7 @@ trailing null byte.  #define DONT_USE_FGETS_IN_GETLINE to disable this code.
 
 #ifdef USE_FGETS_IN_GETLINE
 static PyObject*
-getline_via_fgets(FILE *fp)
+getline_via_fgets(PyFileObject *f)
 {
 /* INITBUFSIZE is the maximum line length that lets us get away with the fast
  * no-realloc, one-fgets()-call path.  Boosting it isn't free, because we have
@@ -746,6 +791,7 @@ getline_via_fgets(FILE *fp)
 	char* pvend;    /* address one beyond last free slot */
 	size_t nfree;	/* # of free buffer slots; pvend-pvfree */
 	size_t total_v_size;  /* total # of slots in buffer */
+	FILE *fp = f->f_fp;
 
 	/* Optimize for normal case:  avoid _PyString_Resize if at all
 	 * possible via first reading into stack buffer "buf".
@@ -753,12 +799,12 @@ getline_via_fgets(FILE *fp)
 	total_v_size = INITBUFSIZE;	/* start small and pray */
 	pvfree = buf;
 	for (;;) {
-		Py_BEGIN_ALLOW_THREADS
+		FILE_BEGIN_ALLOW_THREADS(f)
 		pvend = buf + total_v_size;
 		nfree = pvend - pvfree;
 		memset(pvfree, '\n', nfree);
 		p = fgets(pvfree, nfree, fp);
-		Py_END_ALLOW_THREADS
+		FILE_END_ALLOW_THREADS(f)
 
 		if (p == NULL) {
 			clearerr(fp);
@@ -827,12 +873,12 @@ getline_via_fgets(FILE *fp)
 	 * the code above for detailed comments about the logic.
 	 */
 	for (;;) {
-		Py_BEGIN_ALLOW_THREADS
+		FILE_BEGIN_ALLOW_THREADS(f)
 		pvend = BUF(v) + total_v_size;
 		nfree = pvend - pvfree;
 		memset(pvfree, '\n', nfree);
 		p = fgets(pvfree, nfree, fp);
-		Py_END_ALLOW_THREADS
+		FILE_END_ALLOW_THREADS(f)
 
 		if (p == NULL) {
 			clearerr(fp);
@@ -905,7 +951,7 @@ get_line(PyFileObject *f, int n)
 
 #ifdef USE_FGETS_IN_GETLINE
 	if (n <= 0)
-		return getline_via_fgets(fp);
+		return getline_via_fgets(f);
 #endif
 	n2 = n > 0 ? n : 100;
 	v = PyString_FromStringAndSize((char *)NULL, n2);
@@ -915,14 +961,14 @@ get_line(PyFileObject *f, int n)
 	end = buf + n2;
 
 	for (;;) {
-		Py_BEGIN_ALLOW_THREADS
+		FILE_BEGIN_ALLOW_THREADS(f)
 		FLOCKFILE(fp);
 		while ((c = GETC(fp)) != EOF &&
 		       (*buf++ = c) != '\n' &&
 			buf != end)
 			;
 		FUNLOCKFILE(fp);
-		Py_END_ALLOW_THREADS
+		FILE_END_ALLOW_THREADS(f)
 		if (c == '\n')
 			break;
 		if (c == EOF) {
@@ -1098,11 +1144,11 @@ file_readlines(PyFileObject *f, PyObject *args)
 		if (shortread)
 			nread = 0;
 		else {
-			Py_BEGIN_ALLOW_THREADS
+			FILE_BEGIN_ALLOW_THREADS(f)
 			errno = 0;
 			nread = fread(buffer+nfilled, 1,
 				      buffersize-nfilled, f->f_fp);
-			Py_END_ALLOW_THREADS
+			FILE_END_ALLOW_THREADS(f)
 			shortread = (nread < buffersize-nfilled);
 		}
 		if (nread == 0) {
@@ -1197,15 +1243,25 @@ file_write(PyFileObject *f, PyObject *args)
 {
 	char *s;
 	int n, n2;
+	PyObject *copy = NULL;
 	if (f->f_fp == NULL)
 		return err_closed();
 	if (!PyArg_ParseTuple(args, f->f_binary ? "s#" : "t#", &s, &n))
 		return NULL;
+	/* Only a string is sure to stay put while the lock is released;
+	   write a private copy of anything else, as writelines() does. */
+	if (!PyString_Check(PyTuple_GET_ITEM(args, 0))) {
+		copy = PyString_FromStringAndSize(s, n);
+		if (copy == NULL)
+			return NULL;
+		s = PyString_AS_STRING(copy);
+	}
 	f->f_softspace = 0;
-	Py_BEGIN_ALLOW_THREADS
+	FILE_BEGIN_ALLOW_THREADS(f)
 	errno = 0;
 	n2 = fwrite(s, 1, n, f->f_fp);
-	Py_END_ALLOW_THREADS
+	FILE_END_ALLOW_THREADS(f)
+	Py_XDECREF(copy);
 	if (n2 != n) {
 		PyErr_SetFromErrno(PyExc_IOError);
 		clearerr(f->f_fp);
@@ -1303,7 +1359,7 @@ file_writelines(PyFileObject *f, PyObject *seq)
 
 		/* Since we are releasing the global lock, the
 		   following code may *not* execute Python code. */
-		Py_BEGIN_ALLOW_THREADS
+		FILE_BEGIN_ALLOW_THREADS(f)
 		f->f_softspace = 0;
 		errno = 0;
 		for (i = 0; i < j; i++) {
@@ -1312,13 +1368,13 @@ file_writelines(PyFileObject *f, PyObject *seq)
 			nwritten = fwrite(PyString_AS_STRING(line),
 					  1, len, f->f_fp);
 			if (nwritten != len) {
-				Py_BLOCK_THREADS
+				FILE_BLOCK_THREADS(f)
 				PyErr_SetFromErrno(PyExc_IOError);
 				clearerr(f->f_fp);
 				goto error;
 			}
 		}
-		Py_END_ALLOW_THREADS
+		FILE_END_ALLOW_THREADS(f)
 
 		if (j < CHUNKSIZE)
 			break;
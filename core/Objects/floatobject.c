@@ -40,9 +40,13 @@ typedef struct _floatblock PyFloatBlock;
 #ifndef SYMBIAN
 static PyFloatBlock *block_list = NULL;
 static PyFloatObject *free_list = NULL;
+static PyFreeListStats float_freelist = {0, 0, 0, -1};
+static int float_trim_at = 0;	/* free list size that triggers a trim */
 #else
 #define block_list ((PyFloatBlock*)(pyglobals->block_list))
 #define free_list ((PyFloatObject*)(pyglobals->free_list))
+#define float_freelist (pyglobals->float_freelist)
+#define float_trim_at (pyglobals->float_trim_at)
 #endif
 
 static PyFloatObject *
@@ -63,9 +67,87 @@ fill_free_list(void)
 	while (--q > p)
 		q->ob_type = (struct _typeobject *)(q-1);
 	q->ob_type = NULL;
+	float_freelist.count += N_FLOATOBJECTS;
 	return p + N_FLOATOBJECTS - 1;
 }
 
+/* Release the blocks in which no float is alive and rebuild the free
+   list from the others.  Stores the number of blocks seen in *pbc and of
+   live floats in *psum; returns the number of blocks released. */
+static int
+compact_blocks(int *pbc, int *psum)
+{
+	PyFloatObject *p;
+	PyFloatBlock *list, *next;
+	int i;
+	int bf;		/* number of freed blocks */
+	int frem;	/* remaining unfreed floats per block */
+#ifdef SYMBIAN
+	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
+#endif
+
+	*pbc = 0;
+	*psum = 0;
+	bf = 0;
+	list = block_list;
+	block_list = NULL;
+	free_list = NULL;
+	float_freelist.count = 0;
+	while (list != NULL) {
+		(*pbc)++;
+		frem = 0;
+		for (i = 0, p = &list->objects[0];
+		     i < N_FLOATOBJECTS;
+		     i++, p++) {
+			if (PyFloat_CheckExact(p) && p->ob_refcnt != 0)
+				frem++;
+		}
+		next = list->next;
+		if (frem) {
+			list->next = block_list;
+			block_list = list;
+			for (i = 0, p = &list->objects[0];
+			     i < N_FLOATOBJECTS;
+			     i++, p++) {
+				if (!PyFloat_CheckExact(p) ||
+				    p->ob_refcnt == 0) {
+					p->ob_type = (struct _typeobject *)
+						free_list;
+					free_list = p;
+				}
+			}
+			float_freelist.count += N_FLOATOBJECTS - frem;
+		}
+		else {
+			PyMem_FREE(list); /* XXX PyObject_FREE ??? */
+			bf++;
+		}
+		*psum += frem;
+		list = next;
+	}
+	/* Don't trim again before the free list has doubled. */
+	float_trim_at = 2 * float_freelist.count;
+	return bf;
+}
+
+PyFreeListStats *
+_PyFloat_FreeListStats(long *bytes)
+{
+#ifdef SYMBIAN
+	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
+#endif
+	*bytes = float_freelist.count * (long)sizeof(PyFloatObject);
+	return &float_freelist;
+}
+
+long
+PyFloat_ClearFreeList(void)
+{
+	int bc, fsum;
+
+	return compact_blocks(&bc, &fsum) * (long)sizeof(PyFloatBlock);
+}
+
 DL_EXPORT(PyObject *)
 PyFloat_FromDouble(double fval)
 {
@@ -74,12 +156,16 @@ PyFloat_FromDouble(double fval)
 	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
 #endif
 	if (free_list == NULL) {
+		float_freelist.misses++;
 		if ((free_list = fill_free_list()) == NULL)
 			return NULL;
 	}
+	else
+		float_freelist.hits++;
 	/* PyObject_New is inlined */
 	op = free_list;
 	free_list = (PyFloatObject *)op->ob_type;
+	float_freelist.count--;
 	PyObject_INIT(op, &PyFloat_Type);
 	op->ob_fval = fval;
 	return (PyObject *) op;
@@ -203,6 +289,10 @@ float_dealloc(PyFloatObject *op)
 	if (PyFloat_CheckExact(op)) {
 		op->ob_type = (struct _typeobject *)free_list;
 		free_list = op;
+		if (++float_freelist.count > float_freelist.limit &&
+		    float_freelist.limit >= 0 &&
+		    float_freelist.count > float_trim_at)
+			(void)PyFloat_ClearFreeList();
 	}
 	else
 		op->ob_type->tp_free((PyObject *)op);
@@ -839,52 +929,16 @@ DL_EXPORT(void)
 PyFloat_Fini(void)
 {
 	PyFloatObject *p;
-	PyFloatBlock *list, *next;
+	PyFloatBlock *list;
 	int i;
 	int bc, bf;	/* block count, number of freed blocks */
-	int frem, fsum;	/* remaining unfreed floats per block, total */
+	int fsum;	/* total unfreed floats */
 
 #ifdef SYMBIAN
 	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
 #endif
 
-	bc = 0;
-	bf = 0;
-	fsum = 0;
-	list = block_list;
-	block_list = NULL;
-	free_list = NULL;
-	while (list != NULL) {
-		bc++;
-		frem = 0;
-		for (i = 0, p = &list->objects[0];
-		     i < N_FLOATOBJECTS;
-		     i++, p++) {
-			if (PyFloat_CheckExact(p) && p->ob_refcnt != 0)
-				frem++;
-		}
-		next = list->next;
-		if (frem) {
-			list->next = block_list;
-			block_list = list;
-			for (i = 0, p = &list->objects[0];
-			     i < N_FLOATOBJECTS;
-			     i++, p++) {
-				if (!PyFloat_CheckExact(p) ||
-				    p->ob_refcnt == 0) {
-					p->ob_type = (struct _typeobject *)
-						free_list;
-					free_list = p;
-				}
-			}
-		}
-		else {
-			PyMem_FREE(list); /* XXX PyObject_FREE ??? */
-			bf++;
-		}
-		fsum += frem;
-		list = next;
-	}
+	bf = compact_blocks(&bc, &fsum);
 	if (!Py_VerboseFlag)
 		return;
 	fprintf(stderr, "# cleanup floats");
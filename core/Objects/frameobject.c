@@ -17,7 +17,6 @@ const static PyMemberDef frame_memberlist[] = {
 	{"f_builtins",	T_OBJECT,	OFF(f_builtins),RO},
 	{"f_globals",	T_OBJECT,	OFF(f_globals),	RO},
 	{"f_lasti",	T_INT,		OFF(f_lasti),	RO},
-	{"f_lineno",	T_INT,		OFF(f_lineno),	RO},
 	{"f_restricted",T_INT,		OFF(f_restricted),RO},
 	{"f_trace",	T_OBJECT,	OFF(f_trace)},
 	{"f_exc_type",	T_OBJECT,	OFF(f_exc_type)},
@@ -34,8 +33,28 @@ frame_getlocals(PyFrameObject *f, void *closure)
 	return f->f_locals;
 }
 
+/* f_lineno is only kept up to date while the frame is being traced;
+   otherwise it is computed from co_lnotab and f_lasti.  A frame that has
+   not started yet (still at offset 0 and not running, so f_stacktop is
+   set) is on its def line, which is what the 'call' event reports. */
+
+static PyObject *
+frame_getlineno(PyFrameObject *f, void *closure)
+{
+	int lineno;
+
+	if (f->f_trace)
+		lineno = f->f_lineno;
+	else if (f->f_lasti == 0 && f->f_stacktop != NULL)
+		lineno = f->f_code->co_firstlineno;
+	else
+		lineno = PyCode_Addr2Line(f->f_code, f->f_lasti);
+	return PyInt_FromLong(lineno);
+}
+
 const static PyGetSetDef frame_getsetlist[] = {
 	{"f_locals",	(getter)frame_getlocals, NULL, NULL},
+	{"f_lineno",	(getter)frame_getlineno, NULL, NULL},
 	{0}
 };
 
@@ -61,6 +80,16 @@ const static PyGetSetDef frame_getsetlist[] = {
    Later, MAXFREELIST was added to bound the # of frames saved on
    free_list.  Else programs creating lots of cyclic trash involving
    frames could provoke free_list into growing without bound.
+
+   On top of that, each code object keeps the last frame that ran it
+   ("zombie frame") in co_zombieframe instead of putting it on
+   free_list.  A zombie frame is already the right size for its code
+   and keeps f_code (a borrowed pointer while it is a zombie), the
+   size fields and f_valuestack; frame_dealloc() leaves its locals
+   NULL.  So the next call of the same function skips the resize,
+   the sizing arithmetic and the clearing of the locals.  There is at
+   most one zombie per code object, and it goes away with the code
+   object (see code_dealloc()).
 */
 
 #ifndef SYMBIAN
@@ -78,6 +107,7 @@ frame_dealloc(PyFrameObject *f)
 	int i, slots;
 	PyObject **fastlocals;
 	PyObject **p;
+	PyCodeObject *co;
 #ifdef SYMBIAN
         SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
 #endif
@@ -87,7 +117,11 @@ frame_dealloc(PyFrameObject *f)
 	slots = f->f_nlocals + f->f_ncells + f->f_nfreevars;
 	fastlocals = f->f_localsplus;
 	for (i = slots; --i >= 0; ++fastlocals) {
-		Py_XDECREF(*fastlocals);
+		PyObject *tmp = *fastlocals;
+		if (tmp != NULL) {
+			*fastlocals = NULL;
+			Py_DECREF(tmp);
+		}
 	}
 
 	/* Free stack */
@@ -97,7 +131,6 @@ frame_dealloc(PyFrameObject *f)
 	}
 
 	Py_XDECREF(f->f_back);
-	Py_XDECREF(f->f_code);
 	Py_XDECREF(f->f_builtins);
 	Py_XDECREF(f->f_globals);
 	Py_XDECREF(f->f_locals);
@@ -105,13 +138,18 @@ frame_dealloc(PyFrameObject *f)
 	Py_XDECREF(f->f_exc_type);
 	Py_XDECREF(f->f_exc_value);
 	Py_XDECREF(f->f_exc_traceback);
-	if (numfree < MAXFREELIST) {
+	co = f->f_code;
+	if (co->co_zombieframe == NULL)
+		co->co_zombieframe = f;
+	else if (numfree < MAXFREELIST) {
 		++numfree;
 		f->f_back = free_list;
 		free_list = f;
 	}
 	else
 		PyObject_GC_Del(f);
+	/* This may free co and with it f, if f became its zombie */
+	Py_DECREF(co);
 	Py_TRASHCAN_SAFE_END(f)
 }
 
@@ -252,9 +290,8 @@ PyFrame_New(PyThreadState *tstate, PyCodeObject *code, PyObject *globals,
 		PyErr_BadInternalCall();
 		return NULL;
 	}
-	ncells = PyTuple_GET_SIZE(code->co_cellvars);
-	nfrees = PyTuple_GET_SIZE(code->co_freevars);
-	extras = code->co_stacksize + code->co_nlocals + ncells + nfrees;
+	if (PyCode_LOAD(code) < 0)
+		return NULL;
 	if (back == NULL || back->f_globals != globals) {
 		builtins = PyDict_GetItem(globals, builtin_object);
 		if (builtins != NULL && PyModule_Check(builtins))
@@ -267,23 +304,55 @@ PyFrame_New(PyThreadState *tstate, PyCodeObject *code, PyObject *globals,
 	}
 	if (builtins != NULL && !PyDict_Check(builtins))
 		builtins = NULL;
-	if (free_list == NULL) {
-		f = PyObject_GC_NewVar(PyFrameObject, &PyFrame_Type, extras);
-		if (f == NULL)
-			return NULL;
+	if (code->co_zombieframe != NULL) {
+		f = (PyFrameObject *)code->co_zombieframe;
+		code->co_zombieframe = NULL;
+		_Py_NewReference((PyObject *)f);
+		assert(f->f_code == code);
 	}
 	else {
-		assert(numfree > 0);
-		--numfree;
-		f = free_list;
-		free_list = free_list->f_back;
-		if (f->ob_size < extras) {
-			f = PyObject_GC_Resize(PyFrameObject, f, extras);
+		ncells = PyTuple_GET_SIZE(code->co_cellvars);
+		nfrees = PyTuple_GET_SIZE(code->co_freevars);
+		extras = code->co_stacksize + code->co_nlocals + ncells +
+			nfrees;
+		if (free_list == NULL) {
+			f = PyObject_GC_NewVar(PyFrameObject, &PyFrame_Type,
+					       extras);
 			if (f == NULL)
 				return NULL;
 		}
-		_Py_NewReference((PyObject *)f);
+		else {
+			assert(numfree > 0);
+			--numfree;
+			f = free_list;
+			free_list = free_list->f_back;
+			if (f->ob_size < extras) {
+				f = PyObject_GC_Resize(PyFrameObject, f,
+						       extras);
+				if (f == NULL)
+					return NULL;
+			}
+			_Py_NewReference((PyObject *)f);
+		}
+		f->f_code = code;
+		f->f_nlocals = code->co_nlocals;
+		f->f_stacksize = code->co_stacksize;
+		f->f_ncells = ncells;
+		f->f_nfreevars = nfrees;
+
+		extras = f->f_nlocals + ncells + nfrees;
+		memset(f->f_localsplus, 0,
+		       extras * sizeof(f->f_localsplus[0]));
+		f->f_valuestack = f->f_localsplus + extras;
 	}
+	/* f owns a reference to its code; with the other references
+	   cleared, a Py_DECREF(f) on the error paths below is safe */
+	Py_INCREF(code);
+	f->f_back = NULL;
+	f->f_builtins = f->f_globals = f->f_locals = NULL;
+	f->f_trace = NULL;
+	f->f_exc_type = f->f_exc_value = f->f_exc_traceback = NULL;
+	f->f_stacktop = f->f_valuestack;
 	if (builtins == NULL) {
 		/* No builtins!  Make up a minimal one. */
 		builtins = PyDict_New();
@@ -298,8 +367,6 @@ PyFrame_New(PyThreadState *tstate, PyCodeObject *code, PyObject *globals,
 	f->f_builtins = builtins;
 	Py_XINCREF(back);
 	f->f_back = back;
-	Py_INCREF(code);
-	f->f_code = code;
 	Py_INCREF(globals);
 	f->f_globals = globals;
 	if (code->co_flags & CO_NEWLOCALS) {
@@ -319,24 +386,12 @@ PyFrame_New(PyThreadState *tstate, PyCodeObject *code, PyObject *globals,
 		Py_INCREF(locals);
 	}
 	f->f_locals = locals;
-	f->f_trace = NULL;
-	f->f_exc_type = f->f_exc_value = f->f_exc_traceback = NULL;
 	f->f_tstate = tstate;
 
 	f->f_lasti = 0;
 	f->f_lineno = code->co_firstlineno;
 	f->f_restricted = (builtins != tstate->interp->builtins);
 	f->f_iblock = 0;
-	f->f_nlocals = code->co_nlocals;
-	f->f_stacksize = code->co_stacksize;
-	f->f_ncells = ncells;
-	f->f_nfreevars = nfrees;
-
-	extras = f->f_nlocals + ncells + nfrees;
-	memset(f->f_localsplus, 0, extras * sizeof(f->f_localsplus[0]));
-
-	f->f_valuestack = f->f_localsplus + extras;
-	f->f_stacktop = f->f_valuestack;
 	_PyObject_GC_TRACK(f);
 	return f;
 }
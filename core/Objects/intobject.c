@@ -92,9 +92,13 @@ typedef struct _intblock PyIntBlock;
 #ifndef SYMBIAN
 static PyIntBlock *block_list = NULL;
 static PyIntObject *free_list = NULL;
+static PyFreeListStats int_freelist = {0, 0, 0, -1};
+static int int_trim_at = 0;	/* free list size that triggers a trim */
 #else
 #define block_list ((PyIntBlock*)(pyglobals->INTOBJ_block_list))
 #define free_list ((PyIntObject*)(pyglobals->INTOBJ_free_list))
+#define int_freelist (pyglobals->int_freelist)
+#define int_trim_at (pyglobals->int_trim_at)
 #endif
 
 static PyIntObject *
@@ -115,9 +119,87 @@ fill_free_list(void)
 	while (--q > p)
 		q->ob_type = (struct _typeobject *)(q-1);
 	q->ob_type = NULL;
+	int_freelist.count += N_INTOBJECTS;
 	return p + N_INTOBJECTS - 1;
 }
 
+/* Release the blocks in which no int is alive and rebuild the free list
+   from the others.  Stores the number of blocks seen in *pbc and of live
+   ints in *psum; returns the number of blocks released. */
+static int
+compact_blocks(int *pbc, int *psum)
+{
+	PyIntObject *p;
+	PyIntBlock *list, *next;
+	int i;
+	int bf;		/* number of freed blocks */
+	int irem;	/* remaining unfreed ints per block */
+#ifdef SYMBIAN
+	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
+#endif
+
+	*pbc = 0;
+	*psum = 0;
+	bf = 0;
+	list = block_list;
+	block_list = NULL;
+	free_list = NULL;
+	int_freelist.count = 0;
+	while (list != NULL) {
+		(*pbc)++;
+		irem = 0;
+		for (i = 0, p = &list->objects[0];
+		     i < N_INTOBJECTS;
+		     i++, p++) {
+			if (PyInt_CheckExact(p) && p->ob_refcnt != 0)
+				irem++;
+		}
+		next = list->next;
+		if (irem) {
+			list->next = block_list;
+			block_list = list;
+			for (i = 0, p = &list->objects[0];
+			     i < N_INTOBJECTS;
+			     i++, p++) {
+				if (!PyInt_CheckExact(p) ||
+				    p->ob_refcnt == 0) {
+					p->ob_type = (struct _typeobject *)
+						free_list;
+					free_list = p;
+				}
+			}
+			int_freelist.count += N_INTOBJECTS - irem;
+		}
+		else {
+			PyMem_FREE(list); /* XXX PyObject_FREE ??? */
+			bf++;
+		}
+		*psum += irem;
+		list = next;
+	}
+	/* Don't trim again before the free list has doubled. */
+	int_trim_at = 2 * int_freelist.count;
+	return bf;
+}
+
+PyFreeListStats *
+_PyInt_FreeListStats(long *bytes)
+{
+#ifdef SYMBIAN
+	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
+#endif
+	*bytes = int_freelist.count * (long)sizeof(PyIntObject);
+	return &int_freelist;
+}
+
+long
+PyInt_ClearFreeList(void)
+{
+	int bc, isum;
+
+	return compact_blocks(&bc, &isum) * (long)sizeof(PyIntBlock);
+}
+
 #ifndef NSMALLPOSINTS
 #define NSMALLPOSINTS		100
 #endif
@@ -162,12 +244,16 @@ PyInt_FromLong(long ival)
 	}
 #endif
 	if (free_list == NULL) {
+		int_freelist.misses++;
 		if ((free_list = fill_free_list()) == NULL)
 			return NULL;
 	}
+	else
+		int_freelist.hits++;
 	/* PyObject_New is inlined */
 	v = free_list;
 	free_list = (PyIntObject *)v->ob_type;
+	int_freelist.count--;
 	PyObject_INIT(v, &PyInt_Type);
 	v->ob_ival = ival;
 #if NSMALLNEGINTS + NSMALLPOSINTS > 0
@@ -189,6 +275,10 @@ int_dealloc(PyIntObject *v)
 	if (PyInt_CheckExact(v)) {
 		v->ob_type = (struct _typeobject *)free_list;
 		free_list = v;
+		if (++int_freelist.count > int_freelist.limit &&
+		    int_freelist.limit >= 0 &&
+		    int_freelist.count > int_trim_at)
+			(void)PyInt_ClearFreeList();
 	}
 	else
 		v->ob_type->tp_free((PyObject *)v);
@@ -202,6 +292,7 @@ int_free(PyIntObject *v)
 #endif
 	v->ob_type = (struct _typeobject *)free_list;
 	free_list = v;
+	int_freelist.count++;
 }
 
 DL_EXPORT(long)
@@ -1027,10 +1118,10 @@ DL_EXPORT(void)
 PyInt_Fini(void)
 {
 	PyIntObject *p;
-	PyIntBlock *list, *next;
+	PyIntBlock *list;
 	int i;
 	int bc, bf;	/* block count, number of freed blocks */
-	int irem, isum;	/* remaining unfreed ints per block, total */
+	int isum;	/* total unfreed ints */
 
 #ifdef SYMBIAN
 	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
@@ -1046,53 +1137,22 @@ PyInt_Fini(void)
                 *q++ = NULL;
         }
 #endif
-	bc = 0;
-	bf = 0;
-	isum = 0;
-	list = block_list;
-	block_list = NULL;
-	free_list = NULL;
-	while (list != NULL) {
-		bc++;
-		irem = 0;
+	bf = compact_blocks(&bc, &isum);
+#if NSMALLNEGINTS + NSMALLPOSINTS > 0
+	for (list = block_list; list != NULL; list = list->next) {
 		for (i = 0, p = &list->objects[0];
 		     i < N_INTOBJECTS;
 		     i++, p++) {
-			if (PyInt_CheckExact(p) && p->ob_refcnt != 0)
-				irem++;
-		}
-		next = list->next;
-		if (irem) {
-			list->next = block_list;
-			block_list = list;
-			for (i = 0, p = &list->objects[0];
-			     i < N_INTOBJECTS;
-			     i++, p++) {
-				if (!PyInt_CheckExact(p) ||
-				    p->ob_refcnt == 0) {
-					p->ob_type = (struct _typeobject *)
-						free_list;
-					free_list = p;
-				}
-#if NSMALLNEGINTS + NSMALLPOSINTS > 0
-				else if (-NSMALLNEGINTS <= p->ob_ival &&
-					 p->ob_ival < NSMALLPOSINTS &&
-					 small_ints[p->ob_ival +
-						    NSMALLNEGINTS] == NULL) {
-					Py_INCREF(p);
-					small_ints[p->ob_ival +
-						   NSMALLNEGINTS] = p;
-				}
-#endif
+			if (PyInt_CheckExact(p) && p->ob_refcnt != 0 &&
+			    -NSMALLNEGINTS <= p->ob_ival &&
+			    p->ob_ival < NSMALLPOSINTS &&
+			    small_ints[p->ob_ival + NSMALLNEGINTS] == NULL) {
+				Py_INCREF(p);
+				small_ints[p->ob_ival + NSMALLNEGINTS] = p;
 			}
 		}
-		else {
-			PyMem_FREE(list); /* XXX PyObject_FREE ??? */
-			bf++;
-		}
-		isum += irem;
-		list = next;
 	}
+#endif
 	if (!Py_VerboseFlag)
 		return;
 	fprintf(stderr, "# cleanup ints");
@@ -54,12 +54,27 @@ do {								\
 		var = NULL;					\
 } while (0)
 
+/* Free list of list objects, linked through ob_item */
+#ifndef PyList_MAXFREELIST
+#define PyList_MAXFREELIST 80	/* Default number of lists to save */
+#endif
+#ifndef SYMBIAN
+static PyListObject *free_lists = NULL;
+static PyFreeListStats list_freelist = {0, 0, 0, PyList_MAXFREELIST};
+#else
+#define free_lists (*(PyListObject **)&(pyglobals->list_free_list))
+#define list_freelist (pyglobals->list_freelist)
+#endif
+
 DL_EXPORT(PyObject *)
 PyList_New(int size)
 {
 	int i;
 	PyListObject *op;
 	size_t nbytes;
+#ifdef SYMBIAN
+	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
+#endif
 	if (size < 0) {
 		PyErr_BadInternalCall();
 		return NULL;
@@ -69,9 +84,19 @@ PyList_New(int size)
 	if (nbytes / sizeof(PyObject *) != (size_t)size) {
 		return PyErr_NoMemory();
 	}
-	op = PyObject_GC_New(PyListObject, &PyList_Type);
-	if (op == NULL) {
-		return NULL;
+	if (free_lists != NULL) {
+		op = free_lists;
+		free_lists = (PyListObject *)op->ob_item;
+		list_freelist.count--;
+		list_freelist.hits++;
+		_Py_NewReference((PyObject *)op);
+	}
+	else {
+		list_freelist.misses++;
+		op = PyObject_GC_New(PyListObject, &PyList_Type);
+		if (op == NULL) {
+			return NULL;
+		}
 	}
 	if (size <= 0) {
 		op->ob_item = NULL;
@@ -210,6 +235,9 @@ static void
 list_dealloc(PyListObject *op)
 {
 	int i;
+#ifdef SYMBIAN
+	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
+#endif
 	PyObject_GC_UnTrack(op);
 	Py_TRASHCAN_SAFE_BEGIN(op)
 	if (op->ob_item != NULL) {
@@ -223,10 +251,51 @@ list_dealloc(PyListObject *op)
 		}
 		PyMem_FREE(op->ob_item);
 	}
-	op->ob_type->tp_free((PyObject *)op);
+	if ((list_freelist.count < list_freelist.limit ||
+	     list_freelist.limit < 0) && PyList_CheckExact(op)) {
+		op->ob_item = (PyObject **)free_lists;
+		free_lists = op;
+		list_freelist.count++;
+	}
+	else
+		op->ob_type->tp_free((PyObject *)op);
 	Py_TRASHCAN_SAFE_END(op)
 }
 
+PyFreeListStats *
+_PyList_FreeListStats(long *bytes)
+{
+#ifdef SYMBIAN
+	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
+#endif
+	*bytes = list_freelist.count * (long)sizeof(PyListObject);
+	return &list_freelist;
+}
+
+long
+PyList_ClearFreeList(void)
+{
+	PyListObject *op;
+	long freed;
+#ifdef SYMBIAN
+	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
+#endif
+	freed = list_freelist.count * (long)sizeof(PyListObject);
+	while (free_lists != NULL) {
+		op = free_lists;
+		free_lists = (PyListObject *)op->ob_item;
+		PyObject_GC_Del(op);
+	}
+	list_freelist.count = 0;
+	return freed;
+}
+
+void
+PyList_Fini(void)
+{
+	(void)PyList_ClearFreeList();
+}
+
 static int
 list_print(PyListObject *op, FILE *fp, int flags)
 {
@@ -630,11 +699,11 @@ ins(PyListObject *self, int where, PyObject *v)
 }
 
 static PyObject *
-listinsert(PyListObject *self, PyObject *args)
+listinsert(PyListObject *self, PyObject **args, int nargs)
 {
 	int i;
 	PyObject *v;
-	if (!PyArg_ParseTuple(args, "iO:insert", &i, &v))
+	if (!_PyArg_ParseStack(args, nargs, "iO:insert", &i, &v))
 		return NULL;
 	return ins(self, i, v);
 }
@@ -731,11 +800,11 @@ listextend(PyListObject *self, PyObject *b)
 }
 
 static PyObject *
-listpop(PyListObject *self, PyObject *args)
+listpop(PyListObject *self, PyObject **args, int nargs)
 {
 	int i = -1;
 	PyObject *v;
-	if (!PyArg_ParseTuple(args, "|i:pop", &i))
+	if (!_PyArg_ParseStack(args, nargs, "|i:pop", &i))
 		return NULL;
 	if (self->ob_size == 0) {
 		/* Special-case most common failure cause */
@@ -757,142 +826,205 @@ listpop(PyListObject *self, PyObject *args)
 	return v;
 }
 
-/* New quicksort implementation for arrays of object pointers.
-   Thanks to discussions with Tim Peters. */
-
-/* CMPERROR is returned by our comparison function when an error
-   occurred.  This is the largest negative integer (0x80000000 on a
-   32-bit system). */
-#define CMPERROR ( (int) ((unsigned int)1 << (8*sizeof(int) - 1)) )
-
-/* Comparison function.  Takes care of calling a user-supplied
-   comparison function (any callable Python object).  Calls the
-   standard comparison function, PyObject_Compare(), if the user-
-   supplied function is NULL. */
-
+/* Adaptive, stable, natural mergesort for arrays of object pointers.
+
+   The list is split into runs: maximal stretches that are already
+   ascending, or strictly descending (those are reversed in place).  Runs
+   shorter than a computed minimum are extended with binary insertion.
+   Runs are pushed on a stack and merged while keeping the lengths of
+   the pending runs decreasing fast enough that the stack stays short and
+   merges stay balanced.  When one run keeps winning during a merge, the
+   merge switches to "galloping": exponential then binary search for
+   where the next element of the other run belongs, so that long
+   stretches are moved with memcpy and log(n) compares.  Already-sorted,
+   reversed and partly ordered input therefore takes O(n) compares, and
+   random input takes close to the n log n minimum.
+
+   Equal elements never change their relative order, because runs are
+   only merged with their neighbours and ties are resolved in favour of
+   the left run. */
+
+/* Return 1 if x < y, 0 if not, or -1 with an exception set.  Takes care
+   of calling a user-supplied comparison function (any callable Python
+   object), or the standard rich comparison if compare is NULL. */
 static int
-docompare(PyObject *x, PyObject *y, PyObject *compare)
+islt(PyObject *x, PyObject *y, PyObject *compare)
 {
 	PyObject *args, *res;
 	int i;
 
-	if (compare == NULL) {
-		/* NOTE: we rely on the fact here that the sorting algorithm
-		   only ever checks whether k<0, i.e., whether x<y.  So we
-		   invoke the rich comparison function with Py_LT ('<'), and
-		   return -1 when it returns true and 0 when it returns
-		   false. */
-		i = PyObject_RichCompareBool(x, y, Py_LT);
-		if (i < 0)
-			return CMPERROR;
-		else
-			return -i;
-	}
+	if (compare == NULL)
+		return PyObject_RichCompareBool(x, y, Py_LT);
 
-	args = Py_BuildValue("(OO)", x, y);
+	args = PyTuple_New(2);
 	if (args == NULL)
-		return CMPERROR;
+		return -1;
+	Py_INCREF(x);
+	Py_INCREF(y);
+	PyTuple_SET_ITEM(args, 0, x);
+	PyTuple_SET_ITEM(args, 1, y);
 	res = PyEval_CallObject(compare, args);
 	Py_DECREF(args);
 	if (res == NULL)
-		return CMPERROR;
+		return -1;
 	if (!PyInt_Check(res)) {
 		Py_DECREF(res);
 		PyErr_SetString(PyExc_TypeError,
 				"comparison function must return int");
-		return CMPERROR;
+		return -1;
 	}
 	i = PyInt_AsLong(res);
 	Py_DECREF(res);
-	if (i < 0)
-		return -1;
-	if (i > 0)
-		return 1;
-	return 0;
+	return i < 0;
+}
+
+#define ISLT(X, Y) islt(X, Y, compare)
+
+/* Compare X to Y via ISLT, jump to "fail" on error, else do the statement
+   that follows if X < Y.  k must be an int in scope. */
+#define IFLT(X, Y) if ((k = ISLT(X, Y)) < 0) goto fail;  \
+		   if (k)
+
+/* The sort works on keys.  When sorting with a key function, values
+   holds the list items and every move of a key is mirrored on the value
+   at the same position; otherwise values is NULL and the keys are the
+   list items themselves. */
+typedef struct {
+	PyObject **keys;
+	PyObject **values;
+} sortslice;
+
+static void
+sortslice_copy(sortslice *s1, int i, sortslice *s2, int j)
+{
+	s1->keys[i] = s2->keys[j];
+	if (s1->values != NULL)
+		s1->values[i] = s2->values[j];
+}
+
+static void
+sortslice_copy_incr(sortslice *dst, sortslice *src)
+{
+	*dst->keys++ = *src->keys++;
+	if (dst->values != NULL)
+		*dst->values++ = *src->values++;
+}
+
+static void
+sortslice_copy_decr(sortslice *dst, sortslice *src)
+{
+	*dst->keys-- = *src->keys--;
+	if (dst->values != NULL)
+		*dst->values-- = *src->values--;
+}
+
+static void
+sortslice_memcpy(sortslice *s1, int i, sortslice *s2, int j, int n)
+{
+	memcpy(&s1->keys[i], &s2->keys[j], sizeof(PyObject *) * n);
+	if (s1->values != NULL)
+		memcpy(&s1->values[i], &s2->values[j], sizeof(PyObject *) * n);
+}
+
+static void
+sortslice_memmove(sortslice *s1, int i, sortslice *s2, int j, int n)
+{
+	memmove(&s1->keys[i], &s2->keys[j], sizeof(PyObject *) * n);
+	if (s1->values != NULL)
+		memmove(&s1->values[i], &s2->values[j], sizeof(PyObject *) * n);
+}
+
+static void
+sortslice_advance(sortslice *slice, int n)
+{
+	slice->keys += n;
+	if (slice->values != NULL)
+		slice->values += n;
+}
+
+/* Reverse the slice [lo, hi) in place. */
+static void
+reverse_slice(PyObject **lo, PyObject **hi)
+{
+	PyObject *t;
+
+	--hi;
+	while (lo < hi) {
+		t = *lo;
+		*lo = *hi;
+		*hi = t;
+		++lo;
+		--hi;
+	}
 }
 
-/* MINSIZE is the smallest array that will get a full-blown samplesort
-   treatment; smaller arrays are sorted using binary insertion.  It must
-   be at least 7 for the samplesort implementation to work.  Binary
-   insertion does fewer compares, but can suffer O(N**2) data movement.
-   The more expensive compares, the larger MINSIZE should be. */
-#define MINSIZE 100
-
-/* MINPARTITIONSIZE is the smallest array slice samplesort will bother to
-   partition; smaller slices are passed to binarysort.  It must be at
-   least 2, and no larger than MINSIZE.  Setting it higher reduces the #
-   of compares slowly, but increases the amount of data movement quickly.
-   The value here was chosen assuming a compare costs ~25x more than
-   swapping a pair of memory-resident pointers -- but under that assumption,
-   changing the value by a few dozen more or less has aggregate effect
-   under 1%.  So the value is crucial, but not touchy <wink>. */
-#define MINPARTITIONSIZE 40
-
-/* MAXMERGE is the largest number of elements we'll always merge into
-   a known-to-be sorted chunk via binary insertion, regardless of the
-   size of that chunk.  Given a chunk of N sorted elements, and a group
-   of K unknowns, the largest K for which it's better to do insertion
-   (than a full-blown sort) is a complicated function of N and K mostly
-   involving the expected number of compares and data moves under each
-   approach, and the relative cost of those operations on a specific
-   architecure.  The fixed value here is conservative, and should be a
-   clear win regardless of architecture or N. */
-#define MAXMERGE 15
-
-/* STACKSIZE is the size of our work stack.  A rough estimate is that
-   this allows us to sort arrays of size N where
-   N / ln(N) = MINPARTITIONSIZE * 2**STACKSIZE, so 60 is more than enough
-   for arrays of size 2**64.  Because we push the biggest partition
-   first, the worst case occurs when all subarrays are always partitioned
-   exactly in two. */
-#define STACKSIZE 60
-
-
-#define SETK(X,Y) if ((k = docompare(X,Y,compare))==CMPERROR) goto fail
+static void
+reverse_sortslice(sortslice *s, int n)
+{
+	reverse_slice(s->keys, &s->keys[n]);
+	if (s->values != NULL)
+		reverse_slice(s->values, &s->values[n]);
+}
 
 /* binarysort is the best method for sorting small arrays: it does
    few compares, but can do data movement quadratic in the number of
    elements.
    [lo, hi) is a contiguous slice of a list, and is sorted via
-   binary insertion.
+   binary insertion.  This sort is stable.
    On entry, must have lo <= start <= hi, and that [lo, start) is already
    sorted (pass start == lo if you don't know!).
-   If docompare complains (returns CMPERROR) return -1, else 0.
+   If islt() complains return -1, else 0.
    Even in case of error, the output slice will be some permutation of
    the input (nothing is lost or duplicated).
 */
-
 static int
-binarysort(PyObject **lo, PyObject **hi, PyObject **start, PyObject *compare)
-     /* compare -- comparison function object, or NULL for default */
+binarysort(sortslice lo, PyObject **hi, PyObject **start, PyObject *compare)
 {
-	/* assert lo <= start <= hi
-	   assert [lo, start) is sorted */
 	register int k;
 	register PyObject **l, **p, **r;
 	register PyObject *pivot;
+	int offset;
 
-	if (lo == start)
+	assert(lo.keys <= start && start <= hi);
+	/* assert [lo, start) is sorted */
+	if (lo.keys == start)
 		++start;
 	for (; start < hi; ++start) {
 		/* set l to where *start belongs */
-		l = lo;
+		l = lo.keys;
 		r = start;
 		pivot = *r;
+		/* Invariants:
+		 * pivot >= all in [lo, l).
+		 * pivot  < all in [r, start).
+		 * The second is vacuously true at the start.
+		 */
+		assert(l < r);
 		do {
 			p = l + ((r - l) >> 1);
-			SETK(pivot, *p);
-			if (k < 0)
+			IFLT(pivot, *p)
 				r = p;
 			else
-				l = p + 1;
+				l = p+1;
 		} while (l < r);
-		/* Pivot should go at l -- slide over to make room.
-		   Caution: using memmove is much slower under MSVC 5;
-		   we're not usually moving many slots. */
+		assert(l == r);
+		/* The invariants still hold, so pivot >= all in [lo, l) and
+		   pivot < all in [l, start), so pivot belongs at l.  Note
+		   that if there are elements equal to pivot, l points to the
+		   first slot after them -- that's why this sort is stable.
+		   Slide over to make room. */
 		for (p = start; p > l; --p)
 			*p = *(p-1);
 		*l = pivot;
+		if (lo.values != NULL) {
+			offset = lo.values - lo.keys;
+			p = start + offset;
+			pivot = *p;
+			l += offset;
+			for (; p > l; --p)
+				*p = *(p-1);
+			*l = pivot;
+		}
 	}
 	return 0;
 
@@ -900,428 +1032,924 @@ binarysort(PyObject **lo, PyObject **hi, PyObject **start, PyObject *compare)
 	return -1;
 }
 
-/* samplesortslice is the sorting workhorse.
-   [lo, hi) is a contiguous slice of a list, to be sorted in place.
-   On entry, must have lo <= hi,
-   If docompare complains (returns CMPERROR) return -1, else 0.
-   Even in case of error, the output slice will be some permutation of
-   the input (nothing is lost or duplicated).
+/* Return the length of the run beginning at lo, in the slice [lo, hi).
+   lo < hi is required on entry.  "A run" is the longest ascending
+   sequence, with
 
-   samplesort is basically quicksort on steroids:  a power of 2 close
-   to n/ln(n) is computed, and that many elements (less 1) are picked at
-   random from the array and sorted.  These 2**k - 1 elements are then
-   used as preselected pivots for an equal number of quicksort
-   partitioning steps, partitioning the slice into 2**k chunks each of
-   size about ln(n).  These small final chunks are then usually handled
-   by binarysort.  Note that when k=1, this is roughly the same as an
-   ordinary quicksort using a random pivot, and when k=2 this is roughly
-   a median-of-3 quicksort.  From that view, using k ~= lg(n/ln(n)) makes
-   this a "median of n/ln(n)" quicksort.  You can also view it as a kind
-   of bucket sort, where 2**k-1 bucket boundaries are picked dynamically.
-
-   The large number of samples makes a quadratic-time case almost
-   impossible, and asymptotically drives the average-case number of
-   compares from quicksort's 2 N ln N (or 12/7 N ln N for the median-of-
-   3 variant) down to N lg N.
-
-   We also play lots of low-level tricks to cut the number of compares.
-
-   Very obscure:  To avoid using extra memory, the PPs are stored in the
-   array and shuffled around as partitioning proceeds.  At the start of a
-   partitioning step, we'll have 2**m-1 (for some m) PPs in sorted order,
-   adjacent (either on the left or the right!) to a chunk of X elements
-   that are to be partitioned: P X or X P.  In either case we need to
-   shuffle things *in place* so that the 2**(m-1) smaller PPs are on the
-   left, followed by the PP to be used for this step (that's the middle
-   of the PPs), followed by X, followed by the 2**(m-1) larger PPs:
-       P X or X P -> Psmall pivot X Plarge
-   and the order of the PPs must not be altered.  It can take a while
-   to realize this isn't trivial!  It can take even longer <wink> to
-   understand why the simple code below works, using only 2**(m-1) swaps.
-   The key is that the order of the X elements isn't necessarily
-   preserved:  X can end up as some cyclic permutation of its original
-   order.  That's OK, because X is unsorted anyway.  If the order of X
-   had to be preserved too, the simplest method I know of using O(1)
-   scratch storage requires len(X) + 2**(m-1) swaps, spread over 2 passes.
-   Since len(X) is typically several times larger than 2**(m-1), that
-   would slow things down.
-*/
+   lo[0] <= lo[1] <= lo[2] <= ...
 
-struct SamplesortStackNode {
-	/* Represents a slice of the array, from (& including) lo up
-	   to (but excluding) hi.  "extra" additional & adjacent elements
-	   are pre-selected pivots (PPs), spanning [lo-extra, lo) if
-	   extra > 0, or [hi, hi-extra) if extra < 0.  The PPs are
-	   already sorted, but nothing is known about the other elements
-	   in [lo, hi). |extra| is always one less than a power of 2.
-	   When extra is 0, we're out of PPs, and the slice must be
-	   sorted by some other means. */
-	PyObject **lo;
-	PyObject **hi;
-	int extra;
-};
+   or the longest descending sequence, with
 
-/* The number of PPs we want is 2**k - 1, where 2**k is as close to
-   N / ln(N) as possible.  So k ~= lg(N / ln(N)).  Calling libm routines
-   is undesirable, so cutoff values are canned in the "cutoff" table
-   below:  cutoff[i] is the smallest N such that k == CUTOFFBASE + i. */
-#define CUTOFFBASE 4
-const static long cutoff[] = {
-	43,        /* smallest N such that k == 4 */
-	106,       /* etc */
-	250,
-	576,
-	1298,
-	2885,
-	6339,
-	13805,
-	29843,
-	64116,
-	137030,
-	291554,
-	617916,
-	1305130,
-	2748295,
-	5771662,
-	12091672,
-	25276798,
-	52734615,
-	109820537,
-	228324027,
-	473977813,
-	982548444,   /* smallest N such that k == 26 */
-	2034159050   /* largest N that fits in signed 32-bit; k == 27 */
-};
+   lo[0] > lo[1] > lo[2] > ...
+
+   Boolean *descending is set to 0 in the former case, or to 1 in the
+   latter.  For its intended use in a stable mergesort, the strictness
+   of the defn of "descending" is needed so that the caller can safely
+   reverse a descending sequence without violating stability (strict >
+   ensures there are no equal elements to get out of order).
 
+   Returns -1 in case of error.
+*/
 static int
-samplesortslice(PyObject **lo, PyObject **hi, PyObject *compare)
-     /* compare -- comparison function object, or NULL for default */
+count_run(PyObject **lo, PyObject **hi, PyObject *compare, int *descending)
 {
-	register PyObject **l, **r;
-	register PyObject *tmp, *pivot;
-	register int k;
-	int n, extra, top, extraOnRight;
-	struct SamplesortStackNode stack[STACKSIZE];
-
-	/* assert lo <= hi */
-	n = hi - lo;
+	int k;
+	int n;
 
-	/* ----------------------------------------------------------
-	 * Special cases
-	 * --------------------------------------------------------*/
-	if (n < 2)
-		return 0;
+	assert(lo < hi);
+	*descending = 0;
+	++lo;
+	if (lo == hi)
+		return 1;
 
-	/* Set r to the largest value such that [lo,r) is sorted.
-	   This catches the already-sorted case, the all-the-same
-	   case, and the appended-a-few-elements-to-a-sorted-list case.
-	   If the array is unsorted, we're very likely to get out of
-	   the loop fast, so the test is cheap if it doesn't pay off.
-	*/
-	/* assert lo < hi */
-	for (r = lo+1; r < hi; ++r) {
-		SETK(*r, *(r-1));
-		if (k < 0)
-			break;
+	n = 2;
+	IFLT(*lo, *(lo-1)) {
+		*descending = 1;
+		for (lo = lo+1; lo < hi; ++lo, ++n) {
+			IFLT(*lo, *(lo-1))
+				;
+			else
+				break;
+		}
+	}
+	else {
+		for (lo = lo+1; lo < hi; ++lo, ++n) {
+			IFLT(*lo, *(lo-1))
+				break;
+		}
 	}
-	/* [lo,r) is sorted, [r,hi) unknown.  Get out cheap if there are
-	   few unknowns, or few elements in total. */
-	if (hi - r <= MAXMERGE || n < MINSIZE)
-		return binarysort(lo, hi, r, compare);
 
-	/* Check for the array already being reverse-sorted.  Typical
-	   benchmark-driven silliness <wink>. */
-	/* assert lo < hi */
-	for (r = lo+1; r < hi; ++r) {
-		SETK(*(r-1), *r);
-		if (k < 0)
-			break;
+	return n;
+ fail:
+	return -1;
+}
+
+/* Locate the proper position of key in a sorted vector; if the vector
+   contains an element equal to key, return the position immediately to
+   the left of the leftmost equal element.  [gallop_right() does the same
+   except returns the position to the right of the rightmost equal
+   element (if any).]
+
+   "a" is a sorted vector with n elements, starting at a[0].  n must be
+   > 0.
+
+   "hint" is an index at which to begin the search, 0 <= hint < n.  The
+   closer hint is to the final result, the faster this runs.
+
+   The return value is the int k in 0..n such that
+
+       a[k-1] < key <= a[k]
+
+   pretending that *(a-1) is minus infinity and a[n] is plus infinity.
+   IOW, key belongs at index k; or, IOW, the first k elements of a
+   should precede key, and the last n-k should follow key.
+
+   Returns -1 on error.
+*/
+static int
+gallop_left(PyObject *key, PyObject **a, int n, int hint, PyObject *compare)
+{
+	int ofs;
+	int lastofs;
+	int k;
+	int maxofs;
+	int m;
+
+	assert(key && a && n > 0 && hint >= 0 && hint < n);
+
+	a += hint;
+	lastofs = 0;
+	ofs = 1;
+	IFLT(*a, key) {
+		/* a[hint] < key -- gallop right, until
+		 * a[hint + lastofs] < key <= a[hint + ofs]
+		 */
+		maxofs = n - hint;	/* &a[n-1] is highest */
+		while (ofs < maxofs) {
+			IFLT(a[ofs], key) {
+				lastofs = ofs;
+				ofs = (ofs << 1) + 1;
+				if (ofs <= 0)	/* int overflow */
+					ofs = maxofs;
+			}
+			else	/* key <= a[hint + ofs] */
+				break;
+		}
+		if (ofs > maxofs)
+			ofs = maxofs;
+		/* Translate back to offsets relative to &a[0]. */
+		lastofs += hint;
+		ofs += hint;
 	}
-	if (hi - r <= MAXMERGE) {
-		/* Reverse the reversed prefix, then insert the tail */
-		PyObject **originalr = r;
-		l = lo;
-		do {
-			--r;
-			tmp = *l; *l = *r; *r = tmp;
-			++l;
-		} while (l < r);
-		return binarysort(lo, hi, originalr, compare);
+	else {
+		/* key <= a[hint] -- gallop left, until
+		 * a[hint - ofs] < key <= a[hint - lastofs]
+		 */
+		maxofs = hint + 1;	/* &a[0] is lowest */
+		while (ofs < maxofs) {
+			IFLT(*(a-ofs), key)
+				break;
+			/* key <= a[hint - ofs] */
+			lastofs = ofs;
+			ofs = (ofs << 1) + 1;
+			if (ofs <= 0)	/* int overflow */
+				ofs = maxofs;
+		}
+		if (ofs > maxofs)
+			ofs = maxofs;
+		/* Translate back to positive offsets relative to &a[0]. */
+		k = lastofs;
+		lastofs = hint - ofs;
+		ofs = hint - k;
+	}
+	a -= hint;
+
+	assert(-1 <= lastofs && lastofs < ofs && ofs <= n);
+	/* Now a[lastofs] < key <= a[ofs], so key belongs somewhere to the
+	 * right of lastofs but no farther right than ofs.  Do a binary
+	 * search, with invariant a[lastofs-1] < key <= a[ofs].
+	 */
+	++lastofs;
+	while (lastofs < ofs) {
+		m = lastofs + ((ofs - lastofs) >> 1);
+
+		IFLT(a[m], key)
+			lastofs = m+1;	/* a[m] < key */
+		else
+			ofs = m;	/* key <= a[m] */
 	}
+	assert(lastofs == ofs);		/* so a[ofs-1] < key <= a[ofs] */
+	return ofs;
 
-	/* ----------------------------------------------------------
-	 * Normal case setup: a large array without obvious pattern.
-	 * --------------------------------------------------------*/
+ fail:
+	return -1;
+}
 
-	/* extra := a power of 2 ~= n/ln(n), less 1.
-	   First find the smallest extra s.t. n < cutoff[extra] */
-	for (extra = 0;
-	     extra < sizeof(cutoff) / sizeof(cutoff[0]);
-	     ++extra) {
-		if (n < cutoff[extra])
-			break;
-		/* note that if we fall out of the loop, the value of
-		   extra still makes *sense*, but may be smaller than
-		   we would like (but the array has more than ~= 2**31
-		   elements in this case!) */
-	}
-	/* Now k == extra - 1 + CUTOFFBASE.  The smallest value k can
-	   have is CUTOFFBASE-1, so
-	   assert MINSIZE >= 2**(CUTOFFBASE-1) - 1 */
-	extra = (1 << (extra - 1 + CUTOFFBASE)) - 1;
-	/* assert extra > 0 and n >= extra */
-
-	/* Swap that many values to the start of the array.  The
-	   selection of elements is pseudo-random, but the same on
-	   every run (this is intentional! timing algorithm changes is
-	   a pain if timing varies across runs).  */
-	{
-		unsigned int seed = n / extra;  /* arbitrary */
-		unsigned int i;
-		for (i = 0; i < (unsigned)extra; ++i) {
-			/* j := random int in [i, n) */
-			unsigned int j;
-			seed = seed * 69069 + 7;
-			j = i + seed % (n - i);
-			tmp = lo[i]; lo[i] = lo[j]; lo[j] = tmp;
+/* Exactly like gallop_left(), except that if key already exists in
+   a[0:n], finds the position immediately to the right of the rightmost
+   equal value.
+
+   The return value is the int k in 0..n such that
+
+       a[k-1] <= key < a[k]
+
+   or -1 if error.
+
+   The code duplication is massive, but this is enough different given
+   that we're sticking to "<" comparisons that it's much harder to follow
+   if written as one routine with yet another "left or right?" flag.
+*/
+static int
+gallop_right(PyObject *key, PyObject **a, int n, int hint, PyObject *compare)
+{
+	int ofs;
+	int lastofs;
+	int k;
+	int maxofs;
+	int m;
+
+	assert(key && a && n > 0 && hint >= 0 && hint < n);
+
+	a += hint;
+	lastofs = 0;
+	ofs = 1;
+	IFLT(key, *a) {
+		/* key < a[hint] -- gallop left, until
+		 * a[hint - ofs] <= key < a[hint - lastofs]
+		 */
+		maxofs = hint + 1;	/* &a[0] is lowest */
+		while (ofs < maxofs) {
+			IFLT(key, *(a-ofs)) {
+				lastofs = ofs;
+				ofs = (ofs << 1) + 1;
+				if (ofs <= 0)	/* int overflow */
+					ofs = maxofs;
+			}
+			else	/* a[hint - ofs] <= key */
+				break;
+		}
+		if (ofs > maxofs)
+			ofs = maxofs;
+		/* Translate back to positive offsets relative to &a[0]. */
+		k = lastofs;
+		lastofs = hint - ofs;
+		ofs = hint - k;
+	}
+	else {
+		/* a[hint] <= key -- gallop right, until
+		 * a[hint + lastofs] <= key < a[hint + ofs]
+		*/
+		maxofs = n - hint;	/* &a[n-1] is highest */
+		while (ofs < maxofs) {
+			IFLT(key, a[ofs])
+				break;
+			/* a[hint + ofs] <= key */
+			lastofs = ofs;
+			ofs = (ofs << 1) + 1;
+			if (ofs <= 0)	/* int overflow */
+				ofs = maxofs;
 		}
+		if (ofs > maxofs)
+			ofs = maxofs;
+		/* Translate back to offsets relative to &a[0]. */
+		lastofs += hint;
+		ofs += hint;
+	}
+	a -= hint;
+
+	assert(-1 <= lastofs && lastofs < ofs && ofs <= n);
+	/* Now a[lastofs] <= key < a[ofs], so key belongs somewhere to the
+	 * right of lastofs but no farther right than ofs.  Do a binary
+	 * search, with invariant a[lastofs-1] <= key < a[ofs].
+	 */
+	++lastofs;
+	while (lastofs < ofs) {
+		m = lastofs + ((ofs - lastofs) >> 1);
+
+		IFLT(key, a[m])
+			ofs = m;	/* key < a[m] */
+		else
+			lastofs = m+1;	/* a[m] <= key */
 	}
+	assert(lastofs == ofs);		/* so a[ofs-1] <= key < a[ofs] */
+	return ofs;
+
+ fail:
+	return -1;
+}
 
-	/* Recursively sort the preselected pivots. */
-	if (samplesortslice(lo, lo + extra, compare) < 0)
-		goto fail;
+/* The maximum number of entries in a MergeState's pending-runs stack.
+   This is enough to sort arrays of size up to about
+       32 * phi ** MAX_MERGE_PENDING
+   where phi ~= 1.618.  85 is large enough for an array
+   with 2**64 elements.
+*/
+#define MAX_MERGE_PENDING 85
+
+/* When we get into galloping mode, we stay there until both runs win
+   less often than MIN_GALLOP consecutive times.
+*/
+#define MIN_GALLOP 7
 
-	top = 0;          /* index of available stack slot */
-	lo += extra;      /* point to first unknown */
-	extraOnRight = 0; /* the PPs are at the left end */
+/* Avoid malloc for small temp arrays. */
+#define MERGESTATE_TEMP_SIZE 256
 
-	/* ----------------------------------------------------------
-	 * Partition [lo, hi), and repeat until out of work.
-	 * --------------------------------------------------------*/
+/* One MergeState exists on the stack per invocation of listsort(). */
+typedef struct s_MergeState {
+	/* The user-supplied comparison function, or NULL if none given. */
+	PyObject *compare;
+
+	/* This controls when we get *into* galloping mode.  It's
+	 * initialized to MIN_GALLOP.  merge_lo and merge_hi tend to nudge
+	 * it higher for random data, and lower for highly structured data.
+	 */
+	int min_gallop;
+
+	/* 'a' is temp storage to help with merges.  It contains room for
+	 * alloced entries.
+	 */
+	sortslice a;
+	int alloced;
+
+	/* A stack of n pending runs yet to be merged.  Run #i starts at
+	 * address base[i] and extends for len[i] elements.  It's always
+	 * true (so long as the indices are in bounds) that
+	 *
+	 *     pending[i].base + pending[i].len == pending[i+1].base
+	 *
+	 * so we could cut the storage for this, but it's a minor amount,
+	 * and keeping all the info explicit simplifies the code.
+	 */
+	int n;
+	struct {
+		sortslice base;
+		int len;
+	} pending[MAX_MERGE_PENDING];
+
+	/* 'a' points to this when possible, rather than muck with malloc. */
+	PyObject *temparray[MERGESTATE_TEMP_SIZE];
+} MergeState;
+
+/* Conceptually a MergeState's constructor. */
+static void
+merge_init(MergeState *ms, PyObject *compare, int has_keyfunc)
+{
+	assert(ms != NULL);
+	ms->compare = compare;
+	ms->a.keys = ms->temparray;
+	if (has_keyfunc) {
+		/* Values need as much temp space as keys. */
+		ms->alloced = MERGESTATE_TEMP_SIZE / 2;
+		ms->a.values = &ms->temparray[ms->alloced];
+	}
+	else {
+		ms->alloced = MERGESTATE_TEMP_SIZE;
+		ms->a.values = NULL;
+	}
+	ms->n = 0;
+	ms->min_gallop = MIN_GALLOP;
+}
+
+/* Free all the temp memory owned by the MergeState.  This must be called
+   when you're done with a MergeState, and may be called before then if
+   you want to free the temp memory early.
+*/
+static void
+merge_freemem(MergeState *ms)
+{
+	assert(ms != NULL);
+	if (ms->a.keys != ms->temparray)
+		PyMem_Free(ms->a.keys);
+	ms->a.keys = ms->temparray;
+}
+
+/* Ensure enough temp memory for 'need' array slots is available.
+   Returns 0 on success and -1 if the memory can't be gotten.
+*/
+static int
+merge_getmem(MergeState *ms, int need)
+{
+	int multiplier;
+
+	assert(ms != NULL);
+	if (need <= ms->alloced)
+		return 0;
+	multiplier = ms->a.values != NULL ? 2 : 1;
+	/* Don't realloc!  That can cost cycles to copy the old data, but
+	 * we don't care what's in the block.
+	 */
+	merge_freemem(ms);
+	if ((size_t)need > INT_MAX / sizeof(PyObject *) / multiplier) {
+		PyErr_NoMemory();
+		return -1;
+	}
+	ms->a.keys = (PyObject **)PyMem_Malloc(multiplier * need *
+					       sizeof(PyObject *));
+	if (ms->a.keys == NULL) {
+		ms->a.keys = ms->temparray;
+		PyErr_NoMemory();
+		return -1;
+	}
+	ms->alloced = need;
+	if (ms->a.values != NULL)
+		ms->a.values = &ms->a.keys[need];
+	return 0;
+}
+#define MERGE_GETMEM(MS, NEED) ((NEED) <= (MS)->alloced ? 0 :	\
+				merge_getmem(MS, NEED))
+
+/* Merge the na elements starting at ssa with the nb elements starting at
+   ssb.keys = ssa.keys + na in a stable way, in-place.  na and nb must be
+   > 0.  Must also have that ssa.keys[na-1] belongs at the end of the
+   merge, and should have na <= nb.
+   Return 0 if successful, -1 if error.
+*/
+static int
+merge_lo(MergeState *ms, sortslice ssa, int na, sortslice ssb, int nb)
+{
+	int k;
+	PyObject *compare = ms->compare;
+	sortslice dest;
+	int result = -1;	/* guilty until proved innocent */
+	int min_gallop;
+	int acount, bcount;
+
+	assert(ms && ssa.keys && ssb.keys && na > 0 && nb > 0);
+	assert(ssa.keys + na == ssb.keys);
+	if (MERGE_GETMEM(ms, na) < 0)
+		return -1;
+	sortslice_memcpy(&ms->a, 0, &ssa, 0, na);
+	dest = ssa;
+	ssa = ms->a;
+
+	sortslice_copy_incr(&dest, &ssb);
+	--nb;
+	if (nb == 0)
+		goto Succeed;
+	if (na == 1)
+		goto CopyB;
+
+	min_gallop = ms->min_gallop;
 	for (;;) {
-		/* assert lo <= hi, so n >= 0 */
-		n = hi - lo;
+		acount = 0;	/* # of times A won in a row */
+		bcount = 0;	/* # of times B won in a row */
 
-		/* We may not want, or may not be able, to partition:
-		   If n is small, it's quicker to insert.
-		   If extra is 0, we're out of pivots, and *must* use
-		   another method.
-		*/
-		if (n < MINPARTITIONSIZE || extra == 0) {
-			if (n >= MINSIZE) {
-				/* assert extra == 0
-				   This is rare, since the average size
-				   of a final block is only about
-				   ln(original n). */
-				if (samplesortslice(lo, hi, compare) < 0)
-					goto fail;
+		/* Do the straightforward thing until (if ever) one run
+		 * appears to win consistently.
+		 */
+		for (;;) {
+			assert(na > 1 && nb > 0);
+			k = ISLT(ssb.keys[0], ssa.keys[0]);
+			if (k) {
+				if (k < 0)
+					goto Fail;
+				sortslice_copy_incr(&dest, &ssb);
+				++bcount;
+				acount = 0;
+				--nb;
+				if (nb == 0)
+					goto Succeed;
+				if (bcount >= min_gallop)
+					break;
 			}
 			else {
-				/* Binary insertion should be quicker,
-				   and we can take advantage of the PPs
-				   already being sorted. */
-				if (extraOnRight && extra) {
-					/* swap the PPs to the left end */
-					k = extra;
-					do {
-						tmp = *lo;
-						*lo = *hi;
-						*hi = tmp;
-						++lo; ++hi;
-					} while (--k);
-				}
-				if (binarysort(lo - extra, hi, lo,
-					       compare) < 0)
-					goto fail;
-			}
-
-			/* Find another slice to work on. */
-			if (--top < 0)
-				break;   /* no more -- done! */
-			lo = stack[top].lo;
-			hi = stack[top].hi;
-			extra = stack[top].extra;
-			extraOnRight = 0;
-			if (extra < 0) {
-				extraOnRight = 1;
-				extra = -extra;
+				sortslice_copy_incr(&dest, &ssa);
+				++acount;
+				bcount = 0;
+				--na;
+				if (na == 1)
+					goto CopyB;
+				if (acount >= min_gallop)
+					break;
 			}
-			continue;
 		}
 
-		/* Pretend the PPs are indexed 0, 1, ..., extra-1.
-		   Then our preselected pivot is at (extra-1)/2, and we
-		   want to move the PPs before that to the left end of
-		   the slice, and the PPs after that to the right end.
-		   The following section changes extra, lo, hi, and the
-		   slice such that:
-		   [lo-extra, lo) contains the smaller PPs.
-		   *lo == our PP.
-		   (lo, hi) contains the unknown elements.
-		   [hi, hi+extra) contains the larger PPs.
-		*/
-		k = extra >>= 1;  /* num PPs to move */
-		if (extraOnRight) {
-			/* Swap the smaller PPs to the left end.
-			   Note that this loop actually moves k+1 items:
-			   the last is our PP */
-			do {
-				tmp = *lo; *lo = *hi; *hi = tmp;
-				++lo; ++hi;
-			} while (k--);
-		}
-		else {
-			/* Swap the larger PPs to the right end. */
-			while (k--) {
-				--lo; --hi;
-				tmp = *lo; *lo = *hi; *hi = tmp;
+		/* One run is winning so consistently that galloping may
+		 * be a huge win.  So try that, and continue galloping until
+		 * (if ever) neither run appears to be winning consistently
+		 * anymore.
+		 */
+		++min_gallop;
+		do {
+			assert(na > 1 && nb > 0);
+			min_gallop -= min_gallop > 1;
+			ms->min_gallop = min_gallop;
+			k = gallop_right(ssb.keys[0], ssa.keys, na, 0, compare);
+			acount = k;
+			if (k) {
+				if (k < 0)
+					goto Fail;
+				sortslice_memcpy(&dest, 0, &ssa, 0, k);
+				sortslice_advance(&dest, k);
+				sortslice_advance(&ssa, k);
+				na -= k;
+				if (na == 1)
+					goto CopyB;
+				/* na==0 is impossible now if the comparison
+				 * function is consistent, but we can't assume
+				 * that it is.
+				 */
+				if (na == 0)
+					goto Succeed;
 			}
-		}
-		--lo;   /* *lo is now our PP */
-		pivot = *lo;
-
-		/* Now an almost-ordinary quicksort partition step.
-		   Note that most of the time is spent here!
-		   Only odd thing is that we partition into < and >=,
-		   instead of the usual <= and >=.  This helps when
-		   there are lots of duplicates of different values,
-		   because it eventually tends to make subfiles
-		   "pure" (all duplicates), and we special-case for
-		   duplicates later. */
-		l = lo + 1;
-		r = hi - 1;
-		/* assert lo < l < r < hi (small n weeded out above) */
+			sortslice_copy_incr(&dest, &ssb);
+			--nb;
+			if (nb == 0)
+				goto Succeed;
+
+			k = gallop_left(ssa.keys[0], ssb.keys, nb, 0, compare);
+			bcount = k;
+			if (k) {
+				if (k < 0)
+					goto Fail;
+				sortslice_memmove(&dest, 0, &ssb, 0, k);
+				sortslice_advance(&dest, k);
+				sortslice_advance(&ssb, k);
+				nb -= k;
+				if (nb == 0)
+					goto Succeed;
+			}
+			sortslice_copy_incr(&dest, &ssa);
+			--na;
+			if (na == 1)
+				goto CopyB;
+		} while (acount >= MIN_GALLOP || bcount >= MIN_GALLOP);
+		++min_gallop;	/* penalize it for leaving galloping mode */
+		ms->min_gallop = min_gallop;
+	}
+ Succeed:
+	result = 0;
+ Fail:
+	if (na)
+		sortslice_memcpy(&dest, 0, &ssa, 0, na);
+	return result;
+ CopyB:
+	assert(na == 1 && nb > 0);
+	/* The last element of ssa belongs at the end of the merge. */
+	sortslice_memmove(&dest, 0, &ssb, 0, nb);
+	sortslice_copy(&dest, nb, &ssa, 0);
+	return 0;
+}
 
-		do {
-			/* slide l right, looking for key >= pivot */
-			do {
-				SETK(*l, pivot);
+/* Merge the na elements starting at ssa with the nb elements starting at
+   ssb.keys = ssa.keys + na in a stable way, in-place.  na and nb must be
+   > 0.  Must also have that ssa.keys[na-1] belongs at the end of the
+   merge, and should have na >= nb.
+   Return 0 if successful, -1 if error.
+*/
+static int
+merge_hi(MergeState *ms, sortslice ssa, int na, sortslice ssb, int nb)
+{
+	int k;
+	PyObject *compare = ms->compare;
+	sortslice dest, basea, baseb;
+	int result = -1;	/* guilty until proved innocent */
+	int min_gallop;
+	int acount, bcount;
+
+	assert(ms && ssa.keys && ssb.keys && na > 0 && nb > 0);
+	assert(ssa.keys + na == ssb.keys);
+	if (MERGE_GETMEM(ms, nb) < 0)
+		return -1;
+	dest = ssb;
+	sortslice_advance(&dest, nb-1);
+	sortslice_memcpy(&ms->a, 0, &ssb, 0, nb);
+	basea = ssa;
+	baseb = ms->a;
+	ssb.keys = ms->a.keys + nb - 1;
+	if (ssb.values != NULL)
+		ssb.values = ms->a.values + nb - 1;
+	sortslice_advance(&ssa, na - 1);
+
+	sortslice_copy_decr(&dest, &ssa);
+	--na;
+	if (na == 0)
+		goto Succeed;
+	if (nb == 1)
+		goto CopyA;
+
+	min_gallop = ms->min_gallop;
+	for (;;) {
+		acount = 0;	/* # of times A won in a row */
+		bcount = 0;	/* # of times B won in a row */
+
+		/* Do the straightforward thing until (if ever) one run
+		 * appears to win consistently.
+		 */
+		for (;;) {
+			assert(na > 0 && nb > 1);
+			k = ISLT(ssb.keys[0], ssa.keys[0]);
+			if (k) {
 				if (k < 0)
-					++l;
-				else
+					goto Fail;
+				sortslice_copy_decr(&dest, &ssa);
+				++acount;
+				bcount = 0;
+				--na;
+				if (na == 0)
+					goto Succeed;
+				if (acount >= min_gallop)
 					break;
-			} while (l < r);
-
-			/* slide r left, looking for key < pivot */
-			while (l < r) {
-				register PyObject *rval = *r--;
-				SETK(rval, pivot);
-				if (k < 0) {
-					/* swap and advance */
-					r[1] = *l;
-					*l++ = rval;
+			}
+			else {
+				sortslice_copy_decr(&dest, &ssb);
+				++bcount;
+				acount = 0;
+				--nb;
+				if (nb == 1)
+					goto CopyA;
+				if (bcount >= min_gallop)
 					break;
-				}
 			}
+		}
 
-		} while (l < r);
-
-		/* assert lo < r <= l < hi
-		   assert r == l or r+1 == l
-		   everything to the left of l is < pivot, and
-		   everything to the right of r is >= pivot */
-
-		if (l == r) {
-			SETK(*r, pivot);
+		/* One run is winning so consistently that galloping may
+		 * be a huge win.  So try that, and continue galloping until
+		 * (if ever) neither run appears to be winning consistently
+		 * anymore.
+		 */
+		++min_gallop;
+		do {
+			assert(na > 0 && nb > 1);
+			min_gallop -= min_gallop > 1;
+			ms->min_gallop = min_gallop;
+			k = gallop_right(ssb.keys[0], basea.keys, na, na-1,
+					 compare);
 			if (k < 0)
-				++l;
-			else
-				--r;
-		}
-		/* assert lo <= r and r+1 == l and l <= hi
-		   assert r == lo or a[r] < pivot
-		   assert a[lo] is pivot
-		   assert l == hi or a[l] >= pivot
-		   Swap the pivot into "the middle", so we can henceforth
-		   ignore it.
-		*/
-		*lo = *r;
-		*r = pivot;
-
-		/* The following is true now, & will be preserved:
-		   All in [lo,r) are < pivot
-		   All in [r,l) == pivot (& so can be ignored)
-		   All in [l,hi) are >= pivot */
-
-		/* Check for duplicates of the pivot.  One compare is
-		   wasted if there are no duplicates, but can win big
-		   when there are.
-		   Tricky: we're sticking to "<" compares, so deduce
-		   equality indirectly.  We know pivot <= *l, so they're
-		   equal iff not pivot < *l.
-		*/
-		while (l < hi) {
-			/* pivot <= *l known */
-			SETK(pivot, *l);
+				goto Fail;
+			k = na - k;
+			acount = k;
+			if (k) {
+				sortslice_advance(&dest, -k);
+				sortslice_advance(&ssa, -k);
+				sortslice_memmove(&dest, 1, &ssa, 1, k);
+				na -= k;
+				if (na == 0)
+					goto Succeed;
+			}
+			sortslice_copy_decr(&dest, &ssb);
+			--nb;
+			if (nb == 1)
+				goto CopyA;
+
+			k = gallop_left(ssa.keys[0], baseb.keys, nb, nb-1,
+					compare);
 			if (k < 0)
-				break;
-			else
-				/* <= and not < implies == */
-				++l;
-		}
+				goto Fail;
+			k = nb - k;
+			bcount = k;
+			if (k) {
+				sortslice_advance(&dest, -k);
+				sortslice_advance(&ssb, -k);
+				sortslice_memcpy(&dest, 1, &ssb, 1, k);
+				nb -= k;
+				if (nb == 1)
+					goto CopyA;
+				/* nb==0 is impossible now if the comparison
+				 * function is consistent, but we can't assume
+				 * that it is.
+				 */
+				if (nb == 0)
+					goto Succeed;
+			}
+			sortslice_copy_decr(&dest, &ssa);
+			--na;
+			if (na == 0)
+				goto Succeed;
+		} while (acount >= MIN_GALLOP || bcount >= MIN_GALLOP);
+		++min_gallop;	/* penalize it for leaving galloping mode */
+		ms->min_gallop = min_gallop;
+	}
+ Succeed:
+	result = 0;
+ Fail:
+	if (nb)
+		sortslice_memcpy(&dest, -(nb-1), &baseb, 0, nb);
+	return result;
+ CopyA:
+	assert(nb == 1 && na > 0);
+	/* The first element of ssb belongs at the front of the merge. */
+	sortslice_memmove(&dest, 1-na, &ssa, 1-na, na);
+	sortslice_advance(&dest, -na);
+	sortslice_advance(&ssa, -na);
+	sortslice_copy(&dest, 0, &ssb, 0);
+	return 0;
+}
+
+/* Merge the two runs at stack indices i and i+1.
+   Returns 0 on success, -1 on error.
+*/
+static int
+merge_at(MergeState *ms, int i)
+{
+	sortslice ssa, ssb;
+	int na, nb;
+	int k;
+	PyObject *compare;
+
+	assert(ms != NULL);
+	assert(ms->n >= 2);
+	assert(i >= 0);
+	assert(i == ms->n - 2 || i == ms->n - 3);
+
+	ssa = ms->pending[i].base;
+	na = ms->pending[i].len;
+	ssb = ms->pending[i+1].base;
+	nb = ms->pending[i+1].len;
+	assert(na > 0 && nb > 0);
+	assert(ssa.keys + na == ssb.keys);
+
+	/* Record the length of the combined runs; if i is the 3rd-last
+	 * run now, also slide over the last run (which isn't involved
+	 * in this merge).  The current run i+1 goes away in any case.
+	 */
+	ms->pending[i].len = na + nb;
+	if (i == ms->n - 3)
+		ms->pending[i+1] = ms->pending[i+2];
+	--ms->n;
+
+	/* Where does b start in a?  Elements in a before that can be
+	 * ignored (already in place).
+	 */
+	compare = ms->compare;
+	k = gallop_right(*ssb.keys, ssa.keys, na, 0, compare);
+	if (k < 0)
+		return -1;
+	sortslice_advance(&ssa, k);
+	na -= k;
+	if (na == 0)
+		return 0;
+
+	/* Where does a end in b?  Elements in b after that can be
+	 * ignored (already in place).
+	 */
+	nb = gallop_left(ssa.keys[na-1], ssb.keys, nb, nb-1, compare);
+	if (nb <= 0)
+		return nb;
 
-		/* assert lo <= r < l <= hi
-		   Partitions are [lo, r) and [l, hi) */
-
-		/* push fattest first; remember we still have extra PPs
-		   to the left of the left chunk and to the right of
-		   the right chunk! */
-		/* assert top < STACKSIZE */
-		if (r - lo <= hi - l) {
-			/* second is bigger */
-			stack[top].lo = l;
-			stack[top].hi = hi;
-			stack[top].extra = -extra;
-			hi = r;
-			extraOnRight = 0;
+	/* Merge what remains of the runs, using a temp array with
+	 * min(na, nb) elements.
+	 */
+	if (na <= nb)
+		return merge_lo(ms, ssa, na, ssb, nb);
+	else
+		return merge_hi(ms, ssa, na, ssb, nb);
+}
+
+/* Examine the stack of runs waiting to be merged, merging adjacent runs
+   until the stack invariants are re-established:
+
+   1. len[-3] > len[-2] + len[-1]
+   2. len[-2] > len[-1]
+
+   The first condition is also checked one level deeper, which is what
+   keeps the invariants true for the whole stack and not just its top.
+
+   Returns 0 on success, -1 on error.
+*/
+static int
+merge_collapse(MergeState *ms)
+{
+	int n;
+
+	assert(ms);
+	while (ms->n > 1) {
+		n = ms->n - 2;
+		if ((n > 0 && ms->pending[n-1].len <=
+			      ms->pending[n].len + ms->pending[n+1].len) ||
+		    (n > 1 && ms->pending[n-2].len <=
+			      ms->pending[n-1].len + ms->pending[n].len)) {
+			if (ms->pending[n-1].len < ms->pending[n+1].len)
+				--n;
+			if (merge_at(ms, n) < 0)
+				return -1;
 		}
-		else {
-			/* first is bigger */
-			stack[top].lo = lo;
-			stack[top].hi = r;
-			stack[top].extra = extra;
-			lo = l;
-			extraOnRight = 1;
+		else if (ms->pending[n].len <= ms->pending[n+1].len) {
+			if (merge_at(ms, n) < 0)
+				return -1;
 		}
-		++top;
+		else
+			break;
+	}
+	return 0;
+}
 
-	}   /* end of partitioning loop */
+/* Regardless of invariants, merge all runs on the stack until only one
+   remains.  This is used at the end of the mergesort.
 
-	return 0;
+   Returns 0 on success, -1 on error.
+*/
+static int
+merge_force_collapse(MergeState *ms)
+{
+	int n;
 
- fail:
-	return -1;
+	assert(ms);
+	while (ms->n > 1) {
+		n = ms->n - 2;
+		if (n > 0 && ms->pending[n-1].len < ms->pending[n+1].len)
+			--n;
+		if (merge_at(ms, n) < 0)
+			return -1;
+	}
+	return 0;
 }
 
-#undef SETK
+/* Compute a good value for the minimum run length; natural runs shorter
+   than this are boosted artificially via binary insertion.
+
+   If n < 64, return n (it's too small to bother with fancy stuff).
+   Else if n is an exact power of 2, return 32.
+   Else return an int k, 32 <= k <= 64, such that n/k is close to, but
+   strictly less than, an exact power of 2.
+*/
+static int
+merge_compute_minrun(int n)
+{
+	int r = 0;	/* becomes 1 if any 1 bits are shifted off */
+
+	assert(n >= 0);
+	while (n >= 64) {
+		r |= n & 1;
+		n >>= 1;
+	}
+	return n + r;
+}
 
 #ifndef SYMBIAN
 staticforward PyTypeObject immutable_list_type;
 #endif
 
+/* An adaptive, stable, natural mergesort (see the comment above islt()).
+   Returns Py_None on success, NULL on error.  Even in case of error, the
+   list will be some permutation of its input state (nothing is lost or
+   duplicated).
+*/
 static PyObject *
-listsort(PyListObject *self, PyObject *args)
+listsort(PyListObject *self, PyObject *args, PyObject *kwds)
 {
-	int err;
+	MergeState ms;
+	int nremaining;
+	int minrun;
+	int n, descending, force, i;
+	sortslice lo;
+	PyObject **keys = NULL;
 	PyObject *compare = NULL;
+	PyObject *keyfunc = NULL;
+	PyObject *result = NULL;	/* guilty until proved innocent */
 	PyTypeObject *savetype;
+	static const char *const kwlist[] = {"cmp", "key", 0};
 
 	if (args != NULL) {
-		if (!PyArg_ParseTuple(args, "|O:sort", &compare))
+		if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OO:sort",
+						 kwlist, &compare, &keyfunc))
 			return NULL;
 	}
+	if (compare == Py_None)
+		compare = NULL;
+	if (keyfunc == Py_None)
+		keyfunc = NULL;
+
+	/* The list is immutable during the sort: see immutable_list_type.
+	 * That includes the calls to the key function.
+	 */
 	savetype = self->ob_type;
 	self->ob_type = &immutable_list_type;
-	err = samplesortslice(self->ob_item,
-			      self->ob_item + self->ob_size,
-			      compare);
+	nremaining = self->ob_size;
+
+	lo.keys = self->ob_item;
+	lo.values = NULL;
+	if (keyfunc != NULL && nremaining > 0) {
+		/* Call the key function once per element; the keys are
+		 * sorted and every move is mirrored on the items.
+		 */
+		if ((size_t)nremaining > INT_MAX / sizeof(PyObject *)) {
+			PyErr_NoMemory();
+			goto fail;
+		}
+		keys = (PyObject **)PyMem_Malloc(nremaining *
+						 sizeof(PyObject *));
+		if (keys == NULL) {
+			PyErr_NoMemory();
+			goto fail;
+		}
+		for (i = 0; i < nremaining; i++) {
+			keys[i] = PyObject_CallFunctionObjArgs(keyfunc,
+						self->ob_item[i], NULL);
+			if (keys[i] == NULL) {
+				while (--i >= 0)
+					Py_DECREF(keys[i]);
+				PyMem_Free(keys);
+				keys = NULL;
+				goto fail;
+			}
+		}
+		lo.keys = keys;
+		lo.values = self->ob_item;
+	}
+
+	merge_init(&ms, compare, keys != NULL);
+	if (nremaining < 2)
+		goto succeed;
+
+	/* March over the array once, left to right, finding natural runs,
+	 * and extending short natural runs to minrun elements.
+	 */
+	minrun = merge_compute_minrun(nremaining);
+	do {
+		/* Identify next run. */
+		n = count_run(lo.keys, lo.keys + nremaining, compare,
+			      &descending);
+		if (n < 0)
+			goto fail_ms;
+		if (descending)
+			reverse_sortslice(&lo, n);
+		/* If short, extend to min(minrun, nremaining). */
+		if (n < minrun) {
+			force = nremaining <= minrun ? nremaining : minrun;
+			if (binarysort(lo, lo.keys + force, lo.keys + n,
+				       compare) < 0)
+				goto fail_ms;
+			n = force;
+		}
+		/* Push run onto pending-runs stack, and maybe merge. */
+		assert(ms.n < MAX_MERGE_PENDING);
+		ms.pending[ms.n].base = lo;
+		ms.pending[ms.n].len = n;
+		++ms.n;
+		if (merge_collapse(&ms) < 0)
+			goto fail_ms;
+		/* Advance to find next run. */
+		sortslice_advance(&lo, n);
+		nremaining -= n;
+	} while (nremaining);
+
+	if (merge_force_collapse(&ms) < 0)
+		goto fail_ms;
+	assert(ms.n == 1);
+	assert(keys == NULL
+	       ? ms.pending[0].base.keys == self->ob_item
+	       : ms.pending[0].base.keys == keys);
+	assert(ms.pending[0].len == self->ob_size);
+
+ succeed:
+	result = Py_None;
+ fail_ms:
+	merge_freemem(&ms);
+ fail:
+	if (keys != NULL) {
+		for (i = 0; i < self->ob_size; i++)
+			Py_DECREF(keys[i]);
+		PyMem_Free(keys);
+	}
 	self->ob_type = savetype;
-	if (err < 0)
-		return NULL;
-	Py_INCREF(Py_None);
-	return Py_None;
+	Py_XINCREF(result);
+	return result;
 }
 
+#undef IFLT
+#undef ISLT
+
 DL_EXPORT(int)
 PyList_Sort(PyObject *v)
 {
@@ -1329,7 +1957,7 @@ PyList_Sort(PyObject *v)
 		PyErr_BadInternalCall();
 		return -1;
 	}
-	v = listsort((PyListObject *)v, (PyObject *)NULL);
+	v = listsort((PyListObject *)v, (PyObject *)NULL, (PyObject *)NULL);
 	if (v == NULL)
 		return -1;
 	Py_DECREF(v);
@@ -1710,19 +2338,22 @@ const static char sort_doc[] =
 #ifdef SYMBIAN
 "";
 #else
-"L.sort([cmpfunc]) -- sort *IN PLACE*; if given, cmpfunc(x, y) -> -1, 0, 1";
+"L.sort(cmp=None, key=None) -- stable sort *IN PLACE*;\n\
+cmp(x, y) -> -1, 0, 1; key(item) is called once per item and the\n\
+items are ordered by the keys it returns";
 #endif
 
 const static PyMethodDef list_methods[] = {
 	{"append",	(PyCFunction)listappend,  METH_O, append_doc},
-	{"insert",	(PyCFunction)listinsert,  METH_VARARGS, insert_doc},
+	{"insert",	(PyCFunction)listinsert,  METH_FASTCALL, insert_doc},
 	{"extend",      (PyCFunction)listextend,  METH_O, extend_doc},
-	{"pop",		(PyCFunction)listpop, 	  METH_VARARGS, pop_doc},
+	{"pop",		(PyCFunction)listpop, 	  METH_FASTCALL, pop_doc},
 	{"remove",	(PyCFunction)listremove,  METH_O, remove_doc},
 	{"index",	(PyCFunction)listindex,   METH_O, index_doc},
 	{"count",	(PyCFunction)listcount,   METH_O, count_doc},
 	{"reverse",	(PyCFunction)listreverse, METH_NOARGS, reverse_doc},
-	{"sort",	(PyCFunction)listsort, 	  METH_VARARGS, sort_doc},
+	{"sort",	(PyCFunction)listsort, 	  METH_VARARGS | METH_KEYWORDS,
+	 sort_doc},
 	{NULL,		NULL}		/* sentinel */
 };
 
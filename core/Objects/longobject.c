@@ -10,6 +10,22 @@
 #include <ctype.h>
 
 #define ABS(x) ((x) < 0 ? -(x) : (x))
+#define MAX(x, y) ((x) < (y) ? (y) : (x))
+#define MIN(x, y) ((x) > (y) ? (y) : (x))
+
+/* For long multiplication, use the O(N**2) school algorithm unless
+ * both operands contain more than KARATSUBA_CUTOFF digits (this
+ * being an internal Python long digit, in base BASE).
+ */
+#define KARATSUBA_CUTOFF 40
+#define KARATSUBA_SQUARE_CUTOFF (2 * KARATSUBA_CUTOFF)
+
+/* str() of longs with more than FORMAT_CUTOFF digits, and long() of
+ * strings of more than PARSE_CUTOFF characters, divide and conquer (see
+ * "Base conversion of big numbers" below).
+ */
+#define FORMAT_CUTOFF 40
+#define PARSE_CUTOFF 600
 
 /* Forward */
 static PyLongObject *long_normalize(PyLongObject *);
@@ -17,6 +33,8 @@ static PyLongObject *mul1(PyLongObject *, wdigit);
 static PyLongObject *muladd1(PyLongObject *, wdigit, wdigit);
 static PyLongObject *divrem1(PyLongObject *, digit, digit *);
 static PyObject *long_format(PyObject *aa, int base, int addL);
+static char *long_format_dc(PyLongObject *a, int base, char *p);
+static PyLongObject *long_from_digits_big(char *s, int len, int base);
 
 #ifndef SYMBIAN
 static int ticker;	/* XXX Could be shared with ceval? */
@@ -832,6 +850,66 @@ divrem1(PyLongObject *a, digit n, digit *prem)
 	return long_normalize(z);
 }
 
+/* Return the largest power of 'base' that fits in a digit, and set
+   *pexp to its exponent. */
+
+static digit
+base_powbase(int base, int *pexp)
+{
+	digit powbase = base;  /* powbase == base ** power */
+	int power = 1;
+	for (;;) {
+		unsigned long newpow = powbase * (unsigned long)base;
+		if (newpow >> SHIFT)  /* doesn't fit in a digit */
+			break;
+		powbase = (digit)newpow;
+		++power;
+	}
+	*pexp = power;
+	return powbase;
+}
+
+/* Store the base-'base' digits (base not a power of 2) of the size > 0
+   digit number at pin so that the last one ends just before p, and
+   return the start of the string, or NULL if interrupted.  scratch has
+   room for size digits and may be pin itself. */
+
+static char *
+format_digits(digit *pin, digit *scratch, int size, int base, char *p)
+{
+	/* Divide repeatedly by base, but for speed use the highest
+	   power of base that fits in a digit. */
+	int power;
+	digit powbase = base_powbase(base, &power);
+
+	assert(size > 0);
+	do {
+		int ntostore = power;
+		digit rem = inplace_divrem1(scratch, pin, size, powbase);
+		pin = scratch; /* no need to use the input again */
+		if (pin[size - 1] == 0)
+			--size;
+		SIGCHECK({
+			return NULL;
+		})
+
+		/* Break rem into digits. */
+		assert(ntostore > 0);
+		do {
+			digit nextrem = (digit)(rem / base);
+			char c = (char)(rem - nextrem * base);
+			c += (c < 10) ? '0' : 'A'-10;
+			*--p = c;
+			rem = nextrem;
+			--ntostore;
+			/* Termination is a bit delicate:  must not
+			   store leading zeroes, so must get out if
+			   remaining quotient and rem are both 0. */
+		} while (ntostore && (size || rem));
+	} while (size != 0);
+	return p;
+}
+
 /* Convert a long int object to a string, using a given conversion base.
    Return a string object.
    If base is 8 or 16, add the proper prefix '0' or '0x'. */
@@ -898,61 +976,27 @@ long_format(PyObject *aa, int base, int addL)
 					 	accum > 0);
 		}
 	}
-	else {
-		/* Not 0, and base not a power of 2.  Divide repeatedly by
-		   base, but for speed use the highest power of base that
-		   fits in a digit. */
-		int size = size_a;
-		digit *pin = a->ob_digit;
-		PyLongObject *scratch;
-		/* powbasw <- largest power of base that fits in a digit. */
-		digit powbase = base;  /* powbase == base ** power */
-		int power = 1;
-		for (;;) {
-			unsigned long newpow = powbase * (unsigned long)base;
-			if (newpow >> SHIFT)  /* doesn't fit in a digit */
-				break;
-			powbase = (digit)newpow;
-			++power;
+	else if (size_a > FORMAT_CUTOFF) {
+		p = long_format_dc(a, base, p);
+		if (p == NULL) {
+			Py_DECREF(str);
+			return NULL;
 		}
-
-		/* Get a scratch area for repeated division. */
-		scratch = _PyLong_New(size);
+	}
+	else {
+		/* Not 0, and base not a power of 2. */
+		PyLongObject *scratch = _PyLong_New(size_a);
 		if (scratch == NULL) {
 			Py_DECREF(str);
 			return NULL;
 		}
-
-		/* Repeatedly divide by powbase. */
-		do {
-			int ntostore = power;
-			digit rem = inplace_divrem1(scratch->ob_digit,
-						     pin, size, powbase);
-			pin = scratch->ob_digit; /* no need to use a again */
-			if (pin[size - 1] == 0)
-				--size;
-			SIGCHECK({
-				Py_DECREF(scratch);
-				Py_DECREF(str);
-				return NULL;
-			})
-
-			/* Break rem into digits. */
-			assert(ntostore > 0);
-			do {
-				digit nextrem = (digit)(rem / base);
-				char c = (char)(rem - nextrem * base);
-				assert(p > PyString_AS_STRING(str));
-				c += (c < 10) ? '0' : 'A'-10;
-				*--p = c;
-				rem = nextrem;
-				--ntostore;
-				/* Termination is a bit delicate:  must not
-				   store leading zeroes, so must get out if
-				   remaining quotient and rem are both 0. */
-			} while (ntostore && (size || rem));
-		} while (size != 0);
+		p = format_digits(a->ob_digit, scratch->ob_digit, size_a,
+				  base, p);
 		Py_DECREF(scratch);
+		if (p == NULL) {
+			Py_DECREF(str);
+			return NULL;
+		}
 	}
 
 	if (base == 8) {
@@ -983,6 +1027,129 @@ long_format(PyObject *aa, int base, int addL)
 	return (PyObject *)str;
 }
 
+/* Return the value of the digit character c in bases up to 36, or -1. */
+
+static int
+digit_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'z')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/* Convert the digits at *str in a power-of-2 base, and set *str to the
+   first character that is not a digit.  Each digit fills a fixed number
+   of bits, so this takes linear time. */
+
+static PyLongObject *
+long_from_binary_base(char **str, int base)
+{
+	char *p = *str;
+	char *start = p;
+	int bits_per_char;
+	int n, k;
+	PyLongObject *z;
+	twodigits accum;
+	int bits_in_accum;
+	digit *pdigit;
+
+	assert(base >= 2 && base <= 32 && (base & (base - 1)) == 0);
+	n = base;
+	for (bits_per_char = -1; n; ++bits_per_char)
+		n >>= 1;
+	while ((k = digit_value(*p)) >= 0 && k < base)
+		++p;
+	*str = p;
+	n = (p - start) * bits_per_char;
+	if (n / bits_per_char != p - start) {
+		PyErr_SetString(PyExc_ValueError,
+				"long string too large to convert");
+		return NULL;
+	}
+	/* n <- # of Python digits needed, = ceiling(n/SHIFT). */
+	n = (n + SHIFT - 1) / SHIFT;
+	z = _PyLong_New(n);
+	if (z == NULL)
+		return NULL;
+	/* Read string from right, and fill in long from left; i.e.,
+	 * from least to most significant in both.
+	 */
+	accum = 0;
+	bits_in_accum = 0;
+	pdigit = z->ob_digit;
+	while (--p >= start) {
+		k = digit_value(*p);
+		assert(k >= 0 && k < base);
+		accum |= (twodigits)k << bits_in_accum;
+		bits_in_accum += bits_per_char;
+		if (bits_in_accum >= SHIFT) {
+			*pdigit++ = (digit)(accum & MASK);
+			assert(pdigit - z->ob_digit <= n);
+			accum >>= SHIFT;
+			bits_in_accum -= SHIFT;
+			assert(bits_in_accum < SHIFT);
+		}
+	}
+	if (bits_in_accum) {
+		assert(bits_in_accum <= SHIFT);
+		*pdigit++ = (digit)accum;
+		assert(pdigit - z->ob_digit <= n);
+	}
+	while (pdigit - z->ob_digit < n)
+		*pdigit++ = 0;
+	return long_normalize(z);
+}
+
+/* Return the value of the len digit characters at s in a base that is
+   not a power of 2.  Groups of digits that fit in a digit are
+   multiplied in place into one preallocated result. */
+
+static PyLongObject *
+long_from_digits(char *s, int len, int base)
+{
+	PyLongObject *z;
+	int power, size, bits, i;
+	char *end = s + len;
+
+	base_powbase(base, &power);
+	for (bits = 0; (1 << bits) < base; ++bits)
+		;
+	/* base**len < 2**(bits*len) */
+	z = _PyLong_New((len * bits) / SHIFT + 1);
+	if (z == NULL)
+		return NULL;
+	size = 0;
+	while (s < end) {
+		twodigits carry = 0;
+		digit mult = 1;
+		/* The first group takes what is left over from whole
+		   groups, so that the later ones all start at a multiple
+		   of power from the end. */
+		int n = (end - s) % power;
+		if (n == 0)
+			n = power;
+		for (i = 0; i < n; ++i) {
+			carry = carry * base + digit_value(*s++);
+			mult *= base;
+		}
+		for (i = 0; i < size; ++i) {
+			carry += (twodigits)z->ob_digit[i] * mult;
+			z->ob_digit[i] = (digit)(carry & MASK);
+			carry >>= SHIFT;
+		}
+		if (carry) {
+			assert(size < z->ob_size);
+			z->ob_digit[size++] = (digit)carry;
+		}
+	}
+	z->ob_size = size;
+	return z;
+}
+
 DL_EXPORT(PyObject *)
 PyLong_FromString(char *str, char **pend, int base)
 {
@@ -1015,23 +1182,17 @@ PyLong_FromString(char *str, char **pend, int base)
 	}
 	if (base == 16 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
 		str += 2;
-	z = _PyLong_New(0);
 	start = str;
-	for ( ; z != NULL; ++str) {
-		int k = -1;
-		PyLongObject *temp;
-
-		if (*str <= '9')
-			k = *str - '0';
-		else if (*str >= 'a')
-			k = *str - 'a' + 10;
-		else if (*str >= 'A')
-			k = *str - 'A' + 10;
-		if (k < 0 || k >= base)
-			break;
-		temp = muladd1(z, (digit)base, (digit)k);
-		Py_DECREF(z);
-		z = temp;
+	if ((base & (base - 1)) == 0)
+		z = long_from_binary_base(&str, base);
+	else {
+		int k;
+		while ((k = digit_value(*str)) >= 0 && k < base)
+			++str;
+		if (str - start > PARSE_CUTOFF)
+			z = long_from_digits_big(start, str - start, base);
+		else
+			z = long_from_digits(start, str - start, base);
 	}
 	if (z == NULL)
 		return NULL;
@@ -1078,6 +1239,7 @@ PyLong_FromUnicode(Py_UNICODE *u, int length, int base)
 static PyLongObject *x_divrem
 	(PyLongObject *, PyLongObject *, PyLongObject **);
 static PyObject *long_pos(PyLongObject *);
+static PyObject *long_neg(PyLongObject *);
 static int long_divrem(PyLongObject *, PyLongObject *,
 	PyLongObject **, PyLongObject **);
 
@@ -1454,13 +1616,408 @@ long_repeat(PyObject *v, PyLongObject *w)
 		return (*v->ob_type->tp_as_sequence->sq_repeat)(v, n);
 }
 
+/* Grade school multiplication, ignoring the signs.
+ * Returns the absolute value of the product, or NULL if error.
+ */
+static PyLongObject *
+x_mul(PyLongObject *a, PyLongObject *b)
+{
+	PyLongObject *z;
+	int size_a = ABS(a->ob_size);
+	int size_b = ABS(b->ob_size);
+	int i;
+
+	z = _PyLong_New(size_a + size_b);
+	if (z == NULL)
+		return NULL;
+
+	memset(z->ob_digit, 0, z->ob_size * sizeof(digit));
+	if (a == b) {
+		/* Squaring: every product off the diagonal of the
+		 * multiplication pyramid appears twice, so add it in
+		 * once with f doubled (HAC, Algorithm 14.16).
+		 */
+		for (i = 0; i < size_a; ++i) {
+			twodigits carry;
+			twodigits f = a->ob_digit[i];
+			digit *pz = z->ob_digit + (i << 1);
+			digit *pa = a->ob_digit + i + 1;
+			digit *paend = a->ob_digit + size_a;
+
+			SIGCHECK({
+				Py_DECREF(z);
+				return NULL;
+			})
+
+			carry = *pz + f * f;
+			*pz++ = (digit)(carry & MASK);
+			carry >>= SHIFT;
+			assert(carry <= MASK);
+
+			f <<= 1;
+			while (pa < paend) {
+				carry += *pz + *pa++ * f;
+				*pz++ = (digit)(carry & MASK);
+				carry >>= SHIFT;
+				assert(carry <= (MASK << 1));
+			}
+			if (carry) {
+				carry += *pz;
+				*pz++ = (digit)(carry & MASK);
+				carry >>= SHIFT;
+			}
+			if (carry)
+				*pz += (digit)(carry & MASK);
+			assert((carry >> SHIFT) == 0);
+		}
+	}
+	else {
+		for (i = 0; i < size_a; ++i) {
+			twodigits carry = 0;
+			twodigits f = a->ob_digit[i];
+			digit *pz = z->ob_digit + i;
+			digit *pb = b->ob_digit;
+			digit *pbend = b->ob_digit + size_b;
+
+			SIGCHECK({
+				Py_DECREF(z);
+				return NULL;
+			})
+
+			while (pb < pbend) {
+				carry += *pz + *pb++ * f;
+				*pz++ = (digit)(carry & MASK);
+				carry >>= SHIFT;
+				assert(carry <= MASK);
+			}
+			if (carry)
+				*pz += (digit)(carry & MASK);
+			assert((carry >> SHIFT) == 0);
+		}
+	}
+	return long_normalize(z);
+}
+
+/* Add y[0:n] into x[0:m] in place, m >= n, and return the carry out of
+ * x[m-1] (0 or 1).  Ignores signs.
+ */
+static digit
+v_iadd(digit *x, int m, digit *y, int n)
+{
+	int i;
+	digit carry = 0;
+
+	assert(m >= n);
+	for (i = 0; i < n; ++i) {
+		carry += x[i] + y[i];
+		x[i] = carry & MASK;
+		carry >>= SHIFT;
+		assert((carry & 1) == carry);
+	}
+	for (; carry && i < m; ++i) {
+		carry += x[i];
+		x[i] = carry & MASK;
+		carry >>= SHIFT;
+		assert((carry & 1) == carry);
+	}
+	return carry;
+}
+
+/* Subtract y[0:n] from x[0:m] in place, m >= n, and return the borrow
+ * out of x[m-1] (0 or 1).  Ignores signs.
+ */
+static digit
+v_isub(digit *x, int m, digit *y, int n)
+{
+	int i;
+	digit borrow = 0;
+
+	assert(m >= n);
+	for (i = 0; i < n; ++i) {
+		borrow = x[i] - y[i] - borrow;
+		x[i] = borrow & MASK;
+		borrow >>= SHIFT;
+		borrow &= 1;	/* keep only 1 sign bit */
+	}
+	for (; borrow && i < m; ++i) {
+		borrow = x[i] - borrow;
+		x[i] = borrow & MASK;
+		borrow >>= SHIFT;
+		borrow &= 1;
+	}
+	return borrow;
+}
+
+/* A helper for Karatsuba multiplication (k_mul).
+ * Takes a long "n" and an integer "size" representing the place to
+ * split, and sets low and high such that abs(n) == (high << size) + low,
+ * viewing the shift as being by digits.  The sign bit is ignored, and
+ * the return values are >= 0.
+ * Returns 0 on success, -1 on failure.
+ */
+static int
+kmul_split(PyLongObject *n, int size, PyLongObject **high, PyLongObject **low)
+{
+	PyLongObject *hi, *lo;
+	int size_lo, size_hi;
+	const int size_n = ABS(n->ob_size);
+
+	size_lo = MIN(size_n, size);
+	size_hi = size_n - size_lo;
+
+	if ((hi = _PyLong_New(size_hi)) == NULL)
+		return -1;
+	if ((lo = _PyLong_New(size_lo)) == NULL) {
+		Py_DECREF(hi);
+		return -1;
+	}
+
+	memcpy(lo->ob_digit, n->ob_digit, size_lo * sizeof(digit));
+	memcpy(hi->ob_digit, n->ob_digit + size_lo, size_hi * sizeof(digit));
+
+	*high = long_normalize(hi);
+	*low = long_normalize(lo);
+	return 0;
+}
+
+static PyLongObject *k_lopsided_mul(PyLongObject *a, PyLongObject *b);
+
+/* Karatsuba multiplication.  Ignores the input signs, and returns the
+ * absolute value of the product (or NULL if error).
+ * See Knuth Vol. 2 Chapter 4.3.3 (Pp. 294-295).
+ */
+static PyLongObject *
+k_mul(PyLongObject *a, PyLongObject *b)
+{
+	int asize = ABS(a->ob_size);
+	int bsize = ABS(b->ob_size);
+	PyLongObject *ah = NULL;
+	PyLongObject *al = NULL;
+	PyLongObject *bh = NULL;
+	PyLongObject *bl = NULL;
+	PyLongObject *ret = NULL;
+	PyLongObject *t1, *t2, *t3;
+	int shift;	/* the number of digits we split off */
+	int i;
+
+	/* (ah*X+al)(bh*X+bl) = ah*bh*X*X + (ah*bl + al*bh)*X + al*bl
+	 * Let k = (ah+al)*(bh+bl) = ah*bl + al*bh  + ah*bh + al*bl
+	 * Then the original product is
+	 *     ah*bh*X*X + (k - ah*bh - al*bl)*X + al*bl
+	 * By picking X to be a power of 2, "*X" is just shifting, and it's
+	 * been reduced to 3 multiplies on numbers half the size.
+	 */
+
+	/* We want to split based on the larger number; fiddle so that b
+	 * is largest.
+	 */
+	if (asize > bsize) {
+		t1 = a;
+		a = b;
+		b = t1;
+
+		i = asize;
+		asize = bsize;
+		bsize = i;
+	}
+
+	/* Use gradeschool math when either number is too small. */
+	i = a == b ? KARATSUBA_SQUARE_CUTOFF : KARATSUBA_CUTOFF;
+	if (asize <= i) {
+		if (asize == 0)
+			return _PyLong_New(0);
+		else
+			return x_mul(a, b);
+	}
+
+	/* If a is small compared to b, splitting on b gives a degenerate
+	 * case with ah==0, and Karatsuba may be (even much) less efficient
+	 * than "grade school" then.  However, we can still win, by viewing
+	 * b as a string of "big digits", each of width a->ob_size.  That
+	 * leads to a sequence of balanced calls to k_mul.
+	 */
+	if (2 * asize <= bsize)
+		return k_lopsided_mul(a, b);
+
+	/* Split a & b into hi & lo pieces. */
+	shift = bsize >> 1;
+	if (kmul_split(a, shift, &ah, &al) < 0) goto fail;
+	assert(ah->ob_size > 0);	/* the split isn't degenerate */
+
+	if (a == b) {
+		bh = ah;
+		bl = al;
+		Py_INCREF(bh);
+		Py_INCREF(bl);
+	}
+	else if (kmul_split(b, shift, &bh, &bl) < 0) goto fail;
+
+	/* The plan:
+	 * 1. Allocate result space (asize + bsize digits:  that's always
+	 *    enough).
+	 * 2. Compute ah*bh, and copy into result at 2*shift.
+	 * 3. Compute al*bl, and copy into result at 0.  Note that this
+	 *    can't overlap with #2.
+	 * 4. Subtract al*bl from the result, starting at shift.  This may
+	 *    underflow (borrow out of the high digit), but we don't care:
+	 *    we're effectively doing unsigned arithmetic mod
+	 *    BASE**(sizea + sizeb), and so long as the *final* result fits,
+	 *    borrows and carries out of the high digit can be ignored.
+	 * 5. Subtract ah*bh from the result, starting at shift.
+	 * 6. Compute (ah+al)*(bh+bl), and add it into the result starting
+	 *    at shift.
+	 */
+
+	/* 1. Allocate result space. */
+	ret = _PyLong_New(asize + bsize);
+	if (ret == NULL) goto fail;
+#ifdef Py_DEBUG
+	/* Fill with trash, to catch reference to uninitialized digits. */
+	memset(ret->ob_digit, 0xDF, ret->ob_size * sizeof(digit));
+#endif
+
+	/* 2. t1 <- ah*bh, and copy into high digits of result. */
+	if ((t1 = k_mul(ah, bh)) == NULL) goto fail;
+	assert(t1->ob_size >= 0);
+	assert(2*shift + t1->ob_size <= ret->ob_size);
+	memcpy(ret->ob_digit + 2*shift, t1->ob_digit,
+	       t1->ob_size * sizeof(digit));
+
+	/* Zero-out the digits higher than the ah*bh copy. */
+	i = ret->ob_size - 2*shift - t1->ob_size;
+	if (i)
+		memset(ret->ob_digit + 2*shift + t1->ob_size, 0,
+		       i * sizeof(digit));
+
+	/* 3. t2 <- al*bl, and copy into the low digits. */
+	if ((t2 = k_mul(al, bl)) == NULL) {
+		Py_DECREF(t1);
+		goto fail;
+	}
+	assert(t2->ob_size >= 0);
+	assert(t2->ob_size <= 2*shift); /* no overlap with high digits */
+	memcpy(ret->ob_digit, t2->ob_digit, t2->ob_size * sizeof(digit));
+
+	/* Zero out remaining digits. */
+	i = 2*shift - t2->ob_size;	/* number of uninitialized digits */
+	if (i)
+		memset(ret->ob_digit + t2->ob_size, 0, i * sizeof(digit));
+
+	/* 4 & 5. Subtract ah*bh (t1) and al*bl (t2).  We do al*bl first
+	 * because it's fresher in cache.
+	 */
+	i = ret->ob_size - shift;  /* # digits after shift */
+	(void)v_isub(ret->ob_digit + shift, i, t2->ob_digit, t2->ob_size);
+	Py_DECREF(t2);
+
+	(void)v_isub(ret->ob_digit + shift, i, t1->ob_digit, t1->ob_size);
+	Py_DECREF(t1);
+
+	/* 6. t3 <- (ah+al)(bh+bl), and add into result. */
+	if ((t1 = x_add(ah, al)) == NULL) goto fail;
+	Py_DECREF(ah);
+	Py_DECREF(al);
+	ah = al = NULL;
+
+	if (a == b) {
+		t2 = t1;
+		Py_INCREF(t2);
+	}
+	else if ((t2 = x_add(bh, bl)) == NULL) {
+		Py_DECREF(t1);
+		goto fail;
+	}
+	Py_DECREF(bh);
+	Py_DECREF(bl);
+	bh = bl = NULL;
+
+	t3 = k_mul(t1, t2);
+	Py_DECREF(t1);
+	Py_DECREF(t2);
+	if (t3 == NULL) goto fail;
+	assert(t3->ob_size >= 0);
+
+	/* Add t3.  Since the whole product fits in asize + bsize digits,
+	 * so does the middle term (k - ah*bh - al*bl) shifted by "shift"
+	 * digits, and carries out of the top digit only cancel the
+	 * borrows of steps 4 and 5.
+	 */
+	(void)v_iadd(ret->ob_digit + shift, i, t3->ob_digit, t3->ob_size);
+	Py_DECREF(t3);
+
+	return long_normalize(ret);
+
+ fail:
+	Py_XDECREF(ret);
+	Py_XDECREF(ah);
+	Py_XDECREF(al);
+	Py_XDECREF(bh);
+	Py_XDECREF(bl);
+	return NULL;
+}
+
+/* b has at least twice the digits of a, and a is big enough that
+ * Karatsuba would pay on a balanced pair.  Multiply a by successive
+ * asize-digit slices of b, so every k_mul call is balanced.
+ */
+static PyLongObject *
+k_lopsided_mul(PyLongObject *a, PyLongObject *b)
+{
+	const int asize = ABS(a->ob_size);
+	int bsize = ABS(b->ob_size);
+	int nbdone;	/* # of b digits already multiplied */
+	PyLongObject *ret;
+	PyLongObject *bslice = NULL;
+
+	assert(asize > KARATSUBA_CUTOFF);
+	assert(2 * asize <= bsize);
+
+	/* Allocate result space, and zero it out. */
+	ret = _PyLong_New(asize + bsize);
+	if (ret == NULL)
+		return NULL;
+	memset(ret->ob_digit, 0, ret->ob_size * sizeof(digit));
+
+	/* Successive slices of b are copied into bslice. */
+	bslice = _PyLong_New(asize);
+	if (bslice == NULL)
+		goto fail;
+
+	nbdone = 0;
+	while (bsize > 0) {
+		PyLongObject *product;
+		const int nbtouse = MIN(bsize, asize);
+
+		/* Multiply the next slice of b by a. */
+		memcpy(bslice->ob_digit, b->ob_digit + nbdone,
+		       nbtouse * sizeof(digit));
+		bslice->ob_size = nbtouse;
+		product = k_mul(a, long_normalize(bslice));
+		if (product == NULL)
+			goto fail;
+
+		/* Add into result. */
+		(void)v_iadd(ret->ob_digit + nbdone, ret->ob_size - nbdone,
+			     product->ob_digit, product->ob_size);
+		Py_DECREF(product);
+
+		bsize -= nbtouse;
+		nbdone += nbtouse;
+	}
+
+	Py_DECREF(bslice);
+	return long_normalize(ret);
+
+ fail:
+	Py_DECREF(ret);
+	Py_XDECREF(bslice);
+	return NULL;
+}
+
 static PyObject *
 long_mul(PyLongObject *v, PyLongObject *w)
 {
 	PyLongObject *a, *b, *z;
-	int size_a;
-	int size_b;
-	int i;
 
 	if (!convert_binop((PyObject *)v, (PyObject *)w, &a, &b)) {
 		if (!PyLong_Check(v) &&
@@ -1475,55 +2032,472 @@ long_mul(PyLongObject *v, PyLongObject *w)
 		return Py_NotImplemented;
 	}
 
-	size_a = ABS(a->ob_size);
-	size_b = ABS(b->ob_size);
-	if (size_a > size_b) {
-		/* we are faster with the small object on the left */
-		int hold_sa = size_a;
-		PyLongObject *hold_a = a;
-		size_a = size_b;
-		size_b = hold_sa;
-		a = b;
-		b = hold_a;
+	z = k_mul(a, b);
+	/* Negate if exactly one of the inputs is negative. */
+	if (((a->ob_size ^ b->ob_size) < 0) && z)
+		z->ob_size = -(z->ob_size);
+	Py_DECREF(a);
+	Py_DECREF(b);
+	return (PyObject *)z;
+}
+
+/* Base conversion of big numbers.
+ *
+ * str() and long() of a number with N digits take O(N**2) time if done
+ * one machine-sized chunk of base-'base' digits at a time.  For big
+ * numbers they split the number in halves instead, at
+ * powers pow[i] = base**(chunk << i) of the output base:
+ *
+ *     long():  value(s) = value(high part) * pow[i] + value(low part)
+ *     str():   str(n)   = str(n / pow[i]) + str(n % pow[i]) zero-padded
+ *
+ * With k_mul that makes long() O(N**1.585).  For str(), every division
+ * by pow[i] is done as two multiplications by a precomputed reciprocal
+ * of pow[i] (Barrett reduction), and the reciprocal itself comes from a
+ * Newton iteration, so str() is O(N**1.585 * log N).
+ */
+#define CONVERT_CHUNK_DIGITS 15	/* approximate size of pow[0] in digits */
+#define RECIPROCAL_CUTOFF 80	/* digits; below that use x_divrem */
+#define CONVERT_MAXLEVELS 32
+
+typedef struct {
+	int base;
+	int chunk;		/* pow[0] == base ** chunk */
+	int levels;		/* number of entries of pow[] in use */
+	PyLongObject *pow[CONVERT_MAXLEVELS];
+	PyLongObject *inv[CONVERT_MAXLEVELS];	/* only filled by str() */
+} convpowers;
+
+/* Set up cp with pow[0] for the given base.  Returns -1 on error. */
+
+static int
+convpowers_init(convpowers *cp, int base)
+{
+	PyLongObject *z, *temp;
+	int power, i;
+	digit powbase = base_powbase(base, &power);
+
+	cp->base = base;
+	cp->levels = 0;
+	z = (PyLongObject *)PyLong_FromLong(1L);
+	for (i = 0; z != NULL && i < CONVERT_CHUNK_DIGITS; ++i) {
+		temp = mul1(z, powbase);
+		Py_DECREF(z);
+		z = temp;
 	}
-	z = _PyLong_New(size_a + size_b);
-	if (z == NULL) {
-		Py_DECREF(a);
-		Py_DECREF(b);
+	if (z == NULL)
+		return -1;
+	cp->chunk = power * CONVERT_CHUNK_DIGITS;
+	cp->pow[0] = z;
+	cp->inv[0] = NULL;
+	cp->levels = 1;
+	return 0;
+}
+
+/* Append pow[levels] == pow[levels-1] ** 2.  Returns -1 on error. */
+
+static int
+convpowers_grow(convpowers *cp)
+{
+	PyLongObject *last = cp->pow[cp->levels - 1];
+	PyLongObject *z;
+
+	if (cp->levels >= CONVERT_MAXLEVELS) {
+		PyErr_SetString(PyExc_OverflowError,
+				"long is too large to convert");
+		return -1;
+	}
+	z = k_mul(last, last);
+	if (z == NULL)
+		return -1;
+	cp->pow[cp->levels] = z;
+	cp->inv[cp->levels] = NULL;
+	cp->levels++;
+	return 0;
+}
+
+static void
+convpowers_clear(convpowers *cp)
+{
+	int i;
+	for (i = 0; i < cp->levels; ++i) {
+		Py_DECREF(cp->pow[i]);
+		Py_XDECREF(cp->inv[i]);
+	}
+	cp->levels = 0;
+}
+
+/* Return digits lo through hi-1 of abs(a), as a new normalized long. */
+
+static PyLongObject *
+long_slice(PyLongObject *a, int lo, int hi)
+{
+	PyLongObject *z;
+	int size_a = ABS(a->ob_size);
+
+	if (hi > size_a)
+		hi = size_a;
+	if (lo > hi)
+		lo = hi;
+	z = _PyLong_New(hi - lo);
+	if (z == NULL)
 		return NULL;
+	memcpy(z->ob_digit, a->ob_digit + lo, (hi - lo) * sizeof(digit));
+	return long_normalize(z);
+}
+
+/* Return abs(a) * BASE**n. */
+
+static PyLongObject *
+long_shift_digits(PyLongObject *a, int n)
+{
+	PyLongObject *z;
+	int size_a = ABS(a->ob_size);
+
+	z = _PyLong_New(size_a ? size_a + n : 0);
+	if (z == NULL)
+		return NULL;
+	if (size_a) {
+		memset(z->ob_digit, 0, n * sizeof(digit));
+		memcpy(z->ob_digit + n, a->ob_digit, size_a * sizeof(digit));
 	}
-	for (i = 0; i < z->ob_size; ++i)
-		z->ob_digit[i] = 0;
-	for (i = 0; i < size_a; ++i) {
-		twodigits carry = 0;
-		twodigits f = a->ob_digit[i];
-		int j;
+	return z;
+}
 
-		SIGCHECK({
-			Py_DECREF(a);
-			Py_DECREF(b);
-			Py_DECREF(z);
+/* Return BASE**n. */
+
+static PyLongObject *
+long_base_power(int n)
+{
+	PyLongObject *z = _PyLong_New(n + 1);
+	if (z == NULL)
+		return NULL;
+	memset(z->ob_digit, 0, n * sizeof(digit));
+	z->ob_digit[n] = 1;
+	return z;
+}
+
+/* Replace *pa by *pa + b (or *pa - b if negate), with signs.  On error
+   *pa is released and set to NULL. */
+
+static void
+long_iadd(PyLongObject **pa, PyLongObject *b, int negate)
+{
+	PyLongObject *z;
+
+	if (*pa == NULL)
+		return;
+	z = (PyLongObject *)(negate ? long_sub(*pa, b) : long_add(*pa, b));
+	Py_DECREF(*pa);
+	*pa = z;
+}
+
+/* Return BASE**(2*m) - x*d, where d has m digits. */
+
+static PyLongObject *
+long_reciprocal_error(PyLongObject *x, PyLongObject *d)
+{
+	PyLongObject *r, *t;
+
+	t = k_mul(x, d);
+	if (t == NULL)
+		return NULL;
+	r = long_base_power(2 * d->ob_size);
+	long_iadd(&r, t, 1);
+	Py_DECREF(t);
+	return r;
+}
+
+/* For d > 0 with m digits, return floor(BASE**(2*m) / d).
+ *
+ * Small d are divided directly.  Otherwise the reciprocal x of the top
+ * h digits of d, scaled to the size of d, is good to about h-1 digits,
+ * and one Newton step
+ *
+ *     x <- x + x * (BASE**(2*m) - x*d) / BASE**(2*m)
+ *
+ * doubles that, so h = (m+4)/2 leaves x off by a few units.  The
+ * remainder then tells exactly how far off.
+ */
+static PyLongObject *
+x_reciprocal(PyLongObject *d)
+{
+	const int m = d->ob_size;
+	PyLongObject *x, *t, *e, *r, *one;
+	int h;
+
+	assert(m > 0 && d->ob_digit[m-1] != 0);
+	if (m <= RECIPROCAL_CUTOFF) {
+		PyLongObject *rem;
+		t = long_base_power(2 * m);
+		if (t == NULL)
 			return NULL;
-		})
-		for (j = 0; j < size_b; ++j) {
-			carry += z->ob_digit[i+j] + b->ob_digit[j] * f;
-			z->ob_digit[i+j] = (digit) (carry & MASK);
-			carry >>= SHIFT;
+		if (long_divrem(t, d, &x, &rem) < 0)
+			x = NULL;
+		else
+			Py_DECREF(rem);
+		Py_DECREF(t);
+		return x;
+	}
+
+	h = (m + 4) / 2;
+	t = long_slice(d, m - h, m);
+	if (t == NULL)
+		return NULL;
+	e = x_reciprocal(t);
+	Py_DECREF(t);
+	if (e == NULL)
+		return NULL;
+	x = long_shift_digits(e, m - h);
+	Py_DECREF(e);
+	if (x == NULL)
+		return NULL;
+
+	/* Newton step, with e <- BASE**(2*m) - x*d. */
+	e = long_reciprocal_error(x, d);
+	if (e == NULL)
+		goto error;
+	t = k_mul(x, e);
+	if (t == NULL) {
+		Py_DECREF(e);
+		goto error;
+	}
+	r = long_slice(t, 2 * m, t->ob_size);
+	Py_DECREF(t);
+	if (r == NULL) {
+		Py_DECREF(e);
+		goto error;
+	}
+	long_iadd(&x, r, e->ob_size < 0);
+	Py_DECREF(r);
+	Py_DECREF(e);
+	if (x == NULL)
+		return NULL;
+
+	/* Fix up x so that 0 <= r < d. */
+	r = long_reciprocal_error(x, d);
+	if (r == NULL)
+		goto error;
+	one = (PyLongObject *)PyLong_FromLong(1L);
+	if (one == NULL) {
+		Py_DECREF(r);
+		goto error;
+	}
+	while (r != NULL && x != NULL && r->ob_size < 0) {
+		long_iadd(&r, d, 0);
+		long_iadd(&x, one, 1);
+	}
+	while (r != NULL && x != NULL && long_compare(r, d) >= 0) {
+		long_iadd(&r, d, 1);
+		long_iadd(&x, one, 0);
+	}
+	Py_DECREF(one);
+	if (r == NULL)
+		goto error;
+	Py_DECREF(r);
+	return x;
+
+ error:
+	Py_XDECREF(x);
+	return NULL;
+}
+
+/* Divide 0 <= n < d**2 by d > 0, given inv == x_reciprocal(d).
+   Returns -1 on error. */
+
+static int
+x_divrem_inv(PyLongObject *n, PyLongObject *d, PyLongObject *inv,
+	     PyLongObject **pdiv, PyLongObject **prem)
+{
+	const int m = d->ob_size;
+	PyLongObject *q, *r, *t, *one;
+
+	/* q <- floor(n * inv / BASE**(2*m)) is at most 2 too small, since
+	   n < BASE**(2*m). */
+	t = k_mul(n, inv);
+	if (t == NULL)
+		return -1;
+	q = long_slice(t, 2 * m, t->ob_size);
+	Py_DECREF(t);
+	if (q == NULL)
+		return -1;
+	t = k_mul(q, d);
+	if (t == NULL) {
+		Py_DECREF(q);
+		return -1;
+	}
+	r = x_sub(n, t);
+	Py_DECREF(t);
+	if (r == NULL) {
+		Py_DECREF(q);
+		return -1;
+	}
+	assert(r->ob_size >= 0);
+	if (long_compare(r, d) >= 0) {
+		one = (PyLongObject *)PyLong_FromLong(1L);
+		while (q != NULL && r != NULL && long_compare(r, d) >= 0) {
+			long_iadd(&r, d, 1);
+			long_iadd(&q, one, 0);
 		}
-		for (; carry != 0; ++j) {
-			assert(i+j < z->ob_size);
-			carry += z->ob_digit[i+j];
-			z->ob_digit[i+j] = (digit) (carry & MASK);
-			carry >>= SHIFT;
+		Py_XDECREF(one);
+		if (q == NULL || r == NULL) {
+			Py_XDECREF(q);
+			Py_XDECREF(r);
+			return -1;
 		}
 	}
-	if (a->ob_size < 0)
-		z->ob_size = -(z->ob_size);
-	if (b->ob_size < 0)
-		z->ob_size = -(z->ob_size);
+	*pdiv = q;
+	*prem = r;
+	return 0;
+}
+
+/* Divide 0 <= n < pow[level]**2 by pow[level].  A short quotient, or a
+   small divisor, is cheaper to get by plain long division than by
+   multiplying with the reciprocal, and then the reciprocal isn't needed
+   at all. */
+
+static int
+convpowers_divrem(convpowers *cp, int level, PyLongObject *n,
+		  PyLongObject **pdiv, PyLongObject **prem)
+{
+	PyLongObject *d = cp->pow[level];
+
+	if (d->ob_size <= RECIPROCAL_CUTOFF ||
+	    n->ob_size - d->ob_size < KARATSUBA_CUTOFF)
+		return long_divrem(n, d, pdiv, prem);
+	if (cp->inv[level] == NULL) {
+		cp->inv[level] = x_reciprocal(d);
+		if (cp->inv[level] == NULL)
+			return -1;
+	}
+	return x_divrem_inv(n, d, cp->inv[level], pdiv, prem);
+}
+
+/* Store the base-'base' digits of the nonnegative number n, where
+ * n < cp->pow[level]**2, so that the last one ends just before p.  With
+ * pad set, write exactly 2*chunk << level characters, zero-filled on
+ * the left.  Returns the start of what was written, or NULL on error.
+ */
+static char *
+format_dc(PyLongObject *n, convpowers *cp, int level, char *p, int pad)
+{
+	PyLongObject *q, *r;
+	char *start;
+
+	if (level < 0) {
+		/* n < pow[0]: a few digits, in the quadratic loop */
+		char *end = p;
+		int size = n->ob_size;
+		if (size > 0) {
+			PyLongObject *scratch = _PyLong_New(size);
+			if (scratch == NULL)
+				return NULL;
+			p = format_digits(n->ob_digit, scratch->ob_digit, size,
+					  cp->base, p);
+			Py_DECREF(scratch);
+			if (p == NULL)
+				return NULL;
+		}
+		if (pad)
+			while (p > end - cp->chunk)
+				*--p = '0';
+		return p;
+	}
+
+	if (convpowers_divrem(cp, level, n, &q, &r) < 0)
+		return NULL;
+	if (!pad && q->ob_size == 0)
+		start = format_dc(r, cp, level - 1, p, 0);
+	else {
+		start = format_dc(r, cp, level - 1, p, 1);
+		if (start != NULL)
+			start = format_dc(q, cp, level - 1, start, pad);
+	}
+	Py_DECREF(q);
+	Py_DECREF(r);
+	return start;
+}
+
+/* long_format() for a big a and a base that is not a power of 2.  Works
+   like format_digits(), and ignores the sign. */
+
+static char *
+long_format_dc(PyLongObject *a, int base, char *p)
+{
+	convpowers cp;
+	int size_a = ABS(a->ob_size);
+	char *start = NULL;
+
+	if (convpowers_init(&cp, base) < 0)
+		return NULL;
+	/* a < BASE**size_a, and pow**2 >= BASE**(2*pow->ob_size - 2) */
+	while (2 * cp.pow[cp.levels-1]->ob_size - 2 < size_a)
+		if (convpowers_grow(&cp) < 0)
+			goto done;
+	if (a->ob_size < 0) {
+		a = (PyLongObject *)long_neg(a);
+		if (a == NULL)
+			goto done;
+	}
+	else
+		Py_INCREF(a);
+	start = format_dc(a, &cp, cp.levels - 1, p, 0);
 	Py_DECREF(a);
-	Py_DECREF(b);
-	return (PyObject *) long_normalize(z);
+ done:
+	convpowers_clear(&cp);
+	return start;
+}
+
+/* Return the value of the len base-'base' digit characters at s,
+   splitting at pow[level] and below. */
+
+static PyLongObject *
+long_from_digits_dc(char *s, int len, convpowers *cp, int level)
+{
+	PyLongObject *hi, *lo, *z;
+	int lowlen;
+
+	while (level >= 0 && (cp->chunk << level) >= len)
+		--level;
+	if (level < 0 || len <= PARSE_CUTOFF)
+		return long_from_digits(s, len, cp->base);
+	lowlen = cp->chunk << level;
+	hi = long_from_digits_dc(s, len - lowlen, cp, level - 1);
+	if (hi == NULL)
+		return NULL;
+	lo = long_from_digits_dc(s + len - lowlen, lowlen, cp, level - 1);
+	if (lo == NULL) {
+		Py_DECREF(hi);
+		return NULL;
+	}
+	z = k_mul(hi, cp->pow[level]);
+	Py_DECREF(hi);
+	if (z != NULL) {
+		hi = z;
+		z = x_add(hi, lo);
+		Py_DECREF(hi);
+	}
+	Py_DECREF(lo);
+	return z;
+}
+
+/* long_from_digits() for long strings. */
+
+static PyLongObject *
+long_from_digits_big(char *s, int len, int base)
+{
+	convpowers cp;
+	PyLongObject *z = NULL;
+
+	if (convpowers_init(&cp, base) < 0)
+		return NULL;
+	while ((cp.chunk << (cp.levels - 1)) < len / 2)
+		if (convpowers_grow(&cp) < 0)
+			goto done;
+	z = long_from_digits_dc(s, len, &cp, cp.levels - 1);
+ done:
+	convpowers_clear(&cp);
+	return z;
 }
 
 /* The / and % operators are now defined in terms of divmod().
@@ -1703,6 +2677,264 @@ long_divmod(PyObject *v, PyObject *w)
 	return z;
 }
 
+/* Modular exponentiation.
+ *
+ * pow(a, b, c) with an odd c works on fixed arrays of n = size(c)
+ * digits in Montgomery form, where x stands for x*R mod c, R = BASE**n.
+ * mont_mul() multiplies two such numbers and reduces the product by
+ * adding multiples of c that clear its low n digits, so no division is
+ * needed and nothing is allocated per step.  The exponent is scanned
+ * left to right in windows of up to k bits that start and end with a 1
+ * bit, so besides one squaring per bit there is one multiplication per
+ * window, by a precomputed odd power of a.
+ */
+
+typedef struct {
+	int n;			/* digits in the modulus */
+	digit *m;		/* the modulus */
+	digit minv;		/* -1/m mod BASE */
+	digit *t;		/* 2*n+1 digits of scratch */
+} montctx;
+
+/* z <- x*y/R mod m, for x, y < m.  z may be x or y. */
+
+static void
+mont_mul(montctx *ctx, digit *z, digit *x, digit *y)
+{
+	const int n = ctx->n;
+	digit *t = ctx->t;
+	digit *m = ctx->m;
+	twodigits carry;
+	int i, j;
+
+	memset(t, 0, (2*n + 1) * sizeof(digit));
+	if (x == y) {
+		/* Squaring, as in x_mul(). */
+		for (i = 0; i < n; ++i) {
+			twodigits f = x[i];
+			carry = t[2*i] + f * f;
+			t[2*i] = (digit)(carry & MASK);
+			carry >>= SHIFT;
+			f <<= 1;
+			for (j = i + 1; j < n; ++j) {
+				carry += t[i+j] + x[j] * f;
+				t[i+j] = (digit)(carry & MASK);
+				carry >>= SHIFT;
+			}
+			for (j += i; carry; ++j) {
+				carry += t[j];
+				t[j] = (digit)(carry & MASK);
+				carry >>= SHIFT;
+			}
+		}
+	}
+	else {
+		for (i = 0; i < n; ++i) {
+			twodigits f = x[i];
+			carry = 0;
+			for (j = 0; j < n; ++j) {
+				carry += t[i+j] + y[j] * f;
+				t[i+j] = (digit)(carry & MASK);
+				carry >>= SHIFT;
+			}
+			t[i+n] = (digit)carry;
+		}
+	}
+
+	/* Add u*m*BASE**i, choosing u to clear digit i.  Then t is a
+	   multiple of R, and t/R < 2*m. */
+	for (i = 0; i < n; ++i) {
+		twodigits u = (t[i] * (twodigits)ctx->minv) & MASK;
+		carry = 0;
+		for (j = 0; j < n; ++j) {
+			carry += t[i+j] + u * m[j];
+			t[i+j] = (digit)(carry & MASK);
+			carry >>= SHIFT;
+		}
+		for (j += i; carry; ++j) {
+			assert(j <= 2*n);
+			carry += t[j];
+			t[j] = (digit)(carry & MASK);
+			carry >>= SHIFT;
+		}
+	}
+
+	/* Subtract m once more if t/R >= m. */
+	t += n;
+	i = n - 1;
+	if (t[n] == 0) {
+		while (i >= 0 && t[i] == m[i])
+			--i;
+	}
+	if (t[n] != 0 || i < 0 || t[i] > m[i])
+		(void)v_isub(t, n + 1, m, n);
+	memcpy(z, t, n * sizeof(digit));
+}
+
+/* Return x*R mod m as an n-digit array in buf, for 0 <= x. */
+
+static int
+mont_from_long(montctx *ctx, PyLongObject *mod, PyLongObject *x, digit *buf)
+{
+	PyLongObject *t, *q, *r;
+
+	t = long_shift_digits(x, ctx->n);
+	if (t == NULL)
+		return -1;
+	if (long_divrem(t, mod, &q, &r) < 0) {
+		Py_DECREF(t);
+		return -1;
+	}
+	Py_DECREF(t);
+	Py_DECREF(q);
+	memset(buf, 0, ctx->n * sizeof(digit));
+	memcpy(buf, r->ob_digit, ABS(r->ob_size) * sizeof(digit));
+	Py_DECREF(r);
+	return 0;
+}
+
+#define EXP_BIT(b, i) (((b)->ob_digit[(i) / SHIFT] >> ((i) % SHIFT)) & 1)
+
+/* Return a**b mod m for 0 <= a < m, 0 <= b and odd m > 1. */
+
+static PyLongObject *
+long_powmod_odd(PyLongObject *a, PyLongObject *b, PyLongObject *mod)
+{
+	montctx ctx;
+	PyLongObject *z = NULL;
+	digit *mem, *table, *acc, *sq;
+	int n = mod->ob_size;
+	int nbits, k, i, j, started;
+	digit inv;
+
+	assert(n > 0 && (mod->ob_digit[0] & 1));
+
+	/* Window size by exponent length, as usual. */
+	nbits = b->ob_size ? (b->ob_size - 1) * SHIFT : 0;
+	for (i = b->ob_size ? b->ob_digit[b->ob_size - 1] : 0; i; i >>= 1)
+		++nbits;
+	k = nbits > 671 ? 6 : nbits > 239 ? 5 : nbits > 79 ? 4 :
+	    nbits > 23 ? 3 : nbits > 6 ? 2 : 1;
+
+	/* table[i] holds a**(2*i+1), followed by the accumulator, a**2
+	   and the scratch area. */
+	mem = PyMem_NEW(digit, ((1 << (k - 1)) + 2) * n + 2 * n + 1);
+	if (mem == NULL)
+		return (PyLongObject *)PyErr_NoMemory();
+	table = mem;
+	acc = table + (1 << (k - 1)) * n;
+	sq = acc + n;
+	ctx.n = n;
+	ctx.m = mod->ob_digit;
+	ctx.t = sq + n;
+
+	/* minv <- -1/m mod BASE, by Newton's iteration; for odd m0, m0 is
+	   its own inverse mod 8, and each step doubles the good bits. */
+	inv = mod->ob_digit[0];
+	for (i = 0; i < 3; ++i)
+		inv = (digit)((inv * (2 - (twodigits)mod->ob_digit[0] * inv))
+			      & MASK);
+	assert(((twodigits)inv * mod->ob_digit[0] & MASK) == 1);
+	ctx.minv = (digit)((BASE - inv) & MASK);
+
+	if (mont_from_long(&ctx, mod, a, table) < 0)
+		goto done;
+	if (k > 1) {
+		mont_mul(&ctx, sq, table, table);
+		for (i = 1; i < (1 << (k - 1)); ++i)
+			mont_mul(&ctx, table + i*n, table + (i-1)*n, sq);
+	}
+
+	started = 0;
+	for (i = nbits - 1; i >= 0; i = j - 1) {
+		int w;
+
+		SIGCHECK({
+			goto done;
+		})
+		if (!EXP_BIT(b, i)) {
+			mont_mul(&ctx, acc, acc, acc);
+			j = i;
+			continue;
+		}
+		/* The window is bits i down to j, with bit j set. */
+		j = i - k + 1;
+		if (j < 0)
+			j = 0;
+		while (!EXP_BIT(b, j))
+			++j;
+		for (w = 0; i >= j; --i)
+			w = (w << 1) | EXP_BIT(b, i);
+		if (started) {
+			for (i = w; i; i >>= 1)
+				mont_mul(&ctx, acc, acc, acc);
+			mont_mul(&ctx, acc, acc, table + (w >> 1) * n);
+		}
+		else {
+			memcpy(acc, table + (w >> 1) * n, n * sizeof(digit));
+			started = 1;
+		}
+	}
+
+	/* Leave Montgomery form by multiplying by plain 1; a**0 is 1. */
+	memset(sq, 0, n * sizeof(digit));
+	sq[0] = 1;
+	if (started)
+		mont_mul(&ctx, acc, acc, sq);
+	else
+		memcpy(acc, sq, n * sizeof(digit));
+	z = _PyLong_New(n);
+	if (z != NULL) {
+		memcpy(z->ob_digit, acc, n * sizeof(digit));
+		z = long_normalize(z);
+	}
+ done:
+	PyMem_DEL(mem);
+	return z;
+}
+
+#undef EXP_BIT
+
+/* Return a**b mod c for 0 <= b and odd c, with the sign of c. */
+
+static PyLongObject *
+long_powmod(PyLongObject *a, PyLongObject *b, PyLongObject *c)
+{
+	PyLongObject *mod, *base, *z, *div, *r;
+
+	if (c->ob_size < 0) {
+		mod = (PyLongObject *)long_neg(c);
+		if (mod == NULL)
+			return NULL;
+	}
+	else {
+		mod = c;
+		Py_INCREF(mod);
+	}
+	base = z = NULL;
+	if (mod->ob_size == 1 && mod->ob_digit[0] == 1) {
+		z = (PyLongObject *)PyLong_FromLong(0L);
+		goto done;
+	}
+	if (l_divmod(a, mod, &div, &base) < 0)
+		goto done;
+	Py_DECREF(div);
+	z = long_powmod_odd(base, b, mod);
+	if (z != NULL && c->ob_size < 0) {
+		/* Shift the result into (c, 0] as l_divmod() would. */
+		if (l_divmod(z, c, &div, &r) < 0)
+			r = NULL;
+		else
+			Py_DECREF(div);
+		Py_DECREF(z);
+		z = r;
+	}
+ done:
+	Py_XDECREF(base);
+	Py_DECREF(mod);
+	return z;
+}
+
 static PyObject *
 long_pow(PyObject *v, PyObject *w, PyObject *x)
 {
@@ -1748,6 +2980,10 @@ long_pow(PyObject *v, PyObject *w, PyObject *x)
 		   arguments to double. */
 		return PyFloat_Type.tp_as_number->nb_power(v, w, x);
 	}
+	if (c != Py_None && (((PyLongObject *)c)->ob_digit[0] & 1)) {
+		z = long_powmod(a, b, (PyLongObject *)c);
+		goto error;
+	}
 	z = (PyLongObject *)PyLong_FromLong(1L);
 	for (i = 0; i < size_b; ++i) {
 		digit bi = b->ob_digit[i];
@@ -2001,9 +3237,6 @@ lshift_error:
 
 /* Bitwise and/xor/or operations */
 
-#define MAX(x, y) ((x) < (y) ? (y) : (x))
-#define MIN(x, y) ((x) > (y) ? (y) : (x))
-
 static PyObject *
 long_bitwise(PyLongObject *a,
 	     int op,  /* '&', '|', '^' */
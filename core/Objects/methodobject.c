@@ -98,6 +98,9 @@ PyCFunction_Call(PyObject *func, PyObject *arg, PyObject *kw)
 			     "%.200s() takes exactly one argument (%d given)",
 			     f->m_ml->ml_name, size);
 		return NULL;
+	case METH_FASTCALL:
+		return (*(PyCFunctionFast)meth)(
+			self, &PyTuple_GET_ITEM(arg, 0), size);
 	case METH_OLDARGS:
 		/* the really old style */
 		if (size == 1)
@@ -1317,6 +1317,7 @@ PyObject_GenericSetAttr(PyObject *obj, PyObject *name, PyObject *value)
 	PyObject *descr;
 	descrsetfunc f;
 	PyObject **dictptr;
+	PyDictKeysObject **pkeys;
 	int res = -1;
 
 #ifdef Py_USING_UNICODE
@@ -1356,17 +1357,29 @@ PyObject_GenericSetAttr(PyObject *obj, PyObject *name, PyObject *value)
 	dictptr = _PyObject_GetDictPtr(obj);
 	if (dictptr != NULL) {
 		PyObject *dict = *dictptr;
+		pkeys = _PyType_SharedKeys(tp);
 		if (dict == NULL && value != NULL) {
-			dict = PyDict_New();
+			if (pkeys != NULL)
+				dict = _PyDict_NewShared(pkeys);
+			else
+				dict = PyDict_New();
 			if (dict == NULL)
 				goto done;
 			*dictptr = dict;
 		}
 		if (dict != NULL) {
-			if (value == NULL)
+			if (pkeys != NULL)
+				res = _PyDict_SetItemShared(pkeys, dict, name,
+							    value);
+			else if (value == NULL)
 				res = PyDict_DelItem(dict, name);
 			else
 				res = PyDict_SetItem(dict, name, value);
+			/* A type's tp_dict, reached without type_setattro()
+			   by object.__setattr__(): the cached lookups of its
+			   subclasses must go too (see typeobject.c) */
+			if (PyType_Check(obj))
+				_PyType_NewEpoch();
 			if (res < 0 && PyErr_ExceptionMatches(PyExc_KeyError))
 				PyErr_SetObject(PyExc_AttributeError, name);
 			goto done;
@@ -231,11 +231,17 @@
 
 #define POOL_SIZE               SYSTEM_PAGE_SIZE        /* must be 2^N */
 #define POOL_SIZE_MASK          SYSTEM_PAGE_SIZE_MASK
-#define POOL_MAGIC              0x74D3A651              /* authentication id */
 
 #define ARENA_NB_POOLS          (ARENA_SIZE / POOL_SIZE)
 #define ARENA_NB_PAGES          (ARENA_SIZE / SYSTEM_PAGE_SIZE)
 
+/*
+ * Number of arena objects (see below) allocated when the arena table
+ * is first needed; the table doubles in size whenever it fills up.
+ */
+
+#define INITIAL_ARENA_OBJECTS   16
+
 /*
  * -- End of tunable settings section --
  */
@@ -289,6 +295,8 @@
 /* When you say memory, my mind reasons in terms of (pointers to) blocks */
 typedef uchar block;
 
+typedef Py_uintptr_t uptr;
+
 /* Pool for small blocks */
 struct pool_header {
         union { block *_padding;
@@ -296,20 +304,63 @@ struct pool_header {
         block *freeblock;               /* pool's free list head         */
         struct pool_header *nextpool;   /* next pool of this size class  */
         struct pool_header *prevpool;   /* previous pool       ""        */
-        struct pool_header *pooladdr;   /* pool address (always aligned) */
-        uint magic;                     /* pool magic number             */
+        uint arenaindex;                /* index into arenas of base adr */
         uint szidx;                     /* block size class index        */
         uint capacity;                  /* pool capacity in # of blocks  */
 };
 
 typedef struct pool_header *poolp;
 
+/* Record keeping for arenas */
+struct arena_object {
+        /*
+         * The address returned by the system allocator, or 0 if this
+         * arena object does not currently describe an allocated arena.
+         */
+        uptr address;
+
+        /* Pool-aligned pointer to the next pool to be carved off. */
+        block *pool_address;
+
+        /*
+         * The number of available pools in the arena: free pools plus
+         * pools not yet carved off.
+         */
+        uint nfreepools;
+
+        /* The total number of pools in the arena. */
+        uint ntotalpools;
+
+        /* Singly-linked list of free pools in this arena. */
+        struct pool_header *freepools;
+
+        /*
+         * Whenever this arena object is not associated with an allocated
+         * arena, the nextarena member is used to link all unassociated
+         * arena objects in the singly-linked unused_arena_objects list.
+         * The prevarena member is unused in this case.
+         *
+         * When this arena object is associated with an allocated arena
+         * with at least one available pool, both members are used in
+         * the doubly-linked usable_arenas list, which is kept sorted by
+         * increasing nfreepools.  Arenas with no available pool are not
+         * linked anywhere.
+         */
+        struct arena_object *nextarena;
+        struct arena_object *prevarena;
+};
+
 #undef  ROUNDUP
 #define ROUNDUP(x)              (((x) + ALIGNMENT_MASK) & ~ALIGNMENT_MASK)
 #define POOL_OVERHEAD           ROUNDUP(sizeof(struct pool_header))
 
 #define DUMMY_SIZE_IDX          0xffff  /* size class of newly cached pools */
 
+/* Arenas are over-allocated by a page so that pools can be page aligned */
+#define ARENA_ALLOC_SIZE        (ARENA_SIZE + SYSTEM_PAGE_SIZE)
+#define ARENA_FIRST_POOL(a)     ((block *)(a) + SYSTEM_PAGE_SIZE - \
+                                 ((uptr )(a) & SYSTEM_PAGE_SIZE_MASK))
+
 /*==========================================================================*/
 
 /*
@@ -370,7 +421,6 @@ extern int obmalloc_globals_init()
   } 
   
   pyglobals->usedpools = usedpoolarray;
-  pyglobals->watermark = ARENA_NB_POOLS;
   
   return 0;
 }
@@ -380,35 +430,120 @@ extern int obmalloc_globals_init()
 extern void obmalloc_globals_fini()
 {
   SPy_Python_globals* pyglobals = PYTHON_GLOBALS;
+  struct arena_object* ao = pyglobals->arenas;
+  uint i;
+
+  /* The heap may outlive this interpreter, so hand the arenas back */
+  for (i = 0; i < pyglobals->maxarenas; i++)
+    if (ao[i].address != 0)
+      _SYSTEM_FREE((void *)ao[i].address);
+  if (ao != NULL)
+    _SYSTEM_FREE(ao);
   PyMem_Free(usedpools);
 }
 #endif /* SYMBIAN */
 
 /*
- * Free (cached) pools
+ * Arenas
+ *
+ * Each allocated arena is described by an entry of the arenas table.
+ * Allocations are served from the usable arena with the fewest free
+ * pools, which gives the others a chance to drain completely; an arena
+ * whose pools are all free again is returned to the system allocator.
  */
 #ifndef SYMBIAN
-static poolp freepools = NULL;          /* free list for cached pools */
+static struct arena_object *arenas = NULL;  /* table of arena objects */
+static uint maxarenas = 0;                  /* # entries in arenas    */
+static struct arena_object *unused_arena_objects = NULL;
+static struct arena_object *usable_arenas = NULL;
+static uint narenas = 0;                    /* # arenas allocated now */
+static ulong arenas_allocated = 0;          /* # arenas ever allocated */
+static ulong arenas_freed = 0;              /* # arenas ever freed    */
 #else
-#define freepools ((poolp)(pyglobals->freepools))
-#endif
+#define arenas (pyglobals->arenas)
+#define maxarenas (pyglobals->maxarenas)
+#define unused_arena_objects (pyglobals->unused_arena_objects)
+#define usable_arenas (pyglobals->usable_arenas)
+#define narenas (pyglobals->narenas)
+#define arenas_allocated (pyglobals->arenas_allocated)
+#define arenas_freed (pyglobals->arenas_freed)
+#endif /* SYMBIAN */
 
 /*
- * Arenas
+ * True if P points into the arena that POOL claims to belong to.  The
+ * pool header of a block we did not allocate holds garbage, but the
+ * arena table itself is always valid, so no false positive is possible.
  */
-#ifndef SYMBIAN
-static uint arenacnt = 0;               /* number of allocated arenas */
-static uint watermark = ARENA_NB_POOLS; /* number of pools allocated from
-                                           the current arena */
-static block *arenalist = NULL;         /* list of allocated arenas */
-static block *arenabase = NULL;         /* free space start address in
-                                           current arena */
-#else
-#define arenacnt (pyglobals->arenacnt)
-#define watermark (pyglobals->watermark)
-#define arenalist ((block*)(pyglobals->arenalist))
-#define arenabase ((block*)(pyglobals->arenabase))
-#endif /* SYMBIAN */
+#define ADDRESS_IN_RANGE(P, POOL)                                       \
+        ((POOL)->arenaindex < maxarenas &&                              \
+         (uptr)(P) - arenas[(POOL)->arenaindex].address <               \
+                (uptr)ARENA_ALLOC_SIZE &&                               \
+         arenas[(POOL)->arenaindex].address != 0)
+
+/*
+ * Allocate a new arena and link it as the only usable arena.  Returns
+ * NULL if the system allocator fails (or the memory limit is reached).
+ * Must be called only when usable_arenas is NULL: the arenas table may
+ * move, and full arenas are not linked anywhere.
+ */
+static struct arena_object *
+new_arena(void)
+{
+        struct arena_object *arenaobj;
+        uint i, numarenas;
+        size_t nbytes;
+        block *bp;
+#ifdef SYMBIAN
+        SPy_Python_globals* pyglobals = PYTHON_GLOBALS;
+#endif
+
+#ifdef WITH_MEMORY_LIMITS
+        if (!(narenas < MAX_ARENAS))
+                return NULL;
+#endif
+        if (unused_arena_objects == NULL) {
+                /* Double the number of arena objects on each allocation */
+                numarenas = maxarenas ? maxarenas << 1 : INITIAL_ARENA_OBJECTS;
+                if (numarenas <= maxarenas)
+                        return NULL;    /* overflow */
+                nbytes = numarenas * sizeof(*arenas);
+                if (nbytes / sizeof(*arenas) != numarenas)
+                        return NULL;    /* overflow */
+                arenaobj = (struct arena_object *)_SYSTEM_REALLOC(arenas,
+                                                                  nbytes);
+                if (arenaobj == NULL)
+                        return NULL;
+                arenas = arenaobj;
+                for (i = maxarenas; i < numarenas; ++i) {
+                        arenas[i].address = 0;  /* mark as unassociated */
+                        arenas[i].nextarena = i < numarenas - 1 ?
+                                              &arenas[i+1] : NULL;
+                }
+                unused_arena_objects = &arenas[maxarenas];
+                maxarenas = numarenas;
+        }
+
+        /*
+         * With malloc, we can't avoid loosing one page address space
+         * per arena due to the required alignment on page boundaries.
+         */
+        bp = (block *)_SYSTEM_MALLOC(ARENA_ALLOC_SIZE);
+        if (bp == NULL)
+                return NULL;
+        arenaobj = unused_arena_objects;
+        unused_arena_objects = arenaobj->nextarena;
+        arenaobj->address = (uptr)bp;
+        arenaobj->pool_address = ARENA_FIRST_POOL(bp);
+        arenaobj->nfreepools = ARENA_NB_POOLS;
+        arenaobj->ntotalpools = ARENA_NB_POOLS;
+        arenaobj->freepools = NULL;
+        arenaobj->nextarena = NULL;
+        arenaobj->prevarena = NULL;
+        usable_arenas = arenaobj;
+        ++narenas;
+        ++arenas_allocated;
+        return arenaobj;
+}
 
 /*
  * Hooks
@@ -497,15 +632,28 @@ _THIS_MALLOC(size_t nbytes)
                         return (void *)bp;
                 }
                 /*
-                 * Try to get a cached free pool
+                 * Take a free pool from the fullest usable arena,
+                 * allocating a new arena if there is none.
                  */
-                pool = freepools;
+                if (usable_arenas == NULL && new_arena() == NULL) {
+                        UNLOCK();
+                        goto redirect;
+                }
+                pool = usable_arenas->freepools;
                 if (pool != NULL) {
                         /*
                          * Unlink from cached pools
                          */
-                        freepools = pool->nextpool;
-                init_pool:
+                        usable_arenas->freepools = pool->nextpool;
+                pool_taken:
+                        if (--usable_arenas->nfreepools == 0) {
+                                /*
+                                 * This arena is now full, unlink it
+                                 */
+                                usable_arenas = usable_arenas->nextarena;
+                                if (usable_arenas != NULL)
+                                        usable_arenas->prevarena = NULL;
+                        }
                         /*
                          * Frontlink to used pools
                          */
@@ -541,51 +689,13 @@ _THIS_MALLOC(size_t nbytes)
                         return (void *)bp;
                 }
                 /*
-                 * Allocate new pool
-                 */
-                if (watermark < ARENA_NB_POOLS) {
-                        /* commit malloc(POOL_SIZE) from the current arena */
-                commit_pool:
-                        watermark++;
-                        pool = (poolp )arenabase;
-                        arenabase += POOL_SIZE;
-                        pool->pooladdr = pool;
-                        pool->magic = (uint )POOL_MAGIC;
-                        pool->szidx = DUMMY_SIZE_IDX;
-                        goto init_pool;
-                }
-                /*
-                 * Allocate new arena
+                 * Carve a new pool off the arena's untouched space
                  */
-#ifdef WITH_MEMORY_LIMITS
-                if (!(arenacnt < MAX_ARENAS)) {
-                        UNLOCK();
-                        goto redirect;
-                }
-#endif
-                /*
-                 * With malloc, we can't avoid loosing one page address space
-                 * per arena due to the required alignment on page boundaries.
-                 */
-                bp = (block *)_SYSTEM_MALLOC(ARENA_SIZE + SYSTEM_PAGE_SIZE);
-                if (bp == NULL) {
-                        UNLOCK();
-                        goto redirect;
-                }
-                /* 
-                 * Keep a reference in the list of allocated arenas. We might
-                 * want to release (some of) them in the future. The first
-                 * word is never used, no matter whether the returned address
-                 * is page-aligned or not, so we safely store a pointer in it.
-                 */
-                *(block **)bp = arenalist;
-                arenalist = bp;
-                arenacnt++;
-                watermark = 0;
-                /* Page-round up */
-                arenabase = bp + (SYSTEM_PAGE_SIZE -
-                                  ((off_t )bp & SYSTEM_PAGE_SIZE_MASK));
-                goto commit_pool;
+                pool = (poolp )usable_arenas->pool_address;
+                usable_arenas->pool_address += POOL_SIZE;
+                pool->arenaindex = usable_arenas - arenas;
+                pool->szidx = DUMMY_SIZE_IDX;
+                goto pool_taken;
         }
 
         /* The small block allocator ends here. */
@@ -610,6 +720,8 @@ _THIS_FREE(void *p)
         poolp next, prev;
         uint size;
         off_t offset;
+        struct arena_object *ao;
+        uint nf;
 #ifdef SYMBIAN
         SPy_Python_globals* pyglobals;
 #endif
@@ -624,16 +736,16 @@ _THIS_FREE(void *p)
         if (p == NULL)  /* free(NULL) has no effect */
                 return;
 
+#ifdef SYMBIAN
+        pyglobals = PYTHON_GLOBALS; // avoid TLS reads
+#endif
         offset = (off_t )p & POOL_SIZE_MASK;
         pool = (poolp )((block *)p - offset);
-        if (pool->pooladdr != pool || pool->magic != (uint )POOL_MAGIC) {
+        if (!ADDRESS_IN_RANGE(p, pool)) {
                 _SYSTEM_FREE(p);
                 return;
         }
 
-#ifdef SYMBIAN
-        pyglobals = PYTHON_GLOBALS; // avoid TLS reads
-#endif
         LOCK();
         /*
          * At this point, the pool is not empty
@@ -676,12 +788,70 @@ _THIS_FREE(void *p)
         next->prevpool = prev;
         prev->nextpool = next;
         /*
-         * Frontlink to free pools
+         * Frontlink to the free pools of its arena
          * This ensures that previously freed pools will be allocated
          * later (being not referenced, they are perhaps paged out).
          */
-        pool->nextpool = freepools;
-        freepools = pool;
+        ao = &arenas[pool->arenaindex];
+        pool->nextpool = ao->freepools;
+        ao->freepools = pool;
+        nf = ++ao->nfreepools;
+
+        if (nf == ao->ntotalpools && ao->nextarena != NULL) {
+                /*
+                 * The arena is entirely free and another usable arena
+                 * follows it: give the memory back to the system.  The
+                 * last usable arena is kept even when it is empty, so
+                 * that a program allocating and freeing around an arena
+                 * boundary doesn't call the system allocator each time.
+                 */
+                if (ao->prevarena == NULL)
+                        usable_arenas = ao->nextarena;
+                else
+                        ao->prevarena->nextarena = ao->nextarena;
+                ao->nextarena->prevarena = ao->prevarena;
+                ao->nextarena = unused_arena_objects;
+                unused_arena_objects = ao;
+                _SYSTEM_FREE((void *)ao->address);
+                ao->address = 0;
+                --narenas;
+                ++arenas_freed;
+                UNLOCK();
+                return;
+        }
+        if (nf == 1) {
+                /*
+                 * The arena was full and is not linked anywhere.  It now
+                 * has the fewest free pools, so it goes in front.
+                 */
+                ao->nextarena = usable_arenas;
+                ao->prevarena = NULL;
+                if (usable_arenas != NULL)
+                        usable_arenas->prevarena = ao;
+                usable_arenas = ao;
+                UNLOCK();
+                return;
+        }
+        /*
+         * Keep usable_arenas sorted by nfreepools: the arena may have to
+         * move towards the end of the list.
+         */
+        if (ao->nextarena == NULL || nf <= ao->nextarena->nfreepools) {
+                UNLOCK();
+                return;
+        }
+        if (ao->prevarena == NULL)
+                usable_arenas = ao->nextarena;
+        else
+                ao->prevarena->nextarena = ao->nextarena;
+        ao->nextarena->prevarena = ao->prevarena;
+        while (ao->nextarena != NULL && nf > ao->nextarena->nfreepools) {
+                ao->prevarena = ao->nextarena;
+                ao->nextarena = ao->nextarena->nextarena;
+        }
+        ao->prevarena->nextarena = ao;
+        if (ao->nextarena != NULL)
+                ao->nextarena->prevarena = ao;
         UNLOCK();
         return;
 }
@@ -694,6 +864,9 @@ _THIS_REALLOC(void *p, size_t nbytes)
         block *bp;
         poolp pool;
         uint size;
+#ifdef SYMBIAN
+        SPy_Python_globals* pyglobals;
+#endif
 
 #ifdef WITH_MALLOC_HOOKS
         if (realloc_hook != NULL)
@@ -703,9 +876,12 @@ _THIS_REALLOC(void *p, size_t nbytes)
         if (p == NULL)
                 return _THIS_MALLOC(nbytes);
 
+#ifdef SYMBIAN
+        pyglobals = PYTHON_GLOBALS; // avoid TLS reads
+#endif
         /* realloc(p, 0) on big blocks is redirected. */
         pool = (poolp )((block *)p - ((off_t )p & POOL_SIZE_MASK));
-        if (pool->pooladdr != pool || pool->magic != (uint )POOL_MAGIC) {
+        if (!ADDRESS_IN_RANGE(p, pool)) {
                 /* We haven't allocated this block */
                 if (!(nbytes > SMALL_REQUEST_THRESHOLD) && nbytes) {
                         /* small request */
@@ -765,6 +941,103 @@ _THIS_CALLOC(size_t nbel, size_t elsz)
 
 /*==========================================================================*/
 
+/*
+ * Statistics, for sys.getallocstats()
+ */
+
+static int
+add_alloc_stat(PyObject *d, char *name, PyObject *v)
+{
+        int status;
+
+        if (v == NULL)
+                return -1;
+        status = PyDict_SetItemString(d, name, v);
+        Py_DECREF(v);
+        return status;
+}
+
+PyObject *
+_PyObject_GetAllocStats(PyObject *self)
+{
+        ulong nblocks[NB_SMALL_SIZE_CLASSES];
+        ulong npools[NB_SMALL_SIZE_CLASSES];
+        ulong npoolsused = 0, npoolsfree = 0, used = 0, reserved;
+        struct arena_object *ao;
+        block *base;
+        poolp pool;
+        PyObject *d, *classes, *t;
+        uint i;
+#ifdef SYMBIAN
+        SPy_Python_globals* pyglobals = PYTHON_GLOBALS;
+#endif
+
+        /*
+         * Walk the arenas before creating any object, since that would
+         * change what is being counted.
+         */
+        memset(nblocks, 0, sizeof(nblocks));
+        memset(npools, 0, sizeof(npools));
+        for (ao = arenas; ao < arenas + maxarenas; ao++) {
+                if (ao->address == 0)
+                        continue;
+                npoolsfree += ao->nfreepools;
+                base = ARENA_FIRST_POOL(ao->address);
+                for (; base < ao->pool_address; base += POOL_SIZE) {
+                        pool = (poolp )base;
+                        if (pool->ref.count == 0)
+                                continue;
+                        npools[pool->szidx]++;
+                        nblocks[pool->szidx] += pool->ref.count;
+                        used += (ulong)pool->ref.count *
+                                ((pool->szidx + 1) << ALIGNMENT_SHIFT);
+                        npoolsused++;
+                }
+        }
+        reserved = (ulong)narenas * ARENA_SIZE;
+
+        d = PyDict_New();
+        if (d == NULL)
+                return NULL;
+        classes = PyTuple_New(NB_SMALL_SIZE_CLASSES);
+        if (classes == NULL)
+                goto error;
+        for (i = 0; i < NB_SMALL_SIZE_CLASSES; i++) {
+                t = Py_BuildValue("(ill)", (int)((i + 1) << ALIGNMENT_SHIFT),
+                                  (long)npools[i], (long)nblocks[i]);
+                if (t == NULL) {
+                        Py_DECREF(classes);
+                        goto error;
+                }
+                PyTuple_SET_ITEM(classes, i, t);
+        }
+        if (add_alloc_stat(d, "size_classes", classes) < 0 ||
+            add_alloc_stat(d, "arenas", PyInt_FromLong((long)narenas)) < 0 ||
+            add_alloc_stat(d, "arenas_allocated",
+                           PyLong_FromUnsignedLong(arenas_allocated)) < 0 ||
+            add_alloc_stat(d, "arenas_freed",
+                           PyLong_FromUnsignedLong(arenas_freed)) < 0 ||
+            add_alloc_stat(d, "arena_size", PyInt_FromLong(ARENA_SIZE)) < 0 ||
+            add_alloc_stat(d, "pools_used",
+                           PyInt_FromLong((long)npoolsused)) < 0 ||
+            add_alloc_stat(d, "pools_free",
+                           PyInt_FromLong((long)npoolsfree)) < 0 ||
+            add_alloc_stat(d, "bytes_used", PyInt_FromLong((long)used)) < 0 ||
+            add_alloc_stat(d, "bytes_reserved",
+                           PyInt_FromLong((long)reserved)) < 0 ||
+            add_alloc_stat(d, "fragmentation",
+                           PyFloat_FromDouble(reserved ?
+                                1.0 - (double)used / reserved : 0.0)) < 0)
+                goto error;
+        return d;
+
+  error:
+        Py_DECREF(d);
+        return NULL;
+}
+
+/*==========================================================================*/
+
 /*
  * Hooks
  */
@@ -5,6 +5,9 @@
 
 #include <ctype.h>
 
+#define STRINGLIB_CHAR char
+#include "fastsearch.h"
+
 #ifdef COUNT_ALLOCS
 int null_strings, one_strings;
 #endif
@@ -841,8 +844,6 @@ string_slice(register PyStringObject *a, register int i, register int j)
 static int
 string_contains(PyObject *a, PyObject *el)
 {
-	register char *s, *end;
-	register char c;
 #ifdef Py_USING_UNICODE
 	if (PyUnicode_Check(el))
 		return PyUnicode_Contains(a, el);
@@ -852,14 +853,8 @@ string_contains(PyObject *a, PyObject *el)
 		    "'in <string>' requires character as left operand");
 		return -1;
 	}
-	c = PyString_AsString(el)[0];
-	s = PyString_AsString(a);
-	end = s + PyString_Size(a);
-	while (s < end) {
-		if (c == *s++)
-			return 1;
-	}
-	return 0;
+	return memchr(PyString_AS_STRING(a), PyString_AS_STRING(el)[0],
+		      PyString_GET_SIZE(a)) != NULL;
 }
 
 static PyObject *
@@ -1118,14 +1113,14 @@ whitespace string is a separator.";
 #endif
 
 static PyObject *
-string_split(PyStringObject *self, PyObject *args)
+string_split(PyStringObject *self, PyObject **args, int nargs)
 {
-	int len = PyString_GET_SIZE(self), n, i, j, err;
+	int len = PyString_GET_SIZE(self), n, i, j, pos, err;
 	int maxsplit = -1;
 	const char *s = PyString_AS_STRING(self), *sub;
 	PyObject *list, *item, *subobj = Py_None;
 
-	if (!PyArg_ParseTuple(args, "|Oi:split", &subobj, &maxsplit))
+	if (!_PyArg_ParseStack(args, nargs, "|Oi:split", &subobj, &maxsplit))
 		return NULL;
 	if (maxsplit < 0)
 		maxsplit = INT_MAX;
@@ -1150,22 +1145,20 @@ string_split(PyStringObject *self, PyObject *args)
 	if (list == NULL)
 		return NULL;
 
-	i = j = 0;
-	while (i+n <= len) {
-		if (s[i] == sub[0] && memcmp(s+i, sub, n) == 0) {
-			if (maxsplit-- <= 0)
-				break;
-			item = PyString_FromStringAndSize(s+j, (int)(i-j));
-			if (item == NULL)
-				goto fail;
-			err = PyList_Append(list, item);
-			Py_DECREF(item);
-			if (err < 0)
-				goto fail;
-			i = j = i + n;
-		}
-		else
-			i++;
+	j = 0;
+	while (maxsplit-- > 0) {
+		pos = fastsearch(s+j, len-j, sub, n, 0, FAST_SEARCH);
+		if (pos < 0)
+			break;
+		i = j + pos;
+		item = PyString_FromStringAndSize(s+j, (int)(i-j));
+		if (item == NULL)
+			goto fail;
+		err = PyList_Append(list, item);
+		Py_DECREF(item);
+		if (err < 0)
+			goto fail;
+		j = i + n;
 	}
 	item = PyString_FromStringAndSize(s+j, (int)(len-j));
 	if (item == NULL)
@@ -1307,14 +1300,14 @@ _PyString_Join(PyObject *sep, PyObject *x)
 }
 
 static long
-string_find_internal(PyStringObject *self, PyObject *args, int dir)
+string_find_internal(PyStringObject *self, PyObject **args, int nargs, int dir)
 {
 	const char *s = PyString_AS_STRING(self), *sub;
 	int len = PyString_GET_SIZE(self);
 	int n, i = 0, last = INT_MAX;
 	PyObject *subobj;
 
-	if (!PyArg_ParseTuple(args, "O|O&O&:find/rfind/index/rindex",
+	if (!_PyArg_ParseStack(args, nargs, "O|O&O&:find/rfind/index/rindex",
 		&subobj, _PyEval_SliceIndex, &i, _PyEval_SliceIndex, &last))
 		return -2;
 	if (PyString_Check(subobj)) {
@@ -1339,25 +1332,15 @@ string_find_internal(PyStringObject *self, PyObject *args, int dir)
 	if (i < 0)
 		i = 0;
 
-	if (dir > 0) {
-		if (n == 0 && i <= last)
-			return (long)i;
-		last -= n;
-		for (; i <= last; ++i)
-			if (s[i] == sub[0] && memcmp(&s[i], sub, n) == 0)
-				return (long)i;
-	}
-	else {
-		int j;
-
-        	if (n == 0 && i <= last)
-			return (long)last;
-		for (j = last-n; j >= i; --j)
-			if (s[j] == sub[0] && memcmp(&s[j], sub, n) == 0)
-				return (long)j;
-	}
-
-	return -1;
+	if (n == 0 && i <= last)
+		return (long)(dir > 0 ? i : last);
+	if (last - i < n)
+		return -1;
+	n = fastsearch(s+i, last-i, sub, n, 0,
+		       dir > 0 ? FAST_SEARCH : FAST_RSEARCH);
+	if (n < 0)
+		return -1;
+	return (long)(i + n);
 }
 
 
@@ -1375,9 +1358,9 @@ Return -1 on failure.";
 #endif
 
 static PyObject *
-string_find(PyStringObject *self, PyObject *args)
+string_find(PyStringObject *self, PyObject **args, int nargs)
 {
-	long result = string_find_internal(self, args, +1);
+	long result = string_find_internal(self, args, nargs, +1);
 	if (result == -2)
 		return NULL;
 	return PyInt_FromLong(result);
@@ -1394,9 +1377,9 @@ Like S.find() but raise ValueError when the substring is not found.";
 #endif
 
 static PyObject *
-string_index(PyStringObject *self, PyObject *args)
+string_index(PyStringObject *self, PyObject **args, int nargs)
 {
-	long result = string_find_internal(self, args, +1);
+	long result = string_find_internal(self, args, nargs, +1);
 	if (result == -2)
 		return NULL;
 	if (result == -1) {
@@ -1422,9 +1405,9 @@ Return -1 on failure.";
 #endif
 
 static PyObject *
-string_rfind(PyStringObject *self, PyObject *args)
+string_rfind(PyStringObject *self, PyObject **args, int nargs)
 {
-	long result = string_find_internal(self, args, -1);
+	long result = string_find_internal(self, args, nargs, -1);
 	if (result == -2)
 		return NULL;
 	return PyInt_FromLong(result);
@@ -1441,9 +1424,9 @@ Like S.rfind() but raise ValueError when the substring is not found.";
 #endif
 
 static PyObject *
-string_rindex(PyStringObject *self, PyObject *args)
+string_rindex(PyStringObject *self, PyObject **args, int nargs)
 {
-	long result = string_find_internal(self, args, -1);
+	long result = string_find_internal(self, args, nargs, -1);
 	if (result == -2)
 		return NULL;
 	if (result == -1) {
@@ -1519,11 +1502,12 @@ do_strip(PyStringObject *self, int striptype)
 
 
 static PyObject *
-do_argstrip(PyStringObject *self, int striptype, PyObject *args)
+do_argstrip(PyStringObject *self, int striptype, PyObject **args, int nargs)
 {
 	PyObject *sep = NULL;
 
-	if (!PyArg_ParseTuple(args, (char *)stripformat[striptype], &sep))
+	if (!_PyArg_ParseStack(args, nargs,
+			       (char *)stripformat[striptype], &sep))
 		return NULL;
 
 	if (sep != NULL && sep != Py_None) {
@@ -1571,12 +1555,12 @@ If sep is unicode, S will be converted to unicode before stripping";
 #endif
 
 static PyObject *
-string_strip(PyStringObject *self, PyObject *args)
+string_strip(PyStringObject *self, PyObject **args, int nargs)
 {
-	if (PyTuple_GET_SIZE(args) == 0)
+	if (nargs == 0)
 		return do_strip(self, BOTHSTRIP); /* Common case */
 	else
-		return do_argstrip(self, BOTHSTRIP, args);
+		return do_argstrip(self, BOTHSTRIP, args, nargs);
 }
 
 
@@ -1592,12 +1576,12 @@ If sep is unicode, S will be converted to unicode before stripping";
 #endif
 
 static PyObject *
-string_lstrip(PyStringObject *self, PyObject *args)
+string_lstrip(PyStringObject *self, PyObject **args, int nargs)
 {
-	if (PyTuple_GET_SIZE(args) == 0)
+	if (nargs == 0)
 		return do_strip(self, LEFTSTRIP); /* Common case */
 	else
-		return do_argstrip(self, LEFTSTRIP, args);
+		return do_argstrip(self, LEFTSTRIP, args, nargs);
 }
 
 
@@ -1613,12 +1597,12 @@ If sep is unicode, S will be converted to unicode before stripping";
 #endif
 
 static PyObject *
-string_rstrip(PyStringObject *self, PyObject *args)
+string_rstrip(PyStringObject *self, PyObject **args, int nargs)
 {
-	if (PyTuple_GET_SIZE(args) == 0)
+	if (nargs == 0)
 		return do_strip(self, RIGHTSTRIP); /* Common case */
 	else
-		return do_argstrip(self, RIGHTSTRIP, args);
+		return do_argstrip(self, RIGHTSTRIP, args, nargs);
 }
 
 
@@ -1778,15 +1762,15 @@ interpreted as in slice notation.";
 #endif
 
 static PyObject *
-string_count(PyStringObject *self, PyObject *args)
+string_count(PyStringObject *self, PyObject **args, int nargs)
 {
 	const char *s = PyString_AS_STRING(self), *sub;
 	int len = PyString_GET_SIZE(self), n;
 	int i = 0, last = INT_MAX;
-	int m, r;
+	int m;
 	PyObject *subobj;
 
-	if (!PyArg_ParseTuple(args, "O|O&O&:count", &subobj,
+	if (!_PyArg_ParseStack(args, nargs, "O|O&O&:count", &subobj,
 		_PyEval_SliceIndex, &i, _PyEval_SliceIndex, &last))
 		return NULL;
 
@@ -1820,17 +1804,11 @@ string_count(PyStringObject *self, PyObject *args)
 	m = last + 1 - n;
 	if (n == 0)
 		return PyInt_FromLong((long) (m-i));
+	if (last - i < n)
+		return PyInt_FromLong(0L);
 
-	r = 0;
-	while (i < m) {
-		if (!memcmp(s+i, sub, n)) {
-			r++;
-			i += n;
-		} else {
-			i++;
-		}
-	}
-	return PyInt_FromLong((long) r);
+	return PyInt_FromLong((long) fastsearch(s+i, last-i, sub, n, INT_MAX,
+						 FAST_COUNT));
 }
 
 
@@ -1995,56 +1973,6 @@ string_translate(PyStringObject *self, PyObject *args)
 
 /* What follows is used for implementing replace().  Perry Stoll. */
 
-/*
-  mymemfind
-
-  strstr replacement for arbitrary blocks of memory.
-
-  Locates the first occurrence in the memory pointed to by MEM of the
-  contents of memory pointed to by PAT.  Returns the index into MEM if
-  found, or -1 if not found.  If len of PAT is greater than length of
-  MEM, the function returns -1.
-*/
-static int
-mymemfind(const char *mem, int len, const char *pat, int pat_len)
-{
-	register int ii;
-
-	/* pattern can not occur in the last pat_len-1 chars */
-	len -= pat_len;
-
-	for (ii = 0; ii <= len; ii++) {
-		if (mem[ii] == pat[0] && memcmp(&mem[ii], pat, pat_len) == 0) {
-			return ii;
-		}
-	}
-	return -1;
-}
-
-/*
-  mymemcnt
-
-   Return the number of distinct times PAT is found in MEM.
-   meaning mem=1111 and pat==11 returns 2.
-           mem=11111 and pat==11 also return 2.
- */
-static int
-mymemcnt(const char *mem, int len, const char *pat, int pat_len)
-{
-	register int offset = 0;
-	int nfound = 0;
-
-	while (len >= 0) {
-		offset = mymemfind(mem, len, pat, pat_len);
-		if (offset == -1)
-			break;
-		mem += offset + pat_len;
-		len -= offset + pat_len;
-		nfound++;
-	}
-	return nfound;
-}
-
 /*
    mymemreplace
 
@@ -2079,11 +2007,9 @@ mymemreplace(const char *str, int len,		/* input string */
 		goto return_same;
 
 	/* find length of output string */
-	nfound = mymemcnt(str, len, pat, pat_len);
 	if (count < 0)
 		count = INT_MAX;
-	else if (nfound > count)
-		nfound = count;
+	nfound = fastsearch(str, len, pat, pat_len, count, FAST_COUNT);
 	if (nfound == 0)
 		goto return_same;
 
@@ -2104,7 +2030,8 @@ mymemreplace(const char *str, int len,		/* input string */
 
 		for (; count > 0 && len > 0; --count) {
 			/* find index of next instance of pattern */
-			offset = mymemfind(str, len, pat, pat_len);
+			offset = fastsearch(str, len, pat, pat_len, 0,
+					    FAST_SEARCH);
 			if (offset == -1)
 				break;
 
@@ -2143,7 +2070,7 @@ given, only the first maxsplit occurrences are replaced.";
 #endif
 
 static PyObject *
-string_replace(PyStringObject *self, PyObject *args)
+string_replace(PyStringObject *self, PyObject **args, int nargs)
 {
 	const char *str = PyString_AS_STRING(self), *sub, *repl;
 	char *new_s;
@@ -2153,7 +2080,7 @@ string_replace(PyStringObject *self, PyObject *args)
 	PyObject *new;
 	PyObject *subobj, *replobj;
 
-	if (!PyArg_ParseTuple(args, "OO|i:replace",
+	if (!_PyArg_ParseStack(args, nargs, "OO|i:replace",
 			      &subobj, &replobj, &count))
 		return NULL;
 
@@ -2222,7 +2149,7 @@ comparing S at that position.";
 #endif
 
 static PyObject *
-string_startswith(PyStringObject *self, PyObject *args)
+string_startswith(PyStringObject *self, PyObject **args, int nargs)
 {
 	const char* str = PyString_AS_STRING(self);
 	int len = PyString_GET_SIZE(self);
@@ -2232,7 +2159,7 @@ string_startswith(PyStringObject *self, PyObject *args)
 	int end = INT_MAX;
 	PyObject *subobj;
 
-	if (!PyArg_ParseTuple(args, "O|O&O&:startswith", &subobj,
+	if (!_PyArg_ParseStack(args, nargs, "O|O&O&:startswith", &subobj,
 		_PyEval_SliceIndex, &start, _PyEval_SliceIndex, &end))
 		return NULL;
 	if (PyString_Check(subobj)) {
@@ -2285,7 +2212,7 @@ comparing S at that position.";
 #endif
 
 static PyObject *
-string_endswith(PyStringObject *self, PyObject *args)
+string_endswith(PyStringObject *self, PyObject **args, int nargs)
 {
 	const char* str = PyString_AS_STRING(self);
 	int len = PyString_GET_SIZE(self);
@@ -2296,7 +2223,7 @@ string_endswith(PyStringObject *self, PyObject *args)
 	int lower, upper;
 	PyObject *subobj;
 
-	if (!PyArg_ParseTuple(args, "O|O&O&:endswith", &subobj,
+	if (!_PyArg_ParseStack(args, nargs, "O|O&O&:endswith", &subobj,
 		_PyEval_SliceIndex, &start, _PyEval_SliceIndex, &end))
 		return NULL;
 	if (PyString_Check(subobj)) {
@@ -2954,7 +2881,7 @@ string_methods[] = {
 	/* Counterparts of the obsolete stropmodule functions; except
 	   string.maketrans(). */
 	{"join",       (PyCFunction)string_join,   METH_O, join__doc__},
-	{"split",       (PyCFunction)string_split, METH_VARARGS, split__doc__},
+	{"split",       (PyCFunction)string_split, METH_FASTCALL, split__doc__},
 	{"lower",      (PyCFunction)string_lower,  METH_NOARGS, lower__doc__},
 	{"upper",       (PyCFunction)string_upper, METH_NOARGS, upper__doc__},
 	{"islower", (PyCFunction)string_islower, METH_NOARGS, islower__doc__},
@@ -2966,19 +2893,19 @@ string_methods[] = {
 	{"isalnum", (PyCFunction)string_isalnum, METH_NOARGS, isalnum__doc__},
 	{"capitalize", (PyCFunction)string_capitalize,  METH_NOARGS,
 	 capitalize__doc__},
-	{"count",      (PyCFunction)string_count,       METH_VARARGS, count__doc__},
-	{"endswith",   (PyCFunction)string_endswith,    METH_VARARGS,
+	{"count",      (PyCFunction)string_count,       METH_FASTCALL, count__doc__},
+	{"endswith",   (PyCFunction)string_endswith,    METH_FASTCALL,
 	 endswith__doc__},
-	{"find",       (PyCFunction)string_find,        METH_VARARGS, find__doc__},
-	{"index",      (PyCFunction)string_index,       METH_VARARGS, index__doc__},
-	{"lstrip",     (PyCFunction)string_lstrip,      METH_VARARGS, lstrip__doc__},
-	{"replace",     (PyCFunction)string_replace,    METH_VARARGS, replace__doc__},
-	{"rfind",       (PyCFunction)string_rfind,      METH_VARARGS, rfind__doc__},
-	{"rindex",      (PyCFunction)string_rindex,     METH_VARARGS, rindex__doc__},
-	{"rstrip",      (PyCFunction)string_rstrip,     METH_VARARGS, rstrip__doc__},
-	{"startswith",  (PyCFunction)string_startswith, METH_VARARGS,
+	{"find",       (PyCFunction)string_find,        METH_FASTCALL, find__doc__},
+	{"index",      (PyCFunction)string_index,       METH_FASTCALL, index__doc__},
+	{"lstrip",     (PyCFunction)string_lstrip,      METH_FASTCALL, lstrip__doc__},
+	{"replace",     (PyCFunction)string_replace,    METH_FASTCALL, replace__doc__},
+	{"rfind",       (PyCFunction)string_rfind,      METH_FASTCALL, rfind__doc__},
+	{"rindex",      (PyCFunction)string_rindex,     METH_FASTCALL, rindex__doc__},
+	{"rstrip",      (PyCFunction)string_rstrip,     METH_FASTCALL, rstrip__doc__},
+	{"startswith",  (PyCFunction)string_startswith, METH_FASTCALL,
 	 startswith__doc__},
-	{"strip",       (PyCFunction)string_strip,      METH_VARARGS, strip__doc__},
+	{"strip",       (PyCFunction)string_strip,      METH_FASTCALL, strip__doc__},
 	{"swapcase",    (PyCFunction)string_swapcase,   METH_NOARGS,
 	 swapcase__doc__},
 	{"translate",   (PyCFunction)string_translate,  METH_VARARGS,
@@ -3905,8 +3832,17 @@ PyString_Format(PyObject *format, PyObject *args)
  */
 #ifndef SYMBIAN
 static PyObject *interned;
+/* Interning statistics, reported by sys.getinternstats() */
+static unsigned long intern_requests = 0;
+static unsigned long intern_cached = 0;	/* answered by ob_sinterned */
+static unsigned long intern_found = 0;	/* answered by the table */
+static unsigned long intern_added = 0;	/* new table entries */
 #else
 #define interned (pyglobals->interned)
+#define intern_requests (pyglobals->intern_requests)
+#define intern_cached (pyglobals->intern_cached)
+#define intern_found (pyglobals->intern_found)
+#define intern_added (pyglobals->intern_added)
 #endif
 
 DL_EXPORT(void)
@@ -3920,7 +3856,9 @@ PyString_InternInPlace(PyObject **p)
 
 	if (s == NULL || !PyString_Check(s))
 		Py_FatalError("PyString_InternInPlace: strings only please!");
+	intern_requests++;
 	if ((t = s->ob_sinterned) != NULL) {
+		intern_cached++;
 		if (t == (PyObject *)s)
 			return;
 		Py_INCREF(t);
@@ -3934,6 +3872,7 @@ PyString_InternInPlace(PyObject **p)
 			return;
 	}
 	if ((t = PyDict_GetItem(interned, (PyObject *)s)) != NULL) {
+		intern_found++;
 		Py_INCREF(t);
 		*p = s->ob_sinterned = t;
 		Py_DECREF(s);
@@ -3944,6 +3883,7 @@ PyString_InternInPlace(PyObject **p)
 	if (PyString_CheckExact(s)) {
 		t = (PyObject *)s;
 		if (PyDict_SetItem(interned, t, t) == 0) {
+			intern_added++;
 			s->ob_sinterned = t;
 			return;
 		}
@@ -3953,6 +3893,7 @@ PyString_InternInPlace(PyObject **p)
 						PyString_GET_SIZE(s));
 		if (t != NULL) {
 			if (PyDict_SetItem(interned, t, t) == 0) {
+				intern_added++;
 				*p = s->ob_sinterned = t;
 				Py_DECREF(s);
 				return;
@@ -3963,6 +3904,26 @@ PyString_InternInPlace(PyObject **p)
 	PyErr_Clear();
 }
 
+/* Return the interned string equal to s, borrowed, or NULL if there is
+   none.  Unlike PyString_InternInPlace() this never adds to the table:
+   interned strings are immortal, so interning names that are built at
+   run time would grow the table without bound. */
+PyObject *
+_PyString_LookupInterned(PyObject *s)
+{
+	PyObject *t = ((PyStringObject *)s)->ob_sinterned;
+#ifdef SYMBIAN
+	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
+#endif
+
+	if (t != NULL || interned == NULL)
+		return t;
+	t = PyDict_GetItem(interned, s);
+	if (t != NULL)
+		((PyStringObject *)s)->ob_sinterned = t;
+	return t;
+}
+
 
 DL_EXPORT(PyObject *)
 PyString_InternFromString(const char *cp)
@@ -3974,6 +3935,56 @@ PyString_InternFromString(const char *cp)
 	return s;
 }
 
+static int
+add_intern_stat(PyObject *d, char *name, unsigned long value)
+{
+	PyObject *v = PyLong_FromUnsignedLong(value);
+	int err;
+
+	if (v == NULL)
+		return -1;
+	err = PyDict_SetItemString(d, name, v);
+	Py_DECREF(v);
+	return err;
+}
+
+PyObject *
+_PyString_GetInternStats(PyObject *self)
+{
+	PyObject *d, *key, *value;
+	unsigned long count = 0, size = 0;
+	unsigned long requests, cached, found, added;
+	int pos = 0;
+#ifdef SYMBIAN
+	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
+#endif
+
+	/* Take a snapshot: filling in the result interns its keys. */
+	requests = intern_requests;
+	cached = intern_cached;
+	found = intern_found;
+	added = intern_added;
+	if (interned != NULL) {
+		while (PyDict_Next(interned, &pos, &key, &value)) {
+			count++;
+			size += PyString_GET_SIZE(key);
+		}
+	}
+	d = PyDict_New();
+	if (d == NULL)
+		return NULL;
+	if (add_intern_stat(d, "strings", count) < 0 ||
+	    add_intern_stat(d, "bytes", size) < 0 ||
+	    add_intern_stat(d, "requests", requests) < 0 ||
+	    add_intern_stat(d, "cached", cached) < 0 ||
+	    add_intern_stat(d, "found", found) < 0 ||
+	    add_intern_stat(d, "added", added) < 0) {
+		Py_DECREF(d);
+		return NULL;
+	}
+	return d;
+}
+
 #endif
 
 DL_EXPORT(void)
@@ -9,7 +9,7 @@
 #define MAXSAVESIZE	20  /* Largest tuple to save on free list */
 #endif
 #ifndef MAXSAVEDTUPLES
-#define MAXSAVEDTUPLES  2000  /* Maximum number of tuples of each size to save */
+#define MAXSAVEDTUPLES  2000  /* Default number of tuples of each size to save */
 #endif
 
 #if MAXSAVESIZE > 0
@@ -24,6 +24,11 @@ static int num_free_tuples[MAXSAVESIZE];
 #define num_free_tuples (pyglobals->num_free_tuples)
 #endif /* SYMBIAN */
 #endif
+#ifndef SYMBIAN
+static PyFreeListStats tuple_freelist = {0, 0, 0, MAXSAVEDTUPLES};
+#else
+#define tuple_freelist (pyglobals->tuple_freelist)
+#endif
 #ifdef COUNT_ALLOCS
 int fast_tuple_allocs;
 int tuple_zero_allocs;
@@ -55,6 +60,7 @@ PyTuple_New(register int size)
 	{
 		free_tuples[size] = (PyTupleObject *) op->ob_item[0];
 		num_free_tuples[size]--;
+		tuple_freelist.hits++;
 #ifdef COUNT_ALLOCS
 		fast_tuple_allocs++;
 #endif
@@ -76,6 +82,10 @@ PyTuple_New(register int size)
 		{
 			return PyErr_NoMemory();
 		}
+#if MAXSAVESIZE > 0
+		if (0 < size && size < MAXSAVESIZE)
+			tuple_freelist.misses++;
+#endif
 		op = PyObject_GC_NewVar(PyTupleObject, &PyTuple_Type, size);
 		if (op == NULL)
 			return NULL;
@@ -159,7 +169,8 @@ tupledealloc(register PyTupleObject *op)
 			Py_XDECREF(op->ob_item[i]);
 #if MAXSAVESIZE > 0
 		if (len < MAXSAVESIZE &&
-		    num_free_tuples[len] < MAXSAVEDTUPLES &&
+		    (num_free_tuples[len] < tuple_freelist.limit ||
+		     tuple_freelist.limit < 0) &&
 		    op->ob_type == &PyTuple_Type)
 		{
 			op->ob_item[0] = (PyObject *) free_tuples[len];
@@ -670,21 +681,48 @@ _PyTuple_Resize(PyObject **pv, int newsize)
 	return 0;
 }
 
-DL_EXPORT(void)
-PyTuple_Fini(void)
+/* Bytes taken by a tuple of n items on the free list. */
+#define TUPLE_BYTES(n) \
+	(sizeof(PyTupleObject) + ((n) - 1) * sizeof(PyObject *))
+
+PyFreeListStats *
+_PyTuple_FreeListStats(long *bytes)
 {
+#ifdef SYMBIAN
+	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
+#endif
+#if MAXSAVESIZE > 0
+	int i;
+
+	tuple_freelist.count = 0;
+	*bytes = 0;
+	for (i = 1; i < MAXSAVESIZE; i++) {
+		tuple_freelist.count += num_free_tuples[i];
+		*bytes += num_free_tuples[i] * TUPLE_BYTES(i);
+	}
+#else
+	*bytes = 0;
+#endif
+	return &tuple_freelist;
+}
+
+/* Release the saved tuples, but not the empty tuple. */
+long
+PyTuple_ClearFreeList(void)
+{
+	long freed = 0;
 #if MAXSAVESIZE > 0
 	int i;
 #ifdef SYMBIAN
 	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
 #endif
-	Py_XDECREF(free_tuples[0]);
-	free_tuples[0] = NULL;
 
 	for (i = 1; i < MAXSAVESIZE; i++) {
 		PyTupleObject *p, *q;
 		p = free_tuples[i];
+		freed += num_free_tuples[i] * TUPLE_BYTES(i);
 		free_tuples[i] = NULL;
+		num_free_tuples[i] = 0;
 		while (p) {
 			q = p;
 			p = (PyTupleObject *)(p->ob_item[0]);
@@ -692,4 +730,18 @@ PyTuple_Fini(void)
 		}
 	}
 #endif
+	return freed;
+}
+
+DL_EXPORT(void)
+PyTuple_Fini(void)
+{
+#if MAXSAVESIZE > 0
+#ifdef SYMBIAN
+	SPy_Python_globals* pyglobals = PYTHON_GLOBALS; // avoid TLS reads
+#endif
+	Py_XDECREF(free_tuples[0]);
+	free_tuples[0] = NULL;
+#endif
+	(void)PyTuple_ClearFreeList();
 }
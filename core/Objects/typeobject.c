@@ -15,6 +15,7 @@ typedef struct {
 	PyMappingMethods as_mapping;
 	PyBufferProcs as_buffer;
 	PyObject *name, *slots;
+	PyDictKeysObject *cached_keys;	/* shared by the instance dicts */
 	PyMemberDef members[1];
 } etype;
 
@@ -1306,13 +1307,69 @@ type_new(PyTypeObject *metatype, PyObject *args, PyObject *kwds)
 	return (PyObject *)type;
 }
 
+/* Method cache.
+
+   The results of _PyType_Lookup() for interned names are kept in a small
+   direct-mapped table keyed on (type, name).  An entry is valid while
+   _PyType_Epoch and the version of the type's own tp_dict are what they
+   were when it was filled.  The epoch moves whenever an attribute of a
+   heap type is set or deleted and whenever a heap type goes away, so an
+   entry never outlives the objects it points to.  C code that changes
+   the tp_dict of a base type behind type_setattro()'s back must call
+   _PyType_NewEpoch().  MROs containing classic classes are not cached,
+   since their dicts can change without notice. */
+
+#define MCACHE_SIZE_EXP 8
+#define MCACHE_SIZE (1 << MCACHE_SIZE_EXP)
+#define MCACHE_HASH(type, name) \
+	((((unsigned long)(type) >> 3) ^ \
+	  (unsigned long)((PyStringObject *)(name))->ob_shash) & \
+	 (MCACHE_SIZE - 1))
+
+struct _method_cache_entry {
+	Py_typeepoch_t epoch;
+	Py_dictversion_t version;	/* of type->tp_dict */
+	PyTypeObject *type;
+	PyObject *name;
+	PyObject *value;	/* borrowed; NULL if the name wasn't found */
+};
+
+#ifndef SYMBIAN
+static struct _method_cache_entry *method_cache = NULL;
+static unsigned long methodcache_hits = 0;
+static unsigned long methodcache_misses = 0;
+#else
+#define method_cache (PYTHON_GLOBALS->method_cache)
+#define methodcache_hits (PYTHON_GLOBALS->methodcache_hits)
+#define methodcache_misses (PYTHON_GLOBALS->methodcache_misses)
+#endif
+
+void
+_PyType_Fini(void)
+{
+	if (method_cache != NULL) {
+		PyMem_FREE(method_cache);
+		method_cache = NULL;
+	}
+	_PyType_NewEpoch();
+}
+
+/* For sys.getcachestats() */
+void
+_PyType_GetCacheStats(unsigned long *hits, unsigned long *misses)
+{
+	*hits = methodcache_hits;
+	*misses = methodcache_misses;
+}
+
 /* Internal API to look for a name through the MRO.
    This returns a borrowed reference, and doesn't set an exception! */
 DL_EXPORT(PyObject *)
 _PyType_Lookup(PyTypeObject *type, PyObject *name)
 {
-	int i, n;
+	int i, n, cacheable;
 	PyObject *mro, *res, *base, *dict;
+	struct _method_cache_entry *entry = NULL;
 
 	/* Look in tp_dict of types in MRO */
 	mro = type->tp_mro;
@@ -1323,12 +1380,40 @@ _PyType_Lookup(PyTypeObject *type, PyObject *name)
 	if (mro == NULL)
 		return NULL;
 
+	if (PyString_CheckExact(name) &&
+	    ((PyStringObject *)name)->ob_sinterned == name &&
+	    type->tp_dict != NULL) {
+		if (method_cache == NULL) {
+			method_cache = (struct _method_cache_entry *)
+				PyMem_MALLOC(MCACHE_SIZE *
+					     sizeof(struct _method_cache_entry));
+			if (method_cache != NULL)
+				memset(method_cache, 0, MCACHE_SIZE *
+				       sizeof(struct _method_cache_entry));
+		}
+		if (method_cache != NULL) {
+			entry = &method_cache[MCACHE_HASH(type, name)];
+			if (entry->type == type && entry->name == name &&
+			    entry->epoch == _PyType_Epoch &&
+			    entry->version ==
+			    ((PyDictObject *)type->tp_dict)->ma_version) {
+				methodcache_hits++;
+				return entry->value;
+			}
+			methodcache_misses++;
+		}
+	}
+
 	assert(PyTuple_Check(mro));
 	n = PyTuple_GET_SIZE(mro);
+	res = NULL;
+	cacheable = 1;
 	for (i = 0; i < n; i++) {
 		base = PyTuple_GET_ITEM(mro, i);
-		if (PyClass_Check(base))
+		if (PyClass_Check(base)) {
 			dict = ((PyClassObject *)base)->cl_dict;
+			cacheable = 0;
+		}
 		else {
 			assert(PyType_Check(base));
 			dict = ((PyTypeObject *)base)->tp_dict;
@@ -1336,9 +1421,16 @@ _PyType_Lookup(PyTypeObject *type, PyObject *name)
 		assert(dict && PyDict_Check(dict));
 		res = PyDict_GetItem(dict, name);
 		if (res != NULL)
-			return res;
+			break;
 	}
-	return NULL;
+	if (entry != NULL && cacheable) {
+		entry->epoch = _PyType_Epoch;
+		entry->version = ((PyDictObject *)type->tp_dict)->ma_version;
+		entry->type = type;
+		entry->name = name;
+		entry->value = res;
+	}
+	return res;
 }
 
 /* This is similar to PyObject_GenericGetAttr(),
@@ -1403,8 +1495,11 @@ type_setattro(PyTypeObject *type, PyObject *name, PyObject *value)
 			type->tp_name);
 		return -1;
 	}
-	if (PyObject_GenericSetAttr((PyObject *)type, name, value) < 0)
+	if (PyObject_GenericSetAttr((PyObject *)type, name, value) < 0) {
+		_PyType_NewEpoch();
 		return -1;
+	}
+	_PyType_NewEpoch();
 	return update_slot(type, name);
 }
 
@@ -1417,6 +1512,8 @@ type_dealloc(PyTypeObject *type)
 	assert(type->tp_flags & Py_TPFLAGS_HEAPTYPE);
 	_PyObject_GC_UNTRACK(type);
 	PyObject_ClearWeakRefs((PyObject *)type);
+	/* Cached lookups may point into its dict or at its address */
+	_PyType_NewEpoch();
 	et = (etype *)type;
 	Py_XDECREF(type->tp_base);
 	Py_XDECREF(type->tp_dict);
@@ -1428,9 +1525,18 @@ type_dealloc(PyTypeObject *type)
 	PyObject_Free((void *)type->tp_doc);
 	Py_XDECREF(et->name);
 	Py_XDECREF(et->slots);
+	_PyDict_ReleaseSharedKeys(&et->cached_keys);
 	type->ob_type->tp_free((PyObject *)type);
 }
 
+PyDictKeysObject **
+_PyType_SharedKeys(PyTypeObject *type)
+{
+	if (!(type->tp_flags & Py_TPFLAGS_HEAPTYPE))
+		return NULL;
+	return &((etype *)type)->cached_keys;
+}
+
 static PyObject *
 type_subclasses(PyTypeObject *type, PyObject *args_ignored)
 {
@@ -1515,6 +1621,7 @@ type_clear(PyTypeObject *type)
 	/* Because of type_is_gc(), the collector only calls this
 	   for heaptypes. */
 	assert(type->tp_flags & Py_TPFLAGS_HEAPTYPE);
+	_PyType_NewEpoch();
 
 #define CLEAR(SLOT) \
 	if (SLOT) { \
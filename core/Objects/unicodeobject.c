@@ -43,6 +43,9 @@ OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #include "ucnhash.h"
 #include "python_globals.h"
 
+#define STRINGLIB_CHAR Py_UNICODE
+#include "fastsearch.h"
+
 #ifdef MS_WIN32
 #include <windows.h>
 #endif
@@ -575,6 +578,41 @@ PyUnicode_FromEncodedObject(register PyObject *obj,
     return NULL;
 }
 
+/* Encodings with a built-in codec, which don't need the codec registry */
+enum builtin_encoding {
+    ENC_OTHER, ENC_UTF8, ENC_LATIN1, ENC_ASCII
+};
+
+/* Recognize the usual spellings of the built-in encodings: case and
+   '-' versus '_' don't matter, and "utf8", "latin1", "iso-8859-1" and
+   "us-ascii" are accepted too. */
+static enum builtin_encoding
+builtin_encoding(const char *encoding)
+{
+    char lower[11];
+    char c;
+    int i;
+
+    for (i = 0; (c = encoding[i]) != '\0'; i++) {
+        if (i == sizeof(lower) - 1)
+            return ENC_OTHER;
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        else if (c == '_')
+            c = '-';
+        lower[i] = c;
+    }
+    lower[i] = '\0';
+    if (strcmp(lower, "utf-8") == 0 || strcmp(lower, "utf8") == 0)
+        return ENC_UTF8;
+    if (strcmp(lower, "latin-1") == 0 || strcmp(lower, "latin1") == 0 ||
+        strcmp(lower, "iso-8859-1") == 0)
+        return ENC_LATIN1;
+    if (strcmp(lower, "ascii") == 0 || strcmp(lower, "us-ascii") == 0)
+        return ENC_ASCII;
+    return ENC_OTHER;
+}
+
 DL_EXPORT(PyObject *)
 PyUnicode_Decode(const char *s,
 		 int size,
@@ -587,12 +625,16 @@ PyUnicode_Decode(const char *s,
 	encoding = PyUnicode_GetDefaultEncoding();
 
     /* Shortcuts for common default encodings */
-    if (strcmp(encoding, "utf-8") == 0)
+    switch (builtin_encoding(encoding)) {
+    case ENC_UTF8:
         return PyUnicode_DecodeUTF8(s, size, errors);
-    else if (strcmp(encoding, "latin-1") == 0)
+    case ENC_LATIN1:
         return PyUnicode_DecodeLatin1(s, size, errors);
-    else if (strcmp(encoding, "ascii") == 0)
+    case ENC_ASCII:
         return PyUnicode_DecodeASCII(s, size, errors);
+    default:
+        break;
+    }
 
     /* Decode via the codec registry */
     buffer = PyBuffer_FromMemory((void *)s, size);
@@ -648,13 +690,21 @@ PyUnicode_AsEncodedString(PyObject *unicode,
 	encoding = PyUnicode_GetDefaultEncoding();
 
     /* Shortcuts for common default encodings */
-    if (errors == NULL) {
-	if (strcmp(encoding, "utf-8") == 0)
-	    return PyUnicode_AsUTF8String(unicode);
-	else if (strcmp(encoding, "latin-1") == 0)
-	    return PyUnicode_AsLatin1String(unicode);
-	else if (strcmp(encoding, "ascii") == 0)
-	    return PyUnicode_AsASCIIString(unicode);
+    switch (builtin_encoding(encoding)) {
+    case ENC_UTF8:
+        return PyUnicode_EncodeUTF8(PyUnicode_AS_UNICODE(unicode),
+                                    PyUnicode_GET_SIZE(unicode),
+                                    errors);
+    case ENC_LATIN1:
+        return PyUnicode_EncodeLatin1(PyUnicode_AS_UNICODE(unicode),
+                                      PyUnicode_GET_SIZE(unicode),
+                                      errors);
+    case ENC_ASCII:
+        return PyUnicode_EncodeASCII(PyUnicode_AS_UNICODE(unicode),
+                                     PyUnicode_GET_SIZE(unicode),
+                                     errors);
+    default:
+        break;
     }
 
     /* Encode via the codec registry */
@@ -1040,6 +1090,105 @@ PyUnicode_EncodeUTF7(const Py_UNICODE *s,
 #undef ENCODE
 #undef DECODE
 
+/* --- Word-at-a-time scanning ------------------------------------------- */
+
+/* The UTF-8, Latin-1 and ASCII codecs go over runs of ASCII (or Latin-1)
+   characters a machine word at a time.  An aligned unsigned long of
+   bytes is all ASCII if none of the bits of ASCII_CHAR_MASK are set in
+   it; an aligned unsigned long of Py_UNICODE units is below 0x80 (0x100)
+   if none of the bits of UCS_ABOVE(0x80) (UCS_ABOVE(0x100)) are.  The
+   masks are built so that they don't depend on the size of a long. */
+
+#define WORD_SIZE sizeof(unsigned long)
+#define WORD_ALIGNED(p) (((Py_uintptr_t)(p) & (WORD_SIZE - 1)) == 0)
+#define UCS_PER_WORD (WORD_SIZE / sizeof(Py_UNICODE))
+
+/* 0x80 in every byte */
+#define ASCII_CHAR_MASK ((~0UL / 0xFF) * 0x80)
+
+/* All bits of one Py_UNICODE unit; 1 in the lowest bit of every unit */
+#define UCS_UNIT_MAX (((1UL << (8 * sizeof(Py_UNICODE) - 1)) << 1) - 1)
+#define UCS_UNIT_ONES (~0UL / UCS_UNIT_MAX)
+
+/* Every bit of every unit that is set only for values >= n (a power
+   of 2) */
+#define UCS_ABOVE(n) (UCS_UNIT_ONES * (UCS_UNIT_MAX & ~((unsigned long)(n) - 1)))
+
+/* Widen the ASCII characters at the start of [*ps, e) into *pp and
+   advance both pointers past them.  Stops at the first byte >= 0x80.
+   The run is found a word at a time first, so the copy loop that
+   follows needs no tests. */
+static void
+ascii_decode(const char **ps, const char *e, Py_UNICODE **pp)
+{
+    register const char *q = *ps;
+    register const char *s = q;
+    register Py_UNICODE *p = *pp;
+
+    while (s < e && !WORD_ALIGNED(s)) {
+        if (*s & 0x80)
+            goto copy;
+        s++;
+    }
+    while (s + WORD_SIZE <= e &&
+           !(*(const unsigned long *)s & ASCII_CHAR_MASK))
+        s += WORD_SIZE;
+    while (s < e && !(*s & 0x80))
+        s++;
+  copy:
+    while (q + 4 <= s) {
+        p[0] = (unsigned char)q[0];
+        p[1] = (unsigned char)q[1];
+        p[2] = (unsigned char)q[2];
+        p[3] = (unsigned char)q[3];
+        p += 4;
+        q += 4;
+    }
+    while (q < s)
+        *p++ = (unsigned char)*q++;
+    *ps = s;
+    *pp = p;
+}
+
+/* Narrow the characters below limit (0x80 or 0x100) at the start of
+   s[0:size] into p, and return how many there were.  Aligned words are
+   checked whole and narrowed out of the register. */
+static int
+ucs_narrow_run(const Py_UNICODE *s, int size, char *p, Py_UNICODE limit)
+{
+    register const Py_UNICODE *q = s;
+    const Py_UNICODE *e = s + size;
+    char *start = p;
+    const unsigned long mask = limit == 0x80 ? UCS_ABOVE(0x80) :
+                                               UCS_ABOVE(0x100);
+    register unsigned long w;
+    int i;
+
+    while (q < e && !WORD_ALIGNED(q)) {
+        if (*q >= limit)
+            return p - start;
+        *p++ = (char)*q++;
+    }
+    while (q + UCS_PER_WORD <= e) {
+        w = *(const unsigned long *)q;
+        if (w & mask)
+            break;
+        for (i = 0; i < UCS_PER_WORD; i++) {
+#ifdef BYTEORDER_IS_LITTLE_ENDIAN
+            p[i] = (char)(w >> (8 * sizeof(Py_UNICODE) * i));
+#else
+            p[i] = (char)(w >> (8 * sizeof(Py_UNICODE) *
+                                (UCS_PER_WORD - 1 - i)));
+#endif
+        }
+        q += UCS_PER_WORD;
+        p += UCS_PER_WORD;
+    }
+    while (q < e && *q < limit)
+        *p++ = (char)*q++;
+    return p - start;
+}
+
 /* --- UTF-8 Codec -------------------------------------------------------- */
 
 const static
@@ -1122,8 +1271,7 @@ PyUnicode_DecodeUTF8(const char *s,
         Py_UCS4 ch = (unsigned char)*s;
 
         if (ch < 0x80) {
-            *p++ = (Py_UNICODE)ch;
-            s++;
+            ascii_decode(&s, e, &p);
             continue;
         }
 
@@ -1286,6 +1434,7 @@ PyUnicode_EncodeUTF8(const Py_UNICODE *s,
     char *p;            /* next free byte in output buffer */
     int nallocated;     /* number of result bytes allocated */
     int nneeded;        /* number of result bytes needed */
+    int n;              /* length of an ASCII run */
     char stackbuf[MAX_SHORT_UNICHARS * 4];
 
     assert(s != NULL);
@@ -1299,24 +1448,38 @@ PyUnicode_EncodeUTF8(const Py_UNICODE *s,
         nallocated = Py_SAFE_DOWNCAST(sizeof(stackbuf), size_t, int);
         v = NULL;   /* will allocate after we're done */
         p = stackbuf;
+        i = 0;
     }
     else {
-        /* Overallocate on the heap, and give the excess back at the end. */
+        /* ASCII comes out unchanged and is the most common input, so
+         * first try to encode all of it into a string of the right size.
+         * Failing that, overallocate, and give the excess back at the
+         * end.
+         */
         nallocated = size * 4;
         if (nallocated / 4 != size)  /* overflow! */
             return PyErr_NoMemory();
-        v = PyString_FromStringAndSize(NULL, nallocated);
+        v = PyString_FromStringAndSize(NULL, size);
         if (v == NULL)
             return NULL;
-        p = PyString_AS_STRING(v);
+        i = ucs_narrow_run(s, size, PyString_AS_STRING(v), 0x80);
+        if (i == size)
+            return v;
+        if (_PyString_Resize(&v, nallocated))
+            return NULL;
+        p = PyString_AS_STRING(v) + i;
     }
 
-    for (i = 0; i < size;) {
+    while (i < size) {
         Py_UCS4 ch = s[i++];
 
-        if (ch < 0x80)
-            /* Encode ASCII */
+        if (ch < 0x80) {
+            /* Encode a run of ASCII */
             *p++ = (char) ch;
+            n = ucs_narrow_run(s + i, size - i, p, 0x80);
+            i += n;
+            p += n;
+        }
 
         else if (ch < 0x0800) {
             /* Encode Latin-1 */
@@ -2201,6 +2364,7 @@ PyUnicode_EncodeLatin1(const Py_UNICODE *p,
 {
     PyObject *repr;
     char *s, *start;
+    int n;
 
     repr = PyString_FromStringAndSize(NULL, size);
     if (repr == NULL)
@@ -2210,15 +2374,20 @@ PyUnicode_EncodeLatin1(const Py_UNICODE *p,
 
     s = PyString_AS_STRING(repr);
     start = s;
-    while (size-- > 0) {
-        Py_UNICODE ch = *p++;
-	if (ch >= 256) {
-	    if (latin1_encoding_error(&p, &s, errors,
-				      "ordinal not in range(256)"))
-		goto onError;
-	}
-	else
-            *s++ = (char)ch;
+    while (size > 0) {
+        /* Copy a run of Latin-1 characters */
+        n = ucs_narrow_run(p, size, s, 256);
+        p += n;
+        s += n;
+        size -= n;
+        if (size == 0)
+            break;
+        /* *p is not Latin-1 */
+        p++;
+        size--;
+        if (latin1_encoding_error(&p, &s, errors,
+                                  "ordinal not in range(256)"))
+            goto onError;
     }
     /* Resize if error handling skipped some characters */
     if (s - start < PyString_GET_SIZE(repr))
@@ -2281,6 +2450,7 @@ PyUnicode_DecodeASCII(const char *s,
 {
     PyUnicodeObject *v;
     Py_UNICODE *p;
+    const char *e;
 
     /* ASCII is equivalent to the first 128 ordinals in Unicode. */
     if (size == 1 && *(unsigned char*)s < 128) {
@@ -2294,15 +2464,16 @@ PyUnicode_DecodeASCII(const char *s,
     if (size == 0)
 	return (PyObject *)v;
     p = PyUnicode_AS_UNICODE(v);
-    while (size-- > 0) {
-	register unsigned char c;
-
-	c = (unsigned char)*s++;
-	if (c < 128)
-	    *p++ = c;
-	else if (ascii_decoding_error(&s, &p, errors,
-				      "ordinal not in range(128)"))
-		goto onError;
+    e = s + size;
+    while (s < e) {
+        ascii_decode(&s, e, &p);
+        if (s == e)
+            break;
+        /* *s is not ASCII */
+        s++;
+        if (ascii_decoding_error(&s, &p, errors,
+                                 "ordinal not in range(128)"))
+            goto onError;
     }
     if (p - PyUnicode_AS_UNICODE(v) < PyString_GET_SIZE(v))
 	if (_PyUnicode_Resize(&v, (int)(p - PyUnicode_AS_UNICODE(v))))
@@ -2351,6 +2522,7 @@ PyUnicode_EncodeASCII(const Py_UNICODE *p,
 {
     PyObject *repr;
     char *s, *start;
+    int n;
 
     repr = PyString_FromStringAndSize(NULL, size);
     if (repr == NULL)
@@ -2360,15 +2532,20 @@ PyUnicode_EncodeASCII(const Py_UNICODE *p,
 
     s = PyString_AS_STRING(repr);
     start = s;
-    while (size-- > 0) {
-        Py_UNICODE ch = *p++;
-	if (ch >= 128) {
-	    if (ascii_encoding_error(&p, &s, errors,
-				      "ordinal not in range(128)"))
-		goto onError;
-	}
-	else
-            *s++ = (char)ch;
+    while (size > 0) {
+        /* Copy a run of ASCII characters */
+        n = ucs_narrow_run(p, size, s, 128);
+        p += n;
+        s += n;
+        size -= n;
+        if (size == 0)
+            break;
+        /* *p is not ASCII */
+        p++;
+        size--;
+        if (ascii_encoding_error(&p, &s, errors,
+                                 "ordinal not in range(128)"))
+            goto onError;
     }
     /* Resize if error handling skipped some characters */
     if (s - start < PyString_GET_SIZE(repr))
@@ -2944,8 +3121,6 @@ int count(PyUnicodeObject *self,
 	  int end,
 	  PyUnicodeObject *substring)
 {
-    int count = 0;
-
     if (start < 0)
         start += self->length;
     if (start < 0)
@@ -2960,16 +3135,12 @@ int count(PyUnicodeObject *self,
     if (substring->length == 0)
 	return (end - start + 1);
 
-    end -= substring->length;
-
-    while (start <= end)
-        if (Py_UNICODE_MATCH(self, start, substring)) {
-            count++;
-            start += substring->length;
-        } else
-            start++;
+    if (end - start < substring->length)
+        return 0;
 
-    return count;
+    return fastsearch(self->str + start, end - start,
+                      substring->str, substring->length,
+                      INT_MAX, FAST_COUNT);
 }
 
 DL_EXPORT(int)
@@ -3005,6 +3176,8 @@ int findstring(PyUnicodeObject *self,
 	       int end,
 	       int direction)
 {
+    int pos;
+
     if (start < 0)
         start += self->length;
     if (start < 0)
@@ -3020,19 +3193,15 @@ int findstring(PyUnicodeObject *self,
     if (substring->length == 0)
 	return (direction > 0) ? start : end;
 
-    end -= substring->length;
-
-    if (direction < 0) {
-        for (; end >= start; end--)
-            if (Py_UNICODE_MATCH(self, end, substring))
-                return end;
-    } else {
-        for (; start <= end; start++)
-            if (Py_UNICODE_MATCH(self, start, substring))
-                return start;
-    }
+    if (end - start < substring->length)
+        return -1;
 
-    return -1;
+    pos = fastsearch(self->str + start, end - start,
+                     substring->str, substring->length, 0,
+                     (direction > 0) ? FAST_SEARCH : FAST_RSEARCH);
+    if (pos < 0)
+        return -1;
+    return start + pos;
 }
 
 DL_EXPORT(int)
@@ -3049,7 +3218,7 @@ PyUnicode_Find(PyObject *str,
 	return -1;
     substr = PyUnicode_FromObject(substr);
     if (substr == NULL) {
-	Py_DECREF(substr);
+	Py_DECREF(str);
 	return -1;
     }
 
@@ -3292,96 +3461,147 @@ int fixtitle(PyUnicodeObject *self)
     return 1;
 }
 
+/* Return 1 if the 8-bit string holds only ASCII characters, so that it
+   can be widened to Unicode without going through a codec. */
+
+static
+int ascii_only(const char *s, int len)
+{
+    const unsigned char *p = (const unsigned char *)s;
+    const unsigned char *e = p + len;
+
+    while (p < e)
+	if (*p++ & 0x80)
+	    return 0;
+    return 1;
+}
+
+/* Join in two passes over a PySequence_Fast view: add up the lengths,
+   allocate the result once, then copy.  ASCII 8-bit strings are widened
+   in place; any other 8-bit item is decoded up front and kept in a
+   private copy of the sequence until the copy pass. */
+
 DL_EXPORT(PyObject *)
 PyUnicode_Join(PyObject *separator,
 	       PyObject *seq)
 {
     Py_UNICODE *sep;
+    Py_UNICODE blank = ' ';
     int seplen;
     PyUnicodeObject *res = NULL;
-    int reslen = 0;
     Py_UNICODE *p;
-    int sz = 100;
-    int i;
-    PyObject *it;
+    size_t sz = 0;
+    int seqlen, i, copied = 0;
+    PyObject *fseq, *item;
 
-    it = PyObject_GetIter(seq);
-    if (it == NULL)
+    fseq = PySequence_Fast(seq, "iteration over non-sequence");
+    if (fseq == NULL)
         return NULL;
 
     if (separator == NULL) {
-	Py_UNICODE blank = ' ';
 	sep = &blank;
 	seplen = 1;
     }
     else {
 	separator = PyUnicode_FromObject(separator);
-	if (separator == NULL)
-	    goto onError;
+	if (separator == NULL) {
+	    Py_DECREF(fseq);
+	    return NULL;
+	}
 	sep = PyUnicode_AS_UNICODE(separator);
 	seplen = PyUnicode_GET_SIZE(separator);
     }
 
-    res = _PyUnicode_New(sz);
-    if (res == NULL)
-	goto onError;
-    p = PyUnicode_AS_UNICODE(res);
-    reslen = 0;
-
-    for (i = 0; ; ++i) {
-	int itemlen;
-	PyObject *item = PyIter_Next(it);
-	if (item == NULL) {
-	    if (PyErr_Occurred())
-		goto onError;
-	    break;
+    seqlen = PySequence_Fast_GET_SIZE(fseq);
+    if (seqlen == 1) {
+	item = PySequence_Fast_GET_ITEM(fseq, 0);
+	if (PyUnicode_CheckExact(item)) {
+	    Py_INCREF(item);
+	    Py_XDECREF(separator);
+	    Py_DECREF(fseq);
+	    return item;
 	}
-	if (!PyUnicode_Check(item)) {
-	    PyObject *v;
-	    if (!PyString_Check(item)) {
-		PyErr_Format(PyExc_TypeError,
-			     "sequence item %i: expected string or Unicode,"
-			     " %.80s found",
-			     i, item->ob_type->tp_name);
+    }
+
+    /* Pass 1: total length, and decode the non-ASCII 8-bit items. */
+    for (i = 0; i < seqlen; i++) {
+	const size_t old_sz = sz;
+	item = PySequence_Fast_GET_ITEM(fseq, i);
+	if (PyUnicode_Check(item))
+	    sz += PyUnicode_GET_SIZE(item);
+	else if (PyString_Check(item)) {
+	    if (ascii_only(PyString_AS_STRING(item),
+			   PyString_GET_SIZE(item)))
+		sz += PyString_GET_SIZE(item);
+	    else {
+		PyObject *v;
+		if (!copied) {
+		    /* fseq may be the caller's list; never modify it */
+		    v = PySequence_List(fseq);
+		    if (v == NULL)
+			goto onError;
+		    Py_DECREF(fseq);
+		    fseq = v;
+		    copied = 1;
+		}
+		v = PyUnicode_FromObject(item);
+		if (v == NULL)
+		    goto onError;
+		PyList_SET_ITEM(fseq, i, v);
 		Py_DECREF(item);
-		goto onError;
+		sz += PyUnicode_GET_SIZE(v);
 	    }
-	    v = PyUnicode_FromObject(item);
-	    Py_DECREF(item);
-	    item = v;
-	    if (item == NULL)
-		goto onError;
 	}
-	itemlen = PyUnicode_GET_SIZE(item);
-	while (reslen + itemlen + seplen >= sz) {
-	    if (_PyUnicode_Resize(&res, sz*2)) {
-		Py_DECREF(item);
-		goto onError;
-	    }
-	    sz *= 2;
-	    p = PyUnicode_AS_UNICODE(res) + reslen;
+	else {
+	    PyErr_Format(PyExc_TypeError,
+			 "sequence item %i: expected string or Unicode,"
+			 " %.80s found",
+			 i, item->ob_type->tp_name);
+	    goto onError;
+	}
+	if (i != 0)
+	    sz += seplen;
+	if (sz < old_sz || sz > INT_MAX) {
+	    PyErr_SetString(PyExc_OverflowError,
+			    "join() is too long for a Python string");
+	    goto onError;
 	}
+    }
+
+    res = _PyUnicode_New((int)sz);
+    if (res == NULL)
+	goto onError;
+
+    /* Pass 2: copy. */
+    p = PyUnicode_AS_UNICODE(res);
+    for (i = 0; i < seqlen; i++) {
+	int itemlen;
+	item = PySequence_Fast_GET_ITEM(fseq, i);
 	if (i > 0) {
 	    Py_UNICODE_COPY(p, sep, seplen);
 	    p += seplen;
-	    reslen += seplen;
 	}
-	Py_UNICODE_COPY(p, PyUnicode_AS_UNICODE(item), itemlen);
-	p += itemlen;
-	reslen += itemlen;
-	Py_DECREF(item);
+	if (PyUnicode_Check(item)) {
+	    itemlen = PyUnicode_GET_SIZE(item);
+	    Py_UNICODE_COPY(p, PyUnicode_AS_UNICODE(item), itemlen);
+	    p += itemlen;
+	}
+	else {
+	    const unsigned char *s =
+		(const unsigned char *)PyString_AS_STRING(item);
+	    itemlen = PyString_GET_SIZE(item);
+	    while (itemlen-- > 0)
+		*p++ = (Py_UNICODE)*s++;
+	}
     }
-    if (_PyUnicode_Resize(&res, reslen))
-	goto onError;
 
     Py_XDECREF(separator);
-    Py_DECREF(it);
+    Py_DECREF(fseq);
     return (PyObject *)res;
 
  onError:
     Py_XDECREF(separator);
-    Py_XDECREF(res);
-    Py_DECREF(it);
+    Py_DECREF(fseq);
     return NULL;
 }
 
@@ -3559,14 +3779,13 @@ PyObject *split_substring(PyUnicodeObject *self,
     int sublen = substring->length;
     PyObject *str;
 
-    for (i = j = 0; i <= len - sublen; ) {
-	if (Py_UNICODE_MATCH(self, i, substring)) {
-	    if (maxcount-- <= 0)
-		break;
-	    SPLIT_APPEND(self->str, j, i);
-	    i = j = i + sublen;
-	} else
-	    i++;
+    for (j = 0; maxcount-- > 0; j = i + sublen) {
+	i = fastsearch(self->str + j, len - j,
+		       substring->str, sublen, 0, FAST_SEARCH);
+	if (i < 0)
+	    break;
+	i += j;
+	SPLIT_APPEND(self->str, j, i);
     }
     if (j <= len) {
 	SPLIT_APPEND(self->str, j, len);
@@ -3650,7 +3869,7 @@ PyObject *replace(PyUnicodeObject *self,
         }
 
     } else {
-        int n, i;
+        int n, i, j;
         Py_UNICODE *p;
 
         /* replace strings */
@@ -3673,19 +3892,21 @@ PyObject *replace(PyUnicodeObject *self,
             if (u) {
                 i = 0;
                 p = u->str;
-                while (i <= self->length - str1->length)
-                    if (Py_UNICODE_MATCH(self, i, str1)) {
-                        /* replace string segment */
-                        Py_UNICODE_COPY(p, str2->str, str2->length);
-                        p += str2->length;
-                        i += str1->length;
-                        if (--n <= 0) {
-                            /* copy remaining part */
-                            Py_UNICODE_COPY(p, self->str+i, self->length-i);
-                            break;
-                        }
-                    } else
-                        *p++ = self->str[i++];
+                while (n-- > 0) {
+                    j = fastsearch(self->str+i, self->length-i,
+                                   str1->str, str1->length, 0, FAST_SEARCH);
+                    /* an empty str1 only matches at the end, see count() */
+                    if (j < 0)
+                        j = self->length - i;
+                    /* copy the unmatched part, then the replacement */
+                    Py_UNICODE_COPY(p, self->str+i, j);
+                    p += j;
+                    i += j + str1->length;
+                    Py_UNICODE_COPY(p, str2->str, str2->length);
+                    p += str2->length;
+                }
+                /* copy remaining part */
+                Py_UNICODE_COPY(p, self->str+i, self->length-i);
             }
         }
     }
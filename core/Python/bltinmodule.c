@@ -652,13 +652,27 @@ The globals and locals are dictionaries, defaulting to the current\n\
 globals and locals.  If only globals is given, locals defaults to it.";
 #endif
 
+/* Return the interned version of the string name, borrowed: the interned
+   table keeps it alive.  Attribute names in class and instance dicts are
+   interned, so the dict lookup then succeeds on identity.  A name that is
+   not interned yet is not added (interned strings are never freed, and
+   getattr() is often called with names built at run time); name itself
+   is returned instead. */
 static PyObject *
-builtin_getattr(PyObject *self, PyObject *args)
+interned_name(PyObject *name)
+{
+	PyObject *t = _PyString_LookupInterned(name);
+
+	return t != NULL ? t : name;
+}
+
+static PyObject *
+builtin_getattr(PyObject *self, PyObject **args, int nargs)
 {
 	PyObject *v, *result, *dflt = NULL;
 	PyObject *name;
 
-	if (!PyArg_ParseTuple(args, "OO|O:getattr", &v, &name, &dflt))
+	if (!_PyArg_ParseStack(args, nargs, "OO|O:getattr", &v, &name, &dflt))
 		return NULL;
 #ifdef Py_USING_UNICODE
 	if (PyUnicode_Check(name)) {
@@ -673,7 +687,7 @@ builtin_getattr(PyObject *self, PyObject *args)
 				"attribute name must be string");
 		return NULL;
 	}
-	result = PyObject_GetAttr(v, name);
+	result = PyObject_GetAttr(v, interned_name(name));
 	if (result == NULL && dflt != NULL &&
 	    PyErr_ExceptionMatches(PyExc_AttributeError))
 	{
@@ -736,7 +750,7 @@ builtin_hasattr(PyObject *self, PyObject *args)
 				"attribute name must be string");
 		return NULL;
 	}
-	v = PyObject_GetAttr(v, name);
+	v = PyObject_GetAttr(v, interned_name(name));
 	if (v == NULL) {
 		PyErr_Clear();
 		Py_INCREF(Py_False);
@@ -1206,23 +1220,30 @@ Return the dictionary containing the current scope's local variables.";
 
 
 static PyObject *
-min_max(PyObject *args, int op)
+min_max(PyObject **args, int nargs, int op)
 {
-	PyObject *v, *w, *x, *it;
+	PyObject *v, *w, *x, *it = NULL;
+	int i = 0;
 
-	if (PyTuple_Size(args) > 1)
-		v = args;
-	else if (!PyArg_ParseTuple(args, "O:min/max", &v))
-		return NULL;
-
-	it = PyObject_GetIter(v);
-	if (it == NULL)
-		return NULL;
+	/* Several arguments are compared directly; a single one is
+	   iterated over */
+	if (nargs <= 1) {
+		if (!_PyArg_ParseStack(args, nargs, "O:min/max", &v))
+			return NULL;
+		it = PyObject_GetIter(v);
+		if (it == NULL)
+			return NULL;
+	}
 
 	w = NULL;  /* the result */
 	for (;;) {
-		x = PyIter_Next(it);
-		if (x == NULL) {
+		if (it == NULL) {
+			if (i == nargs)
+				break;
+			x = args[i++];
+			Py_INCREF(x);
+		}
+		else if ((x = PyIter_Next(it)) == NULL) {
 			if (PyErr_Occurred()) {
 				Py_XDECREF(w);
 				Py_DECREF(it);
@@ -1242,7 +1263,7 @@ min_max(PyObject *args, int op)
 			else if (cmp < 0) {
 				Py_DECREF(x);
 				Py_DECREF(w);
-				Py_DECREF(it);
+				Py_XDECREF(it);
 				return NULL;
 			}
 			else
@@ -1252,14 +1273,14 @@ min_max(PyObject *args, int op)
 	if (w == NULL)
 		PyErr_SetString(PyExc_ValueError,
 				"min() or max() arg is an empty sequence");
-	Py_DECREF(it);
+	Py_XDECREF(it);
 	return w;
 }
 
 static PyObject *
-builtin_min(PyObject *self, PyObject *v)
+builtin_min(PyObject *self, PyObject **args, int nargs)
 {
-	return min_max(v, Py_LT);
+	return min_max(args, nargs, Py_LT);
 }
 
 const static char min_doc[] =
@@ -1275,9 +1296,9 @@ With two or more arguments, return the smallest argument.";
 
 
 static PyObject *
-builtin_max(PyObject *self, PyObject *v)
+builtin_max(PyObject *self, PyObject **args, int nargs)
 {
-	return min_max(v, Py_GT);
+	return min_max(args, nargs, Py_GT);
 }
 
 const static char max_doc[] =
@@ -1412,7 +1433,7 @@ get_len_of_range(long lo, long hi, long step)
 }
 
 static PyObject *
-builtin_range(PyObject *self, PyObject *args)
+builtin_range(PyObject *self, PyObject **args, int nargs)
 {
 	long ilow = 0, ihigh = 0, istep = 1;
 	long bign;
@@ -1420,14 +1441,14 @@ builtin_range(PyObject *self, PyObject *args)
 
 	PyObject *v;
 
-	if (PyTuple_Size(args) <= 1) {
-		if (!PyArg_ParseTuple(args,
+	if (nargs <= 1) {
+		if (!_PyArg_ParseStack(args, nargs,
 				"l;range() requires 1-3 int arguments",
 				&ihigh))
 			return NULL;
 	}
 	else {
-		if (!PyArg_ParseTuple(args,
+		if (!_PyArg_ParseStack(args, nargs,
 				"ll|l;range() requires 1-3 int arguments",
 				&ilow, &ihigh, &istep))
 			return NULL;
@@ -1793,13 +1814,13 @@ With an argument, equivalent to object.__dict__.";
 #endif
 
 static PyObject *
-builtin_isinstance(PyObject *self, PyObject *args)
+builtin_isinstance(PyObject *self, PyObject **args, int nargs)
 {
 	PyObject *inst;
 	PyObject *cls;
 	int retval;
 
-	if (!PyArg_ParseTuple(args, "OO:isinstance", &inst, &cls))
+	if (!_PyArg_ParseStack(args, nargs, "OO:isinstance", &inst, &cls))
 		return NULL;
 
 	retval = PyObject_IsInstance(inst, cls);
@@ -1949,7 +1970,7 @@ const static PyMethodDef builtin_methods[] = {
  	{"eval",	builtin_eval,       METH_VARARGS, eval_doc},
  	{"execfile",	builtin_execfile,   METH_VARARGS, execfile_doc},
  	{"filter",	builtin_filter,     METH_VARARGS, filter_doc},
- 	{"getattr",	builtin_getattr,    METH_VARARGS, getattr_doc},
+ 	{"getattr",	(PyCFunction)builtin_getattr,    METH_FASTCALL, getattr_doc},
  	{"globals",	(PyCFunction)builtin_globals,    METH_NOARGS, globals_doc},
  	{"hasattr",	builtin_hasattr,    METH_VARARGS, hasattr_doc},
  	{"hash",	builtin_hash,       METH_O, hash_doc},
@@ -1957,18 +1978,18 @@ const static PyMethodDef builtin_methods[] = {
  	{"id",		builtin_id,         METH_O, id_doc},
  	{"input",	builtin_input,      METH_VARARGS, input_doc},
  	{"intern",	builtin_intern,     METH_VARARGS, intern_doc},
- 	{"isinstance",  builtin_isinstance, METH_VARARGS, isinstance_doc},
+ 	{"isinstance",  (PyCFunction)builtin_isinstance, METH_FASTCALL, isinstance_doc},
  	{"issubclass",  builtin_issubclass, METH_VARARGS, issubclass_doc},
  	{"iter",	builtin_iter,       METH_VARARGS, iter_doc},
  	{"len",		builtin_len,        METH_O, len_doc},
  	{"locals",	(PyCFunction)builtin_locals,     METH_NOARGS, locals_doc},
  	{"map",		builtin_map,        METH_VARARGS, map_doc},
- 	{"max",		builtin_max,        METH_VARARGS, max_doc},
- 	{"min",		builtin_min,        METH_VARARGS, min_doc},
+ 	{"max",		(PyCFunction)builtin_max, METH_FASTCALL, max_doc},
+ 	{"min",		(PyCFunction)builtin_min, METH_FASTCALL, min_doc},
  	{"oct",		builtin_oct,        METH_O, oct_doc},
  	{"ord",		builtin_ord,        METH_O, ord_doc},
  	{"pow",		builtin_pow,        METH_VARARGS, pow_doc},
- 	{"range",	builtin_range,      METH_VARARGS, range_doc},
+ 	{"range",	(PyCFunction)builtin_range,      METH_FASTCALL, range_doc},
  	{"raw_input",	builtin_raw_input,  METH_VARARGS, raw_input_doc},
  	{"reduce",	builtin_reduce,     METH_VARARGS, reduce_doc},
  	{"reload",	builtin_reload,     METH_O, reload_doc},
@@ -30,6 +30,22 @@
 #define CHECKEXC 1	/* Double-check exception checking */
 #endif
 
+/* Threaded-code dispatch: when USE_COMPUTED_GOTOS is on, every opcode
+   handler jumps straight to the handler of the next instruction through
+   the opcode_targets[] label table, instead of going back to the top of
+   the loop and through the switch.  That gives the branch predictor one
+   indirect jump per opcode to learn instead of a single shared one.
+   It needs the gcc "labels as values" extension (HAVE_COMPUTED_GOTOS);
+   other compilers keep using the switch. */
+#if defined(USE_COMPUTED_GOTOS) && !defined(HAVE_COMPUTED_GOTOS)
+#undef USE_COMPUTED_GOTOS
+#endif
+#if defined(USE_COMPUTED_GOTOS) && (defined(LLTRACE) || \
+	defined(DYNAMIC_EXECUTION_PROFILE) || defined(CASE_TOO_BIG))
+/* These need every instruction to pass through the top of the loop */
+#undef USE_COMPUTED_GOTOS
+#endif
+
 typedef PyObject *(*callproc)(PyObject *, PyObject *, PyObject *);
 
 /* Forward declarations */
@@ -52,6 +68,8 @@ static int call_trace(Py_tracefunc, PyObject *, PyFrameObject *,
 static void call_trace_protected(Py_tracefunc, PyObject *,
 				 PyFrameObject *, int);
 static void call_exc_trace(Py_tracefunc, PyObject *, PyFrameObject *);
+static int maybe_call_line_trace(Py_tracefunc, PyObject *,
+				 PyFrameObject *, int *, int *, int *);
 static PyObject *loop_subscript(PyObject *, PyObject *);
 static PyObject *apply_slice(PyObject *, PyObject *, PyObject *);
 static int assign_slice(PyObject *, PyObject *,
@@ -254,48 +272,182 @@ extern int _PyThread_Started; /* Flag for Py_Exit */
 #define _PyThread_Started (PYTHON_GLOBALS->_PyThread_Started)
 #endif
 
+/* The interpreter lock.  interpreter_lock itself is only held for a
+   moment, to guard the state below; whether the interpreter is taken is
+   gil_locked.  A thread that finds it taken joins gil_waiters, a queue
+   ordered by priority (first come, first served among equals), and
+   sleeps on a lock of its own.  Releasing the interpreter hands it
+   straight to the head of the queue, so a thread that lets go can't
+   take it back before the others get their turn.  While anyone waits,
+   gil_drop_request is set and the eval loop lets go once the holder has
+   had the interpreter for the switch interval, or at once if a waiter
+   has a higher priority.  A waiter sets gil_drop_request to GIL_DROP_NEW,
+   which makes the eval loop check at the next instruction, whatever the
+   check interval; the holder marks it GIL_DROP_SEEN and from then on
+   checks every GIL_DROP_TICKS instructions at most, so that reading the
+   clock doesn't slow it down while it waits out the switch interval.
+
+   A thread that waits sleeps on the wakeup lock of its thread state.
+   PyEval_AcquireLock() has no thread state, so it borrows one of
+   gil_spare, wakeup locks kept for it (at most GIL_SPARE_LOCKS of
+   them, guarded by interpreter_lock), rather than making a new one
+   each time.  GIL_SPARE_LOCKS is defined in python_globals.h, which
+   holds gil_spare on Symbian. */
+
+#define GIL_DROP_NEW	1
+#define GIL_DROP_SEEN	2
+#define GIL_DROP_TICKS	100
+
+struct gil_waiter {
+	PyThread_type_lock wakeup;
+	int priority;
+	struct gil_waiter *next;
+};
+
 #ifndef SYMBIAN
 static PyThread_type_lock interpreter_lock = 0;
 static long main_thread = 0;
+static int gil_locked = 0;
+static volatile int gil_drop_request = 0;
+static int gil_waiter_priority = 0;	/* of the head of gil_waiters */
+static struct gil_waiter *gil_waiters = NULL;
+static unsigned long gil_since = 0;	/* when the holder took it */
+static PyThread_type_lock gil_spare[GIL_SPARE_LOCKS];
+static int gil_nspare = 0;
 #else
 #define interpreter_lock (PYTHON_GLOBALS->interpreter_lock)
 #define main_thread (PYTHON_GLOBALS->main_thread)
+#define gil_locked (PYTHON_GLOBALS->gil_locked)
+#define gil_drop_request (PYTHON_GLOBALS->gil_drop_request)
+#define gil_waiter_priority (PYTHON_GLOBALS->gil_waiter_priority)
+#define gil_waiters (*(struct gil_waiter **)&PYTHON_GLOBALS->gil_waiters)
+#define gil_since (PYTHON_GLOBALS->gil_since)
+#define gil_spare (PYTHON_GLOBALS->gil_spare)
+#define gil_nspare (PYTHON_GLOBALS->gil_nspare)
 #endif
 
+/* A new wakeup lock, acquired so that waiting on it blocks */
+static PyThread_type_lock
+new_wakeup_lock(void)
+{
+	PyThread_type_lock lock = PyThread_allocate_lock();
+
+	if (lock == NULL)
+		Py_FatalError("PyEval: can't allocate interpreter lock");
+	PyThread_acquire_lock(lock, 1);
+	return lock;
+}
+
+static void
+take_gil(PyThreadState *tstate)
+{
+	struct gil_waiter self, **p;
+	unsigned long start;
+
+	self.wakeup = NULL;
+	if (tstate != NULL) {
+		if (tstate->gil_wakeup == NULL)
+			tstate->gil_wakeup = new_wakeup_lock();
+		self.wakeup = (PyThread_type_lock)tstate->gil_wakeup;
+	}
+
+	PyThread_acquire_lock(interpreter_lock, 1);
+	if (!gil_locked) {
+		gil_locked = 1;
+		PyThread_release_lock(interpreter_lock);
+		gil_since = PyThread_get_microseconds();
+	}
+	else {
+		if (self.wakeup == NULL) {
+			if (gil_nspare > 0)
+				self.wakeup = gil_spare[--gil_nspare];
+			else
+				self.wakeup = new_wakeup_lock();
+		}
+		self.priority = tstate != NULL ? tstate->gil_priority : 0;
+		for (p = &gil_waiters; *p != NULL; p = &(*p)->next)
+			if ((*p)->priority < self.priority)
+				break;
+		self.next = *p;
+		*p = &self;
+		gil_waiter_priority = gil_waiters->priority;
+		gil_drop_request = GIL_DROP_NEW;
+		PyThread_release_lock(interpreter_lock);
+
+		/* drop_gil() takes us off the queue and leaves gil_locked
+		   set for us before it wakes us up. */
+		start = PyThread_get_microseconds();
+		PyThread_acquire_lock(self.wakeup, 1);
+		gil_since = PyThread_get_microseconds();
+		if (tstate != NULL) {
+			tstate->gil_contended++;
+			tstate->gil_wait += (gil_since - start) / 1e6;
+		}
+	}
+	if (tstate != NULL)
+		tstate->gil_acquisitions++;
+	else if (self.wakeup != NULL) {
+		/* the lock is acquired again, ready for the next wait */
+		PyThread_acquire_lock(interpreter_lock, 1);
+		if (gil_nspare < GIL_SPARE_LOCKS) {
+			gil_spare[gil_nspare++] = self.wakeup;
+			self.wakeup = NULL;
+		}
+		PyThread_release_lock(interpreter_lock);
+		if (self.wakeup != NULL)
+			PyThread_free_lock(self.wakeup);
+	}
+}
+
+static void
+drop_gil(PyThreadState *tstate)
+{
+	PyThread_type_lock wakeup = NULL;
+
+	if (tstate != NULL)
+		tstate->gil_hold +=
+			(PyThread_get_microseconds() - gil_since) / 1e6;
+	PyThread_acquire_lock(interpreter_lock, 1);
+	if (gil_waiters != NULL) {
+		wakeup = gil_waiters->wakeup;
+		gil_waiters = gil_waiters->next;
+		if (gil_waiters != NULL) {
+			/* news for the thread woken up */
+			gil_waiter_priority = gil_waiters->priority;
+			gil_drop_request = GIL_DROP_NEW;
+		}
+		else
+			gil_drop_request = 0;
+	}
+	else
+		gil_locked = 0;
+	PyThread_release_lock(interpreter_lock);
+	if (wakeup != NULL)
+		PyThread_release_lock(wakeup);
+}
+
 DL_EXPORT(void)
 PyEval_InitThreads(void)
 {
 	if (interpreter_lock)
 		return;
 	_PyThread_Started = 1;
-#ifndef SYMBIAN
 	interpreter_lock = PyThread_allocate_lock();
-	PyThread_acquire_lock(interpreter_lock, 1);
-#else
-	interpreter_lock = (void*)PyThread_allocate_lock();
-	PyThread_acquire_lock(((PyThread_type_lock)interpreter_lock), 1);
-#endif
+	gil_locked = 1;
+	gil_since = PyThread_get_microseconds();
 	main_thread = PyThread_get_thread_ident();
 }
 
 DL_EXPORT(void)
 PyEval_AcquireLock(void)
 {
-#ifndef SYMBIAN
-	PyThread_acquire_lock(interpreter_lock, 1);
-#else
-	PyThread_acquire_lock((PyThread_type_lock)interpreter_lock, 1);
-#endif
+	take_gil(NULL);
 }
 
 DL_EXPORT(void)
 PyEval_ReleaseLock(void)
 {
-#ifndef SYMBIAN
-	PyThread_release_lock(interpreter_lock);
-#else
-	PyThread_release_lock((PyThread_type_lock)interpreter_lock);
-#endif
+	drop_gil(NULL);
 }
 
 DL_EXPORT(void)
@@ -303,7 +455,7 @@ PyEval_AcquireThread(PyThreadState *tstate)
 {
 	if (tstate == NULL)
 		Py_FatalError("PyEval_AcquireThread: NULL new thread state");
-	PyThread_acquire_lock((PyThread_type_lock)interpreter_lock, 1);
+	take_gil(tstate);
 	if (PyThreadState_Swap(tstate) != NULL)
 		Py_FatalError(
 			"PyEval_AcquireThread: non-NULL old thread state");
@@ -316,7 +468,7 @@ PyEval_ReleaseThread(PyThreadState *tstate)
 		Py_FatalError("PyEval_ReleaseThread: NULL thread state");
 	if (PyThreadState_Swap(NULL) != tstate)
 		Py_FatalError("PyEval_ReleaseThread: wrong thread state");
-	PyThread_release_lock((PyThread_type_lock)interpreter_lock);
+	drop_gil(tstate);
 }
 
 /* This function is called from PyOS_AfterFork to ensure that newly
@@ -334,11 +486,50 @@ PyEval_ReInitThreads(void)
 	  adding a new function to each thread_*.h.  Instead, just
 	  create a new lock and waste a little bit of memory */
 	interpreter_lock = PyThread_allocate_lock();
-	PyThread_acquire_lock(interpreter_lock, 1);
+	gil_locked = 1;
+	gil_waiters = NULL;
+	gil_drop_request = 0;
+	gil_since = PyThread_get_microseconds();
+	gil_nspare = 0;
 	main_thread = PyThread_get_thread_ident();
 }
+#else /* !WITH_THREAD */
+#define gil_drop_request 0
+#define GIL_DROP_NEW	1
 #endif
 
+/* The switch interval, in microseconds; 0 means the default. */
+
+#define DEFAULT_SWITCH_INTERVAL 5000
+
+#ifndef SYMBIAN
+static unsigned long switch_interval = 0;
+#else
+#define switch_interval (PYTHON_GLOBALS->gil_interval)
+#endif
+
+unsigned long
+_PyEval_GetSwitchInterval(void)
+{
+	return switch_interval ? switch_interval : DEFAULT_SWITCH_INTERVAL;
+}
+
+void
+_PyEval_SetSwitchInterval(unsigned long microseconds)
+{
+	switch_interval = microseconds ? microseconds : 1;
+}
+
+unsigned long
+_PyEval_GetGILHeld(void)
+{
+#ifdef WITH_THREAD
+	if (interpreter_lock)
+		return PyThread_get_microseconds() - gil_since;
+#endif
+	return 0;
+}
+
 /* Functions save_thread and restore_thread are always defined so
    dynamically loaded modules needn't be compiled separately for use
    with and without threads: */
@@ -351,7 +542,7 @@ PyEval_SaveThread(void)
 		Py_FatalError("PyEval_SaveThread: NULL tstate");
 #ifdef WITH_THREAD
 	if (interpreter_lock)
-		PyThread_release_lock(interpreter_lock);
+		drop_gil(tstate);
 #endif
 	return tstate;
 }
@@ -364,7 +555,7 @@ PyEval_RestoreThread(PyThreadState *tstate)
 #ifdef WITH_THREAD
 	if (interpreter_lock) {
 		int err = errno;
-		PyThread_acquire_lock(interpreter_lock, 1);
+		take_gil(tstate);
 		errno = err;
 	}
 #endif
@@ -519,6 +710,243 @@ Py_SetRecursionLimit(int new_limit)
 	recursion_limit = new_limit;
 }
 
+/* LOAD_GLOBAL and LOAD_ATTR cache statistics, reported by
+   sys.getcachestats() */
+
+#ifndef SYMBIAN
+static unsigned long globalcache_hits = 0;
+static unsigned long globalcache_misses = 0;
+static unsigned long attrcache_hits = 0;
+static unsigned long attrcache_misses = 0;
+#else
+#define globalcache_hits (PYTHON_GLOBALS->globalcache_hits)
+#define globalcache_misses (PYTHON_GLOBALS->globalcache_misses)
+#define attrcache_hits (PYTHON_GLOBALS->attrcache_hits)
+#define attrcache_misses (PYTHON_GLOBALS->attrcache_misses)
+#endif
+
+extern void _PyType_GetCacheStats(unsigned long *, unsigned long *);
+
+static int
+add_cache_stat(PyObject *d, char *name, unsigned long value)
+{
+	PyObject *v = PyLong_FromUnsignedLong(value);
+	int err;
+
+	if (v == NULL)
+		return -1;
+	err = PyDict_SetItemString(d, name, v);
+	Py_DECREF(v);
+	return err;
+}
+
+PyObject *
+_PyEval_GetCacheStats(PyObject *self)
+{
+	PyObject *d = PyDict_New();
+	unsigned long method_hits, method_misses;
+
+	if (d == NULL)
+		return NULL;
+	_PyType_GetCacheStats(&method_hits, &method_misses);
+	if (add_cache_stat(d, "global_hits", globalcache_hits) < 0 ||
+	    add_cache_stat(d, "global_misses", globalcache_misses) < 0 ||
+	    add_cache_stat(d, "attr_hits", attrcache_hits) < 0 ||
+	    add_cache_stat(d, "attr_misses", attrcache_misses) < 0 ||
+	    add_cache_stat(d, "method_hits", method_hits) < 0 ||
+	    add_cache_stat(d, "method_misses", method_misses) < 0) {
+		Py_DECREF(d);
+		return NULL;
+	}
+	return d;
+}
+
+/* LOAD_ATTR cache.  Only objects whose type uses the generic getattr and
+   keeps the instance dict at a fixed offset are cached; for those the
+   lookup order of PyObject_GenericGetAttr() is known, so remembering
+   which step found the attribute is enough to repeat it. */
+
+#define AC_DICT		1	/* in the instance dict, entry ac_hint */
+#define AC_CLASS	2	/* non-data descriptor or plain class attr */
+#define AC_DATA		3	/* data descriptor */
+
+#define ATTRCACHE_OK(tp) \
+	((tp)->tp_getattro == PyObject_GenericGetAttr && \
+	 (tp)->tp_dict != NULL && (tp)->tp_dictoffset >= 0)
+
+#define INSTANCE_DICT(v, tp) \
+	((tp)->tp_dictoffset > 0 ? \
+	 *(PyObject **)((char *)(v) + (tp)->tp_dictoffset) : NULL)
+
+/* Return 1 and set *px (possibly to NULL with an exception) if the entry
+   answers v.w, or 0 if the slow path must be taken. */
+static int
+attrcache_load(PyAttrCacheEntry *ace, PyObject *v, PyObject *w,
+	       PyObject **px)
+{
+	PyTypeObject *tp = v->ob_type;
+	PyObject *dict, *x;
+	PyDictObject *mp;
+
+	if (ace->ac_type != tp || ace->ac_epoch != _PyType_Epoch ||
+	    ace->ac_version != ((PyDictObject *)tp->tp_dict)->ma_version)
+		return 0;
+	dict = INSTANCE_DICT(v, tp);
+	switch (ace->ac_kind) {
+	case AC_DICT:
+		if (dict == NULL)
+			return 0;
+		mp = (PyDictObject *)dict;
+		if (ace->ac_hint >= mp->ma_keys->dk_nentries ||
+		    _PyDict_ENTRIES(mp->ma_keys)[ace->ac_hint].me_key != w)
+			return 0;
+		x = _PyDict_VALUE(mp, ace->ac_hint);
+		if (x == NULL)
+			return 0;
+		Py_INCREF(x);
+		*px = x;
+		return 1;
+	case AC_CLASS:
+		if (dict != NULL && PyDict_GetItem(dict, w) != NULL)
+			return 0;
+		/* fall through */
+	case AC_DATA:
+		if (ace->ac_get != NULL) {
+			*px = ace->ac_get(ace->ac_descr, v, (PyObject *)tp);
+			return 1;
+		}
+		x = ace->ac_descr;
+		Py_INCREF(x);
+		*px = x;
+		return 1;
+	}
+	return 0;
+}
+
+/* Record where PyObject_GenericGetAttr() just found v.w */
+static void
+attrcache_fill(PyAttrCacheEntry *ace, PyObject *v, PyObject *w)
+{
+	PyTypeObject *tp = v->ob_type;
+	PyObject *mro, *descr, *dict;
+	PyDictObject *mp;
+	PyObject **value_addr;
+	descrgetfunc f;
+	long hash;
+	int i, ix;
+
+	ace->ac_kind = 0;
+	ace->ac_type = NULL;
+	/* Classic classes in the MRO can change without moving the epoch */
+	mro = tp->tp_mro;
+	if (mro == NULL)
+		return;
+	for (i = PyTuple_GET_SIZE(mro); --i >= 0; ) {
+		if (PyClass_Check(PyTuple_GET_ITEM(mro, i)))
+			return;
+	}
+	descr = _PyType_Lookup(tp, w);
+	f = NULL;
+	if (descr != NULL &&
+	    PyType_HasFeature(descr->ob_type, Py_TPFLAGS_HAVE_CLASS))
+		f = descr->ob_type->tp_descr_get;
+	if (f != NULL && PyDescr_IsData(descr))
+		ace->ac_kind = AC_DATA;
+	else if (descr != NULL)
+		ace->ac_kind = AC_CLASS;
+	else {
+		dict = INSTANCE_DICT(v, tp);
+		hash = ((PyStringObject *)w)->ob_shash;
+		if (dict == NULL || hash == -1)
+			return;
+		mp = (PyDictObject *)dict;
+		ix = mp->ma_keys->dk_lookup(mp, w, hash, &value_addr);
+		if (ix < 0 || *value_addr == NULL ||
+		    _PyDict_ENTRIES(mp->ma_keys)[ix].me_key != w)
+			return;
+		ace->ac_hint = ix;
+		ace->ac_kind = AC_DICT;
+	}
+	ace->ac_type = tp;
+	ace->ac_epoch = _PyType_Epoch;
+	ace->ac_version = ((PyDictObject *)tp->tp_dict)->ma_version;
+	ace->ac_descr = descr;
+	ace->ac_get = f;
+}
+
+/* Specialization ("quickening").  An arithmetic or comparison instruction
+   that finds int or float operands is rewritten into a variant handling
+   just those types, without going through PyNumber_* and coercion.  The
+   rewritten bytes go into a private copy of the bytecode, co_quickcode,
+   which the eval loop runs from once it exists; co_code itself, which is
+   what marshal, dis and code comparison see, never changes.  When a
+   specialized instruction meets other operand types it puts back the
+   original opcode from co_code and runs that, which may specialize it
+   again for the new types.  A code object that has done this
+   QUICK_MAX_DEOPTS times is left alone from then on. */
+
+#define QUICK_MAX_DEOPTS 16
+
+#define IS_NUMBER(o) (PyInt_CheckExact(o) || PyFloat_CheckExact(o))
+
+/* Return the specialized form of opcode for operands v and w, or 0 */
+static int
+quick_opcode(int opcode, int oparg, PyObject *v, PyObject *w)
+{
+	int ints;
+
+	if (!IS_NUMBER(v) || !IS_NUMBER(w))
+		return 0;
+	ints = PyInt_CheckExact(v) && PyInt_CheckExact(w);
+	switch (opcode) {
+	case BINARY_ADD:
+	case INPLACE_ADD:
+		return ints ? BINARY_ADD_INT : BINARY_ADD_FLOAT;
+	case BINARY_SUBTRACT:
+	case INPLACE_SUBTRACT:
+		return ints ? BINARY_SUBTRACT_INT : BINARY_SUBTRACT_FLOAT;
+	case BINARY_MULTIPLY:
+	case INPLACE_MULTIPLY:
+		return ints ? BINARY_MULTIPLY_INT : BINARY_MULTIPLY_FLOAT;
+	case BINARY_MODULO:
+	case INPLACE_MODULO:
+		return ints ? BINARY_MODULO_INT : 0;
+	case BINARY_DIVIDE:
+	case INPLACE_DIVIDE:
+	case BINARY_TRUE_DIVIDE:
+	case INPLACE_TRUE_DIVIDE:
+		/* int / int depends on -Qnew; the rest doesn't */
+		return ints ? 0 : BINARY_DIVIDE_FLOAT;
+	case COMPARE_OP:
+		if (oparg > GE)
+			return 0;
+		return ints ? COMPARE_OP_INT : COMPARE_OP_FLOAT;
+	}
+	return 0;
+}
+
+/* Write op over the instruction at offset in co's co_quickcode, creating
+   it first if needed.  Return 0 if that can't be done. */
+static int
+quicken(PyCodeObject *co, int offset, int op)
+{
+	unsigned char *code;
+	int n;
+
+	if (co->co_quickcode == NULL) {
+		if (!PyString_CheckExact(co->co_code))
+			return 0;
+		n = PyString_GET_SIZE(co->co_code);
+		code = PyMem_NEW(unsigned char, n);
+		if (code == NULL)
+			return 0;
+		memcpy(code, PyString_AS_STRING(co->co_code), n);
+		co->co_quickcode = code;
+	}
+	co->co_quickcode[offset] = op;
+	return 1;
+}
+
 /* Status code for main loop (reason for stack unwind) */
 
 enum why_code {
@@ -575,7 +1003,15 @@ eval_frame(PyFrameObject *f)
 	PyObject *retval = NULL;	/* Return value */
 	PyThreadState *tstate = PyThreadState_GET();
 	PyCodeObject *co;
+	PyGlobalCacheEntry *gce;
+	PyAttrCacheEntry *ace;
+	PyObject *acx;		/* not register: attrcache_load() sets it */
+	int quickop;
+	double da, db;		/* operands of the float specializations */
 	unsigned char *first_instr;
+	/* Bounds of the source line the last traced instruction belongs
+	   to, and that instruction; see maybe_call_line_trace() */
+	int instr_lb = 0, instr_ub = -1, instr_prev = -1;
 #ifdef LLTRACE
 	int lltrace;
 #endif
@@ -595,11 +1031,37 @@ eval_frame(PyFrameObject *f)
 #define JUMPTO(x)	(next_instr = first_instr + (x))
 #define JUMPBY(x)	(next_instr += (x))
 
+/* Opcode dispatch macros.  DISPATCH() ends a handler that succeeded.
+   With computed gotos it fetches the next instruction and jumps to its
+   handler directly, unless the periodic checks at the top of the loop
+   are due; otherwise it is a plain 'continue'. */
+
+#ifdef USE_COMPUTED_GOTOS
+#include "opcode_targets.h"
+#define TARGET(op)		TARGET_##op: case op:
+#define TARGET_SLOT(op, n)	TARGET_##op##_##n: case op+n:
+#define FAST_DISPATCH()	{ f->f_lasti = INSTR_OFFSET(); \
+			  opcode = NEXTOP(); \
+			  if (HAS_ARG(opcode)) oparg = NEXTARG(); \
+			  goto *opcode_targets[opcode]; }
+#define DISPATCH()	{ if (!things_to_do && \
+			      gil_drop_request != GIL_DROP_NEW && \
+			      tstate->c_tracefunc == NULL && \
+			      --tstate->ticker >= 0) \
+				FAST_DISPATCH(); \
+			  continue; }
+#else
+#define TARGET(op)		case op:
+#define TARGET_SLOT(op, n)	case op+n:
+#define DISPATCH()	continue
+#endif
+
 /* Stack manipulation macros */
 
 #define STACK_LEVEL()	(stack_pointer - f->f_valuestack)
 #define STACK_EMPTY()		(STACK_LEVEL() == 0)
 #define TOP()		(stack_pointer[-1])
+#define SECOND()	(stack_pointer[-2])
 #define BASIC_PUSH(v)	(*stack_pointer++ = (v))
 #define BASIC_POP()	(*--stack_pointer)
 
@@ -617,6 +1079,37 @@ eval_frame(PyFrameObject *f)
 
 #define GETLOCAL(i)	(fastlocals[i])
 
+/* Specialization macros (see quick_opcode() above).  QUICKEN() is used by
+   the generic handlers once they have popped their operands; the frame
+   switches to co_quickcode if it wasn't running from it already. */
+
+#define QUICKEN(v, w) \
+	if (co->co_quickdeopts < QUICK_MAX_DEOPTS && \
+	    (quickop = quick_opcode(opcode, oparg, v, w)) != 0 && \
+	    quicken(co, f->f_lasti, quickop)) { \
+		next_instr = co->co_quickcode + INSTR_OFFSET(); \
+		first_instr = co->co_quickcode; \
+	}
+
+/* Load v and w into da and db if one is a float and the other a float or
+   an int; otherwise give up the specialization */
+#define FLOAT_OPERANDS(v, w) \
+	if (PyFloat_CheckExact(v)) { \
+		da = PyFloat_AS_DOUBLE(v); \
+		if (PyFloat_CheckExact(w)) \
+			db = PyFloat_AS_DOUBLE(w); \
+		else if (PyInt_CheckExact(w)) \
+			db = (double)PyInt_AS_LONG(w); \
+		else \
+			goto deoptimize; \
+	} \
+	else if (PyInt_CheckExact(v) && PyFloat_CheckExact(w)) { \
+		da = (double)PyInt_AS_LONG(v); \
+		db = PyFloat_AS_DOUBLE(w); \
+	} \
+	else \
+		goto deoptimize
+
 /* The SETLOCAL() macro must not DECREF the local variable in-place and
    then store the new value; it must copy the old value to a temporary
    value, then store the new value, and then DECREF the temporary value.
@@ -690,7 +1183,10 @@ eval_frame(PyFrameObject *f)
 	co = f->f_code;
 	fastlocals = f->f_localsplus;
 	freevars = f->f_localsplus + f->f_nlocals;
-	_PyCode_GETCODEPTR(co, &first_instr);
+	if (co->co_quickcode != NULL)
+		first_instr = co->co_quickcode;
+	else
+		_PyCode_GETCODEPTR(co, &first_instr);
 	next_instr = first_instr + f->f_lasti;
 	stack_pointer = f->f_stacktop;
 	assert(stack_pointer != NULL);
@@ -717,9 +1213,11 @@ eval_frame(PyFrameObject *f)
 		   ``things_to_do'' is set, i.e. when an asynchronous
 		   event needs attention (e.g. a signal handler or
 		   async I/O handler); see Py_AddPendingCall() and
-		   Py_MakePendingCalls() above. */
+		   Py_MakePendingCalls() above, and while another
+		   thread waits for the interpreter. */
 
-		if (things_to_do || --tstate->ticker < 0) {
+		if (things_to_do || gil_drop_request == GIL_DROP_NEW ||
+		    --tstate->ticker < 0) {
 			tstate->ticker = tstate->interp->checkinterval;
 			tstate->tick_counter++;
 			if (things_to_do) {
@@ -740,27 +1238,57 @@ eval_frame(PyFrameObject *f)
 #endif
 
 #ifdef WITH_THREAD
-			if (interpreter_lock) {
-				/* Give another thread a chance */
-
+			/* Hand the interpreter over to a waiting thread
+			   once this one has had it for the switch interval,
+			   or at once if the waiter outranks it */
+			if (gil_drop_request &&
+			    gil_waiter_priority <= tstate->gil_priority &&
+			    _PyEval_GetGILHeld() <
+			    _PyEval_GetSwitchInterval()) {
+				/* not yet; look again soon */
+				gil_drop_request = GIL_DROP_SEEN;
+				if (tstate->ticker > GIL_DROP_TICKS)
+					tstate->ticker = GIL_DROP_TICKS;
+			}
+			else if (gil_drop_request) {
 				if (PyThreadState_Swap(NULL) != tstate)
 					Py_FatalError("ceval: tstate mix-up");
-				PyThread_release_lock(interpreter_lock);
+				tstate->gil_handoffs++;
+				drop_gil(tstate);
 
 				/* Other threads may run now */
 
-				PyThread_acquire_lock(interpreter_lock, 1);
+				take_gil(tstate);
 				if (PyThreadState_Swap(tstate) != NULL)
 					Py_FatalError("ceval: orphan tstate");
 			}
 #endif
 		}
 
-		/* Extract opcode and argument */
+		/* f_lasti always tells where in the code the frame is, so
+		   that line numbers can be computed from co_lnotab when
+		   they are needed (tracebacks, f_lineno, line tracing). */
 
-#if defined(Py_DEBUG) || defined(LLTRACE)
 		f->f_lasti = INSTR_OFFSET();
-#endif
+
+		if (tstate->c_tracefunc != NULL && !tstate->tracing) {
+			/* Line-by-line tracing */
+			f->f_stacktop = stack_pointer;
+			err = maybe_call_line_trace(tstate->c_tracefunc,
+						    tstate->c_traceobj, f,
+						    &instr_lb, &instr_ub,
+						    &instr_prev);
+			/* Reload possibly changed frame fields */
+			JUMPTO(f->f_lasti);
+			stack_pointer = f->f_stacktop;
+			assert(stack_pointer != NULL);
+			f->f_stacktop = NULL;
+			if (err)
+				/* trace function raised an exception */
+				goto on_error;
+		}
+
+		/* Extract opcode and argument */
 
 		opcode = NEXTOP();
 		if (HAS_ARG(opcode))
@@ -800,28 +1328,31 @@ eval_frame(PyFrameObject *f)
 
 		/* case STOP_CODE: this is an error! */
 
-		case POP_TOP:
+		TARGET(NOP)
+			DISPATCH();
+
+		TARGET(POP_TOP)
 			v = POP();
 			Py_DECREF(v);
-			continue;
+			DISPATCH();
 
-		case ROT_TWO:
+		TARGET(ROT_TWO)
 			v = POP();
 			w = POP();
 			PUSH(v);
 			PUSH(w);
-			continue;
+			DISPATCH();
 
-		case ROT_THREE:
+		TARGET(ROT_THREE)
 			v = POP();
 			w = POP();
 			x = POP();
 			PUSH(v);
 			PUSH(x);
 			PUSH(w);
-			continue;
+			DISPATCH();
 
-		case ROT_FOUR:
+		TARGET(ROT_FOUR)
 			u = POP();
 			v = POP();
 			w = POP();
@@ -830,21 +1361,21 @@ eval_frame(PyFrameObject *f)
 			PUSH(x);
 			PUSH(w);
 			PUSH(v);
-			continue;
+			DISPATCH();
 
-		case DUP_TOP:
+		TARGET(DUP_TOP)
 			v = TOP();
 			Py_INCREF(v);
 			PUSH(v);
-			continue;
+			DISPATCH();
 
-		case DUP_TOPX:
+		TARGET(DUP_TOPX)
 			switch (oparg) {
 			case 1:
 				x = TOP();
 				Py_INCREF(x);
 				PUSH(x);
-				continue;
+				DISPATCH();
 			case 2:
 				x = POP();
 				Py_INCREF(x);
@@ -853,7 +1384,7 @@ eval_frame(PyFrameObject *f)
 				PUSH(x);
 				PUSH(w);
 				PUSH(x);
-				continue;
+				DISPATCH();
 			case 3:
 				x = POP();
 				Py_INCREF(x);
@@ -866,7 +1397,7 @@ eval_frame(PyFrameObject *f)
 				PUSH(v);
 				PUSH(w);
 				PUSH(x);
-				continue;
+				DISPATCH();
 			case 4:
 				x = POP();
 				Py_INCREF(x);
@@ -883,7 +1414,7 @@ eval_frame(PyFrameObject *f)
 				PUSH(v);
 				PUSH(w);
 				PUSH(x);
-				continue;
+				DISPATCH();
 			case 5:
 				x = POP();
 				Py_INCREF(x);
@@ -904,128 +1435,133 @@ eval_frame(PyFrameObject *f)
 				PUSH(v);
 				PUSH(w);
 				PUSH(x);
-				continue;
+				DISPATCH();
 			default:
 				Py_FatalError("invalid argument to DUP_TOPX"
 					      " (bytecode corruption?)");
 			}
 			break;
 
-		case UNARY_POSITIVE:
+		TARGET(UNARY_POSITIVE)
 			v = POP();
 			x = PyNumber_Positive(v);
 			Py_DECREF(v);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case UNARY_NEGATIVE:
+		TARGET(UNARY_NEGATIVE)
 			v = POP();
 			x = PyNumber_Negative(v);
 			Py_DECREF(v);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case UNARY_NOT:
+		TARGET(UNARY_NOT)
 			v = POP();
 			err = PyObject_IsTrue(v);
 			Py_DECREF(v);
 			if (err == 0) {
 				Py_INCREF(Py_True);
 				PUSH(Py_True);
-				continue;
+				DISPATCH();
 			}
 			else if (err > 0) {
 				Py_INCREF(Py_False);
 				PUSH(Py_False);
 				err = 0;
-				continue;
+				DISPATCH();
 			}
 			break;
 
-		case UNARY_CONVERT:
+		TARGET(UNARY_CONVERT)
 			v = POP();
 			x = PyObject_Repr(v);
 			Py_DECREF(v);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case UNARY_INVERT:
+		TARGET(UNARY_INVERT)
 			v = POP();
 			x = PyNumber_Invert(v);
 			Py_DECREF(v);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_POWER:
+		TARGET(BINARY_POWER)
 			w = POP();
 			v = POP();
 			x = PyNumber_Power(v, w, Py_None);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_MULTIPLY:
+		TARGET(BINARY_MULTIPLY)
 			w = POP();
 			v = POP();
+			QUICKEN(v, w);
 			x = PyNumber_Multiply(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_DIVIDE:
+		TARGET(BINARY_DIVIDE)
 			if (!_Py_QnewFlag) {
 				w = POP();
 				v = POP();
+				QUICKEN(v, w);
 				x = PyNumber_Divide(v, w);
 				Py_DECREF(v);
 				Py_DECREF(w);
 				PUSH(x);
-				if (x != NULL) continue;
+				if (x != NULL) DISPATCH();
 				break;
 			}
 			/* -Qnew is in effect:  fall through to
 			   BINARY_TRUE_DIVIDE */
-		case BINARY_TRUE_DIVIDE:
+		TARGET(BINARY_TRUE_DIVIDE)
 			w = POP();
 			v = POP();
+			QUICKEN(v, w);
 			x = PyNumber_TrueDivide(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_FLOOR_DIVIDE:
+		TARGET(BINARY_FLOOR_DIVIDE)
 			w = POP();
 			v = POP();
 			x = PyNumber_FloorDivide(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_MODULO:
+		TARGET(BINARY_MODULO)
 			w = POP();
 			v = POP();
+			QUICKEN(v, w);
 			x = PyNumber_Remainder(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_ADD:
+		TARGET(BINARY_ADD)
 			w = POP();
 			v = POP();
+			QUICKEN(v, w);
 			if (PyInt_CheckExact(v) && PyInt_CheckExact(w)) {
 				/* INLINE: int + int */
 				register long a, b, i;
@@ -1043,12 +1579,13 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_SUBTRACT:
+		TARGET(BINARY_SUBTRACT)
 			w = POP();
 			v = POP();
+			QUICKEN(v, w);
 			if (PyInt_CheckExact(v) && PyInt_CheckExact(w)) {
 				/* INLINE: int - int */
 				register long a, b, i;
@@ -1066,10 +1603,10 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_SUBSCR:
+		TARGET(BINARY_SUBSCR)
 			w = POP();
 			v = POP();
 			if (PyList_CheckExact(v) && PyInt_CheckExact(w)) {
@@ -1093,125 +1630,130 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_LSHIFT:
+		TARGET(BINARY_LSHIFT)
 			w = POP();
 			v = POP();
 			x = PyNumber_Lshift(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_RSHIFT:
+		TARGET(BINARY_RSHIFT)
 			w = POP();
 			v = POP();
 			x = PyNumber_Rshift(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_AND:
+		TARGET(BINARY_AND)
 			w = POP();
 			v = POP();
 			x = PyNumber_And(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_XOR:
+		TARGET(BINARY_XOR)
 			w = POP();
 			v = POP();
 			x = PyNumber_Xor(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case BINARY_OR:
+		TARGET(BINARY_OR)
 			w = POP();
 			v = POP();
 			x = PyNumber_Or(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_POWER:
+		TARGET(INPLACE_POWER)
 			w = POP();
 			v = POP();
 			x = PyNumber_InPlacePower(v, w, Py_None);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_MULTIPLY:
+		TARGET(INPLACE_MULTIPLY)
 			w = POP();
 			v = POP();
+			QUICKEN(v, w);
 			x = PyNumber_InPlaceMultiply(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_DIVIDE:
+		TARGET(INPLACE_DIVIDE)
 			if (!_Py_QnewFlag) {
 				w = POP();
 				v = POP();
+				QUICKEN(v, w);
 				x = PyNumber_InPlaceDivide(v, w);
 				Py_DECREF(v);
 				Py_DECREF(w);
 				PUSH(x);
-				if (x != NULL) continue;
+				if (x != NULL) DISPATCH();
 				break;
 			}
 			/* -Qnew is in effect:  fall through to
 			   INPLACE_TRUE_DIVIDE */
-		case INPLACE_TRUE_DIVIDE:
+		TARGET(INPLACE_TRUE_DIVIDE)
 			w = POP();
 			v = POP();
+			QUICKEN(v, w);
 			x = PyNumber_InPlaceTrueDivide(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_FLOOR_DIVIDE:
+		TARGET(INPLACE_FLOOR_DIVIDE)
 			w = POP();
 			v = POP();
 			x = PyNumber_InPlaceFloorDivide(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_MODULO:
+		TARGET(INPLACE_MODULO)
 			w = POP();
 			v = POP();
+			QUICKEN(v, w);
 			x = PyNumber_InPlaceRemainder(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_ADD:
+		TARGET(INPLACE_ADD)
 			w = POP();
 			v = POP();
+			QUICKEN(v, w);
 			if (PyInt_CheckExact(v) && PyInt_CheckExact(w)) {
 				/* INLINE: int + int */
 				register long a, b, i;
@@ -1229,12 +1771,13 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_SUBTRACT:
+		TARGET(INPLACE_SUBTRACT)
 			w = POP();
 			v = POP();
+			QUICKEN(v, w);
 			if (PyInt_CheckExact(v) && PyInt_CheckExact(w)) {
 				/* INLINE: int - int */
 				register long a, b, i;
@@ -1252,63 +1795,63 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_LSHIFT:
+		TARGET(INPLACE_LSHIFT)
 			w = POP();
 			v = POP();
 			x = PyNumber_InPlaceLshift(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_RSHIFT:
+		TARGET(INPLACE_RSHIFT)
 			w = POP();
 			v = POP();
 			x = PyNumber_InPlaceRshift(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_AND:
+		TARGET(INPLACE_AND)
 			w = POP();
 			v = POP();
 			x = PyNumber_InPlaceAnd(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_XOR:
+		TARGET(INPLACE_XOR)
 			w = POP();
 			v = POP();
 			x = PyNumber_InPlaceXor(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case INPLACE_OR:
+		TARGET(INPLACE_OR)
 			w = POP();
 			v = POP();
 			x = PyNumber_InPlaceOr(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case SLICE+0:
-		case SLICE+1:
-		case SLICE+2:
-		case SLICE+3:
+		TARGET(SLICE)
+		TARGET_SLOT(SLICE, 1)
+		TARGET_SLOT(SLICE, 2)
+		TARGET_SLOT(SLICE, 3)
 			if ((opcode-SLICE) & 2)
 				w = POP();
 			else
@@ -1323,13 +1866,13 @@ eval_frame(PyFrameObject *f)
 			Py_XDECREF(v);
 			Py_XDECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case STORE_SLICE+0:
-		case STORE_SLICE+1:
-		case STORE_SLICE+2:
-		case STORE_SLICE+3:
+		TARGET(STORE_SLICE)
+		TARGET_SLOT(STORE_SLICE, 1)
+		TARGET_SLOT(STORE_SLICE, 2)
+		TARGET_SLOT(STORE_SLICE, 3)
 			if ((opcode-STORE_SLICE) & 2)
 				w = POP();
 			else
@@ -1345,13 +1888,13 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(u);
 			Py_XDECREF(v);
 			Py_XDECREF(w);
-			if (err == 0) continue;
+			if (err == 0) DISPATCH();
 			break;
 
-		case DELETE_SLICE+0:
-		case DELETE_SLICE+1:
-		case DELETE_SLICE+2:
-		case DELETE_SLICE+3:
+		TARGET(DELETE_SLICE)
+		TARGET_SLOT(DELETE_SLICE, 1)
+		TARGET_SLOT(DELETE_SLICE, 2)
+		TARGET_SLOT(DELETE_SLICE, 3)
 			if ((opcode-DELETE_SLICE) & 2)
 				w = POP();
 			else
@@ -1366,10 +1909,10 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(u);
 			Py_XDECREF(v);
 			Py_XDECREF(w);
-			if (err == 0) continue;
+			if (err == 0) DISPATCH();
 			break;
 
-		case STORE_SUBSCR:
+		TARGET(STORE_SUBSCR)
 			w = POP();
 			v = POP();
 			u = POP();
@@ -1378,20 +1921,20 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(u);
 			Py_DECREF(v);
 			Py_DECREF(w);
-			if (err == 0) continue;
+			if (err == 0) DISPATCH();
 			break;
 
-		case DELETE_SUBSCR:
+		TARGET(DELETE_SUBSCR)
 			w = POP();
 			v = POP();
 			/* del v[w] */
 			err = PyObject_DelItem(v, w);
 			Py_DECREF(v);
 			Py_DECREF(w);
-			if (err == 0) continue;
+			if (err == 0) DISPATCH();
 			break;
 
-		case PRINT_EXPR:
+		TARGET(PRINT_EXPR)
 			v = POP();
 			w = PySys_GetObject("displayhook");
 			if (w == NULL) {
@@ -1415,11 +1958,11 @@ eval_frame(PyFrameObject *f)
 			Py_XDECREF(x);
 			break;
 
-		case PRINT_ITEM_TO:
+		TARGET(PRINT_ITEM_TO)
 			w = stream = POP();
 			/* fall through to PRINT_ITEM */
 
-		case PRINT_ITEM:
+		TARGET(PRINT_ITEM)
 			v = POP();
 			if (stream == NULL || stream == Py_None) {
 				w = PySys_GetObject("stdout");
@@ -1458,14 +2001,14 @@ eval_frame(PyFrameObject *f)
 			Py_XDECREF(stream);
 			stream = NULL;
 			if (err == 0)
-				continue;
+				DISPATCH();
 			break;
 
-		case PRINT_NEWLINE_TO:
+		TARGET(PRINT_NEWLINE_TO)
 			w = stream = POP();
 			/* fall through to PRINT_NEWLINE */
 
-		case PRINT_NEWLINE:
+		TARGET(PRINT_NEWLINE)
 			if (stream == NULL || stream == Py_None) {
 				w = PySys_GetObject("stdout");
 				if (w == NULL)
@@ -1485,16 +2028,16 @@ eval_frame(PyFrameObject *f)
 #ifdef CASE_TOO_BIG
 		default: switch (opcode) {
 #endif
-		case BREAK_LOOP:
+		TARGET(BREAK_LOOP)
 			why = WHY_BREAK;
 			break;
 
-		case CONTINUE_LOOP:
+		TARGET(CONTINUE_LOOP)
 			retval = PyInt_FromLong(oparg);
 			why = WHY_CONTINUE;
 			break;
 
-		case RAISE_VARARGS:
+		TARGET(RAISE_VARARGS)
 			u = v = w = NULL;
 			switch (oparg) {
 			case 3:
@@ -1516,7 +2059,7 @@ eval_frame(PyFrameObject *f)
 			}
 			break;
 
-		case LOAD_LOCALS:
+		TARGET(LOAD_LOCALS)
 			if ((x = f->f_locals) == NULL) {
 				PyErr_SetString(PyExc_SystemError,
 						"no locals");
@@ -1526,12 +2069,12 @@ eval_frame(PyFrameObject *f)
 			PUSH(x);
 			break;
 
-		case RETURN_VALUE:
+		TARGET(RETURN_VALUE)
 			retval = POP();
 			why = WHY_RETURN;
 			break;
 
-		case YIELD_VALUE:
+		TARGET(YIELD_VALUE)
 			retval = POP();
 			f->f_stacktop = stack_pointer;
 			f->f_lasti = INSTR_OFFSET();
@@ -1539,7 +2082,7 @@ eval_frame(PyFrameObject *f)
 			break;
 
 
-		case EXEC_STMT:
+		TARGET(EXEC_STMT)
 			w = POP();
 			v = POP();
 			u = POP();
@@ -1549,7 +2092,7 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(w);
 			break;
 
-		case POP_BLOCK:
+		TARGET(POP_BLOCK)
 			{
 				PyTryBlock *b = PyFrame_BlockPop(f);
 				while (STACK_LEVEL() > b->b_level) {
@@ -1559,7 +2102,7 @@ eval_frame(PyFrameObject *f)
 			}
 			break;
 
-		case END_FINALLY:
+		TARGET(END_FINALLY)
 			v = POP();
 			if (PyInt_Check(v)) {
 				why = (enum why_code) PyInt_AsLong(v);
@@ -1583,7 +2126,7 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(v);
 			break;
 
-		case BUILD_CLASS:
+		TARGET(BUILD_CLASS)
 			u = POP();
 			v = POP();
 			w = POP();
@@ -1594,7 +2137,7 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(w);
 			break;
 
-		case STORE_NAME:
+		TARGET(STORE_NAME)
 			w = GETNAMEV(oparg);
 			v = POP();
 			if ((x = f->f_locals) == NULL) {
@@ -1607,7 +2150,7 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(v);
 			break;
 
-		case DELETE_NAME:
+		TARGET(DELETE_NAME)
 			w = GETNAMEV(oparg);
 			if ((x = f->f_locals) == NULL) {
 				PyErr_Format(PyExc_SystemError,
@@ -1620,7 +2163,7 @@ eval_frame(PyFrameObject *f)
 							NAME_ERROR_MSG ,w);
 			break;
 
-		case UNPACK_SEQUENCE:
+		TARGET(UNPACK_SEQUENCE)
 			v = POP();
 			if (PyTuple_Check(v)) {
 				if (PyTuple_Size(v) != oparg) {
@@ -1662,7 +2205,7 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(v);
 			break;
 
-		case STORE_ATTR:
+		TARGET(STORE_ATTR)
 			w = GETNAMEV(oparg);
 			v = POP();
 			u = POP();
@@ -1671,7 +2214,7 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(u);
 			break;
 
-		case DELETE_ATTR:
+		TARGET(DELETE_ATTR)
 			w = GETNAMEV(oparg);
 			v = POP();
 			err = PyObject_SetAttr(v, w, (PyObject *)NULL);
@@ -1679,27 +2222,27 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(v);
 			break;
 
-		case STORE_GLOBAL:
+		TARGET(STORE_GLOBAL)
 			w = GETNAMEV(oparg);
 			v = POP();
 			err = PyDict_SetItem(f->f_globals, w, v);
 			Py_DECREF(v);
 			break;
 
-		case DELETE_GLOBAL:
+		TARGET(DELETE_GLOBAL)
 			w = GETNAMEV(oparg);
 			if ((err = PyDict_DelItem(f->f_globals, w)) != 0)
 				format_exc_check_arg(
 				    PyExc_NameError, GLOBAL_NAME_ERROR_MSG, w);
 			break;
 
-		case LOAD_CONST:
+		TARGET(LOAD_CONST)
 			x = GETCONST(oparg);
 			Py_INCREF(x);
 			PUSH(x);
 			break;
 
-		case LOAD_NAME:
+		TARGET(LOAD_NAME)
 			w = GETNAMEV(oparg);
 			if ((x = f->f_locals) == NULL) {
 				PyErr_Format(PyExc_SystemError,
@@ -1724,7 +2267,25 @@ eval_frame(PyFrameObject *f)
 			PUSH(x);
 			break;
 
-		case LOAD_GLOBAL:
+		TARGET(LOAD_GLOBAL)
+			/* The cache entry for this name holds the result of
+			   the last lookup, valid while neither dict has
+			   changed since. */
+			gce = co->co_globalcache;
+			if (gce != NULL) {
+				gce += oparg;
+				if (gce->gc_globals_version ==
+				    ((PyDictObject *)f->f_globals)->ma_version &&
+				    gce->gc_builtins_version ==
+				    ((PyDictObject *)f->f_builtins)->ma_version) {
+					globalcache_hits++;
+					x = gce->gc_value;
+					Py_INCREF(x);
+					PUSH(x);
+					DISPATCH();
+				}
+			}
+			globalcache_misses++;
 			w = GETNAMEV(oparg);
 			x = PyDict_GetItem(f->f_globals, w);
 			if (x == NULL) {
@@ -1736,11 +2297,29 @@ eval_frame(PyFrameObject *f)
 					break;
 				}
 			}
+			if (gce == NULL) {
+				/* First use; without memory, just don't cache */
+				gce = PyMem_NEW(PyGlobalCacheEntry,
+					PyTuple_GET_SIZE(co->co_names));
+				if (gce != NULL) {
+					memset(gce, 0, sizeof(PyGlobalCacheEntry) *
+					       PyTuple_GET_SIZE(co->co_names));
+					co->co_globalcache = gce;
+					gce += oparg;
+				}
+			}
+			if (gce != NULL) {
+				gce->gc_globals_version =
+					((PyDictObject *)f->f_globals)->ma_version;
+				gce->gc_builtins_version =
+					((PyDictObject *)f->f_builtins)->ma_version;
+				gce->gc_value = x;
+			}
 			Py_INCREF(x);
 			PUSH(x);
-			break;
+			DISPATCH();
 
-		case LOAD_FAST:
+		TARGET(LOAD_FAST)
 			x = GETLOCAL(oparg);
 			if (x == NULL) {
 				format_exc_check_arg(
@@ -1752,15 +2331,15 @@ eval_frame(PyFrameObject *f)
 			}
 			Py_INCREF(x);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case STORE_FAST:
+		TARGET(STORE_FAST)
 			v = POP();
 			SETLOCAL(oparg, v);
-			continue;
+			DISPATCH();
 
-		case DELETE_FAST:
+		TARGET(DELETE_FAST)
 			x = GETLOCAL(oparg);
 			if (x == NULL) {
 				format_exc_check_arg(
@@ -1771,15 +2350,15 @@ eval_frame(PyFrameObject *f)
 				break;
 			}
 			SETLOCAL(oparg, NULL);
-			continue;
+			DISPATCH();
 
-		case LOAD_CLOSURE:
+		TARGET(LOAD_CLOSURE)
 			x = freevars[oparg];
 			Py_INCREF(x);
 			PUSH(x);
 			break;
 
-		case LOAD_DEREF:
+		TARGET(LOAD_DEREF)
 			x = freevars[oparg];
 			w = PyCell_Get(x);
 			if (w == NULL) {
@@ -1805,14 +2384,14 @@ eval_frame(PyFrameObject *f)
 			PUSH(w);
 			break;
 
-		case STORE_DEREF:
+		TARGET(STORE_DEREF)
 			w = POP();
 			x = freevars[oparg];
 			PyCell_Set(x, w);
 			Py_DECREF(w);
-			continue;
+			DISPATCH();
 
-		case BUILD_TUPLE:
+		TARGET(BUILD_TUPLE)
 			x = PyTuple_New(oparg);
 			if (x != NULL) {
 				for (; --oparg >= 0;) {
@@ -1820,11 +2399,11 @@ eval_frame(PyFrameObject *f)
 					PyTuple_SET_ITEM(x, oparg, w);
 				}
 				PUSH(x);
-				continue;
+				DISPATCH();
 			}
 			break;
 
-		case BUILD_LIST:
+		TARGET(BUILD_LIST)
 			x =  PyList_New(oparg);
 			if (x != NULL) {
 				for (; --oparg >= 0;) {
@@ -1832,28 +2411,63 @@ eval_frame(PyFrameObject *f)
 					PyList_SET_ITEM(x, oparg, w);
 				}
 				PUSH(x);
-				continue;
+				DISPATCH();
 			}
 			break;
 
-		case BUILD_MAP:
+		TARGET(BUILD_MAP)
 			x = PyDict_New();
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case LOAD_ATTR:
+		TARGET(LOAD_ATTR)
 			w = GETNAMEV(oparg);
 			v = POP();
+			if (!ATTRCACHE_OK(v->ob_type)) {
+				x = PyObject_GetAttr(v, w);
+				Py_DECREF(v);
+				PUSH(x);
+				if (x != NULL) DISPATCH();
+				break;
+			}
+			ace = co->co_attrcache;
+			if (ace != NULL &&
+			    attrcache_load(ace + oparg, v, w, &acx)) {
+				attrcache_hits++;
+				x = acx;
+				Py_DECREF(v);
+				PUSH(x);
+				if (x != NULL) DISPATCH();
+				break;
+			}
+			attrcache_misses++;
 			x = PyObject_GetAttr(v, w);
+			if (x != NULL) {
+				/* The lookup may have run code; look again */
+				ace = co->co_attrcache;
+				if (ace == NULL) {
+					ace = PyMem_NEW(PyAttrCacheEntry,
+						PyTuple_GET_SIZE(co->co_names));
+					if (ace != NULL) {
+						memset(ace, 0,
+						       sizeof(PyAttrCacheEntry) *
+						       PyTuple_GET_SIZE(co->co_names));
+						co->co_attrcache = ace;
+					}
+				}
+				if (ace != NULL && ATTRCACHE_OK(v->ob_type))
+					attrcache_fill(ace + oparg, v, w);
+			}
 			Py_DECREF(v);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case COMPARE_OP:
+		TARGET(COMPARE_OP)
 			w = POP();
 			v = POP();
+			QUICKEN(v, w);
 			if (PyInt_CheckExact(v) && PyInt_CheckExact(w)) {
 				/* INLINE: cmp(int, int) */
 				register long a, b;
@@ -1881,10 +2495,189 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(v);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
+			break;
+
+		/* Specialized instructions, see QUICKEN().  They peek at
+		   their operands so that they can still hand them to the
+		   generic instruction if the types don't match. */
+
+		TARGET(BINARY_ADD_INT)
+			w = TOP();
+			v = SECOND();
+			if (PyInt_CheckExact(v) && PyInt_CheckExact(w)) {
+				register long a, b, i;
+				a = PyInt_AS_LONG(v);
+				b = PyInt_AS_LONG(w);
+				i = a + b;
+				if ((i^a) < 0 && (i^b) < 0)
+					goto run_generic;
+				x = PyInt_FromLong(i);
+				goto quick_binary_done;
+			}
+			goto deoptimize;
+
+		TARGET(BINARY_SUBTRACT_INT)
+			w = TOP();
+			v = SECOND();
+			if (PyInt_CheckExact(v) && PyInt_CheckExact(w)) {
+				register long a, b, i;
+				a = PyInt_AS_LONG(v);
+				b = PyInt_AS_LONG(w);
+				i = a - b;
+				if ((i^a) < 0 && (i^~b) < 0)
+					goto run_generic;
+				x = PyInt_FromLong(i);
+				goto quick_binary_done;
+			}
+			goto deoptimize;
+
+		TARGET(BINARY_MULTIPLY_INT)
+			w = TOP();
+			v = SECOND();
+			if (PyInt_CheckExact(v) && PyInt_CheckExact(w)) {
+				/* The product is exact if the C product, which
+				   may have wrapped, agrees with the (rounded)
+				   double product to within 5 bits; otherwise
+				   int_mul() decides. */
+				register long a, b, i;
+				double dprod, dlprod;
+				a = PyInt_AS_LONG(v);
+				b = PyInt_AS_LONG(w);
+				i = (long)((unsigned long)a * b);
+				dprod = (double)a * (double)b;
+				dlprod = (double)i;
+				if (dlprod != dprod) {
+					double diff = dlprod - dprod;
+					double absprod = dprod >= 0.0 ?
+						dprod : -dprod;
+					if (diff < 0.0)
+						diff = -diff;
+					if (32.0 * diff > absprod)
+						goto run_generic;
+				}
+				x = PyInt_FromLong(i);
+				goto quick_binary_done;
+			}
+			goto deoptimize;
+
+		TARGET(BINARY_MODULO_INT)
+			w = TOP();
+			v = SECOND();
+			if (PyInt_CheckExact(v) && PyInt_CheckExact(w)) {
+				register long a, b, i;
+				a = PyInt_AS_LONG(v);
+				b = PyInt_AS_LONG(w);
+				/* Zero and negative divisors: int_mod() */
+				if (b <= 0)
+					goto run_generic;
+				i = a % b;
+				if (i < 0)
+					i += b;
+				x = PyInt_FromLong(i);
+				goto quick_binary_done;
+			}
+			goto deoptimize;
+
+		TARGET(BINARY_ADD_FLOAT)
+			w = TOP();
+			v = SECOND();
+			FLOAT_OPERANDS(v, w);
+			x = PyFloat_FromDouble(da + db);
+			goto quick_binary_done;
+
+		TARGET(BINARY_SUBTRACT_FLOAT)
+			w = TOP();
+			v = SECOND();
+			FLOAT_OPERANDS(v, w);
+			x = PyFloat_FromDouble(da - db);
+			goto quick_binary_done;
+
+		TARGET(BINARY_MULTIPLY_FLOAT)
+			w = TOP();
+			v = SECOND();
+			FLOAT_OPERANDS(v, w);
+			x = PyFloat_FromDouble(da * db);
+			goto quick_binary_done;
+
+		TARGET(BINARY_DIVIDE_FLOAT)
+			w = TOP();
+			v = SECOND();
+			FLOAT_OPERANDS(v, w);
+			if (db == 0.0)
+				goto run_generic;
+			x = PyFloat_FromDouble(da / db);
+			goto quick_binary_done;
+
+		TARGET(COMPARE_OP_INT)
+			w = TOP();
+			v = SECOND();
+			if (PyInt_CheckExact(v) && PyInt_CheckExact(w)) {
+				register long a, b;
+				register int res;
+				a = PyInt_AS_LONG(v);
+				b = PyInt_AS_LONG(w);
+				switch (oparg) {
+				case LT: res = a <  b; break;
+				case LE: res = a <= b; break;
+				case EQ: res = a == b; break;
+				case NE: res = a != b; break;
+				case GT: res = a >  b; break;
+				default: res = a >= b; break;
+				}
+				x = res ? Py_True : Py_False;
+				Py_INCREF(x);
+				goto quick_binary_done;
+			}
+			goto deoptimize;
+
+		TARGET(COMPARE_OP_FLOAT)
+			w = TOP();
+			v = SECOND();
+			FLOAT_OPERANDS(v, w);
+			{
+				/* As float_compare(): a NaN compares equal */
+				register int c, res;
+				c = da < db ? -1 : da > db ? 1 : 0;
+				switch (oparg) {
+				case LT: res = c <  0; break;
+				case LE: res = c <= 0; break;
+				case EQ: res = c == 0; break;
+				case NE: res = c != 0; break;
+				case GT: res = c >  0; break;
+				default: res = c >= 0; break;
+				}
+				x = res ? Py_True : Py_False;
+				Py_INCREF(x);
+			}
+			/* fall through */
+
+		  quick_binary_done:
+			/* x is the result; v and w are still on the stack */
+			w = POP();
+			v = POP();
+			Py_DECREF(v);
+			Py_DECREF(w);
+			PUSH(x);
+			if (x != NULL) DISPATCH();
 			break;
 
-		case IMPORT_NAME:
+		  deoptimize:
+			/* The operand types changed: put back the generic
+			   instruction, which may specialize itself again */
+			co->co_quickdeopts++;
+			co->co_quickcode[f->f_lasti] =
+				PyString_AS_STRING(co->co_code)[f->f_lasti];
+			/* fall through */
+
+		  run_generic:
+			/* Let the generic instruction handle an operand
+			   value the specialization doesn't */
+			opcode = (unsigned char)
+				PyString_AS_STRING(co->co_code)[f->f_lasti];
+			goto dispatch_opcode;
+
+		TARGET(IMPORT_NAME)
 			w = GETNAMEV(oparg);
 			x = PyDict_GetItemString(f->f_builtins, "__import__");
 			if (x == NULL) {
@@ -1907,10 +2700,10 @@ eval_frame(PyFrameObject *f)
 			x = PyEval_CallObject(x, w);
 			Py_DECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case IMPORT_STAR:
+		TARGET(IMPORT_STAR)
 			v = POP();
 			PyFrame_FastToLocals(f);
 			if ((x = f->f_locals) == NULL) {
@@ -1921,22 +2714,22 @@ eval_frame(PyFrameObject *f)
 			err = import_all_from(x, v);
 			PyFrame_LocalsToFast(f, 0);
 			Py_DECREF(v);
-			if (err == 0) continue;
+			if (err == 0) DISPATCH();
 			break;
 
-		case IMPORT_FROM:
+		TARGET(IMPORT_FROM)
 			w = GETNAMEV(oparg);
 			v = TOP();
 			x = import_from(v, w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case JUMP_FORWARD:
+		TARGET(JUMP_FORWARD)
 			JUMPBY(oparg);
-			continue;
+			DISPATCH();
 
-		case JUMP_IF_FALSE:
+		TARGET(JUMP_IF_FALSE)
 			err = PyObject_IsTrue(TOP());
 			if (err > 0)
 				err = 0;
@@ -1944,9 +2737,9 @@ eval_frame(PyFrameObject *f)
 				JUMPBY(oparg);
 			else
 				break;
-			continue;
+			DISPATCH();
 
-		case JUMP_IF_TRUE:
+		TARGET(JUMP_IF_TRUE)
 			err = PyObject_IsTrue(TOP());
 			if (err > 0) {
 				err = 0;
@@ -1956,41 +2749,41 @@ eval_frame(PyFrameObject *f)
 				;
 			else
 				break;
-			continue;
+			DISPATCH();
 
-		case JUMP_ABSOLUTE:
+		TARGET(JUMP_ABSOLUTE)
 			JUMPTO(oparg);
-			continue;
+			DISPATCH();
 
-		case GET_ITER:
+		TARGET(GET_ITER)
 			/* before: [obj]; after [getiter(obj)] */
 			v = POP();
 			x = PyObject_GetIter(v);
 			Py_DECREF(v);
 			if (x != NULL) {
 				PUSH(x);
-				continue;
+				DISPATCH();
 			}
 			break;
 
-		case FOR_ITER:
+		TARGET(FOR_ITER)
 			/* before: [iter]; after: [iter, iter()] *or* [] */
 			v = TOP();
 			x = PyIter_Next(v);
 			if (x != NULL) {
 				PUSH(x);
-				continue;
+				DISPATCH();
 			}
 			if (!PyErr_Occurred()) {
 				/* iterator ended normally */
  				x = v = POP();
 				Py_DECREF(v);
 				JUMPBY(oparg);
-				continue;
+				DISPATCH();
 			}
 			break;
 
-		case FOR_LOOP:
+		TARGET(FOR_LOOP)
 			/* for v in s: ...
 			   On entry: stack contains s, i.
 			   On exit: stack contains s, i+1, s[i];
@@ -2005,7 +2798,7 @@ eval_frame(PyFrameObject *f)
 				PUSH(x);
 				Py_DECREF(w);
 				PUSH(u);
-				if (x != NULL) continue;
+				if (x != NULL) DISPATCH();
 			}
 			else {
 				Py_DECREF(v);
@@ -2016,52 +2809,35 @@ eval_frame(PyFrameObject *f)
 					why = WHY_EXCEPTION;
 				else {
 					JUMPBY(oparg);
-					continue;
+					DISPATCH();
 				}
 			}
 			break;
 
-		case SETUP_LOOP:
-		case SETUP_EXCEPT:
-		case SETUP_FINALLY:
+		TARGET(SETUP_LOOP)
+		TARGET(SETUP_EXCEPT)
+		TARGET(SETUP_FINALLY)
 			PyFrame_BlockSetup(f, opcode, INSTR_OFFSET() + oparg,
 					   STACK_LEVEL());
-			continue;
+			DISPATCH();
 
-		case SET_LINENO:
+		TARGET(SET_LINENO)
+			/* Only found in code compiled with Py_LinenoFlag
+			   set; line events come from co_lnotab anyway. */
 #ifdef LLTRACE
 			if (lltrace)
 				printf("--- %s:%d \n", filename, oparg);
 #endif
 			f->f_lineno = oparg;
-			if (tstate->c_tracefunc == NULL || tstate->tracing)
-				continue;
-			/* Trace each line of code reached */
-			f->f_lasti = INSTR_OFFSET();
-			f->f_stacktop = stack_pointer;
-			/* Inline call_trace() for performance: */
-			tstate->tracing++;
-			tstate->use_tracing = 0;
-			err = (tstate->c_tracefunc)(tstate->c_traceobj, f,
-						    PyTrace_LINE, Py_None);
-			tstate->use_tracing = (tstate->c_tracefunc
-					       || tstate->c_profilefunc);
-			tstate->tracing--;
-			/* Reload possibly changed frame fields */
-			JUMPTO(f->f_lasti);
-			stack_pointer = f->f_stacktop;
-			assert(stack_pointer != NULL);
-			f->f_stacktop = NULL;
-			break;
+			DISPATCH();
 
-		case CALL_FUNCTION:
+		TARGET(CALL_FUNCTION)
 		{
 		    int na = oparg & 0xff;
 		    int nk = (oparg>>8) & 0xff;
 		    int n = na + 2 * nk;
 		    PyObject **pfunc = stack_pointer - n - 1;
 		    PyObject *func = *pfunc;
-		    f->f_lasti = INSTR_OFFSET() - 3; /* For tracing */
 
 		    /* Always dispatch PyCFunction first, because
 		       these are presumed to be the most frequent
@@ -2110,13 +2886,13 @@ eval_frame(PyFrameObject *f)
 		    }
 		    PUSH(x);
 		    if (x != NULL)
-			    continue;
+			    DISPATCH();
 		    break;
 		}
 
-		case CALL_FUNCTION_VAR:
-		case CALL_FUNCTION_KW:
-		case CALL_FUNCTION_VAR_KW:
+		TARGET(CALL_FUNCTION_VAR)
+		TARGET(CALL_FUNCTION_KW)
+		TARGET(CALL_FUNCTION_VAR_KW)
 		{
 		    int na = oparg & 0xff;
 		    int nk = (oparg>>8) & 0xff;
@@ -2129,7 +2905,6 @@ eval_frame(PyFrameObject *f)
 			    n++;
 		    pfunc = stack_pointer - n - 1;
 		    func = *pfunc;
-		    f->f_lasti = INSTR_OFFSET() - 3; /* For tracing */
 
 		    if (PyMethod_Check(func)
 			&& PyMethod_GET_SELF(func) != NULL) {
@@ -2152,11 +2927,11 @@ eval_frame(PyFrameObject *f)
 		    }
 		    PUSH(x);
 		    if (x != NULL)
-			    continue;
+			    DISPATCH();
 		    break;
 		}
 
-		case MAKE_FUNCTION:
+		TARGET(MAKE_FUNCTION)
 			v = POP(); /* code object */
 			x = PyFunction_New(v, f->f_globals);
 			Py_DECREF(v);
@@ -2178,7 +2953,7 @@ eval_frame(PyFrameObject *f)
 			PUSH(x);
 			break;
 
-		case MAKE_CLOSURE:
+		TARGET(MAKE_CLOSURE)
 		{
 			int nfree;
 			v = POP(); /* code object */
@@ -2218,7 +2993,7 @@ eval_frame(PyFrameObject *f)
 			break;
 		}
 
-		case BUILD_SLICE:
+		TARGET(BUILD_SLICE)
 			if (oparg == 3)
 				w = POP();
 			else
@@ -2230,14 +3005,17 @@ eval_frame(PyFrameObject *f)
 			Py_DECREF(v);
 			Py_XDECREF(w);
 			PUSH(x);
-			if (x != NULL) continue;
+			if (x != NULL) DISPATCH();
 			break;
 
-		case EXTENDED_ARG:
+		TARGET(EXTENDED_ARG)
 			opcode = NEXTOP();
 			oparg = oparg<<16 | NEXTARG();
 			goto dispatch_opcode;
 
+#ifdef USE_COMPUTED_GOTOS
+		_unknown_opcode:
+#endif
 		default:
 			fprintf(stderr,
 				"XXX lineno: %d, opcode: %d\n",
@@ -2265,7 +3043,7 @@ eval_frame(PyFrameObject *f)
 						"XXX undetected error\n");
 				else
 #endif
-					continue; /* Normal, fast path */
+					DISPATCH(); /* Normal, fast path */
 			}
 			why = WHY_EXCEPTION;
 			x = Py_None;
@@ -2296,9 +3074,6 @@ eval_frame(PyFrameObject *f)
 		/* Log traceback info if this is a real exception */
 
 		if (why == WHY_EXCEPTION) {
-			f->f_lasti = INSTR_OFFSET() - 1;
-			if (HAS_ARG(opcode))
-				f->f_lasti -= 2;
 			PyTraceBack_Here(f);
 
 			if (tstate->c_tracefunc != NULL)
@@ -2430,7 +3205,7 @@ eval_frame(PyFrameObject *f)
 
 	return retval;
 #undef PYTHON_GLOBALS
-#define PYTHON_GLOBALS (SPy_get_globals())
+#define PYTHON_GLOBALS SPY_GLOBALS_LOOKUP
 }
 
 DL_EXPORT(PyObject *)
@@ -2964,6 +3739,65 @@ call_trace_protected(Py_tracefunc func, PyObject *obj, PyFrameObject *frame,
 	}
 }
 
+/* Line tracing without SET_LINENO.
+
+   A 'line' event is reported when execution reaches the first
+   instruction of a source line, or jumps backwards (the next iteration
+   of a loop), as found from co_lnotab.  To avoid scanning co_lnotab on
+   every instruction, eval_frame() keeps the address range of the line
+   the last instruction belonged to in [*instr_lb, *instr_ub); the table
+   is only consulted again when f_lasti leaves that range. */
+
+static int
+maybe_call_line_trace(Py_tracefunc func, PyObject *obj,
+		      PyFrameObject *frame, int *instr_lb, int *instr_ub,
+		      int *instr_prev)
+{
+	int result = 0;
+
+	if (frame->f_lasti < *instr_lb || frame->f_lasti >= *instr_ub) {
+		PyCodeObject *co = frame->f_code;
+		int size = PyString_GET_SIZE(co->co_lnotab) / 2;
+		unsigned char *p =
+			(unsigned char *)PyString_AS_STRING(co->co_lnotab);
+		int addr = 0;
+		int line = co->co_firstlineno;
+
+		/* Entries with a zero line increment only continue an
+		   address range (see "All about c_lnotab" in compile.c),
+		   they don't start a new line. */
+		*instr_lb = 0;
+		while (size > 0) {
+			if (addr + *p > frame->f_lasti)
+				break;
+			addr += *p++;
+			if (*p)
+				*instr_lb = addr;
+			line += *p++;
+			--size;
+		}
+		frame->f_lineno = line;
+		if (frame->f_lasti == *instr_lb ||
+		    frame->f_lasti <= *instr_prev)
+			result = call_trace(func, obj, frame,
+					    PyTrace_LINE, Py_None);
+		/* Find where the next line starts */
+		*instr_ub = INT_MAX;
+		while (--size >= 0) {
+			addr += *p++;
+			if (*p++) {
+				*instr_ub = addr;
+				break;
+			}
+		}
+	}
+	else if (frame->f_lasti <= *instr_prev) {
+		result = call_trace(func, obj, frame, PyTrace_LINE, Py_None);
+	}
+	*instr_prev = frame->f_lasti;
+	return result;
+}
+
 static int
 call_trace(Py_tracefunc func, PyObject *obj, PyFrameObject *frame,
 	   int what, PyObject *arg)
@@ -3167,7 +4001,8 @@ PyEval_GetFuncDesc(PyObject *func)
 
 /* The two fast_xxx() functions optimize calls for which no argument
    tuple is necessary; the objects are passed directly from the stack.
-   fast_cfunction() is called for METH_OLDARGS functions.
+   fast_cfunction() is called for METH_OLDARGS, METH_NOARGS, METH_O and
+   METH_FASTCALL functions.
    fast_function() is for functions with no special argument handling.
 */
 
@@ -3211,6 +4046,9 @@ fast_cfunction(PyObject *func, PyObject ***pp_stack, int na)
 			     "%.200s() takes exactly one argument (%d given)",
 			     ((PyCFunctionObject*)func)->m_ml->ml_name, na);
 		return NULL;
+	case METH_FASTCALL:
+		/* The arguments stay on the stack; the caller pops them */
+		return (*(PyCFunctionFast)meth)(self, *pp_stack - na, na);
 	default:
 		fprintf(stderr, "%.200s() flags = %d\n",
 			((PyCFunctionObject*)func)->m_ml->ml_name, flags);
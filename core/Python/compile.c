@@ -38,6 +38,8 @@
 
 #ifndef SYMBIAN
 int Py_OptimizeFlag = 0;
+int Py_LinenoFlag = 0; /* Emit SET_LINENO instructions */
+int Py_NoPeepholeFlag = 0; /* Skip the peephole optimizer */
 #endif
 
 #define OP_DELETE 0
@@ -81,16 +83,37 @@ const static PyMemberDef code_memberlist[] = {
 	{"co_nlocals",	T_INT,		OFF(co_nlocals),	READONLY},
 	{"co_stacksize",T_INT,		OFF(co_stacksize),	READONLY},
 	{"co_flags",	T_INT,		OFF(co_flags),		READONLY},
-	{"co_code",	T_OBJECT,	OFF(co_code),		READONLY},
-	{"co_consts",	T_OBJECT,	OFF(co_consts),		READONLY},
-	{"co_names",	T_OBJECT,	OFF(co_names),		READONLY},
-	{"co_varnames",	T_OBJECT,	OFF(co_varnames),	READONLY},
 	{"co_freevars",	T_OBJECT,	OFF(co_freevars),	READONLY},
 	{"co_cellvars",	T_OBJECT,	OFF(co_cellvars),	READONLY},
 	{"co_filename",	T_OBJECT,	OFF(co_filename),	READONLY},
 	{"co_name",	T_OBJECT,	OFF(co_name),		READONLY},
 	{"co_firstlineno", T_INT,	OFF(co_firstlineno),	READONLY},
-	{"co_lnotab",	T_OBJECT,	OFF(co_lnotab),		READONLY},
+	{NULL}	/* Sentinel */
+};
+
+/* The members that may still have to be loaded, see PyCode_LOAD() */
+#define CODE_GETBODY(member) \
+	static PyObject * \
+	code_get_##member(PyCodeObject *co, void *closure) \
+	{ \
+		if (PyCode_LOAD(co) < 0) \
+			return NULL; \
+		Py_INCREF(co->member); \
+		return co->member; \
+	}
+
+CODE_GETBODY(co_code)
+CODE_GETBODY(co_consts)
+CODE_GETBODY(co_names)
+CODE_GETBODY(co_varnames)
+CODE_GETBODY(co_lnotab)
+
+const static PyGetSetDef code_getsetlist[] = {
+	{"co_code",	(getter)code_get_co_code},
+	{"co_consts",	(getter)code_get_co_consts},
+	{"co_names",	(getter)code_get_co_names},
+	{"co_varnames",	(getter)code_get_co_varnames},
+	{"co_lnotab",	(getter)code_get_co_lnotab},
 	{NULL}	/* Sentinel */
 };
 
@@ -106,6 +129,15 @@ code_dealloc(PyCodeObject *co)
 	Py_XDECREF(co->co_filename);
 	Py_XDECREF(co->co_name);
 	Py_XDECREF(co->co_lnotab);
+	if (co->co_globalcache != NULL)
+		PyMem_DEL(co->co_globalcache);
+	if (co->co_attrcache != NULL)
+		PyMem_DEL(co->co_attrcache);
+	if (co->co_quickcode != NULL)
+		PyMem_DEL(co->co_quickcode);
+	if (co->co_zombieframe != NULL)
+		PyObject_GC_Del(co->co_zombieframe);
+	Py_XDECREF(co->co_lazysource);
 	PyObject_DEL(co);
 }
 
@@ -133,6 +165,8 @@ static int
 code_compare(PyCodeObject *co, PyCodeObject *cp)
 {
 	int cmp;
+	if (PyCode_LOAD(co) < 0 || PyCode_LOAD(cp) < 0)
+		return -1;
 	cmp = PyObject_Compare(co->co_name, cp->co_name);
 	if (cmp) return cmp;
 	cmp = co->co_argcount - cp->co_argcount;
@@ -159,6 +193,8 @@ static long
 code_hash(PyCodeObject *co)
 {
 	long h, h0, h1, h2, h3, h4, h5, h6;
+	if (PyCode_LOAD(co) < 0)
+		return -1;
 	h0 = PyObject_Hash(co->co_name);
 	if (h0 == -1) return -1;
 	h1 = PyObject_Hash(co->co_code);
@@ -212,7 +248,7 @@ const PyTypeObject c_PyCode_Type = {
 	0,				/* tp_iternext */
 	0,				/* tp_methods */
 	code_memberlist,		/* tp_members */
-	0,				/* tp_getset */
+	code_getsetlist,		/* tp_getset */
 	0,				/* tp_base */
 	0,				/* tp_dict */
 	0,				/* tp_descr_get */
@@ -268,6 +304,23 @@ intern_strings(PyObject *tuple)
 	return 0;
 }
 
+/* Intern the identifier-like strings among consts, including those in
+   constant tuples such as the fromlist of "from m import a, b". */
+static void
+intern_string_constants(PyObject *consts)
+{
+	int i;
+
+	for (i = PyTuple_GET_SIZE(consts); --i >= 0; ) {
+		PyObject *v = PyTuple_GET_ITEM(consts, i);
+		if (PyTuple_CheckExact(v))
+			intern_string_constants(v);
+		else if (PyString_CheckExact(v) &&
+			 all_name_chars((unsigned char *)PyString_AS_STRING(v)))
+			PyString_InternInPlace(&PyTuple_GET_ITEM(consts, i));
+	}
+}
+
 DL_EXPORT(PyCodeObject *)
 PyCode_New(int argcount, int nlocals, int stacksize, int flags,
 	   PyObject *code, PyObject *consts, PyObject *names,
@@ -276,7 +329,6 @@ PyCode_New(int argcount, int nlocals, int stacksize, int flags,
 	   PyObject *lnotab)
 {
 	PyCodeObject *co;
-	int i;
 	/* Check argument types */
 	if (argcount < 0 || nlocals < 0 ||
 	    code == NULL ||
@@ -300,15 +352,10 @@ PyCode_New(int argcount, int nlocals, int stacksize, int flags,
 	if (cellvars == NULL)
 		cellvars = PyTuple_New(0);
 	intern_strings(cellvars);
-	/* Intern selected string constants */
-	for (i = PyTuple_Size(consts); --i >= 0; ) {
-		PyObject *v = PyTuple_GetItem(consts, i);
-		if (!PyString_Check(v))
-			continue;
-		if (!all_name_chars((unsigned char *)PyString_AS_STRING(v)))
-			continue;
-		PyString_InternInPlace(&PyTuple_GET_ITEM(consts, i));
-	}
+	intern_string_constants(consts);
+	Py_INCREF(name);
+	if (all_name_chars((unsigned char *)PyString_AS_STRING(name)))
+		PyString_InternInPlace(&name);
 	co = PyObject_NEW(PyCodeObject, &PyCode_Type);
 	if (co != NULL) {
 		co->co_argcount = argcount;
@@ -329,12 +376,20 @@ PyCode_New(int argcount, int nlocals, int stacksize, int flags,
 		co->co_cellvars = cellvars;
 		Py_INCREF(filename);
 		co->co_filename = filename;
-		Py_INCREF(name);
 		co->co_name = name;
 		co->co_firstlineno = firstlineno;
 		Py_INCREF(lnotab);
 		co->co_lnotab = lnotab;
+		co->co_globalcache = NULL;
+		co->co_attrcache = NULL;
+		co->co_quickcode = NULL;
+		co->co_quickdeopts = 0;
+		co->co_zombieframe = NULL;
+		co->co_lazysource = NULL;
+		co->co_lazyoffset = 0;
 	}
+	else
+		Py_DECREF(name);
 	return co;
 }
 
@@ -356,9 +411,10 @@ PyCode_New(int argcount, int nlocals, int stacksize, int flags,
 
 /* All about c_lnotab.
 
-c_lnotab is an array of unsigned bytes disguised as a Python string.  In -O
-mode, SET_LINENO opcodes aren't generated, and bytecode offsets are mapped
-to source code line #s (when needed for tracebacks) via c_lnotab instead.
+c_lnotab is an array of unsigned bytes disguised as a Python string.
+SET_LINENO opcodes are only generated when Py_LinenoFlag is set (and never
+in -O mode); bytecode offsets are mapped to source code line #s (for
+tracebacks, frame.f_lineno and line tracing) via c_lnotab instead.
 The array is conceptually a list of
     (bytecode offset increment, line number increment)
 pairs.  The details are important and delicate, best illustrated by example:
@@ -703,6 +759,281 @@ com_done(struct compiling *c)
 		_PyString_Resize(&c->c_lnotab, c->c_lnotab_next);
 }
 
+/* Peephole optimizer.
+
+   optimize_code() rewrites the finished code string of a code block
+   before the code object is built.  Instructions are never moved: a
+   transformation overwrites its pattern in place, padding the leftover
+   bytes with NOP, and a final pass squeezes the NOPs out while fixing up
+   jump arguments and the address increments in c_lnotab.
+
+   Transformations that span several instructions only apply inside a
+   basic block, i.e. when no jump lands in the middle of the pattern.
+   Code using EXTENDED_ARG, or long enough that a retargeted jump might
+   need it, is left alone.  Setting Py_NoPeepholeFlag disables the pass.
+*/
+
+#define GETARG(arr, i) ((int)((arr[i+2]<<8) + arr[i+1]))
+#define SETARG(arr, i, val) arr[i+2] = (val)>>8; arr[i+1] = (val) & 255
+#define CODESIZE(op)  (HAS_ARG(op) ? 3 : 1)
+#define UNCONDITIONAL_JUMP(op)  (op==JUMP_ABSOLUTE || op==JUMP_FORWARD)
+#define ABSOLUTE_JUMP(op) (op==JUMP_ABSOLUTE || op==CONTINUE_LOOP)
+#define GETJUMPTGT(arr, i) (GETARG(arr,i) + (ABSOLUTE_JUMP(arr[i]) ? 0 : i+3))
+#define ISBASICBLOCK(blocks, start, bytes) \
+	(blocks[start] == blocks[start+bytes-1])
+
+/* Longest chain of unconditional jumps followed from one jump */
+#define MAX_JUMP_CHAIN 16
+
+static int
+is_jump(int op)
+{
+	switch (op) {
+	case FOR_ITER:
+	case FOR_LOOP:
+	case JUMP_FORWARD:
+	case JUMP_IF_FALSE:
+	case JUMP_IF_TRUE:
+	case JUMP_ABSOLUTE:
+	case CONTINUE_LOOP:
+	case SETUP_LOOP:
+	case SETUP_EXCEPT:
+	case SETUP_FINALLY:
+		return 1;
+	}
+	return 0;
+}
+
+/* Number the basic blocks: blocks[i] changes at every jump target.
+   Returns -1 if the code uses EXTENDED_ARG or has a jump outside of
+   the code string, in which case it must not be touched. */
+static int
+mark_blocks(unsigned char *code, int len, int *blocks)
+{
+	int i, op, tgt, blockcnt = 0;
+
+	memset(blocks, 0, len * sizeof(int));
+	for (i = 0; i < len; i += CODESIZE(op)) {
+		op = code[i];
+		if (op == EXTENDED_ARG || i + CODESIZE(op) > len)
+			return -1;
+		if (is_jump(op)) {
+			tgt = GETJUMPTGT(code, i);
+			if (tgt >= len)
+				return -1;
+			blocks[tgt] = 1;
+		}
+	}
+	for (i = 0; i < len; i++) {
+		blockcnt += blocks[i];
+		blocks[i] = blockcnt;
+	}
+	return 0;
+}
+
+static void
+optimize_code(struct compiling *c)
+{
+	unsigned char *code, *lnotab;
+	int *blocks, *addrmap;
+	int codelen, tabsiz, i, j, h, op, tgt, tgttgt, nops, hops;
+	int cum_orig, last_new;
+	PyObject *v;
+
+	if (c->c_code == NULL || c->c_lnotab == NULL)
+		return;
+	codelen = PyString_GET_SIZE(c->c_code);
+	/* Keep every rewritten jump argument below 64K */
+	if (codelen == 0 || codelen > 32700)
+		return;
+	code = (unsigned char *)PyString_AS_STRING(c->c_code);
+	lnotab = (unsigned char *)PyString_AS_STRING(c->c_lnotab);
+	tabsiz = PyString_GET_SIZE(c->c_lnotab);
+
+	/* One buffer: block numbers, then the old -> new address map */
+	blocks = PyMem_NEW(int, 2 * (codelen + 1));
+	if (blocks == NULL)
+		return;
+	addrmap = blocks + codelen + 1;
+	if (mark_blocks(code, codelen, blocks) < 0) {
+		PyMem_DEL(blocks);
+		return;
+	}
+
+	for (i = 0; i < codelen; i += CODESIZE(code[i])) {
+		op = code[i];
+		switch (op) {
+
+		/* LOAD_CONST c  JUMP_IF_xxx x  POP_TOP, with c a constant
+		   that never takes the jump: drop all three.  If it always
+		   takes the jump and x is the matching POP_TOP, jump straight
+		   past x instead of pushing c just to pop it again. */
+		case LOAD_CONST:
+			if (i + 7 > codelen ||
+			    (code[i+3] != JUMP_IF_FALSE &&
+			     code[i+3] != JUMP_IF_TRUE) ||
+			    code[i+6] != POP_TOP ||
+			    !ISBASICBLOCK(blocks, i, 7))
+				break;
+			v = PyList_GET_ITEM(c->c_consts, GETARG(code, i));
+			j = PyObject_IsTrue(v);
+			if (j < 0) {
+				PyErr_Clear();
+				break;
+			}
+			if (j == (code[i+3] == JUMP_IF_TRUE)) {
+				tgt = GETJUMPTGT(code, i+3);
+				if (code[tgt] != POP_TOP)
+					break;
+				code[i] = code[i+1] = code[i+2] = NOP;
+				code[i+3] = JUMP_ABSOLUTE;
+				SETARG(code, i+3, tgt + 1);
+			}
+			else
+				memset(code + i, NOP, 7);
+			break;
+
+		/* UNARY_NOT  JUMP_IF_FALSE x  POP_TOP, where x is a POP_TOP
+		   --> JUMP_IF_TRUE x  POP_TOP  NOP (and vice versa).  Both
+		   paths pop the tested value, so its sense is irrelevant. */
+		case UNARY_NOT:
+			if (i + 5 > codelen ||
+			    (code[i+1] != JUMP_IF_FALSE &&
+			     code[i+1] != JUMP_IF_TRUE) ||
+			    code[i+4] != POP_TOP ||
+			    !ISBASICBLOCK(blocks, i, 5))
+				break;
+			tgt = GETJUMPTGT(code, i+1);
+			if (code[tgt] != POP_TOP)
+				break;
+			j = GETARG(code, i+1) + 1;
+			code[i] = code[i+1] == JUMP_IF_FALSE ?
+				JUMP_IF_TRUE : JUMP_IF_FALSE;
+			SETARG(code, i, j);
+			code[i+3] = POP_TOP;
+			code[i+4] = NOP;
+			break;
+
+		/* BUILD_TUPLE n  UNPACK_SEQUENCE n, as in "a, b = b, a"
+		   --> nothing, ROT_TWO or ROT_THREE ROT_TWO for n = 1..3 */
+		case BUILD_TUPLE:
+		case BUILD_LIST:
+			j = GETARG(code, i);
+			if (i + 6 > codelen ||
+			    code[i+3] != UNPACK_SEQUENCE ||
+			    GETARG(code, i+3) != j ||
+			    j < 1 || j > 3 ||
+			    !ISBASICBLOCK(blocks, i, 6))
+				break;
+			memset(code + i, NOP, 6);
+			if (j == 2)
+				code[i] = ROT_TWO;
+			else if (j == 3) {
+				code[i] = ROT_THREE;
+				code[i+1] = ROT_TWO;
+			}
+			break;
+
+		/* Conditional jump to a conditional jump on the same value:
+		   x: JUMP_IF_FALSE y  ...  y: JUMP_IF_FALSE z  -->  x jumps to z
+		   x: JUMP_IF_FALSE y  ...  y: JUMP_IF_TRUE z   -->  x jumps to y+3
+		*/
+		case JUMP_IF_FALSE:
+		case JUMP_IF_TRUE:
+			tgt = GETJUMPTGT(code, i);
+			if (code[tgt] == JUMP_IF_FALSE ||
+			    code[tgt] == JUMP_IF_TRUE) {
+				if (code[tgt] == op)
+					tgttgt = GETJUMPTGT(code, tgt);
+				else
+					tgttgt = tgt + 3;
+				SETARG(code, i, tgttgt - i - 3);
+				break;
+			}
+			/* Fall through */
+
+		/* Any jump to an unconditional jump goes to its target.
+		   An unconditional jump to a RETURN_VALUE becomes one. */
+		case JUMP_FORWARD:
+		case JUMP_ABSOLUTE:
+		case CONTINUE_LOOP:
+		case SETUP_LOOP:
+		case SETUP_EXCEPT:
+		case SETUP_FINALLY:
+		case FOR_ITER:
+			tgt = GETJUMPTGT(code, i);
+			if (UNCONDITIONAL_JUMP(op) && code[tgt] == RETURN_VALUE) {
+				code[i] = RETURN_VALUE;
+				code[i+1] = code[i+2] = NOP;
+				break;
+			}
+			for (hops = 0; hops < MAX_JUMP_CHAIN &&
+				     UNCONDITIONAL_JUMP(code[tgt]); hops++)
+				tgt = GETJUMPTGT(code, tgt);
+			if (hops == 0)
+				break;
+			if (op == JUMP_FORWARD)	/* JUMP_ABSOLUTE may go back */
+				op = JUMP_ABSOLUTE;
+			if (!ABSOLUTE_JUMP(op)) {
+				tgt -= i + 3;	/* relative jumps only go forward */
+				if (tgt < 0)
+					break;
+			}
+			code[i] = op;
+			SETARG(code, i, tgt);
+			break;
+		}
+	}
+
+	/* Map every old address to its address with the NOPs removed */
+	for (i = 0, nops = 0; i < codelen; ) {
+		if (code[i] == NOP) {
+			addrmap[i] = i - nops;
+			nops++;
+			i++;
+			continue;
+		}
+		for (j = CODESIZE(code[i]); j > 0; j--, i++)
+			addrmap[i] = i - nops;
+	}
+	addrmap[codelen] = codelen - nops;
+	if (nops == 0) {
+		PyMem_DEL(blocks);
+		return;
+	}
+
+	/* Shrink the address increments of c_lnotab to match.  The map
+	   never stretches a distance, so every increment still fits. */
+	cum_orig = last_new = 0;
+	for (i = 0; i < tabsiz; i += 2) {
+		cum_orig += lnotab[i];
+		j = addrmap[cum_orig];
+		lnotab[i] = (unsigned char)(j - last_new);
+		last_new = j;
+	}
+
+	/* Squeeze out the NOPs and fix up the jump arguments */
+	for (i = 0, h = 0; i < codelen; ) {
+		op = code[i];
+		if (op == NOP) {
+			i++;
+			continue;
+		}
+		if (is_jump(op)) {
+			tgt = addrmap[GETJUMPTGT(code, i)];
+			if (!ABSOLUTE_JUMP(op))
+				tgt -= h + 3;
+			SETARG(code, i, tgt);
+		}
+		j = CODESIZE(op);
+		while (j--)
+			code[h++] = code[i++];
+	}
+	assert(h + nops == codelen);
+	PyMem_DEL(blocks);
+	_PyString_Resize(&c->c_code, h);
+}
+
 static int
 com_check_size(PyObject **s, int offset)
 {
@@ -779,8 +1110,11 @@ com_addoparg(struct compiling *c, int op, int arg)
 {
 	int extended_arg = arg >> 16;
 	if (op == SET_LINENO) {
+		/* Line numbers live in c_lnotab; the instruction itself is
+		   only emitted on request (Py_LinenoFlag), since both
+		   tracebacks and line tracing work from co_lnotab. */
 		com_set_lineno(c, arg);
-		if (Py_OptimizeFlag)
+		if (Py_OptimizeFlag || !Py_LinenoFlag)
 			return;
 	}
 	if (extended_arg){
@@ -833,13 +1167,40 @@ com_backpatch(struct compiling *c, int anchor)
 
 /* Handle literals and names uniformly */
 
+/* The key of v in c_const_dict and c_name_dict: v and its type, so that
+   1, 1L and 1.0 stay apart.  Folded tuples are keyed on their items'
+   keys, or (1, 2) and (1.0, 2) would share one constant. */
+static PyObject *
+com_const_key(PyObject *v)
+{
+	PyObject *k, *t;
+	int i, len;
+
+	if (!PyTuple_CheckExact(v))
+		return Py_BuildValue("(OO)", v, v->ob_type);
+	len = PyTuple_GET_SIZE(v);
+	if ((k = PyTuple_New(len)) == NULL)
+		return NULL;
+	for (i = 0; i < len; i++) {
+		t = com_const_key(PyTuple_GET_ITEM(v, i));
+		if (t == NULL) {
+			Py_DECREF(k);
+			return NULL;
+		}
+		PyTuple_SET_ITEM(k, i, t);
+	}
+	t = Py_BuildValue("(OO)", k, v->ob_type);
+	Py_DECREF(k);
+	return t;
+}
+
 static int
 com_add(struct compiling *c, PyObject *list, PyObject *dict, PyObject *v)
 {
 	PyObject *w, *t, *np=NULL;
 	long n;
 
-	t = Py_BuildValue("(OO)", v, v->ob_type);
+	t = com_const_key(v);
 	if (t == NULL)
 	    goto fail;
 	w = PyDict_GetItem(dict, t);
@@ -1435,6 +1796,321 @@ com_dictmaker(struct compiling *c, node *n)
 	}
 }
 
+/* Constant folding.
+
+   Arithmetic on number and string literals, and tuples made only of
+   constants, are evaluated here and stored as a single constant.
+   com_const_value() returns the value of such an expression (a new
+   reference), or NULL if it is not constant or cannot be evaluated;
+   in that case the expression is compiled as usual and any error is
+   raised at run time.  A NULL return with an exception set means a
+   literal itself was bad and the error has been reported.
+
+   Folded results are capped in size so that "'x' * 10**6" does not
+   bloat co_consts and .pyc files; classic division, which depends on
+   -Qnew and -Qwarn, and string formatting are left to run time.
+*/
+
+#define MAX_FOLD_SIZE 20	/* items (or long digits) in a folded result */
+#define MAX_FOLD_SHIFT 512	/* larger shifts and powers blow the cap */
+
+static PyObject *com_const_value(struct compiling *, node *);
+
+static int
+is_const_sequence(PyObject *v)
+{
+	return PyString_Check(v) || PyTuple_Check(v)
+#ifdef Py_USING_UNICODE
+		|| PyUnicode_Check(v)
+#endif
+		;
+}
+
+/* Is x neither an infinity nor a NaN? */
+static int
+fold_finite(double x)
+{
+	return x == x && x - x == 0.0;
+}
+
+/* Can v be stored as a folded constant? */
+static int
+com_fold_ok(PyObject *v, int capped)
+{
+	/* The const dict can't tell +0.0 from -0.0, and marshal writes
+	   floats as text that the target's atof() may not read back if
+	   it is an infinity or a NaN */
+	if (PyFloat_Check(v))
+		return PyFloat_AS_DOUBLE(v) != 0.0 &&
+			fold_finite(PyFloat_AS_DOUBLE(v));
+#ifndef WITHOUT_COMPLEX
+	if (PyComplex_Check(v))
+		return ((PyComplexObject *)v)->cval.real != 0.0 &&
+			((PyComplexObject *)v)->cval.imag != 0.0 &&
+			fold_finite(((PyComplexObject *)v)->cval.real) &&
+			fold_finite(((PyComplexObject *)v)->cval.imag);
+#endif
+	if (!capped)
+		return 1;
+	if (PyLong_Check(v))
+		return ((PyVarObject *)v)->ob_size <= MAX_FOLD_SIZE &&
+			((PyVarObject *)v)->ob_size >= -MAX_FOLD_SIZE;
+	if (is_const_sequence(v))
+		return PyObject_Size(v) <= MAX_FOLD_SIZE;
+	return 1;
+}
+
+static PyObject *
+com_fold_binary(struct compiling *c, int op, PyObject *v, PyObject *w)
+{
+	PyObject *r;
+
+	/* Mixing str and unicode depends on the default encoding */
+	if (is_const_sequence(v) && is_const_sequence(w) &&
+	    v->ob_type != w->ob_type)
+		return NULL;
+	/* Don't build a huge sequence or long just to throw it away */
+	if (op == STAR && PyInt_Check(w) && is_const_sequence(v) &&
+	    PyInt_AS_LONG(w) > MAX_FOLD_SIZE && PyObject_Size(v) > 0)
+		return NULL;
+	if (op == STAR && PyInt_Check(v) && is_const_sequence(w) &&
+	    PyInt_AS_LONG(v) > MAX_FOLD_SIZE && PyObject_Size(w) > 0)
+		return NULL;
+	if ((op == LEFTSHIFT || op == DOUBLESTAR) &&
+	    (PyInt_Check(v) || PyLong_Check(v)) &&
+	    (PyLong_Check(w) ||
+	     (PyInt_Check(w) && PyInt_AS_LONG(w) > MAX_FOLD_SHIFT)))
+		return NULL;
+
+	switch (op) {
+	case DOUBLESTAR:
+		r = PyNumber_Power(v, w, Py_None);
+		break;
+	case STAR:
+		r = PyNumber_Multiply(v, w);
+		break;
+	case SLASH:
+		if (!(c->c_flags & CO_FUTURE_DIVISION))
+			return NULL;
+		r = PyNumber_TrueDivide(v, w);
+		break;
+	case DOUBLESLASH:
+		r = PyNumber_FloorDivide(v, w);
+		break;
+	case PERCENT:
+		if (is_const_sequence(v))
+			return NULL;
+		r = PyNumber_Remainder(v, w);
+		break;
+	case PLUS:
+		r = PyNumber_Add(v, w);
+		break;
+	case MINUS:
+		r = PyNumber_Subtract(v, w);
+		break;
+	case LEFTSHIFT:
+		r = PyNumber_Lshift(v, w);
+		break;
+	case RIGHTSHIFT:
+		r = PyNumber_Rshift(v, w);
+		break;
+	case AMPER:
+		r = PyNumber_And(v, w);
+		break;
+	case CIRCUMFLEX:
+		r = PyNumber_Xor(v, w);
+		break;
+	case VBAR:
+		r = PyNumber_Or(v, w);
+		break;
+	default:
+		return NULL;
+	}
+	if (r == NULL) {
+		/* Leave the exception to run time */
+		PyErr_Clear();
+		return NULL;
+	}
+	if (!com_fold_ok(r, op != PLUS)) {
+		Py_DECREF(r);
+		return NULL;
+	}
+	return r;
+}
+
+static PyObject *
+com_const_tuple(struct compiling *c, node *n)
+{
+	/* testlist: test (',' test)* [','] */
+	PyObject *t, *v;
+	int i, len = (NCH(n) + 1) / 2;
+
+	t = PyTuple_New(len);
+	if (t == NULL) {
+		PyErr_Clear();
+		return NULL;
+	}
+	for (i = 0; i < len; i++) {
+		v = com_const_value(c, CHILD(n, 2*i));
+		if (v == NULL) {
+			Py_DECREF(t);
+			return NULL;
+		}
+		PyTuple_SET_ITEM(t, i, v);
+	}
+	return t;
+}
+
+static PyObject *
+com_const_factor(struct compiling *c, node *n)
+{
+	/* factor: ('+'|'-'|'~') factor | power */
+	int op = TYPE(CHILD(n, 0));
+	node *p = CHILD(n, 1);
+	PyObject *v, *r;
+	char *s;
+
+	/* As in com_factor, the sign of a negative literal is parsed
+	   along with it so that -2147483648 stays an int */
+	if (op == MINUS && NCH(p) == 1 && NCH(CHILD(p, 0)) == 1 &&
+	    TYPE(CHILD(CHILD(p, 0), 0)) == atom &&
+	    TYPE(CHILD(CHILD(CHILD(p, 0), 0), 0)) == NUMBER) {
+		p = CHILD(CHILD(CHILD(p, 0), 0), 0);
+		s = PyMem_Malloc(strlen(STR(p)) + 2);
+		if (s == NULL)
+			return NULL;
+		s[0] = '-';
+		strcpy(s + 1, STR(p));
+		r = parsenumber(c, s);
+		PyMem_Free(s);
+	}
+	else {
+		if ((v = com_const_value(c, p)) == NULL)
+			return NULL;
+		if (op == PLUS)
+			r = PyNumber_Positive(v);
+		else if (op == MINUS)
+			r = PyNumber_Negative(v);
+		else
+			r = PyNumber_Invert(v);
+		Py_DECREF(v);
+	}
+	if (r == NULL) {
+		PyErr_Clear();
+		return NULL;
+	}
+	if (!com_fold_ok(r, 0)) {
+		Py_DECREF(r);
+		return NULL;
+	}
+	return r;
+}
+
+static PyObject *
+com_const_value(struct compiling *c, node *n)
+{
+	PyObject *v, *w, *r;
+	node *ch;
+	int i;
+
+	switch (TYPE(n)) {
+	case testlist:
+	case testlist_safe:
+		if (NCH(n) == 1)
+			return com_const_value(c, CHILD(n, 0));
+		return com_const_tuple(c, n);
+	case test:
+	case and_test:
+	case not_test:
+	case comparison:
+		if (NCH(n) != 1)
+			return NULL;
+		return com_const_value(c, CHILD(n, 0));
+	case expr:
+	case xor_expr:
+	case and_expr:
+	case shift_expr:
+	case arith_expr:
+	case term:
+		v = com_const_value(c, CHILD(n, 0));
+		for (i = 2; v != NULL && i < NCH(n); i += 2) {
+			w = com_const_value(c, CHILD(n, i));
+			if (w == NULL) {
+				Py_DECREF(v);
+				return NULL;
+			}
+			r = com_fold_binary(c, TYPE(CHILD(n, i-1)), v, w);
+			Py_DECREF(v);
+			Py_DECREF(w);
+			v = r;
+		}
+		return v;
+	case factor:
+		if (NCH(n) == 1)
+			return com_const_value(c, CHILD(n, 0));
+		return com_const_factor(c, n);
+	case power:
+		/* power: atom trailer* ['**' factor] */
+		if (NCH(n) != 1 &&
+		    (NCH(n) != 3 || TYPE(CHILD(n, 1)) != DOUBLESTAR))
+			return NULL;
+		v = com_const_value(c, CHILD(n, 0));
+		if (v == NULL || NCH(n) == 1)
+			return v;
+		w = com_const_value(c, CHILD(n, 2));
+		if (w == NULL) {
+			Py_DECREF(v);
+			return NULL;
+		}
+		r = com_fold_binary(c, DOUBLESTAR, v, w);
+		Py_DECREF(v);
+		Py_DECREF(w);
+		return r;
+	case atom:
+		ch = CHILD(n, 0);
+		if (TYPE(ch) == NUMBER)
+			return parsenumber(c, STR(ch));
+		if (TYPE(ch) == STRING) {
+			v = parsestrplus(c, n);
+			if (v == NULL)
+				c->c_errors++;
+			return v;
+		}
+		if (TYPE(ch) == LPAR) {
+			if (TYPE(CHILD(n, 1)) == RPAR)
+				return PyTuple_New(0);
+			return com_const_value(c, CHILD(n, 1));
+		}
+		return NULL;
+	}
+	return NULL;
+}
+
+/* If n is a constant expression, emit a LOAD_CONST of its value and
+   return 1; otherwise emit nothing and return 0. */
+static int
+com_fold_constant(struct compiling *c, node *n)
+{
+	PyObject *v;
+	int i;
+
+	if (PyErr_Occurred())
+		return 0;
+	v = com_const_value(c, n);
+	if (v == NULL) {
+		if (!PyErr_Occurred())
+			return 0;
+		i = 255;	/* bad literal, already reported */
+	}
+	else {
+		i = com_addconst(c, v);
+		Py_DECREF(v);
+	}
+	com_addoparg(c, LOAD_CONST, i);
+	com_push(c, 1);
+	return 1;
+}
+
 static void
 com_atom(struct compiling *c, node *n)
 {
@@ -1863,6 +2539,9 @@ com_power(struct compiling *c, node *n)
 {
 	int i;
 	REQ(n, power);
+	if (NCH(n) == 3 && TYPE(CHILD(n, 1)) == DOUBLESTAR &&
+	    com_fold_constant(c, n))
+		return;
 	com_atom(c, CHILD(n, 0));
 	for (i = 1; i < NCH(n); i++) {
 		if (TYPE(CHILD(n, i)) == DOUBLESTAR) {
@@ -1979,6 +2658,8 @@ com_factor(struct compiling *c, node *n)
 		}
 		com_atom(c, patom);
 	}
+	else if (NCH(n) == 2 && com_fold_constant(c, n))
+		return;
 	else if (childtype == PLUS) {
 		com_factor(c, CHILD(n, 1));
 		com_addbyte(c, UNARY_POSITIVE);
@@ -2002,6 +2683,8 @@ com_term(struct compiling *c, node *n)
 	int i;
 	int op;
 	REQ(n, term);
+	if (NCH(n) > 1 && com_fold_constant(c, n))
+		return;
 	com_factor(c, CHILD(n, 0));
 	for (i = 2; i < NCH(n); i += 2) {
 		com_factor(c, CHILD(n, i));
@@ -2037,6 +2720,8 @@ com_arith_expr(struct compiling *c, node *n)
 	int i;
 	int op;
 	REQ(n, arith_expr);
+	if (NCH(n) > 1 && com_fold_constant(c, n))
+		return;
 	com_term(c, CHILD(n, 0));
 	for (i = 2; i < NCH(n); i += 2) {
 		com_term(c, CHILD(n, i));
@@ -2063,6 +2748,8 @@ com_shift_expr(struct compiling *c, node *n)
 	int i;
 	int op;
 	REQ(n, shift_expr);
+	if (NCH(n) > 1 && com_fold_constant(c, n))
+		return;
 	com_arith_expr(c, CHILD(n, 0));
 	for (i = 2; i < NCH(n); i += 2) {
 		com_arith_expr(c, CHILD(n, i));
@@ -2089,6 +2776,8 @@ com_and_expr(struct compiling *c, node *n)
 	int i;
 	int op;
 	REQ(n, and_expr);
+	if (NCH(n) > 1 && com_fold_constant(c, n))
+		return;
 	com_shift_expr(c, CHILD(n, 0));
 	for (i = 2; i < NCH(n); i += 2) {
 		com_shift_expr(c, CHILD(n, i));
@@ -2111,6 +2800,8 @@ com_xor_expr(struct compiling *c, node *n)
 	int i;
 	int op;
 	REQ(n, xor_expr);
+	if (NCH(n) > 1 && com_fold_constant(c, n))
+		return;
 	com_and_expr(c, CHILD(n, 0));
 	for (i = 2; i < NCH(n); i += 2) {
 		com_and_expr(c, CHILD(n, i));
@@ -2133,6 +2824,8 @@ com_expr(struct compiling *c, node *n)
 	int i;
 	int op;
 	REQ(n, expr);
+	if (NCH(n) > 1 && com_fold_constant(c, n))
+		return;
 	com_xor_expr(c, CHILD(n, 0));
 	for (i = 2; i < NCH(n); i += 2) {
 		com_xor_expr(c, CHILD(n, i));
@@ -2385,6 +3078,8 @@ com_list(struct compiling *c, node *n, int toplevel)
 	else {
 		int i;
 		int len;
+		if (com_fold_constant(c, n))
+			return;
 		len = (NCH(n) + 1) / 2;
 		for (i = 0; i < NCH(n); i += 2)
 			com_node(c, CHILD(n, i));
@@ -4128,6 +4823,8 @@ jcompile(node *n, char *filename, struct compiling *base,
 	}
 	compile_node(&sc, n);
 	com_done(&sc);
+	if (sc.c_errors == 0 && !Py_NoPeepholeFlag)
+		optimize_code(&sc);
 	if (sc.c_errors == 0) {
 		PyObject *consts, *names, *varnames, *filename, *name,
 			*freevars, *cellvars;
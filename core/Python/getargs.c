@@ -16,7 +16,7 @@ int PyArg_ParseTupleAndKeywords(PyObject *, PyObject *,
 				char *, const char * const *, ...);
 
 /* Forward */
-static int vgetargs1(PyObject *, char *, va_list *, int);
+static int vgetargs1(PyObject *, PyObject **, int, char *, va_list *, int);
 static void seterror(int, char *, int *, char *, char *);
 static char *convertitem(PyObject *, char **, va_list *, int *, char *, 
 			 size_t);
@@ -36,7 +36,7 @@ PyArg_Parse(PyObject *args, char *format, ...)
 	va_list va;
 	
 	va_start(va, format);
-	retval = vgetargs1(args, format, &va, 1);
+	retval = vgetargs1(args, NULL, 0, format, &va, 1);
 	va_end(va);
 	return retval;
 }
@@ -49,7 +49,7 @@ PyArg_ParseTuple(PyObject *args, char *format, ...)
 	va_list va;
 	
 	va_start(va, format);
-	retval = vgetargs1(args, format, &va, 0);
+	retval = vgetargs1(args, NULL, 0, format, &va, 0);
 	va_end(va);
 	return retval;
 }
@@ -70,12 +70,28 @@ PyArg_VaParse(PyObject *args, char *format, va_list va)
 #endif
 #endif
 
-	return vgetargs1(args, format, &lva, 0);
+	return vgetargs1(args, NULL, 0, format, &lva, 0);
+}
+
+
+/* PyArg_ParseTuple() for METH_FASTCALL functions: the arguments are the
+   nargs objects at args instead of the items of a tuple. */
+int
+_PyArg_ParseStack(PyObject **args, int nargs, char *format, ...)
+{
+	int retval;
+	va_list va;
+	
+	va_start(va, format);
+	retval = vgetargs1(NULL, args, nargs, format, &va, 0);
+	va_end(va);
+	return retval;
 }
 
 
 static int
-vgetargs1(PyObject *args, char *format, va_list *p_va, int compat)
+vgetargs1(PyObject *args, PyObject **stack, int nstack, char *format,
+	  va_list *p_va, int compat)
 {
 	char msgbuf[256];
 	int levels[32];
@@ -89,7 +105,7 @@ vgetargs1(PyObject *args, char *format, va_list *p_va, int compat)
 	int i, len;
 	char *msg;
 	
-	assert(compat || (args != (PyObject*)NULL));
+	assert(compat || args != NULL || stack != NULL || nstack == 0);
 
 	while (endfmt == 0) {
 		int c = *format++;
@@ -172,13 +188,18 @@ vgetargs1(PyObject *args, char *format, va_list *p_va, int compat)
 		}
 	}
 	
-	if (!PyTuple_Check(args)) {
-		PyErr_SetString(PyExc_SystemError,
-		    "new style getargs format but argument is not a tuple");
-		return 0;
+	if (args != NULL) {
+		if (!PyTuple_Check(args)) {
+			PyErr_SetString(PyExc_SystemError,
+			    "new style getargs format but argument "
+			    "is not a tuple");
+			return 0;
+		}
+		stack = &PyTuple_GET_ITEM(args, 0);
+		len = PyTuple_GET_SIZE(args);
 	}
-	
-	len = PyTuple_GET_SIZE(args);
+	else
+		len = nstack;
 	
 	if (len < min || max < len) {
 		if (message == NULL) {
@@ -201,7 +222,7 @@ vgetargs1(PyObject *args, char *format, va_list *p_va, int compat)
 	for (i = 0; i < len; i++) {
 		if (*format == '|')
 			format++;
-		msg = convertitem(PyTuple_GET_ITEM(args, i), &format, p_va,
+		msg = convertitem(stack[i], &format, p_va,
 				  levels, msgbuf, sizeof(msgbuf));
 		if (msg) {
 			seterror(i+1, msg, levels, fname, message);
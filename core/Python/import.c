@@ -645,7 +645,8 @@ read_compiled_module(char *cpathname, FILE *fp)
 {
 	PyObject *co;
 
-	co = PyMarshal_ReadLastObjectFromFile(fp);
+	/* Function bodies are only unmarshalled when first run */
+	co = PyMarshal_ReadLazyObjectFromFile(fp);
 	/* Ugly: rd_object() may return NULL with or without error */
 	if (co == NULL || !PyCode_Check(co)) {
 		if (!PyErr_Occurred())
@@ -0,0 +1,49 @@
+#! /usr/bin/env python
+"""Generate Python/opcode_targets.h from Include/opcode.h.
+
+The table holds the label addresses used by the computed-goto dispatch
+in ceval.c.  Re-run this whenever an opcode is added or renumbered:
+
+    python makeopcodetargets.py ../Include/opcode.h opcode_targets.h
+"""
+
+import re
+import sys
+
+# Opcodes that occupy several consecutive slots ("Also uses 31-33").
+MULTI_SLOT = {'SLICE': 4, 'STORE_SLICE': 4, 'DELETE_SLICE': 4}
+
+def find_opcodes(header):
+    targets = ['_unknown_opcode'] * 256
+    pattern = re.compile(r'^#define\s+([A-Z_]+)\s+(\d+)')
+    for line in open(header).readlines():
+        m = pattern.match(line)
+        if not m:
+            continue
+        name, num = m.group(1), int(m.group(2))
+        if name == 'HAVE_ARGUMENT':
+            continue
+        if name in MULTI_SLOT:
+            targets[num] = 'TARGET_' + name
+            for i in range(1, MULTI_SLOT[name]):
+                targets[num + i] = 'TARGET_%s_%d' % (name, i)
+        else:
+            targets[num] = 'TARGET_' + name
+    # STOP_CODE is never a valid instruction to execute.
+    targets[0] = '_unknown_opcode'
+    return targets
+
+def main():
+    if len(sys.argv) != 3:
+        sys.stderr.write("usage: %s opcode.h opcode_targets.h\n" % sys.argv[0])
+        sys.exit(2)
+    targets = find_opcodes(sys.argv[1])
+    f = open(sys.argv[2], 'w')
+    f.write("/* Generated by Python/makeopcodetargets.py -- do not edit */\n")
+    f.write("static void *const opcode_targets[256] = {\n")
+    f.write(",\n".join(["\t&&%s" % t for t in targets]))
+    f.write("\n};\n")
+    f.close()
+
+if __name__ == '__main__':
+    main()
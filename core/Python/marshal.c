@@ -10,6 +10,10 @@
 #include "compile.h"
 #include "marshal.h"
 
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
 /* High water mark to determine when the marshalled object is dangerously deep
  * and risks coring the interpreter.  When the object stack gets this deep,
  * raise an exception instead of continuing.
@@ -41,6 +45,9 @@ typedef struct {
 	PyObject *str;
 	char *ptr;
 	char *end;
+	/* Reading only: if nested code objects are to be read lazily,
+	   the CObject holding the lazysource ptr..end lie in, else NULL */
+	PyObject *source;
 } WFILE;
 
 #define w_byte(c, p) if (((p)->fp)) putc((c), (p)->fp); \
@@ -233,6 +240,12 @@ w_object(PyObject *v, WFILE *p)
 	}
 	else if (PyCode_Check(v)) {
 		PyCodeObject *co = (PyCodeObject *)v;
+		if (PyCode_LOAD(co) < 0) {
+			PyErr_Clear();
+			p->depth--;
+			p->error = 1;
+			return;
+		}
 		w_byte(TYPE_CODE, p);
 		w_short(co->co_argcount, p);
 		w_short(co->co_nlocals, p);
@@ -371,6 +384,281 @@ r_long64(RFILE *p)
 #endif
 }
 
+static PyObject *r_object(RFILE *p);
+
+/* The data that code objects read by PyMarshal_ReadLazyObjectFromFile()
+   load their bodies from.  They share it through a CObject, which frees
+   it when the last of them has been loaded or freed. */
+typedef struct {
+	char *data;
+	int size;
+	void *map;	/* mmap()ed region data lies in, or NULL if malloced */
+	size_t maplen;
+} lazysource;
+
+static void
+lazysource_free(void *ptr)
+{
+	lazysource *ls = (lazysource *)ptr;
+#ifdef HAVE_MMAP
+	if (ls->map != NULL)
+		munmap(ls->map, ls->maplen);
+	else
+#endif
+		PyMem_FREE(ls->data);
+	PyMem_DEL(ls);
+}
+
+/* Step over the next object in a string without building it.  Returns 0,
+   or -1 with an exception set. */
+static int
+r_skip(RFILE *p)
+{
+	long i, n;
+	int type = r_byte(p);
+
+	switch (type) {
+
+	case EOF:
+		PyErr_SetString(PyExc_EOFError,
+				"EOF read where object expected");
+		return -1;
+
+	case TYPE_NULL:
+	case TYPE_NONE:
+	case TYPE_STOPITER:
+	case TYPE_ELLIPSIS:
+		return 0;
+
+	case TYPE_INT:
+		n = 4;
+		break;
+
+	case TYPE_INT64:
+		n = 8;
+		break;
+
+	case TYPE_LONG:
+		n = r_long(p);
+		n = 2 * (n < 0 ? -n : n);
+		break;
+
+	case TYPE_FLOAT:
+		n = r_byte(p);
+		break;
+
+	case TYPE_COMPLEX:
+		n = r_byte(p);
+		if (n >= 0 && n <= p->end - p->ptr) {
+			p->ptr += n;
+			n = r_byte(p);
+		}
+		break;
+
+	case TYPE_STRING:
+	case TYPE_UNICODE:
+		n = r_long(p);
+		break;
+
+	case TYPE_TUPLE:
+	case TYPE_LIST:
+		n = r_long(p);
+		if (n < 0)
+			break;
+		for (i = 0; i < n; i++) {
+			if (r_skip(p) < 0)
+				return -1;
+		}
+		return 0;
+
+	case TYPE_DICT:
+		/* Keys and values up to a NULL key */
+		while (p->ptr == p->end || *p->ptr != TYPE_NULL) {
+			if (r_skip(p) < 0 || r_skip(p) < 0)
+				return -1;
+		}
+		p->ptr++;
+		return 0;
+
+	case TYPE_CODE:
+		/* 4 shorts, 8 objects, a short and the line number table */
+		n = 8;
+		if (n > p->end - p->ptr)
+			break;
+		p->ptr += n;
+		for (i = 0; i < 8; i++) {
+			if (r_skip(p) < 0)
+				return -1;
+		}
+		(void)r_short(p);
+		return r_skip(p);
+
+	default:
+		n = -1;
+		break;
+	}
+	if (n < 0) {
+		PyErr_SetString(PyExc_ValueError, "bad marshal data");
+		return -1;
+	}
+	if (n > p->end - p->ptr) {
+		p->ptr = p->end;
+		PyErr_SetString(PyExc_EOFError,
+				"EOF read where object expected");
+		return -1;
+	}
+	p->ptr += n;
+	return 0;
+}
+
+static PyObject *
+r_code(RFILE *p)
+{
+	PyObject *v;
+	int argcount = r_short(p);
+	int nlocals = r_short(p);
+	int stacksize = r_short(p);
+	int flags = r_short(p);
+	PyObject *code = NULL;
+	PyObject *consts = NULL;
+	PyObject *names = NULL;
+	PyObject *varnames = NULL;
+	PyObject *freevars = NULL;
+	PyObject *cellvars = NULL;
+	PyObject *filename = NULL;
+	PyObject *name = NULL;
+	int firstlineno = 0;
+	PyObject *lnotab = NULL;
+
+	/* Code objects nested in this one are read lazily if p->source
+	   is set */
+	p->depth++;
+	code = r_object(p);
+	if (code) consts = r_object(p);
+	if (consts) names = r_object(p);
+	if (names) varnames = r_object(p);
+	if (varnames) freevars = r_object(p);
+	if (freevars) cellvars = r_object(p);
+	if (cellvars) filename = r_object(p);
+	if (filename) name = r_object(p);
+	if (name) {
+		firstlineno = r_short(p);
+		lnotab = r_object(p);
+	}
+	p->depth--;
+
+	if (!PyErr_Occurred()) {
+		v = (PyObject *) PyCode_New(
+			argcount, nlocals, stacksize, flags,
+			code, consts, names, varnames,
+			freevars, cellvars, filename, name,
+			firstlineno, lnotab);
+	}
+	else
+		v = NULL;
+	Py_XDECREF(code);
+	Py_XDECREF(consts);
+	Py_XDECREF(names);
+	Py_XDECREF(varnames);
+	Py_XDECREF(freevars);
+	Py_XDECREF(cellvars);
+	Py_XDECREF(filename);
+	Py_XDECREF(name);
+	Py_XDECREF(lnotab);
+	return v;
+}
+
+/* Read the constants of a lazily read code object.  Only the first is
+   kept, if it is a string, as that is all PyFunction_New() looks at
+   (for the docstring). */
+static PyObject *
+r_lazy_consts(RFILE *p)
+{
+	PyObject *v, *doc = NULL;
+	long i, n;
+
+	if (r_byte(p) != TYPE_TUPLE || (n = r_long(p)) < 0) {
+		PyErr_SetString(PyExc_ValueError, "bad marshal data");
+		return NULL;
+	}
+	for (i = 0; i < n; i++) {
+		if (i == 0 && p->ptr != p->end &&
+		    (*p->ptr == TYPE_STRING || *p->ptr == TYPE_UNICODE)) {
+			if ((doc = r_object(p)) == NULL)
+				return NULL;
+		}
+		else if (r_skip(p) < 0) {
+			Py_XDECREF(doc);
+			return NULL;
+		}
+	}
+	if (doc == NULL)
+		return PyTuple_New(0);
+	v = PyTuple_New(1);
+	if (v == NULL)
+		Py_DECREF(doc);
+	else
+		PyTuple_SET_ITEM(v, 0, doc);
+	return v;
+}
+
+/* Read a code object nested in one read by
+   PyMarshal_ReadLazyObjectFromFile().  Only what it takes to make a
+   function of it is read; the body is stepped over, and loaded by
+   _PyCode_Load() when it is first needed. */
+static PyObject *
+r_lazy_code(RFILE *p)
+{
+	lazysource *ls = (lazysource *)PyCObject_AsVoidPtr(p->source);
+	int offset = p->ptr - ls->data;
+	int argcount = r_short(p);
+	int nlocals = r_short(p);
+	int stacksize = r_short(p);
+	int flags = r_short(p);
+	PyObject *consts = NULL;
+	PyObject *freevars = NULL;
+	PyObject *cellvars = NULL;
+	PyObject *filename = NULL;
+	PyObject *name = NULL;
+	PyObject *empty = NULL;
+	PyObject *nothing = NULL;
+	PyCodeObject *co = NULL;
+	int firstlineno;
+
+	if (r_skip(p) == 0 &&
+	    (consts = r_lazy_consts(p)) != NULL &&
+	    r_skip(p) == 0 && r_skip(p) == 0 &&
+	    (freevars = r_object(p)) != NULL &&
+	    (cellvars = r_object(p)) != NULL &&
+	    (filename = r_object(p)) != NULL &&
+	    (name = r_object(p)) != NULL) {
+		firstlineno = r_short(p);
+		if (r_skip(p) == 0 &&
+		    (empty = PyTuple_New(0)) != NULL &&
+		    (nothing = PyString_FromStringAndSize(NULL, 0)) != NULL) {
+			co = PyCode_New(argcount, nlocals, stacksize, flags,
+					nothing, consts, empty, empty,
+					freevars, cellvars, filename, name,
+					firstlineno, nothing);
+		}
+	}
+	if (co != NULL) {
+		Py_INCREF(p->source);
+		co->co_lazysource = p->source;
+		co->co_lazyoffset = offset;
+	}
+	else if (!PyErr_Occurred())
+		PyErr_SetString(PyExc_ValueError, "bad marshal data");
+	Py_XDECREF(consts);
+	Py_XDECREF(freevars);
+	Py_XDECREF(cellvars);
+	Py_XDECREF(filename);
+	Py_XDECREF(name);
+	Py_XDECREF(empty);
+	Py_XDECREF(nothing);
+	return (PyObject *)co;
+}
+
 static PyObject *
 r_object(RFILE *p)
 {
@@ -573,56 +861,10 @@ r_object(RFILE *p)
 				"restricted execution mode");
 			return NULL;
 		}
-		else {
-			int argcount = r_short(p);
-			int nlocals = r_short(p);
-			int stacksize = r_short(p);
-			int flags = r_short(p);
-			PyObject *code = NULL;
-			PyObject *consts = NULL;
-			PyObject *names = NULL;
-			PyObject *varnames = NULL;
-			PyObject *freevars = NULL;
-			PyObject *cellvars = NULL;
-			PyObject *filename = NULL;
-			PyObject *name = NULL;
-			int firstlineno = 0;
-			PyObject *lnotab = NULL;
-
-			code = r_object(p);
-			if (code) consts = r_object(p);
-			if (consts) names = r_object(p);
-			if (names) varnames = r_object(p);
-			if (varnames) freevars = r_object(p);
-			if (freevars) cellvars = r_object(p);
-			if (cellvars) filename = r_object(p);
-			if (filename) name = r_object(p);
-			if (name) {
-				firstlineno = r_short(p);
-				lnotab = r_object(p);
-			}
-
-			if (!PyErr_Occurred()) {
-				v = (PyObject *) PyCode_New(
-					argcount, nlocals, stacksize, flags,
-					code, consts, names, varnames,
-					freevars, cellvars, filename, name,
-					firstlineno, lnotab);
-			}
-			else
-				v = NULL;
-			Py_XDECREF(code);
-			Py_XDECREF(consts);
-			Py_XDECREF(names);
-			Py_XDECREF(varnames);
-			Py_XDECREF(freevars);
-			Py_XDECREF(cellvars);
-			Py_XDECREF(filename);
-			Py_XDECREF(name);
-			Py_XDECREF(lnotab);
-
-		}
-		return v;
+		else if (p->source != NULL && p->depth > 0)
+			return r_lazy_code(p);
+		else
+			return r_code(p);
 
 	default:
 		/* Bogus data got written, which isn't ideal.
@@ -638,6 +880,7 @@ PyMarshal_ReadShortFromFile(FILE *fp)
 {
 	RFILE rf;
 	rf.fp = fp;
+	rf.source = NULL;
 	return r_short(&rf);
 }
 
@@ -646,6 +889,7 @@ PyMarshal_ReadLongFromFile(FILE *fp)
 {
 	RFILE rf;
 	rf.fp = fp;
+	rf.source = NULL;
 	return r_long(&rf);
 }
 
@@ -725,6 +969,8 @@ PyMarshal_ReadObjectFromFile(FILE *fp)
 		return NULL;
 	}
 	rf.fp = fp;
+	rf.source = NULL;
+	rf.depth = 0;
 	return r_object(&rf);
 }
 
@@ -740,9 +986,129 @@ PyMarshal_ReadObjectFromString(char *str, int len)
 	rf.str = NULL;
 	rf.ptr = str;
 	rf.end = str + len;
+	rf.source = NULL;
+	rf.depth = 0;
 	return r_object(&rf);
 }
 
+/* Like PyMarshal_ReadLastObjectFromFile(), but the code objects nested
+ * in the object read are only built when they are first run (see
+ * compile.h).  Until the last of them is, the rest of the file stays in
+ * memory: mapped, where there is mmap(), else read into the heap, which
+ * still costs less than the objects it would have become.  A mapped
+ * file must not be rewritten in place meanwhile, only replaced, as
+ * import.c does with the .pyc files it writes.
+ */
+PyObject *
+PyMarshal_ReadLazyObjectFromFile(FILE *fp)
+{
+	RFILE rf;
+	lazysource *ls;
+	PyObject *source, *v;
+	long start, size;
+
+	if (PyErr_Occurred()) {
+		fprintf(stderr, "XXX rd_object called with exception set\n");
+		return NULL;
+	}
+	start = ftell(fp);
+	if (start < 0 || fseek(fp, 0L, SEEK_END) != 0 ||
+	    (size = ftell(fp) - start) <= 0 || size > INT_MAX ||
+	    fseek(fp, start, SEEK_SET) != 0) {
+		/* Not a plain file */
+		if (start >= 0)
+			fseek(fp, start, SEEK_SET);
+		return PyMarshal_ReadLastObjectFromFile(fp);
+	}
+	ls = PyMem_NEW(lazysource, 1);
+	if (ls == NULL)
+		return PyErr_NoMemory();
+	ls->map = NULL;
+	ls->maplen = 0;
+#ifdef HAVE_MMAP
+	ls->maplen = start + size;
+	ls->map = mmap(NULL, ls->maplen, PROT_READ, MAP_PRIVATE,
+		       fileno(fp), 0);
+	if (ls->map == MAP_FAILED)
+		ls->map = NULL;
+	else
+		ls->data = (char *)ls->map + start;
+#endif
+	if (ls->map == NULL) {
+		ls->data = (char *)PyMem_MALLOC(size);
+		if (ls->data == NULL) {
+			PyMem_DEL(ls);
+			return PyErr_NoMemory();
+		}
+		size = fread(ls->data, 1, size, fp);
+	}
+	ls->size = size;
+	source = PyCObject_FromVoidPtr(ls, lazysource_free);
+	if (source == NULL) {
+		lazysource_free(ls);
+		return NULL;
+	}
+	rf.fp = NULL;
+	rf.str = NULL;
+	rf.ptr = ls->data;
+	rf.end = ls->data + ls->size;
+	rf.source = source;
+	rf.depth = 0;
+	v = r_object(&rf);
+	Py_DECREF(source);
+	return v;
+}
+
+/* Load the body of a code object that r_lazy_code() read.  Returns 0,
+   or -1 with an exception set, in which case the code is left as it
+   was.  An exception already set is kept. */
+int
+_PyCode_Load(PyCodeObject *co)
+{
+	RFILE rf;
+	lazysource *ls;
+	PyCodeObject *full;
+	PyObject *type, *value, *tb, *t;
+
+	if (co->co_lazysource == NULL)
+		return 0;
+	ls = (lazysource *)PyCObject_AsVoidPtr(co->co_lazysource);
+	PyErr_Fetch(&type, &value, &tb);
+	rf.fp = NULL;
+	rf.str = NULL;
+	rf.ptr = ls->data + co->co_lazyoffset;
+	rf.end = ls->data + ls->size;
+	rf.source = co->co_lazysource;
+	rf.depth = 0;
+	full = (PyCodeObject *)r_code(&rf);
+	if (full == NULL) {
+		Py_XDECREF(type);
+		Py_XDECREF(value);
+		Py_XDECREF(tb);
+		return -1;
+	}
+	PyErr_Restore(type, value, tb);
+	if (co->co_lazysource == NULL) {
+		/* Loaded meanwhile, by code a collection ran */
+		Py_DECREF(full);
+		return 0;
+	}
+	/* Trade the body for the placeholders, which go with full */
+#define TAKE(member) t = co->member; co->member = full->member; \
+	full->member = t
+	TAKE(co_code);
+	TAKE(co_consts);
+	TAKE(co_names);
+	TAKE(co_varnames);
+	TAKE(co_lnotab);
+#undef TAKE
+	Py_DECREF(full);
+	t = co->co_lazysource;
+	co->co_lazysource = NULL;
+	Py_DECREF(t);
+	return 0;
+}
+
 DL_EXPORT(PyObject *)
 PyMarshal_WriteObjectToString(PyObject *x) /* wrs_object() */
 {
@@ -817,6 +1183,8 @@ marshal_load(PyObject *self, PyObject *args)
 	rf.fp = PyFile_AsFile(f);
 	rf.str = NULL;
 	rf.ptr = rf.end = NULL;
+	rf.source = NULL;
+	rf.depth = 0;
 	PyErr_Clear();
 	v = r_object(&rf);
 	if (PyErr_Occurred()) {
@@ -848,6 +1216,8 @@ marshal_loads(PyObject *self, PyObject *args)
 	rf.str = args;
 	rf.ptr = s;
 	rf.end = s + n;
+	rf.source = NULL;
+	rf.depth = 0;
 	PyErr_Clear();
 	v = r_object(&rf);
 	if (PyErr_Occurred()) {
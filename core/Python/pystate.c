@@ -148,6 +148,19 @@ PyThreadState_New(PyInterpreterState *interp)
 		tstate->use_tracing = 0;
 		tstate->tick_counter = 0;
 
+		tstate->gil_wakeup = NULL;
+		tstate->gil_priority = 0;
+#ifdef WITH_THREAD
+		tstate->thread_id = PyThread_get_thread_ident();
+#else
+		tstate->thread_id = 0;
+#endif
+		tstate->gil_wait = 0.0;
+		tstate->gil_hold = 0.0;
+		tstate->gil_acquisitions = 0;
+		tstate->gil_contended = 0;
+		tstate->gil_handoffs = 0;
+
 		tstate->dict = NULL;
 
 		tstate->curexc_type = NULL;
@@ -220,6 +233,10 @@ tstate_delete_common(PyThreadState *tstate)
 	}
 	*p = tstate->next;
 	HEAD_UNLOCK();
+#ifdef WITH_THREAD
+	if (tstate->gil_wakeup != NULL)
+		PyThread_free_lock((PyThread_type_lock)tstate->gil_wakeup);
+#endif
 	PyMem_DEL(tstate);
 }
 
@@ -286,6 +303,45 @@ PyThreadState_GetDict(void)
 }
 
 
+/* Return a new array, to be freed with PyMem_DEL(), of the interpreter
+   lock statistics of interp's threads, and their number in *count.  The
+   copies are taken under the head lock, so that no thread state can be
+   deleted meanwhile. */
+
+PyGILStats *
+_PyThreadState_GetGILStats(PyInterpreterState *interp, int *count)
+{
+	PyThreadState *p;
+	PyGILStats *stats;
+	int n = 0;
+
+	HEAD_LOCK();
+	for (p = interp->tstate_head; p != NULL; p = p->next)
+		n++;
+	stats = PyMem_NEW(PyGILStats, n > 0 ? n : 1);
+	if (stats != NULL) {
+		n = 0;
+		for (p = interp->tstate_head; p != NULL; p = p->next) {
+			stats[n].thread_id = p->thread_id;
+			stats[n].gil_wait = p->gil_wait;
+			stats[n].gil_hold = p->gil_hold;
+			stats[n].gil_acquisitions = p->gil_acquisitions;
+			stats[n].gil_contended = p->gil_contended;
+			stats[n].gil_handoffs = p->gil_handoffs;
+			stats[n].gil_priority = p->gil_priority;
+			n++;
+		}
+	}
+	HEAD_UNLOCK();
+	if (stats == NULL) {
+		PyErr_NoMemory();
+		return NULL;
+	}
+	*count = n;
+	return stats;
+}
+
+
 /* Routines for advanced debuggers, requested by David Beazley.
    Don't use unless you know what you are doing! */
 
@@ -54,6 +54,7 @@ int _Py_AskYesNo(char *prompt);
 
 extern void _PyUnicode_Init(void);
 extern void _PyUnicode_Fini(void);
+extern void _PyType_Fini(void);
 extern void _PyCodecRegistry_Init(void);
 extern void _PyCodecRegistry_Fini(void);
 
@@ -272,9 +273,12 @@ Py_Finalize(void)
 	PyFrame_Fini();
 	PyCFunction_Fini();
 	PyTuple_Fini();
+	PyList_Fini();
+	PyDict_Fini();
 	PyString_Fini();
 	PyInt_Fini();
 	PyFloat_Fini();
+	_PyType_Fini();
 
 #ifdef Py_USING_UNICODE
 	/* Cleanup Unicode implementation */
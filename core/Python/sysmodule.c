@@ -591,12 +591,377 @@ extern PyObject *_Py_GetObjects(PyObject *, PyObject *);
 extern PyObject *_Py_GetDXProfile(PyObject *,  PyObject *);
 #endif
 
+/* Defined in ceval.c, next to the caches it reports on */
+extern PyObject *_PyEval_GetCacheStats(PyObject *);
+
+const static char getcachestats_doc[] =
+#ifdef SYMBIAN
+"";
+#else
+"getcachestats() -> dict\n\
+\n\
+Return the hit and miss counts of the interpreter's lookup caches.";
+#endif
+
+#ifdef WITH_PYMALLOC
+/* Defined in obmalloc.c, next to the arenas it reports on */
+extern PyObject *_PyObject_GetAllocStats(PyObject *);
+
+const static char getallocstats_doc[] =
+#ifdef SYMBIAN
+"";
+#else
+"getallocstats() -> dict\n\
+\n\
+Return statistics of the small object allocator: live blocks and pools\n\
+per size class, arenas in use, allocated and freed, and the fraction of\n\
+arena memory not holding live blocks.";
+#endif
+#endif
+
+#ifdef INTERN_STRINGS
+/* Defined in stringobject.c, next to the interned table */
+extern PyObject *_PyString_GetInternStats(PyObject *);
+
+const static char getinternstats_doc[] =
+#ifdef SYMBIAN
+"";
+#else
+"getinternstats() -> dict\n\
+\n\
+Return the number and total length of interned strings, and how\n\
+interning requests were answered: by the string itself (cached), by\n\
+the interned table (found), or by adding a new entry (added).";
+#endif
+#endif
+
+/* The free lists of the built-in types, see PyFreeListStats */
+static const struct {
+	char *name;
+	PyFreeListStats *(*stats)(long *);
+	long (*clear)(void);
+} freelists[] = {
+	{"dict",	_PyDict_FreeListStats,	PyDict_ClearFreeList},
+	{"float",	_PyFloat_FreeListStats,	PyFloat_ClearFreeList},
+	{"int",		_PyInt_FreeListStats,	PyInt_ClearFreeList},
+	{"list",	_PyList_FreeListStats,	PyList_ClearFreeList},
+	{"tuple",	_PyTuple_FreeListStats,	PyTuple_ClearFreeList},
+};
+#define NFREELISTS ((int)(sizeof(freelists) / sizeof(freelists[0])))
+
+static int
+add_stat(PyObject *d, char *name, PyObject *v)
+{
+	int status;
+
+	if (v == NULL)
+		return -1;
+	status = PyDict_SetItemString(d, name, v);
+	Py_DECREF(v);
+	return status;
+}
+
+static PyObject *
+sys_getfreeliststats(PyObject *self)
+{
+	PyFreeListStats stats[NFREELISTS];
+	long bytes[NFREELISTS];
+	double total;
+	PyObject *result, *d;
+	int i;
+
+	/* Building the result allocates from the free lists, so take a
+	   snapshot of all of them first. */
+	for (i = 0; i < NFREELISTS; i++)
+		stats[i] = *freelists[i].stats(&bytes[i]);
+	result = PyDict_New();
+	if (result == NULL)
+		return NULL;
+	for (i = 0; i < NFREELISTS; i++) {
+		total = (double)stats[i].hits + (double)stats[i].misses;
+		d = PyDict_New();
+		if (add_stat(result, freelists[i].name, d) < 0 ||
+		    add_stat(d, "hits",
+				PyLong_FromUnsignedLong(stats[i].hits)) < 0 ||
+		    add_stat(d, "misses",
+				PyLong_FromUnsignedLong(stats[i].misses)) < 0 ||
+		    add_stat(d, "hit_rate", PyFloat_FromDouble(
+				total ? stats[i].hits / total : 0.0)) < 0 ||
+		    add_stat(d, "count",
+				PyInt_FromLong(stats[i].count)) < 0 ||
+		    add_stat(d, "limit",
+				PyInt_FromLong(stats[i].limit)) < 0 ||
+		    add_stat(d, "bytes",
+				PyInt_FromLong(bytes[i])) < 0) {
+			Py_DECREF(result);
+			return NULL;
+		}
+	}
+	return result;
+}
+
+const static char getfreeliststats_doc[] =
+#ifdef SYMBIAN
+"";
+#else
+"getfreeliststats() -> dict\n\
+\n\
+Return, for each built-in type that keeps a free list of deallocated\n\
+objects, how many allocations it served (hits) or left to the allocator\n\
+(misses), the objects it holds and their size in bytes, and its limit.";
+#endif
+
+static PyObject *
+sys_setfreelistlimit(PyObject *self, PyObject *args)
+{
+	char *name;
+	int limit, i;
+	PyFreeListStats *stats;
+	long bytes;
+
+	if (!PyArg_ParseTuple(args, "si:setfreelistlimit", &name, &limit))
+		return NULL;
+	for (i = 0; i < NFREELISTS; i++) {
+		if (strcmp(name, freelists[i].name) == 0) {
+			stats = freelists[i].stats(&bytes);
+			stats->limit = limit < 0 ? -1 : limit;
+			Py_INCREF(Py_None);
+			return Py_None;
+		}
+	}
+	PyErr_Format(PyExc_ValueError, "no free list for '%.100s'", name);
+	return NULL;
+}
+
+const static char setfreelistlimit_doc[] =
+#ifdef SYMBIAN
+"";
+#else
+"setfreelistlimit(type_name, n)\n\
+\n\
+Keep at most n deallocated objects on the free list of the named type\n\
+('dict', 'float', 'int', 'list' or 'tuple'); a negative n means no\n\
+limit.  The tuple limit applies to each tuple size.  Int and float\n\
+objects share memory blocks, so those free lists only shrink as far\n\
+as whole blocks become free.";
+#endif
+
+static PyObject *
+sys_setswitchinterval(PyObject *self, PyObject *args)
+{
+	double d;
+
+	if (!PyArg_ParseTuple(args, "d:setswitchinterval", &d))
+		return NULL;
+	if (d <= 0.0 || d * 1e6 > (double)LONG_MAX) {
+		PyErr_SetString(PyExc_ValueError,
+				"switch interval out of range");
+		return NULL;
+	}
+	_PyEval_SetSwitchInterval((unsigned long)(d * 1e6));
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+const static char setswitchinterval_doc[] =
+#ifdef SYMBIAN
+"";
+#else
+"setswitchinterval(n)\n\
+\n\
+Set how long, in seconds, a thread may keep the interpreter while\n\
+another thread waits for it.  The timer's resolution is the system tick.";
+#endif
+
+static PyObject *
+sys_getswitchinterval(PyObject *self)
+{
+	return PyFloat_FromDouble(_PyEval_GetSwitchInterval() / 1e6);
+}
+
+const static char getswitchinterval_doc[] =
+#ifdef SYMBIAN
+"";
+#else
+"getswitchinterval() -> seconds\n\
+\n\
+Return the interval set with setswitchinterval().";
+#endif
+
+static PyObject *
+sys_setpeephole(PyObject *self, PyObject *args)
+{
+	int on;
+
+	if (!PyArg_ParseTuple(args, "i:setpeephole", &on))
+		return NULL;
+	Py_NoPeepholeFlag = !on;
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+const static char setpeephole_doc[] =
+#ifdef SYMBIAN
+"";
+#else
+"setpeephole(flag)\n\
+\n\
+Turn the compiler's peephole optimizer on (flag true) or off.  Code\n\
+compiled already is not affected.";
+#endif
+
+static PyObject *
+sys_getpeephole(PyObject *self)
+{
+	return PyInt_FromLong(!Py_NoPeepholeFlag);
+}
+
+const static char getpeephole_doc[] =
+#ifdef SYMBIAN
+"";
+#else
+"getpeephole() -> flag\n\
+\n\
+Return whether the compiler's peephole optimizer is on.";
+#endif
+
+static PyObject *
+sys_setgilpriority(PyObject *self, PyObject *args)
+{
+	PyThreadState *tstate = PyThreadState_GET();
+
+	if (!PyArg_ParseTuple(args, "i:setgilpriority", &tstate->gil_priority))
+		return NULL;
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+const static char setgilpriority_doc[] =
+#ifdef SYMBIAN
+"";
+#else
+"setgilpriority(n)\n\
+\n\
+Set the current thread's priority for the interpreter lock (default 0).\n\
+Waiting threads get the lock in order of priority, and one that\n\
+outranks the running thread takes over without waiting out the switch\n\
+interval.";
+#endif
+
+static PyObject *
+sys_getgilpriority(PyObject *self)
+{
+	return PyInt_FromLong(PyThreadState_GET()->gil_priority);
+}
+
+const static char getgilpriority_doc[] =
+#ifdef SYMBIAN
+"";
+#else
+"getgilpriority() -> int\n\
+\n\
+Return the current thread's interpreter lock priority.";
+#endif
+
+static PyObject *
+sys_getgilstats(PyObject *self)
+{
+	PyThreadState *current = PyThreadState_GET();
+	PyGILStats *stats, *s;
+	PyObject *result, *key, *d;
+	double hold;
+	int i, n;
+
+	/* Building the dicts can run a collection, and a __del__ can let
+	   other threads delete their states, so work on a copy */
+	stats = _PyThreadState_GetGILStats(current->interp, &n);
+	if (stats == NULL)
+		return NULL;
+	result = PyDict_New();
+	if (result == NULL)
+		goto error;
+	for (i = 0; i < n; i++) {
+		s = &stats[i];
+		hold = s->gil_hold;
+		if (s->thread_id == current->thread_id)
+			hold += _PyEval_GetGILHeld() / 1e6;
+		key = PyInt_FromLong(s->thread_id);
+		d = PyDict_New();
+		if (key == NULL || d == NULL ||
+		    PyDict_SetItem(result, key, d) < 0) {
+			Py_XDECREF(key);
+			Py_XDECREF(d);
+			goto error;
+		}
+		Py_DECREF(key);
+		Py_DECREF(d);
+		if (add_stat(d, "wait", PyFloat_FromDouble(s->gil_wait)) < 0 ||
+		    add_stat(d, "hold", PyFloat_FromDouble(hold)) < 0 ||
+		    add_stat(d, "acquisitions",
+				PyInt_FromLong(s->gil_acquisitions)) < 0 ||
+		    add_stat(d, "contended",
+				PyInt_FromLong(s->gil_contended)) < 0 ||
+		    add_stat(d, "handoffs",
+				PyInt_FromLong(s->gil_handoffs)) < 0 ||
+		    add_stat(d, "priority",
+				PyInt_FromLong(s->gil_priority)) < 0)
+			goto error;
+	}
+	PyMem_DEL(stats);
+	return result;
+
+  error:
+	Py_XDECREF(result);
+	PyMem_DEL(stats);
+	return NULL;
+}
+
+const static char getgilstats_doc[] =
+#ifdef SYMBIAN
+"";
+#else
+"getgilstats() -> dict\n\
+\n\
+Return, for each thread by its thread.get_ident(), the time in seconds\n\
+it has spent waiting for and holding the interpreter lock, how often\n\
+it took the lock and how often it had to wait for it, how often it\n\
+was made to hand the lock over at the end of a switch interval or to\n\
+a thread of higher priority, and its priority.";
+#endif
+
+static PyObject *
+sys_trim_caches(PyObject *self)
+{
+	long freed = 0;
+	int i;
+
+	for (i = 0; i < NFREELISTS; i++)
+		freed += freelists[i].clear();
+	return PyInt_FromLong(freed);
+}
+
+const static char trim_caches_doc[] =
+#ifdef SYMBIAN
+"";
+#else
+"trim_caches() -> int\n\
+\n\
+Give the memory held by the free lists of the built-in types back to\n\
+the allocator, and return the number of bytes released.";
+#endif
+
 const static PyMethodDef sys_methods[] = {
 	/* Might as well keep this in alphabetic order */
 	{"displayhook",	sys_displayhook, METH_O, displayhook_doc},
 	{"exc_info",	(PyCFunction)sys_exc_info, METH_NOARGS, exc_info_doc},
 	{"excepthook",	sys_excepthook, METH_VARARGS, excepthook_doc},
 	{"exit",	sys_exit, METH_OLDARGS, exit_doc},
+#ifdef WITH_PYMALLOC
+	{"getallocstats", (PyCFunction)_PyObject_GetAllocStats, METH_NOARGS,
+	 getallocstats_doc},
+#endif
+	{"getcachestats", (PyCFunction)_PyEval_GetCacheStats, METH_NOARGS,
+	 getcachestats_doc},
 #ifdef Py_USING_UNICODE
 	{"getdefaultencoding", (PyCFunction)sys_getdefaultencoding, METH_NOARGS,
 	 getdefaultencoding_doc},
@@ -610,14 +975,28 @@ const static PyMethodDef sys_methods[] = {
 #endif
 #ifdef DYNAMIC_EXECUTION_PROFILE
 	{"getdxp",	_Py_GetDXProfile, METH_VARARGS},
+#endif
+	{"getfreeliststats", (PyCFunction)sys_getfreeliststats, METH_NOARGS,
+	 getfreeliststats_doc},
+	{"getgilpriority", (PyCFunction)sys_getgilpriority, METH_NOARGS,
+	 getgilpriority_doc},
+	{"getgilstats",	(PyCFunction)sys_getgilstats, METH_NOARGS,
+	 getgilstats_doc},
+#ifdef INTERN_STRINGS
+	{"getinternstats", (PyCFunction)_PyString_GetInternStats, METH_NOARGS,
+	 getinternstats_doc},
 #endif
 #ifdef Py_TRACE_REFS
 	{"getobjects",	_Py_GetObjects, METH_VARARGS},
 	{"gettotalrefcount", (PyCFunction)sys_gettotalrefcount, METH_NOARGS},
 #endif
+	{"getpeephole",	(PyCFunction)sys_getpeephole, METH_NOARGS,
+	 getpeephole_doc},
 	{"getrefcount",	(PyCFunction)sys_getrefcount, METH_O, getrefcount_doc},
 	{"getrecursionlimit", (PyCFunction)sys_getrecursionlimit, METH_NOARGS,
 	 getrecursionlimit_doc},
+	{"getswitchinterval", (PyCFunction)sys_getswitchinterval, METH_NOARGS,
+	 getswitchinterval_doc},
 	{"_getframe", sys_getframe, METH_VARARGS, getframe_doc},
 #ifdef USE_MALLOPT
 	{"mdebug",	sys_mdebug, METH_VARARGS},
@@ -632,10 +1011,19 @@ const static PyMethodDef sys_methods[] = {
 	{"setdlopenflags", sys_setdlopenflags, METH_VARARGS,
 	 setdlopenflags_doc},
 #endif
+	{"setfreelistlimit", sys_setfreelistlimit, METH_VARARGS,
+	 setfreelistlimit_doc},
+	{"setgilpriority", sys_setgilpriority, METH_VARARGS,
+	 setgilpriority_doc},
+	{"setpeephole",	sys_setpeephole, METH_VARARGS, setpeephole_doc},
 	{"setprofile",	sys_setprofile, METH_O, setprofile_doc},
 	{"setrecursionlimit", sys_setrecursionlimit, METH_VARARGS,
 	 setrecursionlimit_doc},
+	{"setswitchinterval", sys_setswitchinterval, METH_VARARGS,
+	 setswitchinterval_doc},
 	{"settrace",	sys_settrace, METH_O, settrace_doc},
+	{"trim_caches",	(PyCFunction)sys_trim_caches, METH_NOARGS,
+	 trim_caches_doc},
 	{NULL,		NULL}		/* sentinel */
 };
 
@@ -776,14 +1164,27 @@ displayhook() -- print an object to the screen, and save it in __builtin__._\n\
 excepthook() -- print an exception and its traceback to sys.stderr\n\
 exc_info() -- return thread-safe information about the current exception\n\
 exit() -- exit the interpreter by raising SystemExit\n\
+getallocstats() -- return statistics of the small object allocator\n\
+getcachestats() -- return the hit and miss counts of the lookup caches\n\
 getdlopenflags() -- returns flags to be used for dlopen() calls\n\
+getfreeliststats() -- return statistics of the built-in types' free lists\n\
+getgilpriority() -- return the current thread's interpreter lock priority\n\
+getgilstats() -- return each thread's interpreter lock wait and hold times\n\
+getinternstats() -- return statistics of the interned strings\n\
+getpeephole() -- tell whether the peephole optimizer is on\n\
 getrefcount() -- return the reference count for an object (plus one :-)\n\
 getrecursionlimit() -- return the max recursion depth for the interpreter\n\
+getswitchinterval() -- return how long a thread may keep the interpreter\n\
 setcheckinterval() -- control how often the interpreter checks for events\n\
 setdlopenflags() -- set the flags to be used for dlopen() calls\n\
+setfreelistlimit() -- limit the free list of a built-in type\n\
+setgilpriority() -- set the current thread's interpreter lock priority\n\
+setpeephole() -- turn the compiler's peephole optimizer on or off\n\
 setprofile() -- set the global profiling function\n\
 setrecursionlimit() -- set the max recursion depth for the interpreter\n\
+setswitchinterval() -- set how long a thread may keep the interpreter\n\
 settrace() -- set the global debug tracing function\n\
+trim_caches() -- give the memory of the free lists back to the allocator\n\
 "
 #endif /* MS_WIN16 */
 /* end of sys_doc */ ;
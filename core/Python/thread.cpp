@@ -148,3 +148,16 @@ extern "C" void PyThread_init_thread(void)
 #include "thread_foobar.h"
 #endif
 */
+
+#ifndef PYTHREAD_HAVE_MICROSECONDS
+/* Fallback for the thread_*.h files without a clock of their own.
+   clock() counts processor time, which is close enough while the
+   lock holder is busy running byte code. */
+#include <time.h>
+
+extern "C" unsigned long
+PyThread_get_microseconds(void)
+{
+	return (unsigned long)((double)clock() * 1000000.0 / CLOCKS_PER_SEC);
+}
+#endif
@@ -11,6 +11,7 @@
 #undef destructor
 #endif
 #include <signal.h>
+#include <sys/time.h>
 
 
 /* try to determine what version of the Pthread Standard is installed.
@@ -148,12 +149,60 @@ PyThread__init_thread(void)
  * Thread support.
  */
 
+#ifdef SYMBIAN
+/* The Symbian port keeps the interpreter's globals in thread-local
+   storage (see Symbian/python_globals.cpp), so a new thread has to be
+   handed those of the thread that started it, just as thread_symbian.h
+   does.  Together with the per-thread exit functions below this lets
+   the port's core run threaded on a POSIX host. */
+
+#define NTHREADEXITFUNCS 32
+
+struct launchpad_args {
+	void (*func)(void *);
+	void *arg;
+	SPy_Python_globals *globals;
+};
+
+struct exitfuncs {
+	void (*tab[NTHREADEXITFUNCS])(void);
+	int n;
+};
+
+static void
+launchpad(void *p)
+{
+	struct launchpad_args args = *(struct launchpad_args *)p;
+	struct exitfuncs xf;
+
+	free(p);
+	if (SPy_tls_initialize(args.globals)) {
+		fprintf(stderr, "Python thread: out of memory\n");
+		return;
+	}
+	xf.n = 0;
+	PYTHON_TLS->l = &xf;
+	args.func(args.arg);
+	SPy_tls_finalize(0);
+}
+
+/* Symbian waits for a thread through the active scheduler; there is no
+   such thing here and the threads are detached, so this always fails. */
+extern "C" int
+PyThread_ao_waittid(long tid)
+{
+	return -1;
+}
+#endif /* SYMBIAN */
 
 long
 PyThread_start_new_thread(void (*func)(void *), void *arg)
 {
 	pthread_t th;
 	int success;
+#ifdef SYMBIAN
+	struct launchpad_args *lp;
+#endif
  	sigset_t oldmask, newmask;
 #if defined(THREAD_STACK_SIZE) || defined(PTHREAD_SYSTEM_SCHED_SUPPORTED)
 	pthread_attr_t attrs;
@@ -176,6 +225,17 @@ PyThread_start_new_thread(void (*func)(void *), void *arg)
 	 * thread.  This causes the new thread to start with all signals
 	 * blocked.
 	 */
+#ifdef SYMBIAN
+	lp = (struct launchpad_args *)malloc(sizeof(struct launchpad_args));
+	if (lp == NULL)
+		return -1;
+	lp->func = func;
+	lp->arg = arg;
+	lp->globals = PYTHON_GLOBALS;
+	func = launchpad;
+	arg = lp;
+#endif
+
 	sigfillset(&newmask);
 	SET_THREAD_SIGMASK(SIG_BLOCK, &newmask, &oldmask);
 
@@ -216,6 +276,12 @@ PyThread_start_new_thread(void (*func)(void *), void *arg)
 		pthread_detach(th);
 #endif
 	}
+#ifdef SYMBIAN
+	else {
+		free(lp);
+		return -1;
+	}
+#endif
 #if SIZEOF_PTHREAD_T <= SIZEOF_LONG
 	return (long) th;
 #else
@@ -245,6 +311,18 @@ PyThread_get_thread_ident(void)
 #endif
 }
 
+#define PYTHREAD_HAVE_MICROSECONDS
+
+unsigned long
+PyThread_get_microseconds(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (unsigned long)tv.tv_sec * 1000000UL +
+		(unsigned long)tv.tv_usec;
+}
+
 static void 
 do_PyThread_exit_thread(int no_cleanup)
 {
@@ -255,6 +333,13 @@ do_PyThread_exit_thread(int no_cleanup)
 		else
 			exit(0);
 	}
+#ifdef SYMBIAN
+	{
+		struct exitfuncs *pxf = (struct exitfuncs *)(PYTHON_TLS->l);
+		while (pxf != NULL && pxf->n > 0)
+			(pxf->tab[--pxf->n])();
+	}
+#endif
 }
 
 void 
@@ -269,6 +354,23 @@ PyThread__exit_thread(void)
 	do_PyThread_exit_thread(1);
 }
 
+#ifdef SYMBIAN
+int
+PyThread_AtExit(void (*func)(void))
+{
+	struct exitfuncs *pxf;
+
+	if ((PYTHON_GLOBALS->main_thread == 0) ||
+	    (PYTHON_GLOBALS->main_thread == PyThread_get_thread_ident()))
+		return Py_AtExit(func);
+	pxf = (struct exitfuncs *)(PYTHON_TLS->l);
+	if (pxf->n >= NTHREADEXITFUNCS)
+		return -1;
+	pxf->tab[pxf->n++] = func;
+	return 0;
+}
+#endif /* SYMBIAN */
+
 #ifndef NO_EXIT_PROG
 static void 
 do_PyThread_exit_prog(int status, int no_cleanup)
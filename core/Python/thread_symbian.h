@@ -22,6 +22,7 @@
 
 #include <e32std.h>
 #include <e32base.h>
+#include <hal.h>      // PyThread_get_microseconds()
 
 #define KStackSize 0x10000
 #define KHeapSize 300000
@@ -222,6 +223,22 @@ PyThread_get_thread_ident(void)
   return (TUint)(RThread().Id());
 }
 
+#define PYTHREAD_HAVE_MICROSECONDS
+
+/* User::TickCount() is available on every release we support; its
+   period (1/64 s on older devices) bounds how finely the interpreter
+   lock's switch interval can be honoured. */
+unsigned long
+PyThread_get_microseconds(void)
+{
+  if (PYTHON_GLOBALS->thread_tick_period == 0)
+    if (HAL::Get(HALData::ESystemTickPeriod,
+                 PYTHON_GLOBALS->thread_tick_period) != KErrNone)
+      PYTHON_GLOBALS->thread_tick_period = 1000000/64;
+  return (unsigned long)User::TickCount() *
+    (unsigned long)PYTHON_GLOBALS->thread_tick_period;
+}
+
 static
 void do_PyThread_exit_thread(int no_cleanup)
 {
@@ -252,7 +252,7 @@
 #undef WANT_WCTYPE_FUNCTIONS
 
 /* Define if you want to compile in cycle garbage collection */
-#undef WITH_CYCLE_GC
+#define WITH_CYCLE_GC 1
 
 /* Define if you want to emulate SGI (IRIX 4) dynamic linking.
    This is rumoured to work on VAX (Ultrix), Sun3 (SunOS 3.4),
@@ -271,7 +271,7 @@
 #undef WITH_DYLD
 
 /* Define if you want to compile in Python-specific mallocs */
-#undef WITH_PYMALLOC
+#define WITH_PYMALLOC
 
 /* Define if you want to produce an OpenStep/Rhapsody framework
    (shared library plus accessory files). */
@@ -288,6 +288,17 @@
 //#undef WITH_THREAD
 #define WITH_THREAD
 
+/* Define if the compiler supports taking the address of a label and
+   jumping to it ("computed goto").  gcc does, CodeWarrior does not. */
+#if defined(__GNUC__) && !defined(__MWERKS__)
+#define HAVE_COMPUTED_GOTOS 1
+#endif
+
+/* Define if you want the interpreter main loop to use threaded-code
+   dispatch (see Python/ceval.c).  Ignored when the compiler lacks
+   HAVE_COMPUTED_GOTOS. */
+#define USE_COMPUTED_GOTOS 1
+
 /* The number of bytes in a char.  */
 #define SIZEOF_CHAR 1
 
@@ -439,6 +450,9 @@
 /* Define if you have the mktime function.  */
 #define HAVE_MKTIME
 
+/* Define if you have the mmap function.  */
+#undef HAVE_MMAP
+
 /* Define if you have the mremap function.  */
 #undef HAVE_MREMAP
 
@@ -21,12 +21,55 @@
 * ====================================================================
 */
 
+#ifdef __SYMBIAN32__
 #include <e32std.h>
 #include "python_globals.h"
 
+#define SPY_TLS_GET()     (Dll::Tls())
+#define SPY_TLS_SET(p)    (Dll::SetTls(p))
+#define SPY_INIT_DATA()   (Dll::InitialiseData())
+
+#else  /* !__SYMBIAN32__ */
+/* Portable build of this shim for hosted (Linux) builds of the core,
+   so that the cached and uncached globals modes can be compared off
+   the phone.  Dll::Tls() becomes a pthread key. */
+#include <pthread.h>
+#include <string.h>
+#include "python_globals.h"
+
+static pthread_key_t spy_tls_key;
+static pthread_once_t spy_tls_once = PTHREAD_ONCE_INIT;
+
+static void spy_tls_key_init()
+{
+  pthread_key_create(&spy_tls_key, NULL);
+}
+
+static void* SPY_TLS_GET()
+{
+  pthread_once(&spy_tls_once, spy_tls_key_init);
+  return pthread_getspecific(spy_tls_key);
+}
+
+static void SPY_TLS_SET(void* p)
+{
+  pthread_once(&spy_tls_once, spy_tls_key_init);
+  pthread_setspecific(spy_tls_key, p);
+}
+
+#define SPY_INIT_DATA()
+
+#endif /* __SYMBIAN32__ */
+
 extern "C" {
-#ifdef USE_GLOBAL_DATA_HACK 
+#ifdef USE_GLOBAL_DATA_HACK
+#ifdef SPY_CACHED_GLOBALS
+  // read directly by PYTHON_GLOBALS inside the core DLL
+  SPy_Python_globals *_SPy_cached_globals=NULL;
+#define __python_globals _SPy_cached_globals
+#else
   static SPy_Python_globals *__python_globals=NULL;
+#endif
   //static int __python_globals=0;
 #endif
   DL_EXPORT(SPy_Python_globals*) SPy_get_globals()
@@ -40,12 +83,12 @@ extern "C" {
     //if (!__python_globals)
     //  __python_globals=((((SPy_Tls*)Dll::Tls())->globals));
     //return __python_globals;
-    return ((((SPy_Tls*)Dll::Tls())->globals));
+    return ((((SPy_Tls*)SPY_TLS_GET())->globals));
   }
 
   DL_EXPORT(SPy_Python_thread_locals*) SPy_get_thread_locals()
   {
-    return ((((SPy_Tls*)Dll::Tls())->thread_locals));
+    return ((((SPy_Tls*)SPY_TLS_GET())->thread_locals));
   }
 
   extern void _Py_None_Init();             // Objects\object.c
@@ -88,19 +131,19 @@ int SPy_tls_initialize(SPy_Python_globals* pg)
   ptls->globals = pg;
 
   memset(ptls->thread_locals, 0, sizeof(SPy_Python_thread_locals));
-  Dll::SetTls(ptls);
+  SPY_TLS_SET(ptls);
   
   return 0;
 }
 
 void SPy_tls_finalize(int fini_globals)
 {
-  SPy_Tls* ptls = (SPy_Tls*)Dll::Tls();
+  SPy_Tls* ptls = (SPy_Tls*)SPY_TLS_GET();
   delete ptls->thread_locals;
   if (fini_globals)
     delete ptls->globals;
   delete ptls;
-  Dll::SetTls(0);
+  SPY_TLS_SET(0);
 }
 
 int SPy_globals_initialize(void* interpreter)
@@ -117,13 +160,16 @@ int SPy_globals_initialize(void* interpreter)
     return (-1);
   }
 #ifdef USE_GLOBAL_DATA_HACK
-  Dll::InitialiseData();  
+  SPY_INIT_DATA();
   __python_globals=pg;
 #endif
   pg->interpreter = interpreter;
 
   if (init_globals()) {
     SPy_tls_finalize(1);
+#ifdef USE_GLOBAL_DATA_HACK
+    __python_globals=NULL;
+#endif
     return (-1);
   }
 
@@ -139,11 +185,33 @@ void SPy_globals_finalize()
   obmalloc_globals_fini();
 #endif
   SPy_tls_finalize(1);
+#ifdef USE_GLOBAL_DATA_HACK
+  __python_globals=NULL;
+#endif
 }
 
+#ifndef MAXSAVEDTUPLES
+#define MAXSAVEDTUPLES 2000     // Objects\tupleobject.c
+#endif
+#ifndef PyList_MAXFREELIST
+#define PyList_MAXFREELIST 80   // Objects\listobject.c
+#endif
+#ifndef PyDict_MAXFREELIST
+#define PyDict_MAXFREELIST 80   // Objects\dictobject.c
+#endif
+
 static int init_globals()
 {
+  SPy_Python_globals* pg = PYTHON_GLOBALS;
+
   PyImport_Inittab = (struct _inittab *)&(_PyImport_Inittab[0]);
+
+  // default free list limits, see PyFreeListStats in objimpl.h
+  pg->tuple_freelist.limit = MAXSAVEDTUPLES;
+  pg->list_freelist.limit = PyList_MAXFREELIST;
+  pg->dict_freelist.limit = PyDict_MAXFREELIST;
+  pg->int_freelist.limit = -1;
+  pg->float_freelist.limit = -1;
 #ifdef WITH_PYMALLOC
   // initialize object allocator
   if (obmalloc_globals_init())
@@ -143,6 +143,15 @@ extern "C" {
     } pendingcalls[NPENDINGCALLS];     // Python\ceval.c
     PyThread_type_lock interpreter_lock;
     long main_thread;
+    int gil_locked;
+    volatile int gil_drop_request;
+    int gil_waiter_priority;
+    void *gil_waiters;
+    unsigned long gil_since;
+    unsigned long gil_interval;
+#define GIL_SPARE_LOCKS 4
+    PyThread_type_lock gil_spare[GIL_SPARE_LOCKS];
+    int gil_nspare;
     int pendingfirst;
     int pendinglast;
     int things_to_do;
@@ -241,6 +250,7 @@ extern "C" {
     PyObject *whatstrings[4];   // Python\sysmodule.c
     PyObject *warnoptions;
     int thread_initialized;     // Python\thread.c
+    int thread_tick_period;     // Python\thread_symbian.h
     int _PyOS_opterr;           // Python\getopt.c
     int _PyOS_optind;
     char *_PyOS_optarg;
@@ -286,7 +296,6 @@ extern "C" {
     PyObject *instance_hex_o;
     PyMethodObject *classobj_free_list;
     PyObject *complexstr;          // Objects\complexobject.c
-    PyObject *dummy;               // Objects\dictobject.c
     PyObject* xreadlines_function; // Objects\fileobject.c
     PyObject *not_yet_string;
     void *block_list;              // floatobject.c 
@@ -317,11 +326,13 @@ extern "C" {
     PyObject *unicodestr;
 #ifdef WITH_PYMALLOC
     void* usedpools;             // Objects\obmalloc.c
-    void* freepools;
-    unsigned int arenacnt;
-    unsigned int watermark;
-    void* arenalist;
-    void* arenabase;
+    struct arena_object* arenas;
+    unsigned int maxarenas;
+    struct arena_object* unused_arena_objects;
+    struct arena_object* usable_arenas;
+    unsigned int narenas;
+    unsigned long arenas_allocated;
+    unsigned long arenas_freed;
 #endif
     PyObject _Py_EllipsisObject; // Objects\sliceobject.c
     // stringobject.c :
@@ -333,11 +344,16 @@ extern "C" {
     void *nullstring;
 #endif
     PyObject *interned; 
+    unsigned long intern_requests;
+    unsigned long intern_cached;
+    unsigned long intern_found;
+    unsigned long intern_added;
 #ifndef MAXSAVESIZE
 #define MAXSAVESIZE     20  /* Largest tuple to save on free list */
 #endif
     void *free_tuples[MAXSAVESIZE];     // Objects\tupleobject.c
     int num_free_tuples[MAXSAVESIZE];
+    PyFreeListStats tuple_freelist;
     slotdef* slotdefs;  // Objects\typeobject.c
     PyObject *bozo_obj;
     PyObject *finalizer_del_str;
@@ -457,6 +473,27 @@ extern "C" {
     int thread_locals_read_count;
     int tls_mode;
 #endif
+    int _LinenoFlag;                   // Python\compile.c
+    int _NoPeepholeFlag;               // Python\compile.c
+    Py_dictversion_t dict_version;     // Objects\dictobject.c
+    void *dict_keys_free_list;         // Objects\dictobject.c
+    int dict_keys_numfree;
+    void *dict_free_list;              // Objects\dictobject.c
+    PyFreeListStats dict_freelist;
+    void *list_free_list;              // Objects\listobject.c
+    PyFreeListStats list_freelist;
+    PyFreeListStats int_freelist;      // Objects\intobject.c
+    int int_trim_at;
+    PyFreeListStats float_freelist;    // Objects\floatobject.c
+    int float_trim_at;
+    unsigned long globalcache_hits;    // Python\ceval.c
+    unsigned long globalcache_misses;  // Python\ceval.c
+    Py_typeepoch_t type_epoch;         // Objects\typeobject.c
+    struct _method_cache_entry *method_cache; // Objects\typeobject.c
+    unsigned long methodcache_hits;    // Objects\typeobject.c
+    unsigned long methodcache_misses;  // Objects\typeobject.c
+    unsigned long attrcache_hits;      // Python\ceval.c
+    unsigned long attrcache_misses;    // Python\ceval.c
   } SPy_Python_globals;
 
   typedef struct {
@@ -472,7 +509,21 @@ extern "C" {
   DL_IMPORT(SPy_Python_globals*) SPy_get_globals()  __attribute__((const));
   DL_IMPORT(SPy_Python_thread_locals*) SPy_get_thread_locals();
 
-#define PYTHON_GLOBALS (SPy_get_globals())
+  /* SPY_CACHED_GLOBALS: inside the core DLL, read the globals pointer
+     straight from writable static data instead of calling through
+     SPy_get_globals() and Dll::Tls().  Needs DLL data (see
+     USE_GLOBAL_DATA_HACK); extension DLLs cannot import data, so they
+     always take the function call.  Py_BUILD_CORE is defined only by
+     core.mmp. */
+#if defined(SPY_CACHED_GLOBALS) && defined(USE_GLOBAL_DATA_HACK) && \
+    defined(Py_BUILD_CORE)
+  extern SPy_Python_globals *_SPy_cached_globals;
+#define SPY_GLOBALS_LOOKUP (_SPy_cached_globals)
+#else
+#define SPY_GLOBALS_LOOKUP (SPy_get_globals())
+#endif
+
+#define PYTHON_GLOBALS SPY_GLOBALS_LOOKUP
 #define PYTHON_TLS (SPy_get_thread_locals())
 
 #ifdef __cplusplus
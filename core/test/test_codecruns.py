@@ -0,0 +1,107 @@
+#
+# test_codecruns.py
+#
+# Copyright (c) 2005 Nokia Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# The UTF-8, Latin-1 and ASCII codecs check runs of ASCII (or Latin-1)
+# a machine word at a time.  Decode and encode text whose runs start at
+# every offset from 0 to 8 and have other characters at and around the
+# word boundaries, under each errors handler, and compare with a
+# character at a time reference.
+
+import testutil
+
+ERROR = None
+HANDLERS = ['strict', 'ignore', 'replace']
+
+# (encoded, decoded) of characters that end a run
+DECODE_STOPS = {
+    'utf-8': [('\xc3\xa9', u'\xe9'), ('\xe2\x82\xac', u'\u20ac'),
+              ('\xff', ERROR)],
+    'latin-1': [('\xe9', u'\xe9'), ('\xff', u'\xff')],
+    'ascii': [('\xe9', ERROR), ('\x80', ERROR)],
+}
+ENCODE_STOPS = {
+    'utf-8': [('\xc3\xa9', u'\xe9'), ('\xe2\x82\xac', u'\u20ac')],
+    'latin-1': [('\xe9', u'\xe9'), (ERROR, u'\u20ac'), (ERROR, u'\u0100')],
+    'ascii': [(ERROR, u'\xe9'), (ERROR, u'\x80')],
+}
+
+LENGTH = 32
+
+def texts(stops):
+    # Runs start at offset o, after a stop at o - 1 when o > 0, and are
+    # ended by stops around the word boundaries that follow.
+    r = []
+    for o in range(9):
+        for k in range(o, o + 18):
+            for k2 in (None, k + 1, k + 3, k + 7, k + 8, k + 9):
+                for stop in stops:
+                    tokens = []
+                    for i in range(LENGTH):
+                        c = chr(ord('a') + i % 26)
+                        tokens.append((c, unicode(c)))
+                    if o > 0:
+                        tokens[o - 1] = stop
+                    tokens[k] = stop
+                    if k2 is not None and k2 < LENGTH:
+                        tokens[k2] = stops[(k2 + o) % len(stops)]
+                    r.append((o, tokens))
+    return r
+
+def expected(tokens, side, errors, replacement):
+    r = []
+    for t in tokens:
+        if t[side] is not ERROR:
+            r.append(t[side])
+        elif errors == 'strict':
+            return ERROR
+        elif errors == 'replace':
+            r.append(replacement)
+    if side == 0:
+        return ''.join(r)
+    return u''.join(r)
+
+def test_decode():
+    for enc in DECODE_STOPS.keys():
+        for o, tokens in texts(DECODE_STOPS[enc]):
+            s = 'x' * o
+            for t in tokens:
+                s = s + t[0]
+            for errors in HANDLERS:
+                want = expected(tokens, 1, errors, u'\ufffd')
+                # a buffer object decodes from an unaligned address
+                try:
+                    got = unicode(buffer(s, o), enc, errors)
+                except UnicodeError:
+                    got = ERROR
+                assert got == want, (enc, errors, o, s, got, want)
+
+def test_encode():
+    for enc in ENCODE_STOPS.keys():
+        for o, tokens in texts(ENCODE_STOPS[enc]):
+            u = u''
+            for t in tokens:
+                u = u + t[1]
+            for errors in HANDLERS:
+                want = expected(tokens, 0, errors, '?')
+                try:
+                    got = u.encode(enc, errors)
+                except UnicodeError:
+                    got = ERROR
+                assert got == want, (enc, errors, o, u, got, want)
+
+testutil.run(globals())
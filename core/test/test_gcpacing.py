@@ -0,0 +1,54 @@
+#
+# test_gcpacing.py
+#
+# Copyright (c) 2005 Nokia Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# An incremental collection of the oldest generation must finish even
+# when the program allocates and promotes faster than the slices go.
+
+import gc
+import testutil
+
+class Node:
+    pass
+
+def test_dead_cycles_freed():
+    gc.enable()
+    gc.collect()
+    old_threshold = gc.get_threshold()
+    old_budget = gc.get_budget()
+    gc.set_threshold(700, 10, 1)
+    gc.set_budget(100)
+    try:
+        nodes = []
+        for i in range(20000):
+            a = Node(); b = Node(); a.b = b; b.a = a
+            nodes.append(a)
+        gc.collect()
+        del nodes, a, b
+        collected = gc.get_stats()[2]['collected']
+        live = []
+        for i in range(2000000):
+            x = [i]
+            if i % 10 == 0:
+                live.append(x)
+        collected = gc.get_stats()[2]['collected'] - collected
+        assert collected >= 40000, collected
+    finally:
+        apply(gc.set_threshold, old_threshold)
+        apply(gc.set_budget, old_budget)
+
+testutil.run(globals())
@@ -0,0 +1,47 @@
+#
+# test_intern.py
+#
+# Copyright (c) 2005 Nokia Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# getattr() and hasattr() look attribute names up through their interned
+# copies, but must not intern names that are not interned already: the
+# interned table never shrinks.
+
+import sys
+import testutil
+
+class C:
+    pass
+
+def test_no_growth():
+    o = C()
+    o.attr_5 = 1
+    before = sys.getinternstats()['strings']
+    for i in range(20000):
+        getattr(o, 'attr_%d' % i, None)
+        hasattr(o, 'x_%d' % i)
+    assert sys.getinternstats()['strings'] - before < 100
+
+def test_lookup():
+    o = C()
+    o.spam = 1
+    name = ''.join(['sp', 'am'])
+    assert getattr(o, name) == 1
+    assert hasattr(o, name)
+    assert getattr(o, 'eggs' + name, 2) == 2
+    assert not hasattr(o, 'eggs' + name)
+
+testutil.run(globals())
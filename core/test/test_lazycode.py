@@ -0,0 +1,130 @@
+#
+# test_lazycode.py
+#
+# Copyright (c) 2005 Nokia Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Code nested in a .pyc is read only up to its docstring when the .pyc
+# is imported, and the rest is read when the code first runs or is
+# looked into.  A module imported from a .pyc must behave like the same
+# source compiled in place.  Each check imports the .pyc afresh, so the
+# code it looks at has not been loaded yet.
+
+import sys, imp, marshal
+import testutil
+
+SOURCE = '''
+"""module doc"""
+def outer(a):
+    """outer doc"""
+    b = a * 2
+    def middle(c):
+        "middle doc"
+        def inner(d):
+            return a, b, c, d
+        return inner
+    return middle
+class K:
+    """class doc"""
+    def m(self, x=3):
+        "method doc"
+        y = x + 1
+        return y
+    def nodoc(self):
+        return None
+lam = lambda: 'first const'
+def lines(n):
+    x = 1
+    y = 2.5
+
+    return x + y * n, u'uni', ('t', 1)
+'''
+
+def pyc_path():
+    script = sys.argv[0]
+    i = max(script.rfind('/'), script.rfind('\\'))
+    return script[:i + 1] + 'lazycode_mod.pyc'
+
+PYC = pyc_path()
+SEQ = [0]
+
+def write_pyc():
+    f = open(PYC, 'wb')
+    f.write(imp.get_magic())
+    f.write('\0\0\0\0')
+    marshal.dump(compile(SOURCE, PYC, 'exec'), f)
+    f.close()
+
+def lazy():
+    SEQ[0] = SEQ[0] + 1
+    return imp.load_compiled('lazycode_mod%d' % SEQ[0], PYC)
+
+def eager():
+    m = imp.new_module('lazycode_eager')
+    exec compile(SOURCE, PYC, 'exec') in m.__dict__
+    return m
+
+def test_closures():
+    assert lazy().outer(1)(2)(3) == (1, 2, 2, 3)
+    assert lazy().outer(1)(2)(3) == eager().outer(1)(2)(3)
+
+def test_docstrings():
+    for m in (lazy(), eager()):
+        assert m.__doc__ == 'module doc'
+        assert m.outer.__doc__ == 'outer doc'
+        assert m.outer(0).__doc__ == 'middle doc'
+        assert m.K.__doc__ == 'class doc'
+        assert m.K.m.__doc__ == 'method doc'
+        assert m.K.nodoc.__doc__ is None
+    assert lazy().lam.__doc__ == eager().lam.__doc__
+    assert lazy().lam() == 'first const'
+
+def test_getters():
+    e = eager()
+    for name in ('outer', 'lines'):
+        code = getattr(e, name).func_code
+        for attr in ('co_consts', 'co_varnames', 'co_lnotab', 'co_code',
+                     'co_names', 'co_nlocals', 'co_stacksize',
+                     'co_firstlineno'):
+            assert getattr(getattr(lazy(), name).func_code, attr) == \
+                   getattr(code, attr), (name, attr)
+    assert lazy().K.m.im_func.func_code.co_varnames == ('self', 'x', 'y')
+    assert lazy().lines(2) == e.lines(2)
+
+def test_hash_compare():
+    a = lazy().lines.func_code
+    b = lazy().lines.func_code
+    c = eager().lines.func_code
+    assert hash(a) == hash(c)
+    assert a == b and b == c
+    assert lazy().outer.func_code != c
+
+def test_marshal():
+    e = eager()
+    for name in ('outer', 'lines', 'lam'):
+        code = getattr(lazy(), name).func_code
+        s = marshal.dumps(code)
+        assert s == marshal.dumps(getattr(e, name).func_code), name
+        assert marshal.loads(s) == code
+
+write_pyc()
+try:
+    testutil.run(globals())
+finally:
+    try:
+        import os
+        os.remove(PYC)
+    except (ImportError, OSError):
+        pass
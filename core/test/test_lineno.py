@@ -0,0 +1,63 @@
+#
+# test_lineno.py
+#
+# Copyright (c) 2005 Nokia Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# f_lineno of a frame that has not run any code yet, as seen by the
+# 'call' trace event, is the line of its def statement.
+
+from __future__ import generators
+import sys
+import testutil
+
+def trace_calls(func):
+    events = []
+    def tracer(frame, event, arg):
+        if event == 'call':
+            events.append((frame.f_code.co_name,
+                           frame.f_lineno - frame.f_code.co_firstlineno))
+        return tracer
+    sys.settrace(tracer)
+    try:
+        func()
+    finally:
+        sys.settrace(None)
+    return events
+
+def add_one(x):
+    y = x + 1
+    return y
+
+def count(n):
+    for i in range(n):
+        yield i
+
+def test_function():
+    assert trace_calls(lambda: add_one(1))[1:] == [('add_one', 0)]
+
+def test_generator():
+    events = trace_calls(lambda: list(count(2)))[1:]
+    assert events[0] == ('count', 0), events
+    # resuming reports the line of the yield
+    for e in events[1:]:
+        assert e == ('count', 2), events
+
+def test_running():
+    def h():
+        return sys._getframe().f_lineno
+    assert h() == h.func_code.co_firstlineno + 1
+
+testutil.run(globals())
@@ -0,0 +1,321 @@
+#
+# test_peephole.py
+#
+# Copyright (c) 2005 Nokia Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# The peephole optimizer must not change what code does.  The library
+# modules and a set of snippets aimed at each rewrite are compiled and run
+# with the optimizer off and on (sys.setpeephole()), and the results of
+# the two runs are compared.
+
+import sys, imp
+import testutil
+
+# Dependencies first: each module is loaded from source by load_module(),
+# and finds the modules loaded before it in sys.modules.
+MODULES = ['__future__', 'types', 'stat', 'string', 'copy_reg', 'copy',
+           'repr', 'keyword', 'StringIO', 'sre_constants', 'sre_parse',
+           'sre_compile', 'sre', 're', 'base64', 'quopri', 'uu',
+           'whrandom', 'random', 'urlparse', 'rfc822', 'mimetools',
+           'codecs', 'linecache', 'traceback', 'warnings', 'weakref',
+           'atexit', 'codeop', 'code', 'ntpath', 'shutil', 'tarfile',
+           'zipfile']
+
+def lib_dirs():
+    script = sys.argv[0]
+    i = max(script.rfind('/'), script.rfind('\\'))
+    if i >= 0:
+        sep = script[i]
+        return [script[:i] + sep + '..' + sep + 'Lib'] + sys.path
+    return ['../Lib', '..\\Lib'] + sys.path
+
+def find_source(name):
+    for d in lib_dirs():
+        for sep in ('/', '\\'):
+            if d:
+                path = d + sep + name + '.py'
+            else:
+                path = name + '.py'
+            try:
+                f = open(path)
+            except IOError:
+                continue
+            source = f.read()
+            f.close()
+            return path, source.replace('\r\n', '\n')
+    return None, None
+
+def load_module(name):
+    path, source = find_source(name)
+    if path is None:
+        return None, 'no source'
+    code = compile(source + '\n', path, 'exec')
+    m = imp.new_module(name)
+    m.__file__ = path
+    sys.modules[name] = m
+    try:
+        exec code in m.__dict__
+    except:
+        del sys.modules[name]
+        return None, '%s: %s' % sys.exc_info()[:2]
+    return m, 'loaded'
+
+def quopri_roundtrip(m):
+    s = m.encodestring('caf\xe9 = 100%\t\n')
+    return s, m.decodestring(s)
+
+def stringio_lines(m):
+    f = m.StringIO()
+    for i in range(5):
+        f.write('line %d\n' % i)
+    f.seek(0)
+    return f.readlines()
+
+def rfc822_headers(m):
+    import StringIO
+    msg = m.Message(StringIO.StringIO(
+        'From: A <a@b.c>\nSubject: peep\n  hole\nTo: x@y, z@w\n\nbody\n'))
+    return msg.getaddr('from'), msg['subject'], msg.getaddrlist('to')
+
+EXERCISES = {
+    '__future__': lambda m: m.generators.getMandatoryRelease(),
+    'types': lambda m: (m.FunctionType.__name__, m.StringTypes),
+    'stat': lambda m: (m.S_ISDIR(040755), m.S_IMODE(0100644)),
+    'string': lambda m: (m.join(m.split(' a b  c '), '-'),
+                         m.capwords('hello  world'), m.zfill('-42', 6),
+                         m.atoi('0x1f', 0), m.translate('abc',
+                             m.maketrans('ab', 'ba'))),
+    'copy': lambda m: m.deepcopy([1, {'a': (2, [3])}, 'x']),
+    'repr': lambda m: (m.repr(range(100)), m.repr('x' * 100)),
+    'keyword': lambda m: (m.iskeyword('finally'), len(m.kwlist)),
+    'StringIO': stringio_lines,
+    'sre_parse': lambda m: m.parse(r'a|b(c+)?').data,
+    're': lambda m: (m.sub(r'(\w+) (\w+)', r'\2 \1', 'hello world foo bar'),
+                     m.findall(r'\d+', 'a1b22c333'),
+                     m.split(r'[,;]\s*', 'a, b;c'),
+                     m.match(r'(?P<x>a+)(b*)c', 'aaabbc').groups(),
+                     m.compile(r'(?i)x[a-f]+$').search('..XABC') is None),
+    'base64': lambda m: m.decodestring(m.encodestring('peephole' * 10)),
+    'quopri': quopri_roundtrip,
+    'whrandom': lambda m: m.whrandom(1, 2, 3).random(),
+    'random': lambda m: m.Random(5).random(),
+    'urlparse': lambda m: (m.urlsplit('http://www.x.org:80/p?q=1#f'),
+                           m.urlsplit('ftp://h/a/b?x#y', 'http', 0)),
+    'rfc822': rfc822_headers,
+    'codecs': lambda m: (m.utf_8_encode(u'caf\xe9'),
+                         m.BOM_LE, m.BOM_BE),
+    'traceback': lambda m: m.format_exception_only(ValueError,
+                                                   ValueError('x')),
+    'codeop': lambda m: (m.compile_command('if 1:') is None,
+                         m.compile_command('x = 1') is None),
+    'ntpath': lambda m: (m.join('a', 'b'), m.splitext('x.py'),
+                         m.normpath('a/./b/../c')),
+}
+
+def run_modules():
+    saved = sys.modules.copy()
+    results = []
+    try:
+        for name in MODULES:
+            m, status = load_module(name)
+            r = None
+            if m is not None and EXERCISES.has_key(name):
+                try:
+                    r = repr(EXERCISES[name](m))
+                except:
+                    r = '%s: %s' % sys.exc_info()[:2]
+            results.append((name, status, r))
+    finally:
+        sys.modules.clear()
+        sys.modules.update(saved)
+    return results
+
+SNIPPETS = {
+'constant_conditions': '''
+def f(n):
+    r = []
+    for i in range(n):
+        if 0: r.append('never')
+        if 1: r.append(i)
+        while 0: r.append('x')
+        if not 0: r.append(-i)
+        if not 1: r.append('never')
+    while 1:
+        n = n - 1
+        if n < 0: break
+    return r, n
+result = f(4)
+''',
+'not_jump': '''
+def f(vals):
+    out = []
+    for v in vals:
+        if not v: out.append('f')
+        else: out.append('t')
+        if not (v and 1): out.append('n')
+        out.append(not v)
+        while not v:
+            v = 1
+            out.append('w')
+    return out
+result = f([0, 1, '', 'a', [], [0], None, 0.0])
+''',
+'swaps': '''
+log = []
+def g(v):
+    log.append(v)
+    return v
+def f(a, b, c):
+    a, b = b, a
+    a, b, c = c, a, b
+    x, y = a, b
+    (p, q), r = (b, a), c
+    [s, t] = a, b
+    u, w = g(a), g(b)
+    return a, b, c, x, y, p, q, r, s, t, u, w
+result = f(1, 'two', [3]), log
+''',
+'jump_chains': '''
+def f(n):
+    out = []
+    i = 0
+    while i < n:
+        i = i + 1
+        if i % 2 and i % 3:
+            continue
+        elif i % 5 or not i % 7:
+            out.append(('a', i))
+        else:
+            for j in range(i):
+                if j > 2: break
+                if j == 1: continue
+                out.append(('b', i, j))
+            else:
+                out.append('else')
+        out.append((i > 3 and i < 8) or (i == 10 and 'ten') or None)
+        out.append(i and 0 or 'zero')
+    return out
+result = f(12)
+''',
+'try_finally': '''
+def f(n):
+    out = []
+    for i in range(n):
+        try:
+            if i == 1: continue
+            if i == 3: break
+            out.append(i)
+        finally:
+            out.append(-i)
+    return out
+def g():
+    try:
+        return 'try'
+    finally:
+        pass
+def h():
+    out = []
+    try:
+        try:
+            1/0
+        finally:
+            out.append('inner')
+    except ZeroDivisionError:
+        out.append('caught')
+    return out
+def k(x):
+    while 1:
+        try:
+            if x: return 'ret'
+            break
+        finally:
+            x = 'finally'
+    return x
+result = f(5), g(), h(), k(1), k(0)
+''',
+}
+
+def code_strings(co):
+    r = [co.co_code]
+    for c in co.co_consts:
+        if type(c) is type(co):
+            r = r + code_strings(c)
+    return r
+
+def run_snippets():
+    results = []
+    names = SNIPPETS.keys()
+    names.sort()
+    for name in names:
+        co = compile(SNIPPETS[name], name, 'exec')
+        d = {}
+        exec co in d
+        results.append((name, repr(d['result']), code_strings(co)))
+    return results
+
+def compare(off, on):
+    assert len(off) == len(on)
+    for i in range(len(off)):
+        assert off[i][:2] == on[i][:2], (off[i][:2], on[i][:2])
+
+def test_peephole():
+    flag = sys.getpeephole()
+    try:
+        sys.setpeephole(0)
+        mods_off = run_modules()
+        snips_off = run_snippets()
+        sys.setpeephole(1)
+        mods_on = run_modules()
+        snips_on = run_snippets()
+    finally:
+        sys.setpeephole(flag)
+    compare(mods_off, mods_on)
+    compare(snips_off, snips_on)
+    # the optimizer must actually have run
+    changed = 0
+    for i in range(len(snips_off)):
+        if snips_off[i][2] != snips_on[i][2]:
+            changed = changed + 1
+    assert changed > 0
+    loaded = 0
+    for name, status, r in mods_on:
+        if status == 'loaded':
+            loaded = loaded + 1
+    assert loaded > 0
+    print '%d modules loaded, %d of %d snippets rewritten' % (
+        loaded, changed, len(snips_on))
+
+def finite(x):
+    # floats compare with cmp(), so a NaN equals everything
+    return not (x == 1.0 and x == 2.0) and -MAX_FLOAT <= x <= MAX_FLOAT
+
+MAX_FLOAT = 1.7976931348623157e308
+
+def test_fold_nonfinite():
+    # marshal writes floats as text, and some C libraries' atof() can't
+    # read back what an infinity or a NaN turns into
+    for src in ('x = 1e200 * 1e200', 'x = -1e308 * 10.0',
+                'x = (1e308 + 1e308) - (1e308 + 1e308)',
+                'x = (1e200 + 1e200j) * 1e200', 'x = -(1e300j * 1e300j)'):
+        co = compile(src, 'fold', 'exec')
+        for c in co.co_consts:
+            if type(c) is type(0.0):
+                assert finite(c), (src, c)
+            elif type(c) is type(0j):
+                assert finite(c.real) and finite(c.imag), (src, c)
+    assert 6.0 in compile('x = 2.0 * 3.0', 'fold', 'exec').co_consts
+
+testutil.run(globals())
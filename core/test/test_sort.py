@@ -0,0 +1,175 @@
+#
+# test_sort.py
+#
+# Copyright (c) 2005 Nokia Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# list.sort() is stable, takes a key function with or without a compare
+# function, leaves the list a permutation of itself when a compare or key
+# function raises, and raises TypeError if the list is changed while it
+# is being sorted.
+
+import testutil
+
+# Lengths on both sides of the 64 items below which the sort only uses
+# binary insertion, and long enough to merge runs and gallop.
+SIZES = [0, 1, 2, 7, 63, 64, 65, 200, 1000, 5000]
+
+def numbers(n, seed=1):
+    r = []
+    x = seed
+    for i in range(n):
+        x = (x * 1103515245 + 12345) & 0x7fffffff
+        r.append(x >> 8)
+    return r
+
+def shapes(n):
+    # random, sorted, reversed, sorted with a few swaps, few distinct values
+    rnd = numbers(n)
+    part = range(n)
+    for i in range(0, n - 1, 17):
+        part[i], part[i + 1] = part[i + 1], part[i]
+    few = []
+    for x in rnd:
+        few.append(x % 4)
+    down = range(n)
+    down.reverse()
+    return [rnd, range(n), down, part, few]
+
+def check_stable(items, sorted_items):
+    # items are (key, original position); equal keys keep their order
+    assert len(sorted_items) == len(items)
+    for i in range(1, len(sorted_items)):
+        a, b = sorted_items[i - 1], sorted_items[i]
+        assert a[0] < b[0] or (a[0] == b[0] and a[1] < b[1]), (a, b)
+
+def test_sorted():
+    for n in SIZES:
+        for data in shapes(n):
+            a = data[:]
+            a.sort()
+            for i in range(1, n):
+                assert a[i - 1] <= a[i]
+            b = data[:]
+            b.sort(lambda x, y: cmp(y, x))
+            a.reverse()
+            assert a == b
+
+def test_stability():
+    for n in SIZES:
+        for data in shapes(n):
+            items = []
+            for i in range(n):
+                items.append((data[i] % 10, i))
+            a = items[:]
+            a.sort(lambda x, y: cmp(x[0], y[0]))
+            check_stable(items, a)
+            b = items[:]
+            b.sort(key=lambda x: x[0])
+            assert a == b
+            c = items[:]
+            c.sort(cmp=lambda x, y: cmp(x, y), key=lambda x: x[0])
+            assert a == c
+
+def test_key():
+    words = ['banana', 'Apple', 'cherry', 'apple', 'Banana', 'date']
+    a = words[:]
+    a.sort(key=lambda s: s.lower())
+    assert a == ['Apple', 'apple', 'banana', 'Banana', 'cherry', 'date']
+    # cmp works on the keys when both are given
+    b = words[:]
+    b.sort(lambda x, y: cmp(y, x), lambda s: s.lower())
+    assert b == ['date', 'cherry', 'banana', 'Banana', 'Apple', 'apple']
+    c = words[:]
+    c.sort(key=None)
+    d = words[:]
+    d.sort(cmp=None)
+    words.sort()
+    assert c == words and d == words
+    # the key function is called once per item
+    calls = []
+    def key(x):
+        calls.append(x)
+        return -x
+    e = numbers(300)
+    e.sort(key=key)
+    assert len(calls) == 300
+    for i in range(1, len(e)):
+        assert e[i - 1] >= e[i]
+
+class Boom(Exception):
+    pass
+
+def test_raising_compare():
+    for n in SIZES[3:]:
+        data = numbers(n)
+        count = [0]
+        def bad(x, y):
+            count[0] = count[0] + 1
+            if count[0] == n:
+                raise Boom
+            return cmp(x, y)
+        a = data[:]
+        try:
+            a.sort(bad)
+        except Boom:
+            pass
+        else:
+            raise AssertionError('no exception from compare')
+        b = a[:]
+        b.sort()
+        c = data[:]
+        c.sort()
+        assert b == c
+        def badkey(x):
+            if x == data[n // 2]:
+                raise Boom
+            return x
+        a = data[:]
+        try:
+            a.sort(key=badkey)
+        except Boom:
+            pass
+        else:
+            raise AssertionError('no exception from key')
+        assert a == data
+
+def test_mutation():
+    for n in (10, 200):
+        a = numbers(n)
+        def mutate(x, y):
+            a.append(x)
+            return cmp(x, y)
+        try:
+            a.sort(mutate)
+        except TypeError:
+            pass
+        else:
+            raise AssertionError('no TypeError')
+        assert len(a) == n
+        def mutate_key(x):
+            del a[0]
+            return x
+        try:
+            a.sort(key=mutate_key)
+        except TypeError:
+            pass
+        else:
+            raise AssertionError('no TypeError')
+        # the list works normally again afterwards
+        a.append(-1)
+        assert len(a) == n + 1
+
+testutil.run(globals())
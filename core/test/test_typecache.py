@@ -0,0 +1,80 @@
+#
+# test_typecache.py
+#
+# Copyright (c) 2005 Nokia Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# The method cache and the LOAD_ATTR caches must see every change to
+# the dict of a base class, also those made with object.__setattr__()
+# and object.__delattr__(), which bypass type.__setattr__.
+
+import testutil
+
+def warm(f, n=10):
+    for i in range(n):
+        r = f()
+    return r
+
+def test_set_through_object():
+    class A(object):
+        def m(s): return 'old'
+    class B(A): pass
+    b = B()
+    assert warm(lambda: b.m()) == 'old'
+    object.__setattr__(A, 'm', lambda s: 'new')
+    assert b.m() == 'new'
+    assert warm(lambda: b.m()) == 'new'
+
+def test_del_through_object():
+    class A(object):
+        def m(s): return 'old'
+    class B(A): pass
+    b = B()
+    assert warm(lambda: b.m()) == 'old'
+    object.__delattr__(A, 'm')
+    try:
+        b.m()
+    except AttributeError:
+        pass
+    else:
+        raise AssertionError('deleted method still found')
+
+def test_class_attribute():
+    class A(object):
+        x = 1
+    class B(A): pass
+    class C(B): pass
+    c = C()
+    assert warm(lambda: c.x) == 1
+    object.__setattr__(A, 'x', 2)
+    assert c.x == 2 and C.x == 2
+    object.__delattr__(A, 'x')
+    assert not hasattr(c, 'x')
+    A.x = 3
+    assert c.x == 3
+
+def test_shadowing():
+    class A(object):
+        def m(s): return 'A'
+    class B(A): pass
+    class C(B): pass
+    c = C()
+    assert warm(lambda: c.m()) == 'A'
+    object.__setattr__(B, 'm', lambda s: 'B')
+    assert c.m() == 'B'
+    object.__delattr__(B, 'm')
+    assert c.m() == 'A'
+
+testutil.run(globals())
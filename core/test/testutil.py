@@ -0,0 +1,38 @@
+#
+# testutil.py
+#
+# Copyright (c) 2005 Nokia Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# The tests in this directory define test_* functions and end with
+# testutil.run(globals()), which calls them in name order and reports
+# success the same way for all of them.
+
+import sys
+
+def script_name():
+    script = sys.argv[0]
+    script = script[max(script.rfind('/'), script.rfind('\\')) + 1:]
+    if script[-3:] == '.py':
+        script = script[:-3]
+    return script
+
+def run(namespace):
+    names = namespace.keys()
+    names.sort()
+    for name in names:
+        if name[:5] == 'test_' and callable(namespace[name]):
+            namespace[name]()
+    print '%s ok' % script_name()
@@ -0,0 +1,146 @@
+# Copyright (c) 2005 Nokia Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Compare eval loop dispatch between interpreter builds.
+
+Build the core twice with gcc, once as configured (USE_COMPUTED_GOTOS,
+threaded-code dispatch) and once with
+
+    #undef USE_COMPUTED_GOTOS
+
+after pyconfig.h is included (the switch), and run
+
+    python dispatch_bench.py [-n RUNS] python_switch python_goto
+
+Each workload spends nearly all its time in eval_frame() running short
+opcodes: int and float arithmetic, comparisons and branches, calls of
+Python functions, and loads and stores of locals, globals and
+attributes.  Each measurement runs the interpreter on a script doing
+the workload, minus a run of a script that does nothing, so no
+interpreter needs a time module.  The best user+sys CPU time out of
+RUNS is reported, with the time relative to the first interpreter.
+"""
+
+import os
+import sys
+import tempfile
+
+WORKLOADS = [
+('arith', '''
+def run():
+    i = 0
+    x = 0
+    y = 0.0
+    while i < 3000000:
+        x = (x + i * 3) & 0xffff
+        y = y * 0.5 + i
+        i = i + 1
+    return x, y
+run()
+'''),
+('branches', '''
+def run():
+    n = 0
+    for i in xrange(3000000):
+        if i & 1 and not i % 3:
+            n = n + 1
+        elif i < 1500000 or i > 2700000:
+            n = n - 1
+        else:
+            n = n ^ i
+    return n
+run()
+'''),
+('calls', '''
+def add(a, b):
+    return a + b
+def run():
+    x = 0
+    for i in xrange(1000000):
+        x = add(x, add(i, 1)) & 0xffff
+    return x
+run()
+'''),
+('names', '''
+class Point:
+    def __init__(self, x, y):
+        self.x = x
+        self.y = y
+limit = 2000000
+def run():
+    p = Point(1, 2)
+    i = 0
+    while i < limit:
+        p.x, p.y = p.y, p.x + 1
+        i = i + 1
+    return p.x
+run()
+'''),
+]
+
+NOTHING = 'pass\n'
+
+def cpu_time(python, script):
+    before = os.times()
+    status = os.spawnv(os.P_WAIT, python, [python, script])
+    after = os.times()
+    if status:
+        raise SystemExit('%s exited with status %d' % (python, status))
+    return (after[2] - before[2]) + (after[3] - before[3])
+
+def best_time(python, text, runs):
+    fd, script = tempfile.mkstemp('.py')
+    os.write(fd, text.encode('ascii'))
+    os.close(fd)
+    try:
+        best = None
+        for i in range(runs):
+            t = cpu_time(python, script)
+            if best is None or t < best:
+                best = t
+    finally:
+        os.remove(script)
+    return best
+
+def main(args):
+    runs = 5
+    if args[:1] == ['-n']:
+        runs = int(args[1])
+        args = args[2:]
+    if not args:
+        sys.stderr.write(__doc__)
+        return 2
+    sys.stdout.write('%-9s' % 'workload')
+    for python in args:
+        sys.stdout.write(' %16s' % os.path.basename(python)[-16:])
+    sys.stdout.write('\n')
+    startup = {}
+    for python in args:
+        startup[python] = best_time(python, NOTHING, runs)
+    for name, text in WORKLOADS:
+        sys.stdout.write('%-9s' % name)
+        base = None
+        for python in args:
+            t = max(best_time(python, text, runs) - startup[python], 0.0)
+            if base is None:
+                base = t
+            if base > 0.0:
+                sys.stdout.write(' %7.3fs %6.1f%%' % (t, 100.0 * t / base))
+            else:
+                sys.stdout.write(' %7.3fs %7s' % (t, '-'))
+        sys.stdout.write('\n')
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,89 @@
+# Copyright (c) 2005 Nokia Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Compare the cost of PYTHON_GLOBALS lookups between interpreter builds.
+
+Build the core twice on the host (python_globals.cpp compiles without
+the Symbian SDK), once plain and once with
+
+    -DUSE_GLOBAL_DATA_HACK -DSPY_CACHED_GLOBALS -DPy_BUILD_CORE
+
+and run
+
+    python globals_bench.py [-n RUNS] python_plain python_cached
+
+The workload below allocates and frees ints, floats, tuples, lists,
+dicts and frames, so nearly every step goes through the type objects
+and free lists kept in SPy_Python_globals.  Each interpreter is run
+RUNS times, alternating, and the best user+sys CPU time is reported.
+"""
+
+import os
+import sys
+import tempfile
+
+WORKLOAD = '''
+def f(a, b):
+    return a + b
+
+def run():
+    d = {}
+    for i in xrange(300000):
+        x = f(i, 1) * 2
+        y = float(i) + 0.5
+        t = (x, y)
+        l = [x, y, t]
+        d[i & 255] = l
+        s = str(i)
+    return len(d)
+
+run()
+'''
+
+def cpu_time(python, script):
+    before = os.times()
+    status = os.spawnv(os.P_WAIT, python, [python, script])
+    after = os.times()
+    if status:
+        raise SystemExit('%s exited with status %d' % (python, status))
+    return (after[2] - before[2]) + (after[3] - before[3])
+
+def main(args):
+    runs = 7
+    if args[:1] == ['-n']:
+        runs = int(args[1])
+        args = args[2:]
+    if not args:
+        sys.stderr.write(__doc__)
+        return 2
+    fd, script = tempfile.mkstemp('.py')
+    os.write(fd, WORKLOAD.encode('ascii'))
+    os.close(fd)
+    try:
+        best = {}
+        for i in range(runs):
+            for python in args:
+                t = cpu_time(python, script)
+                if python not in best or t < best[python]:
+                    best[python] = t
+    finally:
+        os.remove(script)
+    base = best[args[0]]
+    for python in args:
+        sys.stdout.write('%-40s %7.3fs %6.1f%%\n' %
+                         (python, best[python], 100.0 * best[python] / base))
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
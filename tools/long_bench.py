@@ -0,0 +1,94 @@
+# Copyright (c) 2005 Nokia Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Time long multiplication and decimal conversion in interpreter builds.
+
+    python long_bench.py [-n RUNS] python1 [python2 ...]
+
+For operands of 1000, 10000 and 100000 decimal digits, times x*y,
+x*x, str(x) and long(s).  Each measurement runs the interpreter on a
+script that repeats the operation, minus a run of the same script that
+only builds the operands, so no interpreter needs a time module.  The
+best user+sys CPU time out of RUNS is reported, in milliseconds per
+operation.
+"""
+
+import os
+import sys
+import tempfile
+
+SIZES = [(1000, 500), (10000, 20), (100000, 1)]
+OPS = ['x*y', 'x*x', 'str(x)', 'long(s)']
+
+WORKLOAD = '''
+n = %(digits)d
+h = n * 830 / 1000
+x = long(('9e3779b97f4a7c15' * (h / 16 + 1))[:h], 16)
+y = long(('c2b2ae3d27d4eb4f' * (h / 16 + 1))[:h], 16)
+s = ('1234567890' * (n / 10 + 1))[:n]
+for i in xrange(%(reps)d):
+    z = %(op)s
+'''
+
+def cpu_time(python, script):
+    before = os.times()
+    status = os.spawnv(os.P_WAIT, python, [python, script])
+    after = os.times()
+    if status:
+        raise SystemExit('%s exited with status %d' % (python, status))
+    return (after[2] - before[2]) + (after[3] - before[3])
+
+def best_time(python, text, runs):
+    fd, script = tempfile.mkstemp('.py')
+    os.write(fd, text.encode('ascii'))
+    os.close(fd)
+    try:
+        best = None
+        for i in range(runs):
+            t = cpu_time(python, script)
+            if best is None or t < best:
+                best = t
+    finally:
+        os.remove(script)
+    return best
+
+def main(args):
+    runs = 3
+    if args[:1] == ['-n']:
+        runs = int(args[1])
+        args = args[2:]
+    if not args:
+        sys.stderr.write(__doc__)
+        return 2
+    sys.stdout.write('%-8s %-8s' % ('digits', 'op'))
+    for python in args:
+        sys.stdout.write(' %14s' % os.path.basename(python)[-14:])
+    sys.stdout.write('\n')
+    for digits, reps in SIZES:
+        setup = {}
+        for python in args:
+            setup[python] = best_time(python, WORKLOAD % {
+                'digits': digits, 'reps': 0, 'op': 'None'}, runs)
+        for op in OPS:
+            sys.stdout.write('%-8d %-8s' % (digits, op))
+            for python in args:
+                t = best_time(python, WORKLOAD % {
+                    'digits': digits, 'reps': reps, 'op': op}, runs)
+                ms = 1000.0 * max(t - setup[python], 0.0) / reps
+                sys.stdout.write(' %12.3fms' % ms)
+            sys.stdout.write('\n')
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,112 @@
+# Copyright (c) 2005 Nokia Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Time list.sort() on differently ordered input in interpreter builds.
+
+    python sort_bench.py [-n RUNS] python1 [python2 ...]
+
+Sorts lists of 1000 and 100000 ints that are random, already sorted,
+reversed, sorted with 1% of the items replaced, or drawn from only 4
+distinct values, and random lists through a cmp function.  Each
+measurement runs the interpreter on a script that copies and sorts the
+list, minus a run of the same script that only copies it, so no
+interpreter needs a time module.  The best user+sys CPU time out of
+RUNS is reported, in milliseconds per sort.
+"""
+
+import os
+import sys
+import tempfile
+
+SIZES = [(1000, 200), (100000, 2)]
+KINDS = ['random', 'sorted', 'reversed', 'partial', 'few', 'cmp']
+
+WORKLOAD = '''
+n = %(n)d
+kind = '%(kind)s'
+seed = 12345
+L = []
+for i in xrange(n):
+    seed = (seed * 1103515245 + 12345) & 0x7fffffff
+    L.append(seed)
+if kind == 'sorted' or kind == 'partial':
+    L.sort()
+elif kind == 'reversed':
+    L.sort()
+    L.reverse()
+elif kind == 'few':
+    L = [x %% 4 for x in L]
+if kind == 'partial':
+    for i in xrange(n / 100):
+        seed = (seed * 1103515245 + 12345) & 0x7fffffff
+        L[seed %% n] = seed
+for i in xrange(%(reps)d):
+    M = L[:]
+    if %(sort)d:
+        if kind == 'cmp':
+            M.sort(cmp)
+        else:
+            M.sort()
+'''
+
+def cpu_time(python, script):
+    before = os.times()
+    status = os.spawnv(os.P_WAIT, python, [python, script])
+    after = os.times()
+    if status:
+        raise SystemExit('%s exited with status %d' % (python, status))
+    return (after[2] - before[2]) + (after[3] - before[3])
+
+def best_time(python, text, runs):
+    fd, script = tempfile.mkstemp('.py')
+    os.write(fd, text.encode('ascii'))
+    os.close(fd)
+    try:
+        best = None
+        for i in range(runs):
+            t = cpu_time(python, script)
+            if best is None or t < best:
+                best = t
+    finally:
+        os.remove(script)
+    return best
+
+def main(args):
+    runs = 3
+    if args[:1] == ['-n']:
+        runs = int(args[1])
+        args = args[2:]
+    if not args:
+        sys.stderr.write(__doc__)
+        return 2
+    sys.stdout.write('%-8s %-9s' % ('items', 'input'))
+    for python in args:
+        sys.stdout.write(' %14s' % os.path.basename(python)[-14:])
+    sys.stdout.write('\n')
+    for n, reps in SIZES:
+        for kind in KINDS:
+            sys.stdout.write('%-8d %-9s' % (n, kind))
+            for python in args:
+                params = {'n': n, 'kind': kind, 'reps': reps}
+                params['sort'] = 0
+                setup = best_time(python, WORKLOAD % params, runs)
+                params['sort'] = 1
+                t = best_time(python, WORKLOAD % params, runs)
+                ms = 1000.0 * max(t - setup, 0.0) / reps
+                sys.stdout.write(' %12.3fms' % ms)
+            sys.stdout.write('\n')
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,135 @@
+# Copyright (c) 2005 Nokia Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Time zlib in several threads at once in interpreter builds.
+
+    python zlib_bench.py [-n RUNS] [-t THREADS] python1 [python2 ...]
+
+THREADS is a comma separated list of thread counts, 1,2,4 by default.
+Each thread compresses and decompresses a buffer of its own, 256K of
+text and 64K of random bytes, with zlib.compress() and with
+compressobj() in 16K pieces.  The work per thread is fixed, so with
+the interpreter lock released around zlib the elapsed time stays flat
+as threads are added, up to the number of processors.  Each
+measurement is the elapsed time of the interpreter running the
+workload, minus a run that only builds the buffers, so no interpreter
+needs a time module; the best out of RUNS is reported as aggregate
+throughput of input bytes, with the speedup over one thread.
+"""
+
+import os
+import sys
+import tempfile
+
+REPS = 40
+
+WORKLOAD = '''
+import thread, zlib
+
+nthreads = %(threads)d
+seed = 12345
+words = []
+for i in xrange(500):
+    seed = (seed * 1103515245 + 12345) & 0x7fffffff
+    words.append('w%%d' %% (seed %% 3000))
+text = ' '.join(words)
+text = (text * (262144 / len(text) + 1))[:262144]
+noise = []
+for i in xrange(65536):
+    seed = (seed * 1103515245 + 12345) & 0x7fffffff
+    noise.append(chr(seed >> 16 & 0xff))
+noise = ''.join(noise)
+
+def work(buf, done):
+    for i in xrange(%(reps)d):
+        if %(compress)d:
+            for data in (text + str(buf), noise):
+                assert zlib.decompress(zlib.compress(data)) == data
+                c = zlib.compressobj()
+                parts = []
+                for j in xrange(0, len(data), 16384):
+                    parts.append(c.compress(data[j:j + 16384]))
+                parts.append(c.flush())
+                assert zlib.decompress(''.join(parts)) == data
+    done.release()
+
+locks = []
+for i in xrange(nthreads):
+    done = thread.allocate_lock()
+    done.acquire()
+    locks.append(done)
+    thread.start_new_thread(work, (i, done))
+for done in locks:
+    done.acquire()
+'''
+
+# Input bytes one thread passes through zlib per repetition.
+BYTES = 2 * 2 * (262144 + 1 + 65536)
+
+def elapsed(python, script):
+    before = os.times()[4]
+    status = os.spawnv(os.P_WAIT, python, [python, script])
+    after = os.times()[4]
+    if status:
+        raise SystemExit('%s exited with status %d' % (python, status))
+    return after - before
+
+def best_time(python, text, runs):
+    fd, script = tempfile.mkstemp('.py')
+    os.write(fd, text.encode('ascii'))
+    os.close(fd)
+    try:
+        best = None
+        for i in range(runs):
+            t = elapsed(python, script)
+            if best is None or t < best:
+                best = t
+    finally:
+        os.remove(script)
+    return best
+
+def main(args):
+    runs = 3
+    counts = [1, 2, 4]
+    while args[:1] in (['-n'], ['-t']):
+        if args[0] == '-n':
+            runs = int(args[1])
+        else:
+            counts = [int(n) for n in args[1].split(',')]
+        args = args[2:]
+    if not args:
+        sys.stderr.write(__doc__)
+        return 2
+    sys.stdout.write('%-8s' % 'threads')
+    for python in args:
+        sys.stdout.write(' %20s' % os.path.basename(python)[-20:])
+    sys.stdout.write('\n')
+    single = {}
+    for n in counts:
+        sys.stdout.write('%-8d' % n)
+        for python in args:
+            params = {'threads': n, 'reps': REPS}
+            params['compress'] = 0
+            setup = best_time(python, WORKLOAD % params, runs)
+            params['compress'] = 1
+            t = max(best_time(python, WORKLOAD % params, runs) - setup, 1e-6)
+            rate = n * REPS * BYTES / t / (1 << 20)
+            if python not in single:
+                single[python] = rate / n
+            sys.stdout.write(' %9.1fMB/s %6.2fx' % (rate, rate / single[python]))
+        sys.stdout.write('\n')
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))